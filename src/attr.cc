@@ -5,6 +5,7 @@
 //
 
 #include "global.h"
+#include <cstdio>
 #include <cstring>
 using namespace std;
 
@@ -14,7 +15,8 @@ bool Attr::CompareAttrWithRID(AttrType attrType, int attrLength, void* valueA, C
     const RID& ridA = *(RID*)((char*)valueA + attrLength);
     const RID& ridB = *(RID*)((char*)valueB + attrLength);
     switch (attrType) {
-        case INT: {
+        case INT:
+        case DATE: {
             const int& intA = *(int*)valueA;
             const int& intB = *(int*)valueB;
             switch (compOp) {
@@ -56,8 +58,28 @@ bool Attr::CompareAttrWithRID(AttrType attrType, int attrLength, void* valueA, C
             }
             break;
         }
-        case DATE:
-        case PRIMARYKEY:
+        case PRIMARYKEY: {
+            int cmp = memcmp(valueA, valueB, attrLength);
+            switch (compOp) {
+                case NO_OP:
+                    return true;
+                case EQ_OP:
+                    return cmp == 0 && ridA == ridB;
+                case NE_OP:
+                    return !(cmp == 0 && ridA == ridB);
+                case LT_OP:
+                    return cmp < 0 || (cmp == 0 && ridA < ridB);
+                case GT_OP:
+                    return cmp > 0 || (cmp == 0 && ridA > ridB);
+                case LE_OP:
+                    return !(cmp > 0 || (cmp == 0 && ridA > ridB));
+                case GE_OP:
+                    return !(cmp < 0 || (cmp == 0 && ridA < ridB));
+                default:
+                    return false;
+            }
+            break;
+        }
         case STRING: {
             switch (compOp) {
                 case NO_OP:
@@ -103,6 +125,7 @@ bool Attr::CompareAttr(AttrType attrType, int attrLength, void* valueA, CompOp c
     valueB = (char*)valueB + 1;
     switch (attrType) {
         case INT:
+        case DATE:
             switch (compOp) {
                 case NO_OP:
                     return true;
@@ -138,8 +161,26 @@ bool Attr::CompareAttr(AttrType attrType, int attrLength, void* valueA, CompOp c
                     return *(float*)valueA >= *(float*)valueB;
             }
             break;
-        case DATE:
         case PRIMARYKEY:
+            switch (compOp) {
+                case NO_OP:
+                    return true;
+                case EQ_OP:
+                    return memcmp(valueA, valueB, attrLength) == 0;
+                case NE_OP:
+                    return memcmp(valueA, valueB, attrLength) != 0;
+                case LT_OP:
+                    return memcmp(valueA, valueB, attrLength) < 0;
+                case GT_OP:
+                    return memcmp(valueA, valueB, attrLength) > 0;
+                case LE_OP:
+                    return memcmp(valueA, valueB, attrLength) <= 0;
+                case GE_OP:
+                    return memcmp(valueA, valueB, attrLength) >= 0;
+                default:
+                    return false;
+            }
+            break;
         case STRING:
             switch (compOp) {
                 case NO_OP:
@@ -283,3 +324,90 @@ bool Attr::binary_searchWithRID(AttrType attrType, int attrLength, char* first,
     int i = lower_boundWithRID(attrType, attrLength, first, len, value);
     return i != len && !CompareAttrWithRID(attrType, attrLength, value, LT_OP, first + i * attrLength);
 }
+
+int Attr::AlignOffset(AttrType attrType, int offset) {
+    if (attrType == INT || attrType == FLOAT || attrType == DATE) {
+        return (offset + 1 + sizeof(int) - 1) / sizeof(int) * sizeof(int) - 1;
+    }
+    return offset;
+}
+
+int Attr::AlignLength(int length) {
+    return (length + sizeof(int) - 1) / sizeof(int) * sizeof(int);
+}
+
+bool Attr::ParseDate(const char* text, int& day) {
+    if (strlen(text) != 10) {
+        return false;
+    }
+    for (int j = 0; j < 10; ++j) {
+        char c = text[j];
+        if (j == 4 || j == 7) {
+            if (c != '-') return false;
+        } else {
+            if (c < '0' || c > '9') return false;
+        }
+    }
+    int yyyy, mm, dd;
+    sscanf(text, "%d-%d-%d", &yyyy, &mm, &dd);
+    if (dd < 1 || mm < 1 || mm > 12) return false;
+    int end2 = (yyyy % 4 == 0 && yyyy % 100 != 0) || yyyy % 400 == 0 ? 29 : 28;
+    if (mm == 2 && dd > end2) return false;
+    if ((mm == 1 || mm == 3 || mm == 5 || mm == 7 || mm == 8 || mm == 10 || mm == 12) && dd > 31) return false;
+    if ((mm == 4 || mm == 6 || mm == 9 || mm == 11) && dd > 30) return false;
+    // count the days of the years from March, so that the leap day is the
+    // last day of a year
+    int y = yyyy - (mm <= 2);
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yearOfEra = y - era * 400;
+    int dayOfYear = (153 * (mm > 2 ? mm - 3 : mm + 9) + 2) / 5 + dd - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    day = era * 146097 + dayOfEra - 719468;
+    return true;
+}
+
+void Attr::FormatDate(int day, char* text) {
+    int z = day + 719468;
+    int era = (z >= 0 ? z : z - 146096) / 146097;
+    int dayOfEra = z - era * 146097;
+    int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int mp = (5 * dayOfYear + 2) / 153;
+    int dd = dayOfYear - (153 * mp + 2) / 5 + 1;
+    int mm = mp < 10 ? mp + 3 : mp - 9;
+    int yyyy = era * 400 + yearOfEra + (mm <= 2);
+    sprintf(text, "%04d-%02d-%02d", yyyy, mm, dd);
+}
+
+void Attr::EncodeKey(AttrType attrType, int attrLength, const char* value, char* key) {
+    key[0] = value[0];
+    memset(key + 1, 0, attrLength);
+    if (value[0] == 0) {
+        return;
+    }
+    unsigned int bits;
+    switch (attrType) {
+        case INT:
+        case DATE:
+            memcpy(&bits, value + 1, sizeof(int));
+            bits ^= 0x80000000u;
+            break;
+        case FLOAT: {
+            float f;
+            memcpy(&f, value + 1, sizeof(float));
+            // -0.0 and 0.0 are equal
+            if (f == 0) {
+                f = 0;
+            }
+            memcpy(&bits, &f, sizeof(float));
+            bits = (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+            break;
+        }
+        default:
+            strncpy(key + 1, value + 1, attrLength);
+            return;
+    }
+    for (int i = 0; i < 4; ++i) {
+        key[1 + i] = (char)(bits >> (24 - 8 * i));
+    }
+}
@@ -130,6 +130,22 @@ public:
     static pair<int, int> equal_rangeWithRID(AttrType attrType, int attrLength, char* first, int len, char* value);
     static bool binary_search(AttrType attrType, int attrLength, char* first, int len, char* value);
     static bool binary_searchWithRID(AttrType attrType, int attrLength, char* first, int len, char* value);
+    // Lowest offset at or after offset for an attribute (its null flag)
+    // such that an INT or FLOAT value after the flag is aligned.
+    static int AlignOffset(AttrType attrType, int offset);
+    // Tuple length rounded up so that the attributes of consecutive tuples
+    // stay aligned.
+    static int AlignLength(int length);
+    // Day number, counted from 1970-01-01, of a date written as YYYY-MM-DD,
+    // false if the text is not a valid date.
+    static bool ParseDate(const char* text, int& day);
+    // YYYY-MM-DD text of a day number, text has room for 11 bytes.
+    static void FormatDate(int day, char* text);
+    // Writes a value (null flag and attrLength bytes) to key in a form whose
+    // byte order under memcmp is the order of the values: big-endian INT and
+    // DATE with the sign bit flipped, FLOAT bits flipped by sign, STRING
+    // padded with zeros. A PRIMARYKEY value is a flag followed by such keys.
+    static void EncodeKey(AttrType attrType, int attrLength, const char* value, char* key);
 };
 
 /********** RID **********/
@@ -43,6 +43,7 @@ static int mk_fields(NODE *list, int max, Field fields[]);
 static int parse_format_string(char *format_string, AttrType *type, int *len);
 static int mk_rel_attrs(NODE *list, int max, RelAttr relAttrs[]);
 static int mk_relations(NODE *list, int max, char *relations[]);
+static int mk_attrs(NODE *list, int max, char *attrs[]);
 static int mk_setters(NODE *list, int max, RelAttr relAttr[], Value rhsValue[]);
 static int mk_conditions(NODE *list, int max, Condition conditions[]);
 static int mk_values(NODE *list, int max, Value values[]);
@@ -55,6 +56,24 @@ static void print_error(char *errmsg, RC errval);
 RC interp(NODE *n) {
     RC errval = 0; /* returned error value */
 
+    /* Rollback does not undo schema changes, and VACUUM moves the records
+       the undo log refers to: refuse them in a transaction */
+    if (pQlm->InTransaction()) {
+        switch (n -> kind) {
+            case N_CREATEDATABASE:
+            case N_DROPDATABASE:
+            case N_USEDATABASE:
+            case N_CREATETABLE:
+            case N_DROPTABLE:
+            case N_CREATEINDEX:
+            case N_DROPINDEX:
+            case N_VACUUM:
+                return QL_TRANSACTIONOPEN;
+            default:
+                break;
+        }
+    }
+
     switch (n -> kind) {
 
         case N_CREATEDATABASE: /* for CreateDb() */
@@ -95,7 +114,7 @@ RC interp(NODE *n) {
             }
 
             /* Make the call to create */
-            errval = pSmm->CreateTable(n->u.CREATETABLE.relname, nfields, fields);
+            errval = pSmm->CreateTable(n->u.CREATETABLE.relname, nfields, fields, n->u.CREATETABLE.isvariable);
             break;
         }
 
@@ -108,12 +127,43 @@ RC interp(NODE *n) {
             break;
 
         case N_CREATEINDEX: /* for CreateIndex() */
-            errval = pSmm->CreateIndex(n->u.CREATEINDEX.relname, n->u.CREATEINDEX.attrname);
+        {
+            int nAttrs;
+            char *attrs[MAXATTRS];
+            int nIncludes;
+            char *includes[MAXATTRS];
+
+            /* Make lists of the key and included attributes suitable for SM */
+            nAttrs = mk_attrs(n->u.CREATEINDEX.attrlist, MAXATTRS, attrs);
+            if (nAttrs < 0) {
+                print_error((char*)"create index", nAttrs);
+                break;
+            }
+            nIncludes = mk_attrs(n->u.CREATEINDEX.includelist, MAXATTRS, includes);
+            if (nIncludes < 0) {
+                print_error((char*)"create index", nIncludes);
+                break;
+            }
+
+            errval = pSmm->CreateIndex(n->u.CREATEINDEX.relname, nAttrs, attrs, nIncludes, includes);
             break;
+        }
 
         case N_DROPINDEX: /* for DropIndex() */
-            errval = pSmm->DropIndex(n->u.DROPINDEX.relname, n->u.DROPINDEX.attrname);
+        {
+            int nAttrs;
+            char *attrs[MAXATTRS];
+
+            /* Make a list of the key attributes suitable for SM */
+            nAttrs = mk_attrs(n->u.DROPINDEX.attrlist, MAXATTRS, attrs);
+            if (nAttrs < 0) {
+                print_error((char*)"drop index", nAttrs);
+                break;
+            }
+
+            errval = pSmm->DropIndex(n->u.DROPINDEX.relname, nAttrs, attrs);
             break;
+        }
 
         case N_PRINT: /* for Print() */
             errval = pSmm->Print(n->u.PRINT.relname);
@@ -234,6 +284,8 @@ RC interp(NODE *n) {
 
         case N_INSERT: { /* for Insert() */
             NODE *cur = n->u.INSERT.valuelists;
+            /* All rows of the statement are inserted or none is */
+            pQlm->BeginStatement();
             for (; cur != NULL; cur = cur->u.LIST.next) {
                 int nValues = 0;
                 Value values[MAXATTRS];
@@ -248,6 +300,7 @@ RC interp(NODE *n) {
                 /* Make the call to insert */
                 if ((errval = pQlm->Insert(n->u.INSERT.relname, nValues, values))) break;
             }
+            errval = pQlm->EndStatement(errval);
             break;
         }
 
@@ -263,7 +316,9 @@ RC interp(NODE *n) {
             }
 
             /* Make the call to delete */
+            pQlm->BeginStatement();
             errval = pQlm->Delete(n->u.DELETE.relname, nConditions, conditions);
+            errval = pQlm->EndStatement(errval);
             break;
         }
 
@@ -289,10 +344,39 @@ RC interp(NODE *n) {
             }
 
             /* Make the call to update */
+            pQlm->BeginStatement();
             errval = pQlm->Update(n->u.UPDATE.relname, nSetters, relAttr, rhsValue, nConditions, conditions);
+            errval = pQlm->EndStatement(errval);
             break;
         }
 
+        case N_LOAD: /* for Load() */
+            /* The whole file is loaded or nothing is */
+            pQlm->BeginStatement();
+            errval = pQlm->Load(n->u.LOAD.relname, n->u.LOAD.filename);
+            errval = pQlm->EndStatement(errval);
+            break;
+
+        case N_VACUUM: /* for Vacuum() and VacuumFull() */
+            if (n->u.VACUUM.isfull) {
+                errval = pSmm->VacuumFull(n->u.VACUUM.relname);
+            } else {
+                errval = pSmm->Vacuum(n->u.VACUUM.relname, n->u.VACUUM.maxpages);
+            }
+            break;
+
+        case N_BEGIN: /* for Begin() */
+            errval = pQlm->Begin();
+            break;
+
+        case N_COMMIT: /* for Commit() */
+            errval = pQlm->Commit();
+            break;
+
+        case N_ROLLBACK: /* for Rollback() */
+            errval = pQlm->Rollback();
+            break;
+
         default: // should never get here
             break;
     }
@@ -341,14 +425,12 @@ static int mk_fields(NODE *list, int max, Field fields[]) {
                     return E_DUPLICATEATTR;
             switch (attr -> u.ATTRTYPE.type) {
                 case INT:
+                case DATE:
                     len = sizeof(int);
                     break;
                 case FLOAT:
                     len = sizeof(float);
                     break;
-                case DATE:
-                    len = 11;
-                    break;
                 case STRING:
                     len = attr -> u.ATTRTYPE.length + 1;
                     if (len < 1 || len > MAXSTRINGLEN) return E_INVSTRLEN;
@@ -436,6 +518,26 @@ static int mk_relations(NODE *list, int max, char *relations[]) {
     return i;
 }
 
+/*
+ * mk_attrs: converts a list of attribute names into an array of names
+ *
+ * Returns:
+ *    the length of the list on success (>= 0)
+ *    error code otherwise
+ */
+static int mk_attrs(NODE *list, int max, char *attrs[]) {
+    int i;
+    NODE *current;
+    /* for each element of the list... */
+    for (i = 0; list != NULL; ++i, list = list -> u.LIST.next) {
+        /* If the list is too long then error */
+        if (i == max) return E_TOOMANY;
+        current = list -> u.LIST.curr;
+        attrs[i] = current->u.ATTR.attrname;
+    }
+    return i;
+}
+
 /*
  * mk_setters: converts a list of setters into arrays
  *
@@ -13,23 +13,81 @@
 #include "pf.h"
 #include "rm.h"
 #include <map>
+#include <vector>
+#include <cstdio>
 
 #define IX_DEBUG 0
 
+// Default fill factor of the nodes written by a bulk load; the free space
+// left in each node absorbs later inserts without splitting
+#define IX_FILLFACTOR 0.9
+
+// Memory used to sort the entries of a bulk load before spilling a sorted
+// run to a temporary file
+#define IX_SORTBUFFERSIZE (8 << 20)
+
+// Bloom filter on the keys of an index: bits per key it is sized for,
+// number of hash functions and smallest size in words, a power of two so
+// that a hash is masked to a bit (512 words fill a page of bits and most
+// of a second one)
+#define IX_BLOOM_BITSPERKEY 10
+#define IX_BLOOM_HASHES 7
+#define IX_BLOOM_MINWORDS 512
+
+// Pages one tree operation may pin, its path from the root and the
+// siblings and new nodes of its splits
+#define IX_MAXPATHPAGES 32
+
+// Internal nodes kept pinned by all the open indexes together; with the
+// header pages of the open files they leave most of the buffer pool to
+// the data pages
+#define IX_MAXCACHEDNODES 8
+
 using std::map;
 
 class IX_Manager;
 class IX_IndexHandle;
 class IX_IndexScan;
+class IX_IndexBuilder;
 struct TreeHeader;
-struct NodeHeader;
 
 enum NodeType {
     LeafNode,
     InternalNode
 };
 
-struct TreeHeader {
+//
+// IX_IncludeField: a record attribute whose value is stored in the leaf
+// entries of an index next to the key, so that a query reading only the
+// key and the included attributes needs no record
+//
+struct IX_IncludeField {
+    short offset;             // offset of the attribute (its null flag) in the record
+    short length;             // attribute length
+};
+
+#define IX_MAXINCLUDEFIELDS MAXATTRS
+
+//
+// IX_KeyField: a record attribute of the key of a multi-column index.  The
+// key is a null flag followed by the values of its attributes in key order,
+// each encoded by Attr::EncodeKey, so that the PRIMARYKEY comparison
+// (memcmp) orders the entries by the attributes in turn.
+//
+struct IX_KeyField {
+    short offset;             // offset of the attribute (its null flag) in the record
+    short length;             // attribute length
+    AttrType attrType;        // attribute type
+};
+
+#define IX_MAXKEYFIELDS 8
+
+//
+// IX_TreeInfo: header page of an index file.  It holds page numbers,
+// lengths and counts only, the in-memory TreeHeader adds what an open
+// index needs.
+//
+struct IX_TreeInfo {
     PageNum infoPNum;
     PageNum rootPNum;
     AttrType attrType;
@@ -39,45 +97,74 @@ struct TreeHeader {
     int maxChildNum;
     PageNum dataHeadPNum;
     PageNum dataTailPNum;
-    PF_FileHandle* indexFH;
-    map<PageNum, char*> *pageMap;
+    // IX_FORMATVERSION.  A file of the first format, written by a 32-bit
+    // build, holds two pointers in these two words instead.
+    int formatVersion;
+    // Whether the node pages hold compressed keys (see IX_NodePage), then
+    // maxChildNum only bounds the entries of a node in memory
+    int keyCompression;
+    // Included attributes, their values (null flags included) are stored
+    // in the value slot of a leaf entry, whose size childItemSize is at
+    // least includeLength.  An index file of an older version reads 0.
+    int includeLength;
+    int numIncludeFields;
+    IX_IncludeField includeFields[IX_MAXINCLUDEFIELDS];
+    // Attributes of the key of a multi-column index, none for an index
+    // whose keys are given by the caller.
+    int numKeyFields;
+    IX_KeyField keyFields[IX_MAXKEYFIELDS];
+};
 
-    bool CompareAttr(void* valueA, CompOp compOp, void* valueB);
-    bool CompareAttrWithRID(void *valueA, CompOp compOp, void *valueB);
+// Format of the index files.  Odd, so that no pointer written by the first
+// format can be taken for it.
+#define IX_FORMATVERSION 0x49580201
 
-    RC GetPageData(PageNum pNum, NodeHeader *&pData);
-    RC AllocatePage(PageNum &pageNum, NodeHeader *&pageData);
-    RC UnpinPages();
+// Size of the node page header of the first format: IX_NodePage and three
+// 4-byte pointers, the keys followed it
+#define IX_V1NODEHEADERSIZE 36
 
-    RC Insert(char *pData);
-    RC Search(char *pData, CompOp compOp, NodeHeader *&cur, int &index);
-    RC Delete(char *pData);
-    RC GetNextEntry(char *pData, CompOp compOp, NodeHeader *&cur, int &index, bool &newPage);
+// Bound on the entries of a compressed node, times the entries of an
+// uncompressed one
+#define IX_MAXCOMPRESSION 8
 
-    RC SearchLeafNodeWithRID(char *pData, NodeHeader *cur, NodeHeader *&leaf);
-    RC SearchLeafNode(char *pData, NodeHeader *cur, NodeHeader *&leaf);
-    RC GetFirstLeafNode(NodeHeader *&leaf);
-    RC GetLastLeafNode(NodeHeader *&leaf);
-    bool IsValidScanResult(char *pData, CompOp compOp, NodeHeader *cur, int index);
-    void appendMaxRID(char *pData);
-    void appendMinRID(char *pData);
-
-    RC DisplayAllTree();
-};
-
-struct NodeHeader {
+//
+// IX_NodePage: header of a node page.  The keys follow it, then after
+// maxChildNum keys the values: the child page numbers of an internal node,
+// the included values of a leaf.
+//
+// With keyCompression, the entries have variable lengths instead.  The
+// header is followed by the length and the bytes of the prefix common to
+// all the keys of the node, the values (sizeof(PageNum) bytes in an
+// internal node), then for each key the length of its bytes after the
+// prefix, the bytes without their trailing zeros, and the RID.  The
+// separators of the internal nodes are cut after the first byte that
+// tells the nodes apart, so that they are mostly zeros.
+//
+struct IX_NodePage {
     PageNum selfPNum;
     NodeType nodeType;
     PageNum parentPNum; // calculate in SearchLeafNode
     PageNum prevPNum;
     PageNum nextPNum;
     int childNum;
-    char* keys;         // calculate in GetPageData
-    char* values;       // calculate in GetPageData
-    TreeHeader *tree;   // calculate in GetPageData
+};
+
+//
+// NodeHeader: a node of an open index, the view of its page computed when
+// it is pinned
+//
+struct NodeHeader {
+    IX_NodePage *hdr;   // header of the page
+    char* keys;         // keys of the page, after the header
+    char* values;       // values of the page, after maxChildNum keys
+    TreeHeader *tree;
+    char *buffer;       // keys and values of a compressed node, NULL until used
+    bool dirty;         // keys or values of a compressed node changed
+    int length;         // bound on the length of its compressed page, or -1
+    int prefix;         // length of the prefix its keys share, with length
 
     bool IsEmpty();
-    bool IsFull();
+    bool IsFull(char *pData, int pageLength = PF_PAGE_SIZE);
     bool HavePrevPage();
     bool HaveNextPage();
     bool HaveParentPage();
@@ -91,6 +178,7 @@ struct NodeHeader {
     PageNum *page(int index);
     PageNum *lastPage();
     PageNum *endPage();
+    char *include(int index);
 
     int UpperBound(char *pData);
     int UpperBoundWithRID(char *pData);
@@ -118,6 +206,82 @@ struct NodeHeader {
     void MoveKey(int begin, char* dest);
     void MoveValue(int begin, char *dest);
     RC MarkDirty();
+
+    int PageLength(char *pData, int &newPrefix);
+    void AddLength(char *pData);
+    void DecodeKeys();
+    void EncodeKeys();
+};
+
+//
+// IX_PageSet: nodes of an open index pinned in the buffer pool.  The root
+// and the internal nodes below it stay pinned until the index is closed,
+// as long as the cached nodes of the open indexes stay within
+// IX_MAXCACHEDNODES, so that a descent does not fetch the upper levels
+// again.  The other pages are pinned by one tree operation and released
+// together by UnpinPages.  A node keeps its slot while it is pinned.
+//
+struct IX_PageSet {
+    int numCached;
+    PageNum cachedPNums[IX_MAXCACHEDNODES];
+    NodeHeader cached[IX_MAXCACHEDNODES];
+    int numPinned;
+    PageNum pinnedPNums[IX_MAXPATHPAGES];     // -1 for a slot unpinned by UnpinPage
+    NodeHeader pinned[IX_MAXPATHPAGES];
+    int *cachedNodes;         // nodes cached by all the open indexes, NULL caches none
+};
+
+//
+// TreeHeader: an open index, a copy of its header page.  The page is
+// pinned while the index is open and WriteInfo copies the header back.
+//
+struct TreeHeader : IX_TreeInfo {
+    PF_FileHandle* indexFH;
+    char *infoData;           // the pinned header page
+    IX_PageSet pages;
+
+    TreeHeader();
+    ~TreeHeader();
+
+    bool CompareAttr(void* valueA, CompOp compOp, void* valueB);
+    bool CompareAttrWithRID(void *valueA, CompOp compOp, void *valueB);
+
+    RC WriteInfo();
+    void SetNode(NodeHeader &node, char *data);
+    void WriteNode(NodeHeader &node);
+    RC GetPageData(PageNum pNum, NodeHeader *&pData);
+    RC AllocatePage(PageNum &pageNum, NodeHeader *&pageData);
+    RC UnpinPages();
+    RC UnpinPage(PageNum pNum);
+    RC ReleaseNodes();
+
+    RC Insert(char *pData);
+    RC InsertUnique(char *pData, bool &exists);
+    RC Search(char *pData, CompOp compOp, NodeHeader *&cur, int &index);
+    RC Delete(char *pData);
+
+    RC SearchLeafNodeWithRID(char *pData, NodeHeader *cur, NodeHeader *&leaf);
+    RC SearchLeafNode(char *pData, NodeHeader *cur, NodeHeader *&leaf);
+    RC GetFirstLeafNode(NodeHeader *&leaf);
+    RC GetLastLeafNode(NodeHeader *&leaf);
+    bool IsValidScanResult(char *pData, CompOp compOp, NodeHeader *cur, int index);
+    void appendMaxRID(char *pData);
+    void appendMinRID(char *pData);
+    void Separator(char *left, char *right, char *sep);
+
+    RC DisplayAllTree();
+};
+
+//
+// IX_BloomHeader: first page of the Bloom filter file of an index, the
+// bits follow in the next pages.  The file is clean only between a close
+// and the next open, otherwise the filter is rebuilt from the leaves.
+//
+struct IX_BloomHeader {
+    int isClean;
+    int numWords;
+    int numKeys;
+    int numPages;
 };
 
 //
@@ -126,12 +290,18 @@ struct NodeHeader {
 class IX_IndexHandle {
     friend class IX_Manager;
     friend class IX_IndexScan;
+    friend class IX_IndexBuilder;
 public:
     IX_IndexHandle();
     ~IX_IndexHandle();
 
-    // Insert a new index entry
-    RC InsertEntry(void *pData, const RID &rid);
+    // Insert a new index entry; include holds the values of the included
+    // attributes of the record (see GetInclude), NULL stores zeros
+    RC InsertEntry(void *pData, const RID &rid, const void *include = NULL);
+
+    // Insert a new index entry unless an entry with the same key exists,
+    // then return IX_DUPLICATEKEY; both in one descent of the tree
+    RC InsertUnique(void *pData, const RID &rid, const void *include = NULL);
 
     // Delete a new index entry
     RC DeleteEntry(void *pData, const RID &rid);
@@ -139,18 +309,57 @@ public:
     // Force index files to disk
     RC ForcePages();
 
+    // Whether the index may have an entry with the key in pData; false
+    // means it has none, without searching the tree
+    bool MayContain(void *pData) const;
+
+    // Number of entries, and smallest and largest key (attrLength + 1
+    // bytes, IX_EOF if the index is empty), read from the leaves only
+    RC GetNumEntries(int &numEntries);
+    RC GetFirstKey(void *pData);
+    RC GetLastKey(void *pData);
+
+    // Type of the keys, PRIMARYKEY for a multi-column key
+    AttrType GetAttrType() const;
+
+    // Attributes included in the leaf entries, and the length of their
+    // values in an entry
+    std::vector<IX_IncludeField> GetIncludeFields() const;
+    int GetIncludeLength() const;
+
+    // Copy the values of the included attributes out of a record
+    void GetInclude(const char *recordData, char *include) const;
+
+    // Attributes of the key of a multi-column index, the length of its
+    // keys (attrLength + 1), and the key of a record in it
+    std::vector<IX_KeyField> GetKeyFields() const;
+    int GetKeyLength() const;
+    void GetKey(const char *recordData, char *key) const;
+
     RC DisplayAllTree();
 private:
     bool isOpen;
     PF_FileHandle indexFH;
-    TreeHeader *treeHeader;
-    map<PageNum, char*> pageMap;
+    TreeHeader *treeHeader;   // NULL while closed
+    PF_FileHandle bloomFH;
+    std::vector<uint64_t> bloomBits;    // power-of-two number of words
+    int bloomKeys;                      // keys added, deleted ones included
 
-    RC CreateIndex(AttrType attrType, int attrLength);
+    RC CreateIndex(AttrType attrType, int attrLength, const std::vector<IX_IncludeField> &includeFields,
+                   const std::vector<IX_KeyField> &keyFields);
 
     RC OpenIndex();
+    RC ConvertIndex(char *infoPData);
 
     RC CloseIndex();
+
+    // Bloom filter on the keys, see ix_bloom.cc
+    RC ReadBloom();
+    RC WriteBloom();
+    RC RebuildBloom();
+    void AddBloom(const char *pData);
+
+    void SetInclude(char *entry, const void *include) const;
 };
 
 //
@@ -168,16 +377,74 @@ public:
     // entries.
     RC GetNextEntry(RID &rid);
 
+    // Same, and copy the key of the entry (attrLength + 1 bytes) into
+    // key and the values of its included attributes into include (unless
+    // NULL), so that an index-only scan needs no record
+    RC GetNextEntry(RID &rid, void *key, void *include = NULL);
+
     // Close index scan
     RC CloseScan();
 
 private:
     TreeHeader *tree;
-    char pData[300];
+    char pData[PF_PAGE_SIZE];
     CompOp op;
-    char buffer[PF_PAGE_SIZE];
-    NodeHeader *cur;
-    int index;
+    NodeHeader pinnedLeaf;    // view of the leaf pinned by the scan
+    NodeHeader *cur;          // &pinnedLeaf, nullptr once done
+    int index;                // current entry of cur
+    int end;                  // end of the matching entries of cur
+
+    RC PinLeaf(PageNum pNum);
+    RC UnpinLeaf();
+    RC SeekEntry();
+};
+
+//
+// IX_IndexBuilder: bottom-up bulk load of an empty index
+//
+class IX_IndexBuilder {
+public:
+    IX_IndexBuilder();
+    ~IX_IndexBuilder();
+
+    // Start collecting the entries of an index on (attrType, attrLength)
+    // whose leaf entries include includeLength bytes of attribute values
+    RC Open(AttrType attrType, int attrLength, int includeLength = 0);
+
+    // Add an index entry, entries may come in any order
+    RC AddEntry(void *pData, const RID &rid, const void *include = NULL);
+
+    // Sort the entries and write them into an empty index, packing each
+    // node to fillFactor of its capacity
+    RC Build(IX_IndexHandle &indexHandle, float fillFactor = IX_FILLFACTOR);
+
+    // Drop the collected entries and the temporary sort runs
+    RC Close();
+private:
+    bool isOpen;
+    AttrType attrType;
+    int attrLength;
+    int includeLength;
+    int keyLength;              // attrLength + 1 + sizeof(RID)
+    int entryLength;            // keyLength + includeLength
+    std::vector<char> buffer;   // unsorted entries in memory
+    std::vector<FILE*> runs;    // sorted runs spilled to disk
+
+    // merge state
+    std::vector<int> order;     // sorted positions in buffer
+    size_t orderPos;
+    std::vector<char> heads;    // current entry of each run
+    std::vector<int> heap;      // runs ordered by their current entry
+
+    bool EntryLess(char *entryA, char *entryB);
+    void SortBuffer();
+    RC SpillRun();
+    RC StartMerge();
+    RC NextEntry(char *&entry);
+    RC WriteLeaves(TreeHeader *tree, int capacity, int pageLength,
+                   std::vector<char> &keys, std::vector<PageNum> &pages);
+    RC WriteLevel(TreeHeader *tree, int capacity, int pageLength,
+                  std::vector<char> &keys, std::vector<PageNum> &pages);
 };
 
 //
@@ -188,13 +455,24 @@ public:
     IX_Manager(PF_Manager &pfm);
     ~IX_Manager();
 
-    // Create a new Index
+    // Create a new Index, its leaf entries include the values of the
+    // record attributes in includeFields.  A multi-column index has the
+    // PRIMARYKEY type and its key attributes in keyFields.
     RC CreateIndex(const char *fileName, int indexNo,
-                   AttrType attrType, int attrLength);
+                   AttrType attrType, int attrLength,
+                   const std::vector<IX_IncludeField> &includeFields = std::vector<IX_IncludeField>(),
+                   const std::vector<IX_KeyField> &keyFields = std::vector<IX_KeyField>());
+
+    // Whether index indexNo of fileName exists
+    bool IndexExists(const char *fileName, int indexNo);
 
     // Destroy and Index
     RC DestroyIndex(const char *fileName, int indexNo);
 
+    // Rename index indexNo of fileName to index indexNo of newFileName,
+    // replacing it if it exists
+    RC RenameIndex(const char *fileName, int indexNo, const char *newFileName);
+
     // Open an Index
     RC OpenIndex(const char *fileName, int indexNo,
                  IX_IndexHandle &indexHandle);
@@ -202,8 +480,13 @@ public:
     // Close an Index
     RC CloseIndex(IX_IndexHandle &indexHandle);
 
+    // Rebuild an Index with a bulk load, repacking its nodes
+    RC RebuildIndex(const char *fileName, int indexNo,
+                    float fillFactor = IX_FILLFACTOR);
+
 private:
     PF_Manager &PFMgr;
+    int cachedNodes;          // internal nodes pinned by the open indexes
 
     //generate a unique file name
     static char* generateIndexFileName(const char *fileName, int indexNo);
@@ -229,6 +512,12 @@ void IX_PrintError(RC rc);
 #define IX_DELETERIDFROMINTERNALNODE (START_IX_WARN + 10)
 #define IX_DELETERIDNOTEXIST (START_IX_WARN + 11)
 #define IX_DELETEPAGEFROMLEAFNODE (START_IX_WARN + 12)
+#define IX_INDEXNOTEMPTY (START_IX_WARN + 13)
+#define IX_BUILDERCLOSED (START_IX_WARN + 14)
+#define IX_DUPLICATEKEY (START_IX_WARN + 15)
+#define IX_INCLUDEINVALID (START_IX_WARN + 16)
+#define IX_PATHFULL (START_IX_WARN + 17)
+#define IX_BADINDEXFILE (START_IX_WARN + 18)
 
 #if IX_DEBUG == 1
 
@@ -0,0 +1,199 @@
+//
+// File:        ix_bloom.cc
+// Description: Bloom filter on the keys of an index
+//              Every key inserted into the index sets IX_BLOOM_HASHES bits
+//              of the filter, so a key with a clear bit is not in the
+//              index and an equality probe for it needs no tree descent.
+//              Deleted keys keep their bits until the filter is rebuilt
+//              from the leaves, which happens when it is outgrown and when
+//              its file was not closed cleanly.
+//
+
+#include "ix.h"
+#include <cstring>
+using namespace std;
+
+#define IX_BLOOM_PAGEWORDS (PF_PAGE_SIZE / (int)sizeof(uint64_t))
+
+// Hash of a key (after its null flag), equal keys hash equally: a STRING
+// ends at its terminator and a FLOAT zero has no sign
+static uint64_t IX_BloomHash(AttrType attrType, int attrLength, const char *pData) {
+    const char *value = pData + 1;
+    int length = attrLength;
+    float f;
+    if (attrType == STRING) {
+        length = strnlen(value, attrLength);
+    } else if (attrType == FLOAT) {
+        memcpy(&f, value, sizeof(float));
+        if (f == 0)
+            f = 0;
+        value = (const char*)&f;
+    }
+    // FNV-1a, then a final mix so that both halves are usable
+    uint64_t h = 14695981039346656037ULL;
+    for (int i = 0; i < length; ++i)
+        h = (h ^ (unsigned char)value[i]) * 1099511628211ULL;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Set the bits of a hash in a filter
+static void IX_BloomSet(vector<uint64_t> &bits, uint64_t h) {
+    uint32_t mask = bits.size() * 64 - 1;
+    uint32_t h1 = (uint32_t)h, h2 = (uint32_t)(h >> 32) | 1;
+    for (int i = 0; i < IX_BLOOM_HASHES; ++i, h1 += h2)
+        bits[(h1 & mask) >> 6] |= 1ULL << (h1 & 63);
+}
+
+bool IX_IndexHandle::MayContain(void *pData) const {
+    if (bloomBits.empty())
+        return true;
+    uint64_t h = IX_BloomHash(treeHeader->attrType, treeHeader->attrLength, (const char*)pData);
+    uint32_t mask = bloomBits.size() * 64 - 1;
+    uint32_t h1 = (uint32_t)h, h2 = (uint32_t)(h >> 32) | 1;
+    for (int i = 0; i < IX_BLOOM_HASHES; ++i, h1 += h2)
+        if (!(bloomBits[(h1 & mask) >> 6] & (1ULL << (h1 & 63))))
+            return false;
+    return true;
+}
+
+// Add a key inserted into the index, rebuilding the filter twice as large
+// when it holds more keys than it is sized for
+void IX_IndexHandle::AddBloom(const char *pData) {
+    if (bloomBits.empty())
+        return;
+    IX_BloomSet(bloomBits, IX_BloomHash(treeHeader->attrType, treeHeader->attrLength, pData));
+    if ((uint64_t)++bloomKeys * IX_BLOOM_BITSPERKEY > bloomBits.size() * 64 && RebuildBloom())
+        bloomBits.clear();
+}
+
+// Size the filter for twice the keys in the leaves and set their bits
+RC IX_IndexHandle::RebuildBloom() {
+    RC rc;
+
+    TreeHeader *tree = treeHeader;
+    vector<uint64_t> hashes;
+    PageNum pNum = tree->dataHeadPNum;
+    while (true) {
+        NodeHeader *leaf;
+        if ((rc = tree->GetPageData(pNum, leaf)))
+            IX_PRINTSTACK
+        for (int i = 0; i < leaf->hdr->childNum; ++i)
+            hashes.push_back(IX_BloomHash(tree->attrType, tree->attrLength, leaf->key(i)));
+        bool last = !leaf->HaveNextPage();
+        pNum = leaf->hdr->nextPNum;
+        if ((rc = tree->UnpinPages()))
+            IX_PRINTSTACK
+        if (last)
+            break;
+    }
+    size_t numWords = IX_BLOOM_MINWORDS;
+    while (numWords * 64 < 2 * hashes.size() * IX_BLOOM_BITSPERKEY)
+        numWords *= 2;
+    bloomBits.assign(numWords, 0);
+    for (size_t i = 0; i < hashes.size(); ++i)
+        IX_BloomSet(bloomBits, hashes[i]);
+    bloomKeys = hashes.size();
+    return OK_RC;
+}
+
+// Read the filter, or rebuild it if its file is not clean or its size is
+// not a power of two (the smallest filter was once a page of 511 words),
+// then mark the file not clean on disk until the index is closed
+RC IX_IndexHandle::ReadBloom() {
+    RC rc;
+
+    // a new file gets its header page
+    PF_PageHandle ph;
+    char *pData;
+    PageNum pNum;
+    if ((rc = bloomFH.GetFirstPage(ph)) && rc != PF_EOF)
+        IX_ERROR(rc)
+    if (rc == PF_EOF) {
+        if ((rc = IX_AllocatePage(bloomFH, ph, pNum, pData)))
+            IX_PRINTSTACK
+        memset(pData, 0, PF_PAGE_SIZE);
+    } else if ((rc = ph.GetData(pData)) || (rc = ph.GetPageNum(pNum))) {
+        IX_ERROR(rc)
+    }
+    IX_BloomHeader *header = (IX_BloomHeader*)pData;
+
+    if (header->isClean && header->numWords > 0 && !(header->numWords & (header->numWords - 1))) {
+        bloomBits.resize(header->numWords);
+        for (int i = 0; i * IX_BLOOM_PAGEWORDS < header->numWords; ++i) {
+            PF_PageHandle bitsPH;
+            char *bits;
+            if ((rc = bloomFH.GetThisPage(i + 1, bitsPH)) || (rc = bitsPH.GetData(bits)))
+                IX_ERROR(rc)
+            int n = header->numWords - i * IX_BLOOM_PAGEWORDS;
+            memcpy(&bloomBits[i * IX_BLOOM_PAGEWORDS], bits, (n < IX_BLOOM_PAGEWORDS ? n : IX_BLOOM_PAGEWORDS) * sizeof(uint64_t));
+            if ((rc = bloomFH.UnpinPage(i + 1)))
+                IX_ERROR(rc)
+        }
+        bloomKeys = header->numKeys;
+    } else if ((rc = RebuildBloom())) {
+        IX_PRINTSTACK
+    }
+
+    header->isClean = 0;
+    if ((rc = bloomFH.MarkDirty(pNum)))
+        IX_ERROR(rc)
+    if ((rc = bloomFH.UnpinPage(pNum)))
+        IX_ERROR(rc)
+    if ((rc = bloomFH.ForcePages(pNum)))
+        IX_ERROR(rc)
+    return OK_RC;
+}
+
+// Write the filter back and mark its file clean once the bits are on disk
+RC IX_IndexHandle::WriteBloom() {
+    RC rc;
+
+    PF_PageHandle ph;
+    char *pData;
+    if ((rc = bloomFH.GetThisPage(0, ph)) || (rc = ph.GetData(pData)))
+        IX_ERROR(rc)
+    IX_BloomHeader header = *(IX_BloomHeader*)pData;
+    if ((rc = bloomFH.UnpinPage(0)))
+        IX_ERROR(rc)
+
+    int numWords = bloomBits.size();
+    for (int i = 0; i * IX_BLOOM_PAGEWORDS < numWords; ++i) {
+        PF_PageHandle bitsPH;
+        char *bits;
+        PageNum pNum = i + 1;
+        if (pNum > header.numPages) {
+            if ((rc = IX_AllocatePage(bloomFH, bitsPH, pNum, bits)))
+                IX_PRINTSTACK
+            header.numPages = pNum;
+        } else if ((rc = bloomFH.GetThisPage(pNum, bitsPH)) || (rc = bitsPH.GetData(bits))) {
+            IX_ERROR(rc)
+        }
+        int n = numWords - i * IX_BLOOM_PAGEWORDS;
+        memcpy(bits, &bloomBits[i * IX_BLOOM_PAGEWORDS], (n < IX_BLOOM_PAGEWORDS ? n : IX_BLOOM_PAGEWORDS) * sizeof(uint64_t));
+        if ((rc = bloomFH.MarkDirty(pNum)))
+            IX_ERROR(rc)
+        if ((rc = bloomFH.UnpinPage(pNum)))
+            IX_ERROR(rc)
+    }
+    if ((rc = bloomFH.ForcePages()))
+        IX_ERROR(rc)
+
+    header.isClean = numWords > 0;
+    header.numWords = numWords;
+    header.numKeys = bloomKeys;
+    if ((rc = bloomFH.GetThisPage(0, ph)) || (rc = ph.GetData(pData)))
+        IX_ERROR(rc)
+    *(IX_BloomHeader*)pData = header;
+    if ((rc = bloomFH.MarkDirty(0)))
+        IX_ERROR(rc)
+    if ((rc = bloomFH.UnpinPage(0)))
+        IX_ERROR(rc)
+    if ((rc = bloomFH.ForcePages(0)))
+        IX_ERROR(rc)
+    return OK_RC;
+}
@@ -9,35 +9,64 @@
 using namespace std;
 
 /**
- * PageNum selfPNum
- * NodeType nodeType
- * PageNum parentPNum
- * PageNum prevPNum
- * PageNum nextPNum
- * int childNum
- * char* keys
- * char* values
- * TreeHeader* tree
+ * node page:
+ * IX_NodePage (selfPNum, nodeType, parentPNum, prevPNum, nextPNum, childNum)
+ * maxChildNum keys (key, RID)
+ * maxChildNum values (PageNum or included values)
+ *
+ * compressed node page:
+ * IX_NodePage
+ * prefix length, prefix of the keys
+ * childNum values
+ * keys (length, bytes after the prefix without the trailing zeros, RID)
  */
 
+// Length of a key without its trailing zero bytes, skipping the zeros a
+// word at a time
+static int IX_TrimmedLength(const char *key, int length) {
+	unsigned long long word;
+	while (length >= (int)sizeof(word)) {
+		memcpy(&word, key + length - sizeof(word), sizeof(word));
+		if (word != 0)
+			break;
+		length -= sizeof(word);
+	}
+	while (length > 0 && key[length - 1] == 0)
+		--length;
+	return length;
+}
+
+// Length of the common prefix of two keys, at most length
+static int IX_CommonLength(const char *keyA, const char *keyB, int length) {
+	int i = 0;
+	while (i < length && keyA[i] == keyB[i])
+		++i;
+	return i;
+}
+
 bool NodeHeader::IsEmpty() {
-	return childNum == 0;
+	return hdr->childNum == 0;
 }
 
-bool NodeHeader::IsFull() {
-	return childNum == tree->maxChildNum;
+// Whether the entry pData does not fit in the node, or its compressed page
+// would be longer than pageLength
+bool NodeHeader::IsFull(char *pData, int pageLength) {
+	if (hdr->childNum == tree->maxChildNum)
+		return true;
+	int newPrefix;
+	return tree->keyCompression && PageLength(pData, newPrefix) > pageLength;
 }
 
 bool NodeHeader::HavePrevPage() {
-	return prevPNum != -1 && prevPNum != tree->infoPNum;
+	return hdr->prevPNum != -1 && hdr->prevPNum != tree->infoPNum;
 }
 
 bool NodeHeader::HaveNextPage() {
-	return nextPNum != -1 && nextPNum != tree->infoPNum;
+	return hdr->nextPNum != -1 && hdr->nextPNum != tree->infoPNum;
 }
 
 bool NodeHeader::HaveParentPage() {
-	return parentPNum != -1;
+	return hdr->parentPNum != -1;
 }
 
 char* NodeHeader::key(int index) {
@@ -49,10 +78,10 @@ char *NodeHeader::lastKey() {
 }
 
 char* NodeHeader::endKey() {
-	if (nodeType == InternalNode)
-		return keys + (childNum - 1) * tree->attrLengthWithRid;
+	if (hdr->nodeType == InternalNode)
+		return keys + (hdr->childNum - 1) * tree->attrLengthWithRid;
 	else
-		return keys + childNum * tree->attrLengthWithRid;
+		return keys + hdr->childNum * tree->attrLengthWithRid;
 }
 
 RID* NodeHeader::rid(int index) {
@@ -76,99 +105,105 @@ PageNum* NodeHeader::lastPage() {
 }
 
 PageNum* NodeHeader::endPage() {
-	return (PageNum*)(values + childNum * tree->childItemSize);
+	return (PageNum*)(values + hdr->childNum * tree->childItemSize);
+}
+
+// values of the included attributes of a leaf entry, in its value slot
+char* NodeHeader::include(int index) {
+	return values + index * tree->childItemSize;
 }
 
 int NodeHeader::UpperBound(char *pData) {
-	if (nodeType == LeafNode)
-		return Attr::upper_bound(tree->attrType, tree->attrLength, keys, childNum, pData);
+	if (hdr->nodeType == LeafNode)
+		return Attr::upper_bound(tree->attrType, tree->attrLength, keys, hdr->childNum, pData);
 	else
-		return Attr::upper_bound(tree->attrType, tree->attrLength, keys, childNum - 1, pData);
+		return Attr::upper_bound(tree->attrType, tree->attrLength, keys, hdr->childNum - 1, pData);
 }
 
 int NodeHeader::UpperBoundWithRID(char *pData) {
-	if (nodeType == LeafNode)
-		return Attr::upper_boundWithRID(tree->attrType, tree->attrLength, keys, childNum, pData);
+	if (hdr->nodeType == LeafNode)
+		return Attr::upper_boundWithRID(tree->attrType, tree->attrLength, keys, hdr->childNum, pData);
 	else
-		return Attr::upper_boundWithRID(tree->attrType, tree->attrLength, keys, childNum - 1, pData);
+		return Attr::upper_boundWithRID(tree->attrType, tree->attrLength, keys, hdr->childNum - 1, pData);
 }
 
 int NodeHeader::LowerBound(char* pData) {
-	if (nodeType == LeafNode)
-		return Attr::lower_bound(tree->attrType, tree->attrLength, keys, childNum, pData);
+	if (hdr->nodeType == LeafNode)
+		return Attr::lower_bound(tree->attrType, tree->attrLength, keys, hdr->childNum, pData);
 	else
-		return Attr::lower_bound(tree->attrType, tree->attrLength, keys, childNum - 1, pData);
+		return Attr::lower_bound(tree->attrType, tree->attrLength, keys, hdr->childNum - 1, pData);
 }
 
 int NodeHeader::LowerBoundWithRID(char *pData) {
-	if (nodeType == LeafNode)
-		return Attr::lower_boundWithRID(tree->attrType, tree->attrLength, keys, childNum, pData);
+	if (hdr->nodeType == LeafNode)
+		return Attr::lower_boundWithRID(tree->attrType, tree->attrLength, keys, hdr->childNum, pData);
 	else
-		return Attr::lower_boundWithRID(tree->attrType, tree->attrLength, keys, childNum - 1, pData);
+		return Attr::lower_boundWithRID(tree->attrType, tree->attrLength, keys, hdr->childNum - 1, pData);
 }
 
 pair<int, int> NodeHeader::EqualRange(char *pData) {
-	if (nodeType == LeafNode)
-		return Attr::equal_range(tree->attrType, tree->attrLength, keys, childNum, pData);
+	if (hdr->nodeType == LeafNode)
+		return Attr::equal_range(tree->attrType, tree->attrLength, keys, hdr->childNum, pData);
 	else
-		return Attr::equal_range(tree->attrType, tree->attrLength, keys, childNum - 1, pData);
+		return Attr::equal_range(tree->attrType, tree->attrLength, keys, hdr->childNum - 1, pData);
 }
 
 pair<int, int> NodeHeader::EqualRangeWithRID(char *pData) {
-	if (nodeType == LeafNode)
-		return Attr::equal_rangeWithRID(tree->attrType, tree->attrLength, keys, childNum, pData);
+	if (hdr->nodeType == LeafNode)
+		return Attr::equal_rangeWithRID(tree->attrType, tree->attrLength, keys, hdr->childNum, pData);
 	else
-		return Attr::equal_rangeWithRID(tree->attrType, tree->attrLength, keys, childNum - 1, pData);
+		return Attr::equal_rangeWithRID(tree->attrType, tree->attrLength, keys, hdr->childNum - 1, pData);
 }
 
 bool NodeHeader::BinarySearch(char *pData) {
-	if (nodeType == LeafNode)
-		return Attr::binary_search(tree->attrType, tree->attrLength, keys, childNum, pData);
+	if (hdr->nodeType == LeafNode)
+		return Attr::binary_search(tree->attrType, tree->attrLength, keys, hdr->childNum, pData);
 	else
-		return Attr::binary_search(tree->attrType, tree->attrLength, keys, childNum - 1, pData);
+		return Attr::binary_search(tree->attrType, tree->attrLength, keys, hdr->childNum - 1, pData);
 }
 
 bool NodeHeader::BinarySearchWithRID(char *pData) {
-	if (nodeType == LeafNode)
-		return Attr::binary_searchWithRID(tree->attrType, tree->attrLength, keys, childNum, pData);
+	if (hdr->nodeType == LeafNode)
+		return Attr::binary_searchWithRID(tree->attrType, tree->attrLength, keys, hdr->childNum, pData);
 	else
-		return Attr::binary_searchWithRID(tree->attrType, tree->attrLength, keys, childNum - 1, pData);
+		return Attr::binary_searchWithRID(tree->attrType, tree->attrLength, keys, hdr->childNum - 1, pData);
 }
 
 RC NodeHeader::DeleteRID(char *pData) {
 	RC rc;
-	if (nodeType != LeafNode)
+	if (hdr->nodeType != LeafNode)
 		IX_ERROR(IX_DELETERIDFROMINTERNALNODE)
 	int pos = LowerBoundWithRID(pData);
-	if (pos == childNum || !tree->CompareAttr(pData, EQ_OP, key(pos))) {
-		//if (pos == childNum) printf("error!"); else printf("error2!!%d", selfPNum);
+	if (pos == hdr->childNum || !tree->CompareAttr(pData, EQ_OP, key(pos))) {
+		//if (pos == hdr->childNum) printf("error!"); else printf("error2!!%d", hdr->selfPNum);
 		IX_ERROR(IX_DELETERIDNOTEXIST)
 	}
 	if ((rc = MarkDirty()))
 		IX_PRINTSTACK
 	MoveKey(pos + 1, key(pos));
 	MoveValue(pos + 1, (char*)page(pos));
-	if (--childNum == 0 && HaveParentPage()) {
-		//printf("Deleted leaf page: %d\n", selfPNum);
+	length = -1;
+	if (--hdr->childNum == 0 && HaveParentPage()) {
+		//printf("Deleted leaf page: %d\n", hdr->selfPNum);
 		if (HavePrevPage()) {
 			NodeHeader *prev;
 			if ((rc = PrevPage(prev)))
 				IX_PRINTSTACK
-			prev->nextPNum = nextPNum;
+			prev->hdr->nextPNum = hdr->nextPNum;
 			if ((rc = prev->MarkDirty()))
 				IX_PRINTSTACK
 		} else {
-			tree->dataHeadPNum = nextPNum;
+			tree->dataHeadPNum = hdr->nextPNum;
 		}
 		if (HaveNextPage()) {
 			NodeHeader *next;
 			if ((rc = NextPage(next)))
 				IX_PRINTSTACK
-			next->prevPNum = prevPNum;
+			next->hdr->prevPNum = hdr->prevPNum;
 			if ((rc = next->MarkDirty()))
 				IX_PRINTSTACK
 		} else {
-			tree->dataTailPNum = prevPNum;
+			tree->dataTailPNum = hdr->prevPNum;
 		}
 		NodeHeader *parent;
 		if ((rc = ParentPage(parent)))
@@ -181,44 +216,47 @@ RC NodeHeader::DeleteRID(char *pData) {
 
 RC NodeHeader::DeletePage(char *pData) {
 	RC rc;
-	if (nodeType != InternalNode)
+	if (hdr->nodeType != InternalNode)
 		IX_ERROR(IX_DELETEPAGEFROMLEAFNODE)
 	if ((rc = MarkDirty()))
 		IX_PRINTSTACK
 	int pos = UpperBoundWithRID(pData);
-	/*printf("Todelete internal page: %d pos = %d\n", selfPNum, pos);
+	/*printf("Todelete internal page: %d pos = %d\n", hdr->selfPNum, pos);
 	printf("from");
-	for (int i = 0; i < childNum - 1; ++i) {
+	for (int i = 0; i < hdr->childNum - 1; ++i) {
 		printf("key: %d", *(int*)key(i));
 	}
-	for (int i = 0; i < childNum; ++i) {
+	for (int i = 0; i < hdr->childNum; ++i) {
 		printf("page: %d", *(PageNum*)page(i));
 	}*/
 	if (pos > 0) {
 		MoveKey(pos, key(pos - 1));
-	} else if (pos + 1 <= childNum - 1) { // pos == 0 also needs moving!!!!
+	} else if (pos + 1 <= hdr->childNum - 1) { // pos == 0 also needs moving!!!!
 		MoveKey(pos + 1, key(pos));
 	}
 	MoveValue(pos + 1, (char*)page(pos));
+	length = -1;
 	/*printf("\nto");
-	for (int i = 0; i < childNum - 2; ++i) {
+	for (int i = 0; i < hdr->childNum - 2; ++i) {
 		printf("key: %d", *(int*)key(i));
 	}
-	for (int i = 0; i < childNum - 1; ++i) {
+	for (int i = 0; i < hdr->childNum - 1; ++i) {
 		printf("page: %d", *(PageNum*)page(i));
 	}
 	printf("\n");*/
-	if (--childNum == 0) {
-		//printf("Deleted internal page: %d\n", selfPNum);
+	if (--hdr->childNum == 0) {
+		//printf("Deleted internal page: %d\n", hdr->selfPNum);
 		if (!HaveParentPage()) {
-			nodeType = LeafNode;
-			tree->dataHeadPNum = tree->dataTailPNum = selfPNum;
+			// the root is an empty leaf again, linked to the info page
+			hdr->nodeType = LeafNode;
+			hdr->prevPNum = hdr->nextPNum = tree->infoPNum;
+			tree->dataHeadPNum = tree->dataTailPNum = hdr->selfPNum;
 		} else {
 			if (HavePrevPage()) {
 				NodeHeader *prev;
 				if ((rc = PrevPage(prev)))
 					IX_PRINTSTACK
-				prev->nextPNum = nextPNum;
+				prev->hdr->nextPNum = hdr->nextPNum;
 				if ((rc = prev->MarkDirty()))
 					IX_PRINTSTACK
 			}
@@ -226,7 +264,7 @@ RC NodeHeader::DeletePage(char *pData) {
 				NodeHeader *next;
 				if ((rc = NextPage(next)))
 					IX_PRINTSTACK
-				next->prevPNum = prevPNum;
+				next->hdr->prevPNum = hdr->prevPNum;
 				if ((rc = next->MarkDirty()))
 					IX_PRINTSTACK
 			}
@@ -245,11 +283,12 @@ RC NodeHeader::InsertRID(char *pData) {
     //r.GetPageNum(num);
     //printf("%d\n", num);
 	RC rc;
-	if (nodeType != LeafNode)
+	if (hdr->nodeType != LeafNode)
 		IX_ERROR(IX_INSERTRIDTOINTERNALNODE)
 	if ((rc = MarkDirty()))
 		IX_PRINTSTACK
-	if (!IsFull()) {
+	if (!IsFull(pData)) {
+		AddLength(pData);
 		int pos = UpperBoundWithRID(pData);
 		//if (pos == 0 && HaveParentPage()) {
 		//	NodeHeader *parent;
@@ -261,9 +300,10 @@ RC NodeHeader::InsertRID(char *pData) {
 		MoveKey(pos, key(pos + 1));
 		MoveValue(pos, (char*)page(pos + 1));
 		memcpy(key(pos), pData, tree->attrLengthWithRid);
-		++childNum;
-		/*printf("selfPNum: %d ----", selfPNum);
-		for (int i = 0; i < childNum; ++i) {
+		memcpy(include(pos), pData + tree->attrLengthWithRid, tree->includeLength);
+		++hdr->childNum;
+		/*printf("hdr->selfPNum: %d ----", hdr->selfPNum);
+		for (int i = 0; i < hdr->childNum; ++i) {
 			int tKey = *(int*)key(i);
 			RID tRID = *rid(i);
 			int tPageNum;
@@ -279,7 +319,7 @@ RC NodeHeader::InsertRID(char *pData) {
 			NodeHeader *prev;
 			if (rc = PrevPage(prev))
 				IX_PRINTSTACK
-			if (prev->parentPNum == parentPNum && !prev->IsFull()) {
+			if (prev->hdr->parentPNum == hdr->parentPNum && !prev->IsFull()) {
 				if (rc = prev->MarkDirty())
 					IX_PRINTSTACK
 				if (tree->CompareAttr(pData, LT_OP, key(0))) {
@@ -291,7 +331,7 @@ RC NodeHeader::InsertRID(char *pData) {
 						IX_PRINTSTACK
 					MoveKey(1, key(0));
 					MoveValue(1, (char*)rid(0));
-					--childNum;
+					--hdr->childNum;
 					if (rc = InsertRID(pData, r))
 						IX_PRINTSTACK
 					return OK_RC;
@@ -302,7 +342,7 @@ RC NodeHeader::InsertRID(char *pData) {
 			NodeHeader *next;
 			if (rc = NextPage(next))
 				IX_PRINTSTACK
-			if (parentPNum == next->parentPNum && !next->IsFull()) {
+			if (hdr->parentPNum == next->hdr->parentPNum && !next->IsFull()) {
 				if (rc = next->MarkDirty())
 					IX_PRINTSTACK
 				if (tree->CompareAttr(lastKey(), LT_OP, pData)) {
@@ -312,7 +352,7 @@ RC NodeHeader::InsertRID(char *pData) {
 				} else {
 					if (rc = next->InsertRID(lastKey(), *lastRid()))
 						IX_PRINTSTACK
-					--childNum;
+					--hdr->childNum;
 					if (rc = InsertRID(pData, r))
 						IX_PRINTSTACK
 					return OK_RC;
@@ -331,50 +371,53 @@ RC NodeHeader::InsertRID(char *pData) {
 			if ((rc = ParentPage(parentPData)))
 				IX_PRINTSTACK
 		} else {
-			if ((rc = tree->AllocatePage(parentPNum, parentPData)))
+			if ((rc = tree->AllocatePage(hdr->parentPNum, parentPData)))
 				IX_PRINTSTACK
 			// Setup the new root node.
-			parentPData->selfPNum = parentPNum;
-			parentPData->nodeType = InternalNode;
-			parentPData->parentPNum = -1;
-			parentPData->prevPNum = -1;
-			parentPData->nextPNum = -1;
-			parentPData->childNum = 1;
-			*parentPData->page(0) = selfPNum;
+			parentPData->hdr->selfPNum = hdr->parentPNum;
+			parentPData->hdr->nodeType = InternalNode;
+			parentPData->hdr->parentPNum = -1;
+			parentPData->hdr->prevPNum = -1;
+			parentPData->hdr->nextPNum = -1;
+			parentPData->hdr->childNum = 1;
+			*parentPData->page(0) = hdr->selfPNum;
 			// Update info page.
-			tree->rootPNum = parentPNum;
+			tree->rootPNum = hdr->parentPNum;
 		}
 		if ((rc = parentPData->MarkDirty()))
 			IX_PRINTSTACK
 		// Setup the new node.
-		newPData->selfPNum = newPNum;
-		newPData->nodeType = LeafNode;
-		newPData->parentPNum = parentPNum;
-		newPData->prevPNum = selfPNum;
-		newPData->nextPNum = nextPNum;
-		newPData->childNum = 0;
+		newPData->hdr->selfPNum = newPNum;
+		newPData->hdr->nodeType = LeafNode;
+		newPData->hdr->parentPNum = hdr->parentPNum;
+		newPData->hdr->prevPNum = hdr->selfPNum;
+		newPData->hdr->nextPNum = hdr->nextPNum;
+		newPData->hdr->childNum = 0;
 		// Update the cur node.
-		if (nextPNum == tree->infoPNum) {
+		if (hdr->nextPNum == tree->infoPNum) {
 			tree->dataTailPNum = newPNum;
 		} else {
 			NodeHeader *next;
 			if ((rc = NextPage(next)))
 				IX_PRINTSTACK
-			next->prevPNum = newPNum;
+			next->hdr->prevPNum = newPNum;
 			if ((rc = next->MarkDirty()))
 				IX_PRINTSTACK
 		}
-		nextPNum = newPNum;
+		hdr->nextPNum = newPNum;
 		// move the data
-		int i = tree->maxChildNum / 2;
+		int i = hdr->childNum / 2;
 		MoveKey(i, newPData->key(0));
 		MoveValue(i, (char*)newPData->page(0));
-		newPData->childNum = childNum - i;
-		childNum = i;
+		newPData->hdr->childNum = hdr->childNum - i;
+		hdr->childNum = i;
+		length = newPData->length = -1;
 		// Insert parent.
-		if ((rc = parentPData->InsertPage(newPData->key(0), newPNum)))
+		char separator[PF_PAGE_SIZE];
+		tree->Separator(lastKey(), newPData->key(0), separator);
+		if ((rc = parentPData->InsertPage(separator, newPNum)))
 			IX_PRINTSTACK
-		if (tree->CompareAttrWithRID(pData, LT_OP, newPData->key(0))) {
+		if (tree->CompareAttrWithRID(pData, LT_OP, separator)) {
 			if ((rc = InsertRID(pData)))
 				IX_PRINTSTACK
 		} else {
@@ -390,17 +433,18 @@ RC NodeHeader::InsertRID(char *pData) {
 RC NodeHeader::InsertPage(char *pData, PageNum newPage) {
 	RC rc;
 
-	if (nodeType != InternalNode)
+	if (hdr->nodeType != InternalNode)
 		IX_ERROR(IX_INSERTPAGETOLEAFNODE)
 	if ((rc = MarkDirty()))
 		IX_PRINTSTACK
-	if (!IsFull()) {
+	if (!IsFull(pData)) {
+		AddLength(pData);
 		int pos = UpperBoundWithRID(pData);
 		MoveKey(pos, key(pos + 1));
 		MoveValue(pos + 1, (char*)page(pos + 2));
 		memcpy(key(pos), pData, tree->attrLengthWithRid);
 		*page(pos + 1) = newPage;
-		++childNum;
+		++hdr->childNum;
 		return OK_RC;
 	} else {
 		/*if (HavePrevPage()) {
@@ -414,7 +458,7 @@ RC NodeHeader::InsertPage(char *pData, PageNum newPage) {
 				if (rc = ParentPrevKey(prevKey))
 					IX_PRINTSTACK
 				if (prev != nullptr) {
-					++(prev->childNum);
+					++(prev->hdr->childNum);
 					memcpy(prev->lastKey(), prevKey, tree->attrLength);
 					if (tree->CompareAttr(pData, LT_OP, key(0))) {
 						*(prev->lastPage()) = *page(0);
@@ -426,7 +470,7 @@ RC NodeHeader::InsertPage(char *pData, PageNum newPage) {
 						memcpy(prevKey, key(0), tree->attrLength);
 						MoveKey(1, key(0));
 						MoveValue(1, (char*)page(0));
-						--childNum;
+						--hdr->childNum;
 						if (rc = InsertPage(pData, newPage))
 							IX_PRINTSTACK
 						return OK_RC;
@@ -447,7 +491,7 @@ RC NodeHeader::InsertPage(char *pData, PageNum newPage) {
 				if (nextKey != nullptr) {
 					next->MoveKey(0, key(1));
 					next->MoveValue(0, (char*)page(1));
-					++(next->childNum);
+					++(next->hdr->childNum);
 					memcpy(next->key(0), nextKey, tree->attrLength);
 					if (tree->CompareAttr(lastKey(), LT_OP, pData)) {
 						*(next->page(0)) = newPage;
@@ -456,7 +500,7 @@ RC NodeHeader::InsertPage(char *pData, PageNum newPage) {
 					} else {
 						*(next->page(0)) = *lastPage();
 						memcpy(nextKey, lastKey(), tree->attrLength);
-						--childNum;
+						--hdr->childNum;
 						if (rc = InsertPage(pData, newPage))
 							IX_PRINTSTACK
 						return OK_RC;
@@ -476,44 +520,45 @@ RC NodeHeader::InsertPage(char *pData, PageNum newPage) {
 			if ((rc = ParentPage(parentPData)))
 				IX_PRINTSTACK
 		} else {
-			if ((rc = tree->AllocatePage(parentPNum, parentPData)))
+			if ((rc = tree->AllocatePage(hdr->parentPNum, parentPData)))
 				IX_PRINTSTACK
 			// Setup the new root node.
-			parentPData->selfPNum = parentPNum;
-			parentPData->nodeType = InternalNode;
-			parentPData->parentPNum = -1;
-			parentPData->prevPNum = -1;
-			parentPData->nextPNum = -1;
-			parentPData->childNum = 1;
-			*parentPData->page(0) = selfPNum;
+			parentPData->hdr->selfPNum = hdr->parentPNum;
+			parentPData->hdr->nodeType = InternalNode;
+			parentPData->hdr->parentPNum = -1;
+			parentPData->hdr->prevPNum = -1;
+			parentPData->hdr->nextPNum = -1;
+			parentPData->hdr->childNum = 1;
+			*parentPData->page(0) = hdr->selfPNum;
 			// Update info page.
-			tree->rootPNum = parentPNum;
+			tree->rootPNum = hdr->parentPNum;
 		}
 		if ((rc = parentPData->MarkDirty()))
 			IX_PRINTSTACK
 		// Setup the new node.
-		newPData->selfPNum = newPNum;
-		newPData->nodeType = InternalNode;
-		newPData->parentPNum = parentPNum;
-		newPData->prevPNum = selfPNum;
-		newPData->nextPNum = nextPNum;
-		newPData->childNum = 0;
+		newPData->hdr->selfPNum = newPNum;
+		newPData->hdr->nodeType = InternalNode;
+		newPData->hdr->parentPNum = hdr->parentPNum;
+		newPData->hdr->prevPNum = hdr->selfPNum;
+		newPData->hdr->nextPNum = hdr->nextPNum;
+		newPData->hdr->childNum = 0;
 		// Update the cur node.
-		if (nextPNum != -1) {
+		if (hdr->nextPNum != -1) {
 			NodeHeader *next;
 			if ((rc = NextPage(next)))
 				IX_PRINTSTACK
 			if ((rc = next->MarkDirty()))
 				IX_PRINTSTACK
-			next->prevPNum = newPNum;
+			next->hdr->prevPNum = newPNum;
 		}
-		nextPNum = newPNum;
+		hdr->nextPNum = newPNum;
 		// move the data
-		int i = tree->maxChildNum / 2;
+		int i = hdr->childNum / 2;
 		MoveKey(i, newPData->key(0));
 		MoveValue(i, (char*)newPData->page(0));
-		newPData->childNum = childNum - i;
-		childNum = i;
+		newPData->hdr->childNum = hdr->childNum - i;
+		hdr->childNum = i;
+		length = newPData->length = -1;
 		// Insert parent.
 		if ((rc = parentPData->InsertPage(key(i - 1), newPNum)))
 			IX_PRINTSTACK
@@ -542,7 +587,7 @@ RC NodeHeader::ChildPage(int index, NodeHeader *&child) {
 RC NodeHeader::PrevPage(NodeHeader *&prev) {
 	RC rc;
 
-	if (tree->GetPageData(prevPNum, prev))
+	if (tree->GetPageData(hdr->prevPNum, prev))
 		IX_PRINTSTACK
 
 	return OK_RC;
@@ -551,7 +596,7 @@ RC NodeHeader::PrevPage(NodeHeader *&prev) {
 RC NodeHeader::NextPage(NodeHeader *&next) {
 	RC rc;
 
-	if (tree->GetPageData(nextPNum, next))
+	if (tree->GetPageData(hdr->nextPNum, next))
 		IX_PRINTSTACK
 
 	return OK_RC;
@@ -561,7 +606,7 @@ RC NodeHeader::NextPage(NodeHeader *&next) {
 RC NodeHeader::ParentPage(NodeHeader *&parent) {
 	RC rc;
 
-	if (tree->GetPageData(parentPNum, parent))
+	if (tree->GetPageData(hdr->parentPNum, parent))
 		IX_PRINTSTACK
 
 	return OK_RC;
@@ -570,7 +615,7 @@ RC NodeHeader::ParentPage(NodeHeader *&parent) {
 RC NodeHeader::ParentPrevKey(char *&k) {
 	RC rc;
 
-	if (nodeType != InternalNode)
+	if (hdr->nodeType != InternalNode)
 		IX_ERROR(IX_GETPARENTKEYINLEAFNODE)
 
 	NodeHeader *parent;
@@ -588,14 +633,14 @@ RC NodeHeader::ParentPrevKey(char *&k) {
 RC NodeHeader::ParentNextKey(char *&k) {
 	RC rc;
 
-	if (nodeType != InternalNode)
+	if (hdr->nodeType != InternalNode)
 		IX_ERROR(IX_GETPARENTKEYINLEAFNODE)
 
 	NodeHeader *parent;
 	if ((rc = ParentPage(parent)))
 		IX_PRINTSTACK
 	int index = parent->UpperBoundWithRID(key(0));
-	if (index == parent->childNum - 1)
+	if (index == parent->hdr->childNum - 1)
 		k = nullptr;
 	else
 		k = parent->key(index);
@@ -604,11 +649,12 @@ RC NodeHeader::ParentNextKey(char *&k) {
 }
 
 RC NodeHeader::UpdateKey(char *oldKey, char *newKey) {
-	if (nodeType != InternalNode)
+	if (hdr->nodeType != InternalNode)
 		IX_ERROR(IX_UPDATEKEYINLEAFNODE)
 
 	int pos = LowerBoundWithRID(oldKey);
 	memcpy(key(pos), newKey, tree->attrLengthWithRid);
+	length = -1;
 
 	return OK_RC;
 }
@@ -627,11 +673,117 @@ void NodeHeader::MoveValue(int begin, char *dest) {
 
 RC NodeHeader::MarkDirty() {
 	RC rc;
-	if ((rc = tree->indexFH->MarkDirty(selfPNum)))
+	if ((rc = tree->indexFH->MarkDirty(hdr->selfPNum)))
 		IX_ERROR(rc)
+	dirty = tree->keyCompression;
 	return OK_RC;
 }
 
+// Length of the page of a compressed node with the entry pData added, and
+// the prefix its keys then share.  Once the length is known, each key
+// before grows by at most the bytes the prefix loses.
+int NodeHeader::PageLength(char *pData, int &newPrefix) {
+	int keyLength = tree->attrLength + 1;
+	int valueLength = hdr->nodeType == LeafNode ? tree->childItemSize : sizeof(PageNum);
+	int numKeys = hdr->nodeType == LeafNode ? hdr->childNum : hdr->childNum - 1;
+	if (numKeys < 0)
+		numKeys = 0;
+	int pageLength;
+	if (length >= 0) {
+		newPrefix = numKeys > 0 ? IX_CommonLength(pData, key(0), prefix) : prefix;
+		pageLength = length + (prefix - newPrefix) * (numKeys - 1);
+	} else {
+		newPrefix = keyLength;
+		for (int i = 0; i < numKeys; ++i)
+			newPrefix = IX_CommonLength(pData, key(i), newPrefix);
+		pageLength = sizeof(IX_NodePage) + sizeof(short) + newPrefix + hdr->childNum * valueLength;
+		for (int i = 0; i < numKeys; ++i)
+			pageLength += sizeof(short) + sizeof(RID) + max(IX_TrimmedLength(key(i), keyLength) - newPrefix, 0);
+	}
+	return pageLength + valueLength + sizeof(short) + sizeof(RID) + max(IX_TrimmedLength(pData, keyLength) - newPrefix, 0);
+}
+
+// Account for the entry pData about to be added to a compressed node
+void NodeHeader::AddLength(char *pData) {
+	if (tree->keyCompression) {
+		int newPrefix;
+		length = PageLength(pData, newPrefix);
+		prefix = newPrefix;
+	}
+}
+
+// Length and prefix of a compressed page of the node, an empty node
+// counting a whole key as its prefix and a first page
+static void IX_SetLength(NodeHeader &node, char *end, int prefix) {
+	node.length = end - (char*)node.hdr;
+	node.prefix = prefix;
+	if (node.hdr->childNum == 0 || (node.hdr->nodeType != LeafNode && node.hdr->childNum == 1)) {
+		node.prefix = node.tree->attrLength + 1;
+		node.length += node.prefix + (node.hdr->childNum == 0 ? sizeof(PageNum) : 0);
+	}
+}
+
+// Expand the entries of a compressed page into the buffer of the node
+void NodeHeader::DecodeKeys() {
+	if (hdr->childNum == 0) {
+		IX_SetLength(*this, (char*)(hdr + 1) + sizeof(short), 0);
+		return;
+	}
+	int keyLength = tree->attrLength + 1;
+	int valueLength = hdr->nodeType == LeafNode ? tree->childItemSize : sizeof(PageNum);
+	int numKeys = hdr->nodeType == LeafNode ? hdr->childNum : hdr->childNum - 1;
+	char *data = (char*)(hdr + 1);
+	unsigned short prefix;
+	memcpy(&prefix, data, sizeof(short));
+	char *prefixData = data + sizeof(short);
+	data = prefixData + prefix;
+	for (int i = 0; i < hdr->childNum; ++i, data += valueLength)
+		memcpy(values + i * tree->childItemSize, data, valueLength);
+	for (int i = 0; i < numKeys; ++i) {
+		unsigned short length;
+		memcpy(&length, data, sizeof(short));
+		data += sizeof(short);
+		char *k = key(i);
+		memcpy(k, prefixData, prefix);
+		memcpy(k + prefix, data, length);
+		memset(k + prefix + length, 0, keyLength - prefix - length);
+		data += length;
+		memcpy(k + keyLength, data, sizeof(RID));
+		data += sizeof(RID);
+	}
+	IX_SetLength(*this, data, prefix);
+}
+
+// Write the entries in the buffer of the node to its compressed page
+void NodeHeader::EncodeKeys() {
+	int keyLength = tree->attrLength + 1;
+	int valueLength = hdr->nodeType == LeafNode ? tree->childItemSize : sizeof(PageNum);
+	int numKeys = hdr->nodeType == LeafNode ? hdr->childNum : hdr->childNum - 1;
+	if (numKeys < 0)
+		numKeys = 0;
+	unsigned short prefix = numKeys > 0 ? keyLength : 0;
+	for (int i = 1; i < numKeys; ++i)
+		prefix = IX_CommonLength(key(0), key(i), prefix);
+	char *data = (char*)(hdr + 1);
+	memcpy(data, &prefix, sizeof(short));
+	data += sizeof(short);
+	memcpy(data, key(0), prefix);
+	data += prefix;
+	for (int i = 0; i < hdr->childNum; ++i, data += valueLength)
+		memcpy(data, values + i * tree->childItemSize, valueLength);
+	for (int i = 0; i < numKeys; ++i) {
+		char *k = key(i);
+		unsigned short length = max(IX_TrimmedLength(k, keyLength) - prefix, 0);
+		memcpy(data, &length, sizeof(short));
+		data += sizeof(short);
+		memcpy(data, k + prefix, length);
+		data += length;
+		memcpy(data, k + keyLength, sizeof(RID));
+		data += sizeof(RID);
+	}
+	IX_SetLength(*this, data, prefix);
+}
+
 bool TreeHeader::CompareAttr(void* valueA, CompOp compOp, void* valueB) {
 	return Attr::CompareAttr(attrType, attrLength, valueA, compOp, valueB);
 }
@@ -640,48 +792,167 @@ bool TreeHeader::CompareAttrWithRID(void *valueA, CompOp compOp, void *valueB) {
 	return Attr::CompareAttrWithRID(attrType, attrLength, valueA, compOp, valueB);
 }
 
+TreeHeader::TreeHeader() : indexFH(nullptr), infoData(nullptr) {
+    pages.numCached = 0;
+    pages.numPinned = 0;
+    pages.cachedNodes = nullptr;
+    for (int i = 0; i < IX_MAXCACHEDNODES; ++i)
+        pages.cached[i].buffer = nullptr;
+    for (int i = 0; i < IX_MAXPATHPAGES; ++i)
+        pages.pinned[i].buffer = nullptr;
+}
+
+TreeHeader::~TreeHeader() {
+    for (int i = 0; i < IX_MAXCACHEDNODES; ++i)
+        delete[] pages.cached[i].buffer;
+    for (int i = 0; i < IX_MAXPATHPAGES; ++i)
+        delete[] pages.pinned[i].buffer;
+}
+
+// Copy the header back into the header page
+RC TreeHeader::WriteInfo() {
+    RC rc;
+    memcpy(infoData, (IX_TreeInfo*)this, sizeof(IX_TreeInfo));
+    if ((rc = indexFH->MarkDirty(infoPNum)))
+        IX_ERROR(rc)
+    return OK_RC;
+}
+
+// Point the view of a node at its pinned page, or at its buffer holding
+// the expanded entries of a compressed page
+void TreeHeader::SetNode(NodeHeader &node, char *data) {
+    node.hdr = (IX_NodePage*)data;
+    node.tree = this;
+    node.dirty = false;
+    node.length = -1;
+    if (!keyCompression) {
+        node.keys = data + sizeof(IX_NodePage);
+        node.values = node.keys + attrLengthWithRid * maxChildNum;
+        return;
+    }
+    if (node.buffer == nullptr)
+        node.buffer = new char[(attrLengthWithRid + childItemSize) * maxChildNum];
+    node.keys = node.buffer;
+    node.values = node.keys + attrLengthWithRid * maxChildNum;
+    node.DecodeKeys();
+}
+
+// Write the changed entries of a compressed node back to its page, before
+// the page can be written
+void TreeHeader::WriteNode(NodeHeader &node) {
+    if (node.dirty) {
+        node.EncodeKeys();
+        node.dirty = false;
+    }
+}
+
+// Pin a node of the tree.  A cached node or a page the operation pinned
+// already needs no buffer pool lookup; an internal node fetched while the
+// budget of cached nodes allows stays pinned until the index is closed.
 RC TreeHeader::GetPageData(PageNum pNum, NodeHeader *&pData) {
     RC rc;
+    for (int i = 0; i < pages.numCached; ++i)
+        if (pages.cachedPNums[i] == pNum) {
+            pData = &pages.cached[i];
+            return OK_RC;
+        }
+    int slot = pages.numPinned;
+    for (int i = 0; i < pages.numPinned; ++i) {
+        if (pages.pinnedPNums[i] == pNum) {
+            pData = &pages.pinned[i];
+            return OK_RC;
+        }
+        if (pages.pinnedPNums[i] == -1 && slot == pages.numPinned)
+            slot = i;
+    }
+
+    PF_PageHandle ph;
     char *tmp;
-    auto iter = pageMap->find(pNum);
-    if (iter == pageMap->end()) {
-        PF_PageHandle ph;
-        if ((rc = indexFH->GetThisPage(pNum, ph)))
-            IX_ERROR(rc)
-        if ((rc = ph.GetData(tmp)))
-            IX_PRINTSTACK
-        pageMap->insert(make_pair(pNum, tmp));
-        pData = (NodeHeader*)tmp;
+    if ((rc = indexFH->GetThisPage(pNum, ph)))
+        IX_ERROR(rc)
+    if ((rc = ph.GetData(tmp)))
+        IX_PRINTSTACK
+    if (pNum != infoPNum && ((IX_NodePage*)tmp)->nodeType == InternalNode && pages.cachedNodes != nullptr
+        && *pages.cachedNodes < IX_MAXCACHEDNODES && pages.numCached < IX_MAXCACHEDNODES) {
+        ++*pages.cachedNodes;
+        pages.cachedPNums[pages.numCached] = pNum;
+        pData = &pages.cached[pages.numCached++];
+    } else if (slot < IX_MAXPATHPAGES) {
+        if (slot == pages.numPinned)
+            ++pages.numPinned;
+        pages.pinnedPNums[slot] = pNum;
+        pData = &pages.pinned[slot];
     } else {
-        pData = (NodeHeader*)iter->second;
+        indexFH->UnpinPage(pNum);
+        IX_ERROR(IX_PATHFULL)
     }
-    pData->tree = this;
-    pData->keys = ((char*)pData + sizeof(NodeHeader));
-    pData->values = (pData->keys + attrLengthWithRid * maxChildNum);
+    SetNode(*pData, tmp);
     return OK_RC;
 }
 
 RC TreeHeader::AllocatePage(PageNum &pageNum, NodeHeader *&pageData) {
 	RC rc;
 
+	int slot = pages.numPinned;
+	for (int i = 0; i < pages.numPinned && slot == pages.numPinned; ++i)
+		if (pages.pinnedPNums[i] == -1)
+			slot = i;
+	if (slot == IX_MAXPATHPAGES)
+		IX_ERROR(IX_PATHFULL)
 	PF_PageHandle newPH;
-	char *tmp = (char*)pageData;
+	char *tmp;
 	if ((rc = IX_AllocatePage(*indexFH, newPH, pageNum, tmp)))
 		IX_PRINTSTACK
-	pageMap->insert(make_pair(pageNum, tmp));
-	pageData = (NodeHeader*)tmp;
-	pageData->tree = this;
-	pageData->keys = (tmp + sizeof(NodeHeader));
-    pageData->values = (pageData->keys + attrLengthWithRid * maxChildNum);
+	if (slot == pages.numPinned)
+		++pages.numPinned;
+	pages.pinnedPNums[slot] = pageNum;
+	pageData = &pages.pinned[slot];
+	((IX_NodePage*)tmp)->childNum = 0;
+	SetNode(*pageData, tmp);
 	return OK_RC;
 }
 
+// Unpin the pages pinned by the operation, the cached nodes stay
 RC TreeHeader::UnpinPages() {
     RC rc;
-    for (auto i : *pageMap)
-        if ((rc = indexFH->UnpinPage(i.first)))
+    for (int i = 0; i < pages.numCached; ++i)
+        WriteNode(pages.cached[i]);
+    while (pages.numPinned > 0) {
+        PageNum pNum = pages.pinnedPNums[--pages.numPinned];
+        if (pNum == -1)
+            continue;
+        WriteNode(pages.pinned[pages.numPinned]);
+        if ((rc = indexFH->UnpinPage(pNum)))
             IX_PRINTSTACK
-    pageMap->clear();
+    }
+    return OK_RC;
+}
+
+// Unpin one page pinned by the operation before the others; the other
+// nodes keep their slots
+RC TreeHeader::UnpinPage(PageNum pNum) {
+    RC rc;
+    for (int i = 0; i < pages.numPinned; ++i) {
+        if (pages.pinnedPNums[i] != pNum)
+            continue;
+        WriteNode(pages.pinned[i]);
+        pages.pinnedPNums[i] = -1;
+        if ((rc = indexFH->UnpinPage(pNum)))
+            IX_ERROR(rc)
+        break;
+    }
+    return OK_RC;
+}
+
+// Unpin the cached nodes, when the index is closed
+RC TreeHeader::ReleaseNodes() {
+    RC rc;
+    while (pages.numCached > 0) {
+        --*pages.cachedNodes;
+        WriteNode(pages.cached[--pages.numCached]);
+        if ((rc = indexFH->UnpinPage(pages.cachedPNums[pages.numCached])))
+            IX_ERROR(rc)
+    }
     return OK_RC;
 }
 
@@ -703,17 +974,56 @@ RC TreeHeader::Insert(char *pData) {
 	return OK_RC;
 }
 
+RC TreeHeader::InsertUnique(char *pData, bool &exists) {
+	RC rc;
+
+	NodeHeader *root;
+	if ((rc = GetPageData(rootPNum, root)))
+		IX_PRINTSTACK
+
+	NodeHeader *leaf;
+	if ((rc = SearchLeafNodeWithRID(pData, root, leaf)))
+		IX_PRINTSTACK
+	// entries with the same key are next to where the entry goes, which
+	// may be the end of the previous leaf or the start of the next one
+	// (only the root leaf is ever empty)
+	int pos = leaf->UpperBoundWithRID(pData);
+	NodeHeader *sibling;
+	exists = false;
+	if (pos > 0) {
+		exists = CompareAttr(leaf->key(pos - 1), EQ_OP, pData);
+	} else if (leaf->HavePrevPage()) {
+		if ((rc = leaf->PrevPage(sibling)))
+			IX_PRINTSTACK
+		exists = CompareAttr(sibling->lastKey(), EQ_OP, pData);
+	}
+	if (!exists && pos < leaf->hdr->childNum) {
+		exists = CompareAttr(leaf->key(pos), EQ_OP, pData);
+	} else if (!exists && leaf->HaveNextPage()) {
+		if ((rc = leaf->NextPage(sibling)))
+			IX_PRINTSTACK
+		exists = CompareAttr(sibling->key(0), EQ_OP, pData);
+	}
+	if (!exists && (rc = leaf->InsertRID(pData)))
+		IX_PRINTSTACK
+
+	if ((rc = UnpinPages()))
+		IX_PRINTSTACK
+	return OK_RC;
+}
+
 RC TreeHeader::Search(char *pData, CompOp compOp, NodeHeader *&leaf, int &index) {
 	RC rc;
 
-	/*if (compOp == NO_OP) {
+	// every entry, along the leaf chain from the first leaf
+	if (compOp == NO_OP) {
 		if ((rc = GetFirstLeafNode(leaf)))
 			IX_PRINTSTACK
 		index = 0;
 		if (!IsValidScanResult(pData, compOp, leaf, index))
 			leaf = nullptr;
 		return OK_RC;
-	}*/
+	}
 	
 	if (compOp == EQ_OP) {
 		NodeHeader *root;
@@ -747,7 +1057,7 @@ RC TreeHeader::Search(char *pData, CompOp compOp, NodeHeader *&leaf, int &index)
 		if (IsValidScanResult(pData, compOp, leaf, index))
 			return OK_RC;
 		
-		if (index != leaf->childNum || !leaf->HaveNextPage()) {
+		if (index != leaf->hdr->childNum || !leaf->HaveNextPage()) {
 			leaf = nullptr;
 			return OK_RC;
 		}
@@ -791,14 +1101,13 @@ RC TreeHeader::Search(char *pData, CompOp compOp, NodeHeader *&leaf, int &index)
 			return OK_RC;
 		
 		while (true) {
-			if (index != leaf->childNum || !leaf->HaveNextPage()) {
+			if (index != leaf->hdr->childNum || !leaf->HaveNextPage()) {
 				leaf = nullptr;
 				return OK_RC;
 			}
 
 			if ((rc = leaf->NextPage(leaf)))
 				IX_PRINTSTACK
-			cerr << leaf << endl;
 			appendMaxRID(pData);
 			index = leaf->UpperBoundWithRID(pData);
 			if (IsValidScanResult(pData, compOp, leaf, index))
@@ -841,75 +1150,20 @@ RC TreeHeader::Delete(char *pData) {
 	return OK_RC;
 }
 
-RC TreeHeader::GetNextEntry(char *pData, CompOp compOp, NodeHeader *&cur, int &index, bool &newPage) {
-	RC rc;
-
-	bool gt = CompareAttr(cur->key(index), GT_OP, pData);
-	newPage = false;
-
-	++index;
-	if (IsValidScanResult(pData, compOp, cur, index))
-		return OK_RC;
-	//if (compOp != NE_OP || gt) {
-		if (index != cur->childNum || !cur->HaveNextPage()) {
-			cur = nullptr;
-			return OK_RC;
-		}
-		if ((rc = cur->NextPage(cur)))
-			IX_PRINTSTACK
-		newPage = true;
-		index = 0;
-		if (!IsValidScanResult(pData, compOp, cur, index))
-			cur = nullptr;
-		return OK_RC;
-	/*} else {
-		if (index != cur->childNum || !cur->HaveNextPage()) {
-			NodeHeader *root;
-			if ((rc = GetPageData(rootPNum, root)))
-				IX_PRINTSTACK
-			appendMinRID(pData);
-			if ((rc = SearchLeafNode(pData, root, cur)))
-				IX_PRINTSTACK
-			appendMaxRID(pData);
-			newPage = true;
-			index = cur->UpperBoundWithRID(pData);
-			if (IsValidScanResult(pData, compOp, cur, index))
-				return OK_RC;
-			if (index != cur->childNum || !cur->HaveNextPage()) {
-				cur = nullptr;
-				return OK_RC;
-			}
-			if ((rc = cur->NextPage(cur)))
-				IX_PRINTSTACK
-			newPage = true;
-			index = 0;
-			if (!IsValidScanResult(pData, compOp, cur, index))
-				cur = nullptr;
-			return OK_RC;
-		}
-		if ((rc = cur->NextPage(cur)))
-			IX_PRINTSTACK
-		newPage = true;
-		index = 0;
-		if (!IsValidScanResult(pData, compOp, cur, index))
-			cur = nullptr;
-		return OK_RC;
-	}*/
-	return OK_RC;
-}
-
 RC TreeHeader::SearchLeafNodeWithRID(char *pData, NodeHeader *cur, NodeHeader *&leaf) {
 	RC rc;
 	//printf(" selfPNum = [");
-	while (cur->nodeType != LeafNode) {
+	while (cur->hdr->nodeType != LeafNode) {
 		int index = cur->UpperBoundWithRID(pData);
-		int lastPNum = cur->selfPNum;
+		int lastPNum = cur->hdr->selfPNum;
 		if ((rc = cur->ChildPage(index, cur)))
 			IX_PRINTSTACK
-		cur->parentPNum = lastPNum; // important !!!
-		if ((rc = cur->MarkDirty()))
-			IX_PRINTSTACK
-		//printf(" ,%d) ", cur->selfPNum);
+		if (cur->hdr->parentPNum != lastPNum) {
+			cur->hdr->parentPNum = lastPNum; // important !!!
+			if ((rc = cur->MarkDirty()))
+				IX_PRINTSTACK
+		}
+		//printf(" ,%d) ", cur->hdr->selfPNum);
 	}
 	//printf("]\n");
 
@@ -920,30 +1174,32 @@ RC TreeHeader::SearchLeafNodeWithRID(char *pData, NodeHeader *cur, NodeHeader *&
 
 RC TreeHeader::SearchLeafNode(char *pData, NodeHeader *cur, NodeHeader *&leaf) {
     RC rc;
-    //printf("pagenum: %d\n", cur->selfPNum);
-    while (cur->nodeType != LeafNode) {
+    //printf("pagenum: %d\n", cur->hdr->selfPNum);
+    while (cur->hdr->nodeType != LeafNode) {
         NodeHeader *p = cur;
         int index = p->UpperBoundWithRID(pData);
-        int lastPNum = p->selfPNum;
+        int lastPNum = p->hdr->selfPNum;
         if ((rc = p->ChildPage(index, cur)))
             IX_PRINTSTACK
-        //printf("pagenum: %d\n", cur->selfPNum);
+        //printf("pagenum: %d\n", cur->hdr->selfPNum);
         /*if (cur->HaveNextPage()) {
             if (CompareAttrWithRID(cur->lastKey(), LT_OP, pData)) {
                 if (rc = cur->NextPage(cur))
                     IX_PRINTSTACK
-                printf("+1 %%%% pagenum: %d\n", cur->selfPNum);
+                printf("+1 %%%% pagenum: %d\n", cur->hdr->selfPNum);
             }
         }*/
-        cur->parentPNum = lastPNum; // important !!!
-        if ((rc = cur->MarkDirty()))
-            IX_PRINTSTACK
+        if (cur->hdr->parentPNum != lastPNum) {
+            cur->hdr->parentPNum = lastPNum; // important !!!
+            if ((rc = cur->MarkDirty()))
+                IX_PRINTSTACK
+        }
     }
     while (cur->HaveNextPage()) {
         if (CompareAttrWithRID(cur->lastKey(), LT_OP, pData)) {
             if ((rc = cur->NextPage(cur)))
                 IX_PRINTSTACK
-            //printf("+1 %%%% pagenum: %d\n", cur->selfPNum);
+            //printf("+1 %%%% pagenum: %d\n", cur->hdr->selfPNum);
         } else {
             break;
         }
@@ -973,7 +1229,7 @@ RC TreeHeader::GetLastLeafNode(NodeHeader *&leaf) {
 bool TreeHeader::IsValidScanResult(char *pData, CompOp compOp, NodeHeader *cur, int index) {
 	if (cur == nullptr)
 		return false;
-	if (index < 0 || index >= cur->childNum)
+	if (index < 0 || index >= cur->hdr->childNum)
 		return false;
 	return CompareAttr(cur->key(index), compOp, pData);
 }
@@ -988,46 +1244,66 @@ void TreeHeader::appendMinRID(char *pData) {
 	memmove(pData + attrLength + 1, &minRID, sizeof(RID));
 }
 
+// Separator for the node split between the entries left and right, left <
+// sep <= right.  The keys of a compressed tree are ordered byte by byte up
+// to the end of a string, so sep keeps the bytes of right up to the first
+// one that differs from left and zeros after it, the RID included (no
+// record has a smaller RID), unless both keys are equal.
+void TreeHeader::Separator(char *left, char *right, char *sep) {
+	memcpy(sep, right, attrLengthWithRid);
+	if (!keyCompression)
+		return;
+	int i = 1;
+	while (i <= attrLength && left[i] == right[i] && (attrType != STRING || right[i] != 0))
+		++i;
+	if (i > attrLength || left[i] == right[i])
+		return;
+	bool cut = false;
+	for (++i; i <= attrLength; ++i)
+		if (sep[i] != 0) {
+			sep[i] = 0;
+			cut = true;
+		}
+	if (cut)
+		memset(sep + attrLength + 1, 0, sizeof(RID));
+}
+
 RC TreeHeader::DisplayAllTree() {
 	RC rc;
 	int depth = 0;
-  char leftBuffer[PF_PAGE_SIZE];
-  char curBuffer[PF_PAGE_SIZE];
-	NodeHeader *left = nullptr;
-	if ((rc = GetPageData(rootPNum, left)))
-		IX_PRINTSTACK
-    memmove(leftBuffer, left, PF_PAGE_SIZE);
-    UnpinPages();
+	PageNum leftPNum = rootPNum;
 	while (true) {
-		printf("\n depth  %d  \n\n", depth);
-		NodeHeader* cur = (NodeHeader*)leftBuffer;
+		printf("\n depth  %d  \n\n", depth++);
+		PageNum pNum = leftPNum;
+		bool leafLevel;
 		while (true) {
-			printf("\nnew page  %d\n\nprev page  %d  next  page  %d\n\n", cur->selfPNum, cur->prevPNum, cur->nextPNum);
-      int maxC = cur->nodeType == LeafNode ? cur->childNum : cur->childNum - 1;
+			NodeHeader *cur;
+			if ((rc = GetPageData(pNum, cur)))
+				IX_PRINTSTACK
+			printf("\nnew page  %d\n\nprev page  %d  next  page  %d\n\n", cur->hdr->selfPNum, cur->hdr->prevPNum, cur->hdr->nextPNum);
+			leafLevel = cur->hdr->nodeType == LeafNode;
+			int maxC = leafLevel ? cur->hdr->childNum : cur->hdr->childNum - 1;
 			for (int i = 0; i < maxC; ++i) {
-        if (cur->nodeType == InternalNode)
-				printf("page: %d\n", *(cur->page(i)));
+				if (!leafLevel)
+					printf("page: %d\n", *(cur->page(i)));
 				PageNum pageNum;
 				SlotNum slotNum;
 				if ((rc = cur->rid(i)->GetPageNum(pageNum)) || (rc = cur->rid(i)->GetSlotNum(slotNum))) IX_PRINTSTACK
-				printf("key: %d, rid: ( %d, %d )\n", *(int*)(cur->key(i)), pageNum, slotNum);
+				printf("key: %d, rid: ( %d, %d )\n", *(int*)(cur->key(i) + 1), pageNum, slotNum);
 			}
-      if (cur->nodeType == InternalNode)
-			  printf("page: %d\n", *(cur->page(cur->childNum - 1)));
-			if (!cur->HaveNextPage())
-				break;
-			if ((rc = cur->NextPage(cur)))
+			if (!leafLevel)
+				printf("page: %d\n", *(cur->page(cur->hdr->childNum - 1)));
+			if (pNum == leftPNum && !leafLevel)
+				leftPNum = *cur->page(0);
+			bool last = !cur->HaveNextPage();
+			pNum = cur->hdr->nextPNum;
+			if ((rc = UnpinPages()))
 				IX_PRINTSTACK
-            memmove(curBuffer, cur, PF_PAGE_SIZE);
-            UnpinPages();
+			if (last)
+				break;
 		}
-        left = (NodeHeader*)leftBuffer;
-		if (left->nodeType == LeafNode)
+		if (leafLevel)
 			break;
-		if ((rc = left->ChildPage(0, left)))
-			IX_PRINTSTACK
-		memmove(leftBuffer, left, PF_PAGE_SIZE);
 	}
-    UnpinPages();
 	return OK_RC;
-}
\ No newline at end of file
+}
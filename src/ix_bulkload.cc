@@ -0,0 +1,327 @@
+//
+// File:        ix_bulkload.cc
+// Description: IX_IndexBuilder class implementation
+//              Builds a B+ tree bottom-up from its sorted entries instead
+//              of inserting them one at a time: the leaves are written
+//              left to right, then each internal level in one pass over
+//              the first keys of the level below.
+//
+
+#include "ix.h"
+#include <cstring>
+#include <algorithm>
+using namespace std;
+
+// Number of entries written to a node of the given fill factor
+static int IX_NodeCapacity(int maxChildNum, float fillFactor, int minChildNum) {
+    int capacity = (int)(maxChildNum * fillFactor);
+    if (capacity < minChildNum)
+        capacity = minChildNum;
+    if (capacity > maxChildNum)
+        capacity = maxChildNum;
+    return capacity;
+}
+
+IX_IndexBuilder::IX_IndexBuilder() { isOpen = false; }
+
+IX_IndexBuilder::~IX_IndexBuilder() { Close(); }
+
+// Start collecting the entries of an index
+RC IX_IndexBuilder::Open(AttrType attrType, int attrLength, int includeLength) {
+    RC rc;
+
+    if ((rc = Close()))
+        IX_PRINTSTACK
+    this->attrType = attrType;
+    this->attrLength = attrLength;
+    this->includeLength = includeLength;
+    keyLength = attrLength + 1 + sizeof(RID);
+    entryLength = keyLength + includeLength;
+    isOpen = true;
+    return OK_RC;
+}
+
+// Add an entry; the buffer is sorted and spilled as a run once full
+RC IX_IndexBuilder::AddEntry(void *pData, const RID &rid, const void *include) {
+    RC rc;
+
+    if (!isOpen)
+        IX_ERROR(IX_BUILDERCLOSED)
+
+    size_t size = buffer.size();
+    buffer.resize(size + entryLength);
+    memcpy(&buffer[size], pData, attrLength + 1);
+    memcpy(&buffer[size + attrLength + 1], &rid, sizeof(RID));
+    if (include != NULL)
+        memcpy(&buffer[size + keyLength], include, includeLength);
+    else
+        memset(&buffer[size + keyLength], 0, includeLength);
+
+    if (buffer.size() + entryLength > IX_SORTBUFFERSIZE)
+        if ((rc = SpillRun()))
+            IX_PRINTSTACK
+    return OK_RC;
+}
+
+// Sort the entries and write them into an empty index
+RC IX_IndexBuilder::Build(IX_IndexHandle &indexHandle, float fillFactor) {
+    RC rc;
+
+    if (!isOpen)
+        IX_ERROR(IX_BUILDERCLOSED)
+    if (!indexHandle.isOpen)
+        IX_ERROR(IX_INDEXHANDLECLOSED)
+
+    TreeHeader *tree = indexHandle.treeHeader;
+    if (tree->attrType != attrType || tree->attrLength != attrLength || tree->includeLength != includeLength)
+        IX_ERROR(IX_LENGTHNOTVALID)
+    NodeHeader *root;
+    if ((rc = tree->GetPageData(tree->rootPNum, root)))
+        IX_PRINTSTACK
+    if (root->hdr->nodeType != LeafNode || !root->IsEmpty()) {
+        tree->UnpinPages();
+        IX_ERROR(IX_INDEXNOTEMPTY)
+    }
+
+    if ((rc = StartMerge()))
+        IX_PRINTSTACK
+
+    // Leaves first, then one pass per internal level until a single node
+    // is left, which becomes the root.  The parentPNum of the other nodes
+    // is set by the descents that reach them.
+    // A compressed node is filled to the fill factor of its page instead of
+    // its number of entries.
+    vector<char> keys;
+    vector<PageNum> pages;
+    int leafCapacity = IX_NodeCapacity(tree->maxChildNum, fillFactor, 1);
+    int capacity = IX_NodeCapacity(tree->maxChildNum, fillFactor, 2);
+    int pageLength = PF_PAGE_SIZE;
+    if (tree->keyCompression) {
+        leafCapacity = capacity = tree->maxChildNum;
+        pageLength = min((int)(PF_PAGE_SIZE * fillFactor), PF_PAGE_SIZE);
+    }
+    if ((rc = WriteLeaves(tree, leafCapacity, pageLength, keys, pages)))
+        IX_PRINTSTACK
+    while (pages.size() > 1)
+        if ((rc = WriteLevel(tree, capacity, pageLength, keys, pages)))
+            IX_PRINTSTACK
+    tree->rootPNum = pages[0];
+
+    if ((rc = tree->WriteInfo()))
+        IX_PRINTSTACK
+    if ((rc = tree->UnpinPages()))
+        IX_PRINTSTACK
+    // the entries bypassed InsertEntry, set their bits in the Bloom filter
+    if ((rc = indexHandle.RebuildBloom()))
+        IX_PRINTSTACK
+    if ((rc = Close()))
+        IX_PRINTSTACK
+    return OK_RC;
+}
+
+// Drop the collected entries and the temporary sort runs
+RC IX_IndexBuilder::Close() {
+    for (size_t i = 0; i < runs.size(); ++i)
+        fclose(runs[i]);
+    runs.clear();
+    vector<char>().swap(buffer);
+    vector<int>().swap(order);
+    heads.clear();
+    heap.clear();
+    isOpen = false;
+    return OK_RC;
+}
+
+bool IX_IndexBuilder::EntryLess(char *entryA, char *entryB) {
+    return Attr::CompareAttrWithRID(attrType, attrLength, entryA, LT_OP, entryB);
+}
+
+// Sort the positions of the buffered entries
+void IX_IndexBuilder::SortBuffer() {
+    int count = buffer.size() / entryLength;
+    order.resize(count);
+    for (int i = 0; i < count; ++i)
+        order[i] = i;
+    char *first = buffer.empty() ? NULL : &buffer[0];
+    int length = entryLength;
+    sort(order.begin(), order.end(), [this, first, length](int a, int b) {
+        return EntryLess(first + a * length, first + b * length);
+    });
+}
+
+// Write the buffered entries to a temporary file as a sorted run
+RC IX_IndexBuilder::SpillRun() {
+    if (buffer.empty())
+        return OK_RC;
+
+    SortBuffer();
+    FILE *run = tmpfile();
+    if (run == NULL)
+        IX_ERROR(PF_UNIX)
+    runs.push_back(run);
+    for (size_t i = 0; i < order.size(); ++i)
+        if (fwrite(&buffer[order[i] * entryLength], entryLength, 1, run) != 1)
+            IX_ERROR(PF_UNIX)
+    if (fflush(run) || fseek(run, 0, SEEK_SET))
+        IX_ERROR(PF_UNIX)
+    buffer.clear();
+    order.clear();
+    return OK_RC;
+}
+
+// Prepare NextEntry: sort in memory if nothing was spilled, otherwise
+// spill the rest too and merge the runs
+RC IX_IndexBuilder::StartMerge() {
+    RC rc;
+
+    orderPos = 0;
+    if (runs.empty()) {
+        SortBuffer();
+        return OK_RC;
+    }
+    if ((rc = SpillRun()))
+        IX_PRINTSTACK
+    vector<char>().swap(buffer);
+
+    heads.resize(runs.size() * entryLength);
+    heap.clear();
+    for (size_t i = 0; i < runs.size(); ++i)
+        if (fread(&heads[i * entryLength], entryLength, 1, runs[i]) == 1)
+            heap.push_back(i);
+    return OK_RC;
+}
+
+// Get the next entry in (key, RID) order, IX_EOF after the last one.
+// The entry stays valid until the next call.
+RC IX_IndexBuilder::NextEntry(char *&entry) {
+    if (runs.empty()) {
+        if (orderPos == order.size())
+            return IX_EOF;
+        entry = &buffer[order[orderPos++] * entryLength];
+        return OK_RC;
+    }
+
+    // heap[0] is the run whose current entry is the smallest
+    auto greater = [this](int a, int b) {
+        return EntryLess(&heads[b * entryLength], &heads[a * entryLength]);
+    };
+    if (orderPos == 0)
+        make_heap(heap.begin(), heap.end(), greater);
+    else {
+        int last = heap[0];
+        pop_heap(heap.begin(), heap.end(), greater);
+        if (fread(&heads[last * entryLength], entryLength, 1, runs[last]) == 1)
+            push_heap(heap.begin(), heap.end(), greater);
+        else
+            heap.pop_back();
+    }
+    ++orderPos;
+    if (heap.empty())
+        return IX_EOF;
+    entry = &heads[heap[0] * entryLength];
+    return OK_RC;
+}
+
+// Fill the leaves from the sorted entries, reusing the empty root as the
+// first leaf.  Returns the page number of every leaf and the key that
+// separates it from the previous leaf (the first key of the first leaf).
+RC IX_IndexBuilder::WriteLeaves(TreeHeader *tree, int capacity, int pageLength,
+                                vector<char> &keys, vector<PageNum> &pages) {
+    RC rc;
+
+    NodeHeader *leaf;
+    if ((rc = tree->GetPageData(tree->rootPNum, leaf)))
+        IX_PRINTSTACK
+    pages.push_back(leaf->hdr->selfPNum);
+
+    char *entry;
+    while ((rc = NextEntry(entry)) == OK_RC) {
+        if (leaf->hdr->childNum == capacity || (!leaf->IsEmpty() && leaf->IsFull(entry, pageLength))) {
+            PageNum newPNum;
+            NodeHeader *newLeaf;
+            if ((rc = tree->AllocatePage(newPNum, newLeaf)))
+                IX_PRINTSTACK
+            newLeaf->hdr->selfPNum = newPNum;
+            newLeaf->hdr->nodeType = LeafNode;
+            newLeaf->hdr->parentPNum = -1;
+            newLeaf->hdr->prevPNum = leaf->hdr->selfPNum;
+            newLeaf->hdr->nextPNum = tree->infoPNum;
+            newLeaf->hdr->childNum = 0;
+            leaf->hdr->nextPNum = newPNum;
+            size_t size = keys.size();
+            keys.resize(size + keyLength);
+            tree->Separator(leaf->lastKey(), entry, &keys[size]);
+            if ((rc = leaf->MarkDirty()))
+                IX_PRINTSTACK
+            if ((rc = tree->UnpinPage(leaf->hdr->selfPNum)))
+                IX_PRINTSTACK
+            leaf = newLeaf;
+            pages.push_back(newPNum);
+        }
+        if (keys.empty())
+            keys.insert(keys.end(), entry, entry + keyLength);
+        leaf->AddLength(entry);
+        memcpy(leaf->key(leaf->hdr->childNum), entry, keyLength);
+        memcpy(leaf->include(leaf->hdr->childNum++), entry + keyLength, includeLength);
+    }
+    if (rc != IX_EOF)
+        IX_PRINTSTACK
+
+    tree->dataTailPNum = leaf->hdr->selfPNum;
+    if ((rc = leaf->MarkDirty()))
+        IX_PRINTSTACK
+    if ((rc = tree->UnpinPage(leaf->hdr->selfPNum)))
+        IX_PRINTSTACK
+    return OK_RC;
+}
+
+// Write the internal level above the given nodes; keys and pages are
+// replaced by the separators and page numbers of the new level
+RC IX_IndexBuilder::WriteLevel(TreeHeader *tree, int capacity, int pageLength,
+                               vector<char> &keys, vector<PageNum> &pages) {
+    RC rc;
+
+    vector<char> upperKeys;
+    vector<PageNum> upperPages;
+    NodeHeader *node = NULL;
+    for (size_t i = 0; i < pages.size(); ++i) {
+        char *key = &keys[i * keyLength];
+        if (node == NULL || node->hdr->childNum == capacity
+            || (node->hdr->childNum >= 2 && node->IsFull(key, pageLength))) {
+            PageNum newPNum;
+            NodeHeader *newNode;
+            if ((rc = tree->AllocatePage(newPNum, newNode)))
+                IX_PRINTSTACK
+            newNode->hdr->selfPNum = newPNum;
+            newNode->hdr->nodeType = InternalNode;
+            newNode->hdr->parentPNum = -1;
+            newNode->hdr->prevPNum = -1;
+            newNode->hdr->nextPNum = -1;
+            newNode->hdr->childNum = 0;
+            if (node != NULL) {
+                newNode->hdr->prevPNum = node->hdr->selfPNum;
+                node->hdr->nextPNum = newPNum;
+                if ((rc = node->MarkDirty()))
+                    IX_PRINTSTACK
+                if ((rc = tree->UnpinPage(node->hdr->selfPNum)))
+                    IX_PRINTSTACK
+            }
+            node = newNode;
+            upperKeys.insert(upperKeys.end(), key, key + keyLength);
+            upperPages.push_back(newPNum);
+        } else {
+            // the key of a child separates it from its left sibling
+            node->AddLength(key);
+            memcpy(node->key(node->hdr->childNum - 1), key, keyLength);
+        }
+        *node->page(node->hdr->childNum++) = pages[i];
+    }
+    if ((rc = node->MarkDirty()))
+        IX_PRINTSTACK
+    if ((rc = tree->UnpinPage(node->hdr->selfPNum)))
+        IX_PRINTSTACK
+
+    keys.swap(upperKeys);
+    pages.swap(upperPages);
+    return OK_RC;
+}
@@ -24,7 +24,13 @@ static char *IX_WarnMsg[] = {
   (char*)"the indexhandle has already been opened",
   (char*)"delete rid from internal node",
   (char*)"delete rid not exist",
-  (char*)"delete page from leaf node"
+  (char*)"delete page from leaf node",
+  (char*)"bulk load into an index that is not empty",
+  (char*)"the index builder has not been opened",
+  (char*)"an entry with the key already exists",
+  (char*)"included or key attributes invalid, or entries too long for a node",
+  (char*)"too many pages pinned by one index operation",
+  (char*)"index file in an unknown format"
 };
 
 static char *IX_ErrorMsg[] = {};
@@ -7,23 +7,52 @@
 #include "ix.h"
 using namespace std;
 
-IX_IndexHandle::IX_IndexHandle() { isOpen = false; }
+IX_IndexHandle::IX_IndexHandle() { isOpen = false; bloomKeys = 0; treeHeader = NULL; }
 
 IX_IndexHandle::~IX_IndexHandle() {}
 
 // Insert a new index entry
-RC IX_IndexHandle::InsertEntry(void *pData, const RID &rid) {
+RC IX_IndexHandle::InsertEntry(void *pData, const RID &rid, const void *include) {
     RC rc;
 
     if (!isOpen)
         IX_ERROR(IX_INDEXHANDLECLOSED)
 
-    char tmp[300];
+    char tmp[PF_PAGE_SIZE];
     memmove(tmp, pData, treeHeader->attrLength + 1);
     memmove(tmp + treeHeader->attrLength + 1, &rid, sizeof(RID));
+    SetInclude(tmp, include);
     
     if ((rc = treeHeader->Insert((char*)tmp)))
         IX_PRINTSTACK;
+    AddBloom((char*)pData);
+
+    return OK_RC;
+}
+
+// Insert a new index entry unless one with the same key exists; a key
+// ruled out by the Bloom filter is inserted without looking
+RC IX_IndexHandle::InsertUnique(void *pData, const RID &rid, const void *include) {
+    RC rc;
+
+    if (!isOpen)
+        IX_ERROR(IX_INDEXHANDLECLOSED)
+
+    char tmp[PF_PAGE_SIZE];
+    memmove(tmp, pData, treeHeader->attrLength + 1);
+    memmove(tmp + treeHeader->attrLength + 1, &rid, sizeof(RID));
+    SetInclude(tmp, include);
+
+    bool exists = false;
+    if (!MayContain(pData)) {
+        if ((rc = treeHeader->Insert((char*)tmp)))
+            IX_PRINTSTACK
+    } else if ((rc = treeHeader->InsertUnique((char*)tmp, exists))) {
+        IX_PRINTSTACK
+    }
+    if (exists)
+        return IX_DUPLICATEKEY;
+    AddBloom((char*)pData);
 
     return OK_RC;
 }
@@ -35,7 +64,7 @@ RC IX_IndexHandle::DeleteEntry(void *pData, const RID &rid) {
     if (!isOpen)
         IX_ERROR(IX_INDEXHANDLECLOSED)
 
-    char tmp[300];
+    char tmp[PF_PAGE_SIZE];
     memmove(tmp, pData, treeHeader->attrLength + 1);
     memmove(tmp + treeHeader->attrLength + 1, &rid, sizeof(RID));
 
@@ -52,19 +81,160 @@ RC IX_IndexHandle::ForcePages() {
     if (!isOpen)
         IX_ERROR(IX_INDEXHANDLECLOSED)
 
+    // the tree header stays pinned while the index is open
+    if ((rc = treeHeader->WriteInfo()))
+        IX_PRINTSTACK
     if ((rc = indexFH.ForcePages()))
         IX_ERROR(rc)
     return OK_RC;
 }
 
+// Number of entries in the index, summed over the leaf chain
+RC IX_IndexHandle::GetNumEntries(int &numEntries) {
+    RC rc;
+
+    if (!isOpen)
+        IX_ERROR(IX_INDEXHANDLECLOSED)
+
+    numEntries = 0;
+    PageNum pNum = treeHeader->dataHeadPNum;
+    while (true) {
+        NodeHeader *leaf;
+        if ((rc = treeHeader->GetPageData(pNum, leaf)))
+            IX_PRINTSTACK
+        numEntries += leaf->hdr->childNum;
+        bool last = !leaf->HaveNextPage();
+        pNum = leaf->hdr->nextPNum;
+        if ((rc = treeHeader->UnpinPages()))
+            IX_PRINTSTACK
+        if (last)
+            break;
+    }
+    return OK_RC;
+}
+
+// Smallest key of the index, from the first leaf; only the root leaf can
+// be empty, so an empty first leaf means an empty index and IX_EOF
+RC IX_IndexHandle::GetFirstKey(void *pData) {
+    RC rc;
+
+    if (!isOpen)
+        IX_ERROR(IX_INDEXHANDLECLOSED)
+
+    NodeHeader *leaf;
+    if ((rc = treeHeader->GetFirstLeafNode(leaf)))
+        IX_PRINTSTACK
+    bool empty = leaf->hdr->childNum == 0;
+    if (!empty)
+        memcpy(pData, leaf->key(0), treeHeader->attrLength + 1);
+    if ((rc = treeHeader->UnpinPages()))
+        IX_PRINTSTACK
+    return empty ? IX_EOF : OK_RC;
+}
+
+// Largest key of the index, from the last leaf, IX_EOF if it is empty
+RC IX_IndexHandle::GetLastKey(void *pData) {
+    RC rc;
+
+    if (!isOpen)
+        IX_ERROR(IX_INDEXHANDLECLOSED)
+
+    NodeHeader *leaf;
+    if ((rc = treeHeader->GetLastLeafNode(leaf)))
+        IX_PRINTSTACK
+    bool empty = leaf->hdr->childNum == 0;
+    if (!empty)
+        memcpy(pData, leaf->lastKey(), treeHeader->attrLength + 1);
+    if ((rc = treeHeader->UnpinPages()))
+        IX_PRINTSTACK
+    return empty ? IX_EOF : OK_RC;
+}
+
+AttrType IX_IndexHandle::GetAttrType() const {
+    return treeHeader->attrType;
+}
+
+vector<IX_IncludeField> IX_IndexHandle::GetIncludeFields() const {
+    return vector<IX_IncludeField>(treeHeader->includeFields, treeHeader->includeFields + treeHeader->numIncludeFields);
+}
+
+int IX_IndexHandle::GetIncludeLength() const {
+    return treeHeader->includeLength;
+}
+
+// Copy the included attributes of a record one after the other
+void IX_IndexHandle::GetInclude(const char *recordData, char *include) const {
+    for (int i = 0; i < treeHeader->numIncludeFields; ++i) {
+        const IX_IncludeField &field = treeHeader->includeFields[i];
+        memcpy(include, recordData + field.offset, field.length + 1);
+        include += field.length + 1;
+    }
+}
+
+vector<IX_KeyField> IX_IndexHandle::GetKeyFields() const {
+    return vector<IX_KeyField>(treeHeader->keyFields, treeHeader->keyFields + treeHeader->numKeyFields);
+}
+
+int IX_IndexHandle::GetKeyLength() const {
+    return treeHeader->attrLength + 1;
+}
+
+// Encode the key attributes of a record one after the other behind a set
+// null flag
+void IX_IndexHandle::GetKey(const char *recordData, char *key) const {
+    *key++ = 1;
+    for (int i = 0; i < treeHeader->numKeyFields; ++i) {
+        const IX_KeyField &field = treeHeader->keyFields[i];
+        Attr::EncodeKey(field.attrType, field.length, recordData + field.offset, key);
+        key += field.length + 1;
+    }
+}
+
+// Append the included values to the key and RID of an entry
+void IX_IndexHandle::SetInclude(char *entry, const void *include) const {
+    char *dest = entry + treeHeader->attrLengthWithRid;
+    if (include != NULL)
+        memcpy(dest, include, treeHeader->includeLength);
+    else
+        memset(dest, 0, treeHeader->includeLength);
+}
+
 RC IX_IndexHandle::DisplayAllTree() {
     return treeHeader->DisplayAllTree();
 }
 
 // Create a new Index.
-RC IX_IndexHandle::CreateIndex(AttrType attrType, int attrLength) {
+RC IX_IndexHandle::CreateIndex(AttrType attrType, int attrLength, const vector<IX_IncludeField> &includeFields,
+                               const vector<IX_KeyField> &keyFields) {
     RC rc;
 
+    // The included values share the value slot of an entry with the child
+    // page number of an internal node, and at least four entries must fit
+    // in a node.
+    int includeLength = 0;
+    if (includeFields.size() > IX_MAXINCLUDEFIELDS)
+        IX_ERROR(IX_INCLUDEINVALID)
+    for (const auto &field : includeFields) {
+        if (field.offset < 0 || field.length <= 0)
+            IX_ERROR(IX_INCLUDEINVALID)
+        includeLength += field.length + 1;
+    }
+    if (keyFields.size() > IX_MAXKEYFIELDS)
+        IX_ERROR(IX_INCLUDEINVALID)
+    int attrLengthWithRid = attrLength + sizeof(RID) + 1;
+    int childItemSize = includeLength > (int)sizeof(PageNum) ? includeLength : sizeof(PageNum);
+    int maxChildNum = (PF_PAGE_SIZE - sizeof(IX_NodePage)) / (attrLengthWithRid + childItemSize);
+    if (maxChildNum < 4)
+        IX_ERROR(IX_INCLUDEINVALID)
+    // Keys compared byte by byte are compressed, a node then holds as many
+    // entries as fit in its page, up to IX_MAXCOMPRESSION times more
+    int keyCompression = attrType == STRING || attrType == PRIMARYKEY;
+    if (keyCompression) {
+        int minEntryLength = sizeof(short) + sizeof(RID) + childItemSize;
+        maxChildNum = min(maxChildNum * IX_MAXCOMPRESSION,
+                          (int)(PF_PAGE_SIZE - sizeof(IX_NodePage) - sizeof(short)) / minEntryLength);
+    }
+
     // Allocate new info page and new root page.
     PF_PageHandle infoPH;
     PageNum infoPNum;
@@ -78,22 +248,31 @@ RC IX_IndexHandle::CreateIndex(AttrType attrType, int attrLength) {
         IX_ERROR(rc)
 
     // Setup info page and root page.
-    treeHeader = (TreeHeader*)infoPData;
-    NodeHeader *rootHeader = (NodeHeader*)rootPData;
-    treeHeader->infoPNum = infoPNum;
-    treeHeader->rootPNum = rootPNum;
-    treeHeader->attrType = attrType;
-    treeHeader->attrLength = attrLength;
-    treeHeader->attrLengthWithRid = attrLength + sizeof(RID) + 1;
-    treeHeader->childItemSize = sizeof(PageNum);
-    treeHeader->maxChildNum = (PF_PAGE_SIZE - sizeof(NodeHeader)) / (treeHeader->attrLengthWithRid + treeHeader->childItemSize);
-    treeHeader->dataHeadPNum = treeHeader->rootPNum;
-    treeHeader->dataTailPNum = treeHeader->rootPNum;
+    IX_TreeInfo *info = (IX_TreeInfo*)infoPData;
+    IX_NodePage *rootHeader = (IX_NodePage*)rootPData;
+    info->formatVersion = IX_FORMATVERSION;
+    info->keyCompression = keyCompression;
+    info->infoPNum = infoPNum;
+    info->rootPNum = rootPNum;
+    info->attrType = attrType;
+    info->attrLength = attrLength;
+    info->attrLengthWithRid = attrLengthWithRid;
+    info->childItemSize = childItemSize;
+    info->maxChildNum = maxChildNum;
+    info->includeLength = includeLength;
+    info->numIncludeFields = includeFields.size();
+    for (unsigned int i = 0; i < includeFields.size(); ++i)
+        info->includeFields[i] = includeFields[i];
+    info->numKeyFields = keyFields.size();
+    for (unsigned int i = 0; i < keyFields.size(); ++i)
+        info->keyFields[i] = keyFields[i];
+    info->dataHeadPNum = info->rootPNum;
+    info->dataTailPNum = info->rootPNum;
     rootHeader->selfPNum = rootPNum;
     rootHeader->nodeType = LeafNode;
     rootHeader->parentPNum = -1;
-    rootHeader->prevPNum = treeHeader->infoPNum;
-    rootHeader->nextPNum = treeHeader->infoPNum;
+    rootHeader->prevPNum = infoPNum;
+    rootHeader->nextPNum = infoPNum;
     rootHeader->childNum = 0;
     if ((rc = indexFH.MarkDirty(infoPNum)))
         IX_ERROR(rc)
@@ -115,19 +294,68 @@ RC IX_IndexHandle::OpenIndex() {
         IX_ERROR(rc)
     if ((rc = infoPH.GetData(infoPData)))
         IX_ERROR(rc)
-    treeHeader = (TreeHeader*)infoPData;
-    treeHeader->pageMap = &(this->pageMap);
+    if (((IX_TreeInfo*)infoPData)->formatVersion != IX_FORMATVERSION && (rc = ConvertIndex(infoPData)))
+        IX_PRINTSTACK
+    // the tree header works on a copy of the header page, written back by
+    // WriteInfo
+    treeHeader = new TreeHeader;
+    memcpy((IX_TreeInfo*)treeHeader, infoPData, sizeof(IX_TreeInfo));
+    treeHeader->infoData = infoPData;
     treeHeader->indexFH = &(this->indexFH);
     isOpen = true;
     return OK_RC;
 }
 
-RC IX_IndexHandle::CloseIndex() {
+// Convert an index file written by the 32-bit build, whose node pages
+// began with in-memory pointers and whose header page held the file handle
+// and page map pointers where formatVersion and keyCompression are now:
+// move the entries of every node down to the smaller node header.
+RC IX_IndexHandle::ConvertIndex(char *infoPData) {
     RC rc;
-    if ((rc = indexFH.MarkDirty(treeHeader->infoPNum)))
+    IX_TreeInfo *info = (IX_TreeInfo*)infoPData;
+    int entriesLength = (info->attrLengthWithRid + info->childItemSize) * info->maxChildNum;
+    if (entriesLength > PF_PAGE_SIZE - IX_V1NODEHEADERSIZE)
+        IX_ERROR(IX_BADINDEXFILE)
+
+    PF_PageHandle ph;
+    PageNum pNum = -1;
+    while ((rc = indexFH.GetNextPage(pNum, ph)) != PF_EOF) {
+        if (rc)
+            IX_ERROR(rc)
+        char *data;
+        if ((rc = ph.GetPageNum(pNum)) || (rc = ph.GetData(data)))
+            IX_ERROR(rc)
+        if (pNum != info->infoPNum) {
+            memmove(data + sizeof(IX_NodePage), data + IX_V1NODEHEADERSIZE, entriesLength);
+            if ((rc = indexFH.MarkDirty(pNum)))
+                IX_ERROR(rc)
+        }
+        if ((rc = indexFH.UnpinPage(pNum)))
+            IX_ERROR(rc)
+    }
+    info->formatVersion = IX_FORMATVERSION;
+    info->keyCompression = 0;
+    // the first format ends the header page at these two words
+    info->includeLength = 0;
+    info->numIncludeFields = 0;
+    info->numKeyFields = 0;
+    if ((rc = indexFH.MarkDirty(info->infoPNum)))
         IX_ERROR(rc)
+    return OK_RC;
+}
+
+RC IX_IndexHandle::CloseIndex() {
+    RC rc;
+    if ((rc = WriteBloom()))
+        IX_PRINTSTACK
+    if ((rc = treeHeader->ReleaseNodes()))
+        IX_PRINTSTACK
+    if ((rc = treeHeader->WriteInfo()))
+        IX_PRINTSTACK
     if ((rc = indexFH.UnpinPage(treeHeader->infoPNum)))
         IX_ERROR(rc)
+    delete treeHeader;
+    treeHeader = NULL;
     isOpen = false;
     return OK_RC;
 }
@@ -7,9 +7,9 @@
 #include "ix.h"
 using namespace std;
 
-IX_IndexScan::IX_IndexScan() : tree(nullptr), cur(nullptr) {}
+IX_IndexScan::IX_IndexScan() : tree(nullptr), cur(nullptr) { pinnedLeaf.buffer = nullptr; }
 
-IX_IndexScan::~IX_IndexScan() {}
+IX_IndexScan::~IX_IndexScan() { CloseScan(); }
 
 // Open index scan
 RC IX_IndexScan::OpenScan(const IX_IndexHandle &indexHandle, CompOp compOp, void *value) {
@@ -24,25 +24,25 @@ RC IX_IndexScan::OpenScan(const IX_IndexHandle &indexHandle, CompOp compOp, void
 	}
 	op = compOp;
 
-	if ((rc = tree->Search(pData, op, cur, index)))
+	// the scan keeps its own pin on the leaf, the pins of the search go
+	NodeHeader *leaf = nullptr;
+	if ((rc = tree->Search(pData, op, leaf, index)))
+		IX_PRINTSTACK
+	if (leaf != nullptr && (rc = PinLeaf(leaf->hdr->selfPNum)))
 		IX_PRINTSTACK
-
-	if (cur != nullptr) {
-		memcpy(buffer, cur, PF_PAGE_SIZE);
-		cur = (NodeHeader*)buffer;
-	}
-
 	if ((rc = tree->UnpinPages()))
 		IX_PRINTSTACK
+	if (cur != nullptr && (rc = SeekEntry()))
+		IX_PRINTSTACK
 	/*printf("maxChildNum: %d\n", tree->maxChildNum);
-	printf("curPage: %d\n", cur->selfPNum);
+	printf("curPage: %d\n", cur->hdr->selfPNum);
 	printf("curKey: %d\n", *(int*)cur->key(index));*/
 	/*NodeHeader* parent;
 	cur->ParentPage(parent);
 	while (true) {
-		int t = parent->selfPNum;
-		printf("selfPNum: %d ----", parent->selfPNum);
-		for (int i = 0; i < parent->childNum; ++i) {
+		int t = parent->hdr->selfPNum;
+		printf("selfPNum: %d ----", parent->hdr->selfPNum);
+		for (int i = 0; i < parent->hdr->childNum; ++i) {
 			int tKey = *(int*)parent->key(i);
 			RID tRID = *parent->rid(i);
 			int tPageNum;
@@ -61,9 +61,9 @@ RC IX_IndexScan::OpenScan(const IX_IndexHandle &indexHandle, CompOp compOp, void
 	}*/
 	/*printf("\n\n\n\n\nLeaf:\n");
 	while (true) {
-		int t = cur->selfPNum;
-		printf("selfPNum: %d ----", cur->selfPNum);
-		for (int i = 0; i < cur->childNum; ++i) {
+		int t = cur->hdr->selfPNum;
+		printf("selfPNum: %d ----", cur->hdr->selfPNum);
+		for (int i = 0; i < cur->hdr->childNum; ++i) {
 			int tKey = *(int*)cur->key(i);
 			RID tRID = *cur->rid(i);
 			int tPageNum;
@@ -81,8 +81,8 @@ RC IX_IndexScan::OpenScan(const IX_IndexHandle &indexHandle, CompOp compOp, void
 		tree->indexFH->UnpinPage(t);
 	}
 	tree->GetPageData(tree->rootPNum, cur);
-	printf("selfPNum: %d ----", cur->selfPNum);
-	for (int i = 0; i < cur->childNum; ++i) {
+	printf("selfPNum: %d ----", cur->hdr->selfPNum);
+	for (int i = 0; i < cur->hdr->childNum; ++i) {
 		int tKey = *(int*)cur->key(i);
 		RID tRID = *cur->rid(i);
 		int tPageNum;
@@ -103,30 +103,91 @@ RC IX_IndexScan::GetNextEntry(RID &r) {
 		IX_ERROR(IX_EOF)
 
 	r = *(cur->rid(index));
-	// printf("cur: %p\n", cur);
-	// printf("key: %d\n", *(int*)cur->key(index));
+	if (++index < end)
+		return OK_RC;
+	if ((rc = SeekEntry()))
+		IX_PRINTSTACK
+	return OK_RC;
+}
 
-	bool newPage = false;
+// Get the next matching entry, its key and its included values
+RC IX_IndexScan::GetNextEntry(RID &r, void *key, void *include) {
+	if (cur != nullptr) {
+		memcpy(key, cur->key(index), tree->attrLength + 1);
+		if (include != NULL)
+			memcpy(include, cur->include(index), tree->includeLength);
+	}
+	return GetNextEntry(r);
+}
 
-	if ((rc = tree->GetNextEntry(pData, op, cur, index, newPage)))
-		IX_PRINTSTACK
-	
-	if (cur != nullptr && newPage) {
-		memcpy(buffer, cur, PF_PAGE_SIZE);
-		cur = (NodeHeader*)buffer;
+// Pin a leaf for the scan and find the end of its matching entries: the
+// entries of a leaf are sorted, so one binary search bounds them and the
+// scan needs no comparison per entry
+RC IX_IndexScan::PinLeaf(PageNum pNum) {
+	RC rc;
+
+	PF_PageHandle ph;
+	char *data;
+	if ((rc = tree->indexFH->GetThisPage(pNum, ph)))
+		IX_ERROR(rc)
+	if ((rc = ph.GetData(data)))
+		IX_ERROR(rc)
+	tree->SetNode(pinnedLeaf, data);
+	cur = &pinnedLeaf;
+
+	switch (op) {
+	case EQ_OP:
+	case LE_OP:
+		end = cur->UpperBound(pData);
+		break;
+	case LT_OP:
+		end = cur->LowerBound(pData);
+		break;
+	default:
+		end = cur->hdr->childNum;
+		break;
+	}
+	return OK_RC;
+}
+
+RC IX_IndexScan::UnpinLeaf() {
+	RC rc;
+
+	PageNum pNum = cur->hdr->selfPNum;
+	cur = nullptr;
+	if ((rc = tree->indexFH->UnpinPage(pNum)))
+		IX_ERROR(rc)
+	return OK_RC;
+}
+
+// Move past the matching entries of the current leaf: into the next leaf
+// if they reach its end, otherwise the scan is over
+RC IX_IndexScan::SeekEntry() {
+	RC rc;
+
+	while (index >= end) {
+		bool last = end < cur->hdr->childNum || !cur->HaveNextPage();
+		PageNum nextPNum = cur->hdr->nextPNum;
+		if ((rc = UnpinLeaf()))
+			IX_PRINTSTACK
+		if (last)
+			return OK_RC;
+		if ((rc = PinLeaf(nextPNum)))
+			IX_PRINTSTACK
+		index = 0;
 	}
-	
-	if ((rc = tree->UnpinPages()))
-		IX_PRINTSTACK
-	
 	return OK_RC;
 }
 
 // Close index scan
 RC IX_IndexScan::CloseScan() {
-	cur = nullptr;
-	if (tree)
-		tree->UnpinPages();
+	RC rc;
+
+	if (cur != nullptr && (rc = UnpinLeaf()))
+		IX_PRINTSTACK
+	// the entries of the next index may be longer
+	delete[] pinnedLeaf.buffer;
+	pinnedLeaf.buffer = nullptr;
 	tree = nullptr;
   return OK_RC;
 }
\ No newline at end of file
@@ -8,14 +8,22 @@
 #include <cstring>
 #include <cstdio>
 #include <cstdlib>
+#include <string>
+#include <unistd.h>
 using namespace std;
 
-IX_Manager::IX_Manager(PF_Manager &pfm) : PFMgr(pfm) {}
+// Name of the Bloom filter file of an index file
+static string IX_BloomFileName(const char *indexFile) {
+    return string(indexFile) + ".bloom";
+}
+
+IX_Manager::IX_Manager(PF_Manager &pfm) : PFMgr(pfm), cachedNodes(0) {}
 
 IX_Manager::~IX_Manager() {}
 
 // Create a new Index
-RC IX_Manager::CreateIndex(const char *fileName, int indexNo, AttrType attrType, int attrLength) {
+RC IX_Manager::CreateIndex(const char *fileName, int indexNo, AttrType attrType, int attrLength,
+                           const vector<IX_IncludeField> &includeFields, const vector<IX_KeyField> &keyFields) {
     RC rc;
 
     char *file = generateIndexFileName(fileName, indexNo);
@@ -25,8 +33,13 @@ RC IX_Manager::CreateIndex(const char *fileName, int indexNo, AttrType attrType,
     IX_IndexHandle indexHandle;
     if ((rc = PFMgr.OpenFile(file, indexHandle.indexFH)))
         IX_ERROR(rc)
-    if ((rc = indexHandle.CreateIndex(attrType, attrLength)))
+    // an index whose included attributes do not fit leaves no file
+    if ((rc = indexHandle.CreateIndex(attrType, attrLength, includeFields, keyFields))) {
+        PFMgr.CloseFile(indexHandle.indexFH);
+        PFMgr.DestroyFile(file);
+        delete[] file;
         IX_PRINTSTACK
+    }
     if ((rc = PFMgr.CloseFile(indexHandle.indexFH)))
         IX_ERROR(rc)
 
@@ -41,11 +54,44 @@ RC IX_Manager::DestroyIndex(const char *fileName, int indexNo) {
     char *file = generateIndexFileName(fileName, indexNo);
     if ((rc = PFMgr.DestroyFile(file)))
         IX_ERROR(rc)
+    string bloomFile = IX_BloomFileName(file);
+    if (access(bloomFile.c_str(), F_OK) == 0 && (rc = PFMgr.DestroyFile(bloomFile.c_str())))
+        IX_ERROR(rc)
 
     delete[] file;
     return OK_RC;
 }
 
+// Rename an Index, with its Bloom filter file: a target filter left
+// without a source one would not match the index, it is removed
+RC IX_Manager::RenameIndex(const char *fileName, int indexNo, const char *newFileName) {
+    RC rc;
+
+    char *file = generateIndexFileName(fileName, indexNo);
+    char *newFile = generateIndexFileName(newFileName, indexNo);
+    string bloomFile = IX_BloomFileName(file);
+    string newBloomFile = IX_BloomFileName(newFile);
+    if ((rc = PFMgr.RenameFile(file, newFile)) == OK_RC) {
+        if (access(bloomFile.c_str(), F_OK) == 0)
+            rc = PFMgr.RenameFile(bloomFile.c_str(), newBloomFile.c_str());
+        else if (access(newBloomFile.c_str(), F_OK) == 0)
+            rc = PFMgr.DestroyFile(newBloomFile.c_str());
+    }
+    delete[] file;
+    delete[] newFile;
+    if (rc)
+        IX_ERROR(rc)
+    return OK_RC;
+}
+
+// Whether an Index exists
+bool IX_Manager::IndexExists(const char *fileName, int indexNo) {
+    char *file = generateIndexFileName(fileName, indexNo);
+    bool exists = access(file, F_OK) == 0;
+    delete[] file;
+    return exists;
+}
+
 // Open an Index
 RC IX_Manager::OpenIndex(const char *fileName, int indexNo, IX_IndexHandle &indexHandle) {
     RC rc;
@@ -58,6 +104,15 @@ RC IX_Manager::OpenIndex(const char *fileName, int indexNo, IX_IndexHandle &inde
         IX_ERROR(rc)
     if ((rc = indexHandle.OpenIndex()))
         IX_PRINTSTACK
+    indexHandle.treeHeader->pages.cachedNodes = &cachedNodes;
+    // an index without a Bloom filter file yet gets one built from its leaves
+    string bloomFile = IX_BloomFileName(file);
+    if (access(bloomFile.c_str(), F_OK) != 0 && (rc = PFMgr.CreateFile(bloomFile.c_str())))
+        IX_ERROR(rc)
+    if ((rc = PFMgr.OpenFile(bloomFile.c_str(), indexHandle.bloomFH)))
+        IX_ERROR(rc)
+    if ((rc = indexHandle.ReadBloom()))
+        IX_PRINTSTACK
 
     delete[] file;
     return OK_RC;
@@ -72,6 +127,55 @@ RC IX_Manager::CloseIndex(IX_IndexHandle &indexHandle) {
         IX_PRINTSTACK
     if ((rc = PFMgr.CloseFile(indexHandle.indexFH)))
         IX_ERROR(rc)
+    if ((rc = PFMgr.CloseFile(indexHandle.bloomFH)))
+        IX_ERROR(rc)
+    return OK_RC;
+}
+
+// Rebuild an Index: collect its entries in leaf order, then recreate the
+// file and bulk load them back, packing every node to fillFactor
+RC IX_Manager::RebuildIndex(const char *fileName, int indexNo, float fillFactor) {
+    RC rc;
+
+    IX_IndexHandle indexHandle;
+    if ((rc = OpenIndex(fileName, indexNo, indexHandle)))
+        IX_PRINTSTACK
+    TreeHeader *tree = indexHandle.treeHeader;
+    AttrType attrType = tree->attrType;
+    int attrLength = tree->attrLength;
+    vector<IX_IncludeField> includeFields = indexHandle.GetIncludeFields();
+    vector<IX_KeyField> keyFields = indexHandle.GetKeyFields();
+    IX_IndexBuilder builder;
+    if ((rc = builder.Open(attrType, attrLength, tree->includeLength)))
+        IX_PRINTSTACK
+    PageNum pNum = tree->dataHeadPNum;
+    while (true) {
+        NodeHeader *leaf;
+        if ((rc = tree->GetPageData(pNum, leaf)))
+            IX_PRINTSTACK
+        for (int i = 0; i < leaf->hdr->childNum; ++i)
+            if ((rc = builder.AddEntry(leaf->key(i), *leaf->rid(i), leaf->include(i))))
+                IX_PRINTSTACK
+        bool last = !leaf->HaveNextPage();
+        pNum = leaf->hdr->nextPNum;
+        if ((rc = tree->UnpinPages()))
+            IX_PRINTSTACK
+        if (last)
+            break;
+    }
+    if ((rc = CloseIndex(indexHandle)))
+        IX_PRINTSTACK
+
+    if ((rc = DestroyIndex(fileName, indexNo)))
+        IX_PRINTSTACK
+    if ((rc = CreateIndex(fileName, indexNo, attrType, attrLength, includeFields, keyFields)))
+        IX_PRINTSTACK
+    if ((rc = OpenIndex(fileName, indexNo, indexHandle)))
+        IX_PRINTSTACK
+    if ((rc = builder.Build(indexHandle, fillFactor)))
+        IX_PRINTSTACK
+    if ((rc = CloseIndex(indexHandle)))
+        IX_PRINTSTACK
     return OK_RC;
 }
 
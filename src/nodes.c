@@ -98,10 +98,11 @@ NODE *show_tables_node() {
     return n;
 }
 
-NODE *create_table_node(char *relname, NODE *fieldlist) {
+NODE *create_table_node(char *relname, NODE *fieldlist, int isvariable) {
     NODE *n = newnode(N_CREATETABLE);
     n -> u.CREATETABLE.relname = relname;
     n -> u.CREATETABLE.fieldlist = fieldlist;
+    n -> u.CREATETABLE.isvariable = isvariable;
     return n;
 }
 
@@ -117,17 +118,18 @@ NODE *desc_table_node(char *relname) {
     return n;
 }
 
-NODE *create_index_node(char *relname, char *attrname) {
+NODE *create_index_node(char *relname, NODE *attrlist, NODE *includelist) {
     NODE *n = newnode(N_CREATEINDEX);
     n -> u.CREATEINDEX.relname = relname;
-    n -> u.CREATEINDEX.attrname = attrname;
+    n -> u.CREATEINDEX.attrlist = attrlist;
+    n -> u.CREATEINDEX.includelist = includelist;
     return n;
 }
 
-NODE *drop_index_node(char *relname, char *attrname) {
+NODE *drop_index_node(char *relname, NODE *attrlist) {
     NODE *n = newnode(N_DROPINDEX);
     n -> u.DROPINDEX.relname = relname;
-    n -> u.DROPINDEX.attrname = attrname;
+    n -> u.DROPINDEX.attrlist = attrlist;
     return n;
 }
 
@@ -185,6 +187,36 @@ NODE *update_node(char *relname, NODE *setterlist, NODE *conditionlist) {
     return n;
 }
 
+NODE *load_node(char *relname, char *filename) {
+    NODE *n = newnode(N_LOAD);
+    n->u.LOAD.relname = relname;
+    n->u.LOAD.filename = filename;
+    return n;
+}
+
+NODE *vacuum_node(char *relname, int maxpages, int isfull) {
+    NODE *n = newnode(N_VACUUM);
+    n->u.VACUUM.relname = relname;
+    n->u.VACUUM.maxpages = maxpages;
+    n->u.VACUUM.isfull = isfull;
+    return n;
+}
+
+NODE *begin_node() {
+    NODE *n = newnode(N_BEGIN);
+    return n;
+}
+
+NODE *commit_node() {
+    NODE *n = newnode(N_COMMIT);
+    return n;
+}
+
+NODE *rollback_node() {
+    NODE *n = newnode(N_ROLLBACK);
+    return n;
+}
+
 NODE *func_node(FuncType func, NODE *relattr) {
     NODE *n = newnode(N_FUNC);
     n -> u.FUNC.func = func;
@@ -91,6 +91,15 @@ QL_Manager *pQlm;          // QL component manager
     RW_MIN
     RW_GROUP
     RW_BY
+    RW_BEGIN
+    RW_COMMIT
+    RW_ROLLBACK
+    RW_LOAD
+    RW_DATA
+    RW_VACUUM
+    RW_VARIABLE
+    RW_FULL
+    RW_INCLUDE
     T_EQ
     T_LT
     T_LE
@@ -109,6 +118,8 @@ QL_Manager *pQlm;          // QL component manager
 
 %type <cval>    op
 
+%type <sval>    ident
+
 %type <n>   program
             command
             createdatabase
@@ -122,6 +133,9 @@ QL_Manager *pQlm;          // QL component manager
             createindex
             dropindex
             print
+            begin
+            commit
+            rollback
             exit
             select_func
             select_group
@@ -129,6 +143,8 @@ QL_Manager *pQlm;          // QL component manager
             insert
             delete 
             update
+            load
+            vacuum
             setter_list
             setter
             field_list
@@ -201,18 +217,23 @@ command
     | insert
     | delete
     | update
+    | load
+    | vacuum
+    | begin
+    | commit
+    | rollback
     | exit
     ;
 
 createdatabase
-    : RW_CREATE RW_DATABASE T_STRING
+    : RW_CREATE RW_DATABASE ident
     {
         $$ = create_database_node($3);
     }
     ;
 
 dropdatabase
-    : RW_DROP RW_DATABASE T_STRING
+    : RW_DROP RW_DATABASE ident
     {
         $$ = drop_database_node($3);
     }
@@ -226,7 +247,7 @@ showdatabases
     ;
 
 usedatabase
-    : RW_USE T_STRING
+    : RW_USE ident
     {
         $$ = use_database_node($2);
     }
@@ -240,47 +261,76 @@ showtables
     ;
 
 createtable
-    : RW_CREATE RW_TABLE T_STRING '(' field_list ')'
+    : RW_CREATE RW_TABLE ident '(' field_list ')'
+    {
+        $$ = create_table_node($3, $5, 0);
+    }
+    | RW_CREATE RW_TABLE ident '(' field_list ')' RW_VARIABLE
     {
-        $$ = create_table_node($3, $5);
+        $$ = create_table_node($3, $5, 1);
     }
     ;
 
 droptable
-    : RW_DROP RW_TABLE T_STRING
+    : RW_DROP RW_TABLE ident
     {
         $$ = drop_table_node($3);
     }
     ;
 
 desctable
-    : RW_DESC T_STRING
+    : RW_DESC ident
     {
         $$ = desc_table_node($2);
     }
     ;
 
 createindex
-    : RW_CREATE RW_INDEX T_STRING '(' T_STRING ')'
+    : RW_CREATE RW_INDEX ident '(' attr_list ')'
     {
-        $$ = create_index_node($3, $5);
+        $$ = create_index_node($3, $5, NULL);
+    }
+    | RW_CREATE RW_INDEX ident '(' attr_list ')' RW_INCLUDE '(' attr_list ')'
+    {
+        $$ = create_index_node($3, $5, $9);
     }
     ;
 
 dropindex
-    : RW_DROP RW_INDEX T_STRING '(' T_STRING ')'
+    : RW_DROP RW_INDEX ident '(' attr_list ')'
     {
         $$ = drop_index_node($3, $5);
     }
     ;
 
 print
-    : RW_PRINT T_STRING
+    : RW_PRINT ident
     {
         $$ = print_node($2);
     }
     ;
 
+begin
+    : RW_BEGIN
+    {
+        $$ = begin_node();
+    }
+    ;
+
+commit
+    : RW_COMMIT
+    {
+        $$ = commit_node();
+    }
+    ;
+
+rollback
+    : RW_ROLLBACK
+    {
+        $$ = rollback_node();
+    }
+    ;
+
 exit
     : RW_EXIT
     {
@@ -311,26 +361,48 @@ select
     ;
 
 insert
-    : RW_INSERT RW_INTO T_STRING RW_VALUES value_lists
+    : RW_INSERT RW_INTO ident RW_VALUES value_lists
     {
         $$ = insert_node($3, $5);
     }
     ;
 
 delete
-    : RW_DELETE RW_FROM T_STRING opt_where_clause
+    : RW_DELETE RW_FROM ident opt_where_clause
     {
         $$ = delete_node($3, $4);
     }
     ;
 
 update
-    : RW_UPDATE T_STRING RW_SET setter_list opt_where_clause
+    : RW_UPDATE ident RW_SET setter_list opt_where_clause
     {
         $$ = update_node($2, $4, $5);
     }
     ;
 
+load
+    : RW_LOAD RW_DATA T_QSTRING RW_INTO RW_TABLE ident
+    {
+        $$ = load_node($6, $3);
+    }
+    ;
+
+vacuum
+    : RW_VACUUM ident
+    {
+        $$ = vacuum_node($2, 0, 0);
+    }
+    | RW_VACUUM ident T_INT
+    {
+        $$ = vacuum_node($2, $3, 0);
+    }
+    | RW_VACUUM RW_FULL ident
+    {
+        $$ = vacuum_node($3, 0, 1);
+    }
+    ;
+
 setter_list
     : setter ',' setter_list
     {
@@ -343,7 +415,7 @@ setter_list
     ;
 
 setter
-    : T_STRING T_EQ value
+    : ident T_EQ value
     {
         $$ = setter_node($1, $3);
     }
@@ -373,26 +445,26 @@ field
     {
         $$ = field_node(NULL, 0, $4, NULL, NULL, NULL);
     }
-    | RW_FOREIGN RW_KEY '(' T_STRING ')' RW_REFERENCES T_STRING '(' T_STRING ')'
+    | RW_FOREIGN RW_KEY '(' ident ')' RW_REFERENCES ident '(' ident ')'
     {
         $$ = field_node(NULL, 0, NULL, $4, $7, $9);
     }
     ;
 
 attrtype
-    : T_STRING RW_INT '(' T_INT ')'
+    : ident RW_INT '(' T_INT ')'
     {
         $$ = attrtype_node($1, INT, $4);
     }
-    | T_STRING RW_VARCHAR '(' T_INT ')'
+    | ident RW_VARCHAR '(' T_INT ')'
     {
         $$ = attrtype_node($1, STRING, $4);
     }
-    | T_STRING RW_DATE
+    | ident RW_DATE
     {
         $$ = attrtype_node($1, DATE, 0);
     }
-    | T_STRING RW_FLOAT
+    | ident RW_FLOAT
     {
         $$ = attrtype_node($1, FLOAT, 0);
     }
@@ -429,7 +501,7 @@ attr_list
     ;
 
 attr
-    : T_STRING
+    : ident
     {
         $$ = attr_node($1);
     }
@@ -455,11 +527,11 @@ relattr_list
     ;
 
 relattr
-    : T_STRING '.' T_STRING
+    : ident '.' ident
     {
         $$ = relattr_node($1, $3);
     }
-    | T_STRING
+    | ident
     {
         $$ = relattr_node(NULL, $1);
     }
@@ -477,7 +549,7 @@ relation_list
     ;
 
 relation
-    : T_STRING
+    : ident
     {
         $$ = relation_node($1);
     }
@@ -576,6 +648,47 @@ value
     }
     ;
 
+/* words that are keywords only where the grammar needs them */
+ident
+    : T_STRING
+    | RW_BEGIN
+    {
+        $$ = (char*)"begin";
+    }
+    | RW_COMMIT
+    {
+        $$ = (char*)"commit";
+    }
+    | RW_ROLLBACK
+    {
+        $$ = (char*)"rollback";
+    }
+    | RW_LOAD
+    {
+        $$ = (char*)"load";
+    }
+    | RW_DATA
+    {
+        $$ = (char*)"data";
+    }
+    | RW_VACUUM
+    {
+        $$ = (char*)"vacuum";
+    }
+    | RW_VARIABLE
+    {
+        $$ = (char*)"variable";
+    }
+    | RW_FULL
+    {
+        $$ = (char*)"full";
+    }
+    | RW_INCLUDE
+    {
+        $$ = (char*)"include";
+    }
+    ;
+
 op
     : T_LT
     {
@@ -664,6 +777,10 @@ void RippleDBparse(PF_Manager &pfm, SM_Manager &smm, QL_Manager &qlm) {
                     if (rc < 0)
                         bExit = TRUE;
                 }
+                /* a statement outside a transaction, or COMMIT, returns
+                   once its changes are synced */
+                if (!pQlm->InTransaction() && (rc = pfm.WaitCommit()))
+                    PrintError(rc);
             }
         }
     }
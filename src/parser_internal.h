@@ -58,6 +58,11 @@ typedef enum {
     N_INSERT,
     N_DELETE,
     N_UPDATE,
+    N_LOAD,
+    N_VACUUM,
+    N_BEGIN,
+    N_COMMIT,
+    N_ROLLBACK,
     N_FUNC,
     N_RELATTR,
     N_CONDITION,
@@ -100,6 +105,7 @@ typedef struct node{
         struct {
             char *relname;
             struct node *fieldlist;
+            int isvariable;
         } CREATETABLE;
         /* drop table node */
         struct {
@@ -112,12 +118,13 @@ typedef struct node{
         /* create index node */
         struct {
             char *relname;
-            char *attrname;
+            struct node *attrlist;
+            struct node *includelist;
         } CREATEINDEX;
         /* drop index node */
         struct {
             char *relname;
-            char *attrname;
+            struct node *attrlist;
         } DROPINDEX;
         /* print node */
         struct {
@@ -160,6 +167,17 @@ typedef struct node{
             struct node *setterlist;
             struct node *conditionlist;
         } UPDATE;
+        /* load node */
+        struct {
+            char *relname;
+            char *filename;
+        } LOAD;
+        /* vacuum node */
+        struct {
+            char *relname;
+            int maxpages;
+            int isfull;
+        } VACUUM;
         /* command support nodes */
         /* function node */
         struct {
@@ -235,11 +253,11 @@ NODE *drop_database_node(char *dbname);
 NODE *show_databases_node();
 NODE *use_database_node(char *dbname);
 NODE *show_tables_node();
-NODE *create_table_node(char *relname, NODE *fieldlist);
+NODE *create_table_node(char *relname, NODE *fieldlist, int isvariable);
 NODE *drop_table_node(char *relname);
 NODE *desc_table_node(char *relname);
-NODE *create_index_node(char *relname, char *attrname);
-NODE *drop_index_node(char *relname, char *attrname);
+NODE *create_index_node(char *relname, NODE *attrlist, NODE *includelist);
+NODE *drop_index_node(char *relname, NODE *attrlist);
 NODE *print_node(char *relname);
 NODE *select_func_node(NODE *func, NODE *rellist, NODE *conditionlist);
 NODE *select_group_node(NODE *relattr1, NODE *func, NODE *rellist, NODE *conditionlist, NODE *relattr2);
@@ -247,6 +265,11 @@ NODE *select_node(NODE *relattrlist, NODE *rellist, NODE *conditionlist);
 NODE *insert_node(char *relname, NODE *valuelists);
 NODE *delete_node(char *relname, NODE *conditionlist);
 NODE *update_node(char *relname, NODE *setterlist, NODE *conditionlist);
+NODE *load_node(char *relname, char *filename);
+NODE *vacuum_node(char *relname, int maxpages, int isfull);
+NODE *begin_node();
+NODE *commit_node();
+NODE *rollback_node();
 NODE *func_node(FuncType func, NODE *relattr);
 NODE *relattr_node(char *relname, char *attrname);
 NODE *condition_node(NODE *lhsRelattr, CompOp op, NODE *rhsRelattrOrValue);
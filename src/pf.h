@@ -66,6 +66,7 @@ struct PF_FileHdr {
 // PF_FileHandle: PF File interface
 //
 class PF_BufferMgr;
+class PF_Flusher;
 
 class PF_FileHandle {
    friend class PF_Manager;
@@ -107,11 +108,17 @@ private:
    // otherwise
    int IsValidPageNum (PageNum pageNum) const;
 
+   // Hand the file to the group commit flusher if it was modified
+   RC RequestSync (int bAllPages) const;
+
    PF_BufferMgr *pBufferMgr;                      // pointer to buffer manager
+   PF_Flusher *pFlusher;                          // group commit flusher
    PF_FileHdr hdr;                                // file header
    int bFileOpen;                                 // file open flag
    int bHdrChanged;                               // dirty flag for file hdr
+   int bSyncPending;                              // modified since last sync
    int unixfd;                                    // OS file descriptor
+   int fileId;                                    // buffer ID of the file
 };
 
 //
@@ -123,6 +130,8 @@ public:
    ~PF_Manager   ();                              // Destructor
    RC CreateFile    (const char *fileName);       // Create a new file
    RC DestroyFile   (const char *fileName);       // Delete a file
+   RC RenameFile    (const char *oldName,         // Rename a file over
+                     const char *newName);        // newName if it exists
 
    // Open and close file methods
    RC OpenFile      (const char *fileName, PF_FileHandle &fileHandle);
@@ -135,6 +144,13 @@ public:
    RC PrintBuffer   ();
    RC ResizeBuffer  (int iNewSize);
 
+   // Group commit: written files are synced in batches, at most
+   // iMaxDelay ms after the write (<= 0 turns group commit off).  A
+   // statement commits once WaitCommit returns.
+   RC SetCommitDelay   (int iMaxDelay);
+   RC WaitCommit       ();
+   RC PrintCommitStats ();
+
    // Three Methods for manipulating raw memory buffers.  These memory
    // locations are handled by the buffer manager, but are not
    // associated with a particular file.  These should be used if you
@@ -156,6 +172,7 @@ public:
 
 private:
    PF_BufferMgr *pBufferMgr;                      // page-buffer manager
+   PF_Flusher   *pFlusher;                        // group commit flusher
 };
 
 //
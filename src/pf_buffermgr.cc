@@ -18,6 +18,7 @@
 #include <cstdio>
 #include <unistd.h>
 #include <iostream>
+#include <sys/stat.h>
 #include "pf_buffermgr.h"
 
 using namespace std;
@@ -131,6 +132,7 @@ PF_BufferMgr::PF_BufferMgr(int _numPages) : hashTable(PF_HASH_TBL_SIZE)
    bufTable[0].prev = bufTable[numPages - 1].next = INVALID_SLOT;
    free = 0;
    first = last = INVALID_SLOT;
+   nextFileId = 0;
 
 #ifdef PF_LOG
    WriteLog("Succesfully created the buffer manager.\n");
@@ -168,14 +170,14 @@ PF_BufferMgr::~PF_BufferMgr()
 //       to it.  If the page is not in the buffer, read it from the file,
 //       pin it, and return a pointer to it.  If the buffer is full,
 //       replace an unpinned page.
-// In:   fd - OS file descriptor of the file to read
+// In:   fileId - buffer ID of the file to read (see AttachFile)
 //       pageNum - number of the page to read
 //       bMultiplePins - if FALSE, it is an error to ask for a page that is
 //                       already pinned in the buffer.
 // Out:  ppBuffer - set *ppBuffer to point to the page in the buffer
 // Ret:  PF return code
 //
-RC PF_BufferMgr::GetPage(int fd, PageNum pageNum, char **ppBuffer,
+RC PF_BufferMgr::GetPage(int fileId, PageNum pageNum, char **ppBuffer,
       int bMultiplePins)
 {
    RC  rc;     // return code
@@ -183,7 +185,7 @@ RC PF_BufferMgr::GetPage(int fd, PageNum pageNum, char **ppBuffer,
 
 #ifdef PF_LOG
    char psMessage[100];
-   sprintf (psMessage, "Looking for (%d,%d).\n", fd, pageNum);
+   sprintf (psMessage, "Looking for (%d,%d).\n", fileId, pageNum);
    WriteLog(psMessage);
 #endif
 
@@ -193,7 +195,7 @@ RC PF_BufferMgr::GetPage(int fd, PageNum pageNum, char **ppBuffer,
 #endif
 
    // Search for page in buffer
-   if ((rc = hashTable.Find(fd, pageNum, slot)) &&
+   if ((rc = hashTable.Find(fileId, pageNum, slot)) &&
          (rc != PF_HASHNOTFOUND))
       return (rc);                // unexpected error
 
@@ -211,9 +213,9 @@ RC PF_BufferMgr::GetPage(int fd, PageNum pageNum, char **ppBuffer,
 
       // read the page, insert it into the hash table,
       // and initialize the page description entry
-      if ((rc = ReadPage(fd, pageNum, bufTable[slot].pData)) ||
-            (rc = hashTable.Insert(fd, pageNum, slot)) ||
-            (rc = InitPageDesc(fd, pageNum, slot))) {
+      if ((rc = ReadPage(fileId, pageNum, bufTable[slot].pData)) ||
+            (rc = hashTable.Insert(fileId, pageNum, slot)) ||
+            (rc = InitPageDesc(fileId, pageNum, slot))) {
 
          // Put the slot back on the free list before returning the error
          Unlink(slot);
@@ -259,24 +261,24 @@ RC PF_BufferMgr::GetPage(int fd, PageNum pageNum, char **ppBuffer,
 // AllocatePage
 //
 // Desc: Allocate a new page in the buffer and return a pointer to it.
-// In:   fd - OS file descriptor of the file associated with the new page
+// In:   fileId - buffer ID of the file associated with the new page
 //       pageNum - number of the new page
 // Out:  ppBuffer - set *ppBuffer to point to the page in the buffer
 // Ret:  PF return code
 //
-RC PF_BufferMgr::AllocatePage(int fd, PageNum pageNum, char **ppBuffer)
+RC PF_BufferMgr::AllocatePage(int fileId, PageNum pageNum, char **ppBuffer)
 {
    RC  rc;     // return code
    int slot;   // buffer slot where page is located
 
 #ifdef PF_LOG
    char psMessage[100];
-   sprintf (psMessage, "Allocating a page for (%d,%d)....", fd, pageNum);
+   sprintf (psMessage, "Allocating a page for (%d,%d)....", fileId, pageNum);
    WriteLog(psMessage);
 #endif
 
    // If page is already in buffer, return an error
-   if (!(rc = hashTable.Find(fd, pageNum, slot)))
+   if (!(rc = hashTable.Find(fileId, pageNum, slot)))
       return (PF_PAGEINBUF);
    else if (rc != PF_HASHNOTFOUND)
       return (rc);              // unexpected error
@@ -287,8 +289,8 @@ RC PF_BufferMgr::AllocatePage(int fd, PageNum pageNum, char **ppBuffer)
 
    // Insert the page into the hash table,
    // and initialize the page description entry
-   if ((rc = hashTable.Insert(fd, pageNum, slot)) ||
-         (rc = InitPageDesc(fd, pageNum, slot))) {
+   if ((rc = hashTable.Insert(fileId, pageNum, slot)) ||
+         (rc = InitPageDesc(fileId, pageNum, slot))) {
 
       // Put the slot back on the free list before returning the error
       Unlink(slot);
@@ -312,23 +314,23 @@ RC PF_BufferMgr::AllocatePage(int fd, PageNum pageNum, char **ppBuffer)
 //
 // Desc: Mark a page dirty so that when it is discarded from the buffer
 //       it will be written back to the file.
-// In:   fd - OS file descriptor of the file associated with the page
+// In:   fileId - buffer ID of the file associated with the page
 //       pageNum - number of the page to mark dirty
 // Ret:  PF return code
 //
-RC PF_BufferMgr::MarkDirty(int fd, PageNum pageNum)
+RC PF_BufferMgr::MarkDirty(int fileId, PageNum pageNum)
 {
    RC  rc;       // return code
    int slot;     // buffer slot where page is located
 
 #ifdef PF_LOG
    char psMessage[100];
-   sprintf (psMessage, "Marking dirty (%d,%d).\n", fd, pageNum);
+   sprintf (psMessage, "Marking dirty (%d,%d).\n", fileId, pageNum);
    WriteLog(psMessage);
 #endif
 
    // The page must be found and pinned in the buffer
-   if ((rc = hashTable.Find(fd, pageNum, slot))){
+   if ((rc = hashTable.Find(fileId, pageNum, slot))){
       if ((rc == PF_HASHNOTFOUND))
          return (PF_PAGENOTINBUF);
       else
@@ -354,17 +356,17 @@ RC PF_BufferMgr::MarkDirty(int fd, PageNum pageNum)
 // UnpinPage
 //
 // Desc: Unpin a page so that it can be discarded from the buffer.
-// In:   fd - OS file descriptor of the file associated with the page
+// In:   fileId - buffer ID of the file associated with the page
 //       pageNum - number of the page to unpin
 // Ret:  PF return code
 //
-RC PF_BufferMgr::UnpinPage(int fd, PageNum pageNum)
+RC PF_BufferMgr::UnpinPage(int fileId, PageNum pageNum)
 {
    RC  rc;       // return code
    int slot;     // buffer slot where page is located
 
    // The page must be found and pinned in the buffer
-   if ((rc = hashTable.Find(fd, pageNum, slot))){
+   if ((rc = hashTable.Find(fileId, pageNum, slot))){
       if ((rc == PF_HASHNOTFOUND))
          return (PF_PAGENOTINBUF);
       else
@@ -377,7 +379,7 @@ RC PF_BufferMgr::UnpinPage(int fd, PageNum pageNum)
 #ifdef PF_LOG
    char psMessage[100];
    sprintf (psMessage, "Unpinning (%d,%d). %d Pin count\n",
-         fd, pageNum, bufTable[slot].pinCount-1);
+         fileId, pageNum, bufTable[slot].pinCount-1);
    WriteLog(psMessage);
 #endif
 
@@ -399,16 +401,16 @@ RC PF_BufferMgr::UnpinPage(int fd, PageNum pageNum)
 //       Returns a warning if any of the file's pages are pinned.
 //       A linear search of the buffer is performed.
 //       A better method is not needed because # of buffers are small.
-// In:   fd - file descriptor
+// In:   fileId - buffer ID of the file
 // Ret:  PF_PAGEPINNED or other PF return code
 //
-RC PF_BufferMgr::FlushPages(int fd)
+RC PF_BufferMgr::FlushPages(int fileId)
 {
    RC rc, rcWarn = 0;  // return codes
 
 #ifdef PF_LOG
    char psMessage[100];
-   sprintf (psMessage, "Flushing all pages for (%d).\n", fd);
+   sprintf (psMessage, "Flushing all pages for (%d).\n", fileId);
    WriteLog(psMessage);
 #endif
 
@@ -422,8 +424,8 @@ RC PF_BufferMgr::FlushPages(int fd)
 
       int next = bufTable[slot].next;
 
-      // If the page belongs to the passed-in file descriptor
-      if (bufTable[slot].fd == fd) {
+      // If the page belongs to the passed-in file
+      if (bufTable[slot].fileId == fileId) {
 
 #ifdef PF_LOG
  sprintf (psMessage, "Page (%d) is in buffer manager.\n", bufTable[slot].pageNum);
@@ -440,13 +442,13 @@ RC PF_BufferMgr::FlushPages(int fd)
  sprintf (psMessage, "Page (%d) is dirty\n",bufTable[slot].pageNum);
  WriteLog(psMessage);
 #endif
-               if ((rc = WritePage(fd, bufTable[slot].pageNum, bufTable[slot].pData)))
+               if ((rc = WritePage(fileId, bufTable[slot].pageNum, bufTable[slot].pData)))
                   return (rc);
                bufTable[slot].bDirty = FALSE;
             }
 
             // Remove page from the hash table and add the slot to the free list
-            if ((rc = hashTable.Delete(fd, bufTable[slot].pageNum)) ||
+            if ((rc = hashTable.Delete(fileId, bufTable[slot].pageNum)) ||
                   (rc = Unlink(slot)) ||
                   (rc = InsertFree(slot)))
                return (rc);
@@ -473,13 +475,13 @@ RC PF_BufferMgr::FlushPages(int fd)
 // Ret:  Standard PF errors
 //
 //
-RC PF_BufferMgr::ForcePages(int fd, PageNum pageNum)
+RC PF_BufferMgr::ForcePages(int fileId, PageNum pageNum)
 {
    RC rc;  // return codes
 
 #ifdef PF_LOG
    char psMessage[100];
-   sprintf (psMessage, "Forcing page %d for (%d).\n", pageNum, fd);
+   sprintf (psMessage, "Forcing page %d for (%d).\n", pageNum, fileId);
    WriteLog(psMessage);
 #endif
 
@@ -489,8 +491,8 @@ RC PF_BufferMgr::ForcePages(int fd, PageNum pageNum)
 
       int next = bufTable[slot].next;
 
-      // If the page belongs to the passed-in file descriptor
-      if (bufTable[slot].fd == fd &&
+      // If the page belongs to the passed-in file
+      if (bufTable[slot].fileId == fileId &&
             (pageNum==ALL_PAGES || bufTable[slot].pageNum == pageNum)) {
 
 #ifdef PF_LOG
@@ -504,7 +506,7 @@ RC PF_BufferMgr::ForcePages(int fd, PageNum pageNum)
 sprintf (psMessage, "Page (%d) is dirty\n",bufTable[slot].pageNum);
 WriteLog(psMessage);
 #endif
-            if ((rc = WritePage(fd, bufTable[slot].pageNum, bufTable[slot].pData)))
+            if ((rc = WritePage(fileId, bufTable[slot].pageNum, bufTable[slot].pData)))
                return (rc);
             bufTable[slot].bDirty = FALSE;
          }
@@ -515,6 +517,127 @@ WriteLog(psMessage);
    return 0;
 }
 
+//
+// AttachFile
+//
+// Desc: Called when a file is opened.  Its pages are kept in the buffer
+//       under a buffer ID bound to the device and inode of the file, so
+//       that the pages left by an earlier open of the same file are
+//       found again.  A file open several times shares one buffer ID.
+// In:   fd - OS file descriptor of the opened file
+// Out:  fileId - buffer ID of the file
+// Ret:  PF_UNIX or other PF return code
+//
+RC PF_BufferMgr::AttachFile(int fd, int &fileId)
+{
+   struct stat st;
+   if (fstat(fd, &st) < 0)
+      return (PF_UNIX);
+
+   std::pair<dev_t, ino_t> key(st.st_dev, st.st_ino);
+   std::map<std::pair<dev_t, ino_t>, int>::iterator it = fileIds.find(key);
+   if (it == fileIds.end())
+      it = fileIds.insert(make_pair(key, nextFileId++)).first;
+   fileId = it->second;
+   openFds[fileId].push_back(fd);
+
+   return (0);
+}
+
+//
+// DetachFile
+//
+// Desc: Called before a file is closed.  Its dirty pages are written
+//       through fd, its clean pages stay in the buffer.  As with
+//       FlushPages, a warning is returned if this is the last open of
+//       the file and some of its pages are pinned; the file stays
+//       attached then.
+// In:   fileId - buffer ID of the file
+//       fd - OS file descriptor about to be closed
+// Ret:  PF_PAGEPINNED or other PF return code
+//
+RC PF_BufferMgr::DetachFile(int fileId, int fd)
+{
+   RC rc;
+
+   // Write the dirty pages while fd is still open
+   if ((rc = ForcePages(fileId, ALL_PAGES)))
+      return (rc);
+
+   std::vector<int> &fds = openFds[fileId];
+   if (fds.size() == 1) {
+      for (int slot = first; slot != INVALID_SLOT; slot = bufTable[slot].next)
+         if (bufTable[slot].fileId == fileId && bufTable[slot].pinCount)
+            return (PF_PAGEPINNED);
+   }
+
+   for (size_t i = 0; i < fds.size(); i++)
+      if (fds[i] == fd) {
+         fds.erase(fds.begin() + i);
+         break;
+      }
+   if (fds.empty())
+      openFds.erase(fileId);
+
+   return (0);
+}
+
+//
+// InvalidateFile
+//
+// Desc: Remove the pages of a file from the buffer without writing them.
+//       Called when the file is destroyed, and when a file is created in
+//       case it reuses the inode of a file removed behind our back.
+// In:   dev, ino - device and inode of the file
+// Ret:  PF return code
+//
+RC PF_BufferMgr::InvalidateFile(dev_t dev, ino_t ino)
+{
+   RC rc;
+
+   std::map<std::pair<dev_t, ino_t>, int>::iterator it =
+      fileIds.find(std::make_pair(dev, ino));
+   if (it == fileIds.end())
+      return (0);
+   int fileId = it->second;
+
+   int slot = first;
+   while (slot != INVALID_SLOT) {
+      int next = bufTable[slot].next;
+      if (bufTable[slot].fileId == fileId && bufTable[slot].pinCount == 0) {
+         bufTable[slot].bDirty = FALSE;
+         if ((rc = hashTable.Delete(fileId, bufTable[slot].pageNum)) ||
+               (rc = Unlink(slot)) ||
+               (rc = InsertFree(slot)))
+            return (rc);
+      }
+      slot = next;
+   }
+
+   // Forget the inode unless the file is still open
+   if (openFds.find(fileId) == openFds.end())
+      fileIds.erase(it);
+
+   return (0);
+}
+
+//
+// GetFd
+//
+// Desc: Internal.  Find an OS file descriptor of an open file
+// In:   fileId - buffer ID of the file
+// Out:  fd - a descriptor the file is open as
+// Ret:  PF_CLOSEDFILE if the file is not open
+//
+RC PF_BufferMgr::GetFd(int fileId, int &fd)
+{
+   std::map<int, std::vector<int> >::iterator it = openFds.find(fileId);
+   if (it == openFds.end() || it->second.empty())
+      return (PF_CLOSEDFILE);
+   fd = it->second.back();
+   return (0);
+}
+
 
 //
 // PrintBuffer
@@ -537,7 +660,7 @@ RC PF_BufferMgr::PrintBuffer()
    while (slot != INVALID_SLOT) {
       next = bufTable[slot].next;
       cout << slot << " :: \n";
-      cout << "  fd = " << bufTable[slot].fd << "\n";
+      cout << "  fileId = " << bufTable[slot].fileId << "\n";
       cout << "  pageNum = " << bufTable[slot].pageNum << "\n";
       cout << "  bDirty = " << bufTable[slot].bDirty << "\n";
       cout << "  pinCount = " << bufTable[slot].pinCount << "\n";
@@ -573,7 +696,7 @@ RC PF_BufferMgr::ClearBuffer()
    while (slot != INVALID_SLOT) {
       next = bufTable[slot].next;
       if (bufTable[slot].pinCount == 0)
-         if ((rc = hashTable.Delete(bufTable[slot].fd,
+         if ((rc = hashTable.Delete(bufTable[slot].fileId,
                bufTable[slot].pageNum)) ||
             (rc = Unlink(slot)) ||
             (rc = InsertFree(slot)))
@@ -645,7 +768,7 @@ RC PF_BufferMgr::ResizeBuffer(int iNewSize)
       next = pOldBufTable[slot].next;
 
       // Must remove the entry from the hashtable from the
-      if ((rc=hashTable.Delete(pOldBufTable[slot].fd, pOldBufTable[slot].pageNum)))
+      if ((rc=hashTable.Delete(pOldBufTable[slot].fileId, pOldBufTable[slot].pageNum)))
          return (rc);
       slot = next;
    }
@@ -662,9 +785,9 @@ RC PF_BufferMgr::ResizeBuffer(int iNewSize)
 
       // Insert the page into the hash table,
       // and initialize the page description entry
-      if ((rc = hashTable.Insert(pOldBufTable[slot].fd,
+      if ((rc = hashTable.Insert(pOldBufTable[slot].fileId,
             pOldBufTable[slot].pageNum, newSlot)) ||
-            (rc = InitPageDesc(pOldBufTable[slot].fd,
+            (rc = InitPageDesc(pOldBufTable[slot].fileId,
             pOldBufTable[slot].pageNum, newSlot)))
          return (rc);
 
@@ -795,7 +918,7 @@ RC PF_BufferMgr::InternalAlloc(int &slot)
 
       // Write out the page if it is dirty
       if (bufTable[slot].bDirty) {
-         if ((rc = WritePage(bufTable[slot].fd, bufTable[slot].pageNum,
+         if ((rc = WritePage(bufTable[slot].fileId, bufTable[slot].pageNum,
                bufTable[slot].pData)))
             return (rc);
 
@@ -803,7 +926,7 @@ RC PF_BufferMgr::InternalAlloc(int &slot)
       }
 
       // Remove page from the hash table and slot from the used buffer list
-      if ((rc = hashTable.Delete(bufTable[slot].fd, bufTable[slot].pageNum)) ||
+      if ((rc = hashTable.Delete(bufTable[slot].fileId, bufTable[slot].pageNum)) ||
             (rc = Unlink(slot)))
          return (rc);
    }
@@ -821,18 +944,19 @@ RC PF_BufferMgr::InternalAlloc(int &slot)
 //
 // Desc: Read a page from disk
 //
-// In:   fd - OS file descriptor
+// In:   fileId - buffer ID of an open file
 //       pageNum - number of page to read
 //       dest - pointer to buffer in which to read page
 // Out:  dest - buffer contains page contents
 // Ret:  PF return code
 //
-RC PF_BufferMgr::ReadPage(int fd, PageNum pageNum, char *dest)
+RC PF_BufferMgr::ReadPage(int fileId, PageNum pageNum, char *dest)
 {
+   RC rc;
 
 #ifdef PF_LOG
    char psMessage[100];
-   sprintf (psMessage, "Reading (%d,%d).\n", fd, pageNum);
+   sprintf (psMessage, "Reading (%d,%d).\n", fileId, pageNum);
    WriteLog(psMessage);
 #endif
 
@@ -840,6 +964,11 @@ RC PF_BufferMgr::ReadPage(int fd, PageNum pageNum, char *dest)
    pStatisticsMgr->Register(PF_READPAGE, STAT_ADDONE);
 #endif
 
+   // Find a descriptor through which the file is open
+   int fd;
+   if ((rc = GetFd(fileId, fd)))
+      return (rc);
+
    // seek to the appropriate place (cast to long for PC's)
    long offset = pageNum * (long)pageSize + PF_FILE_HDR_SIZE;
    if (lseek(fd, offset, L_SET) < 0)
@@ -860,17 +989,18 @@ RC PF_BufferMgr::ReadPage(int fd, PageNum pageNum, char *dest)
 //
 // Desc: Write a page to disk
 //
-// In:   fd - OS file descriptor
+// In:   fileId - buffer ID of an open file
 //       pageNum - number of page to write
 //       dest - pointer to buffer containing page contents
 // Ret:  PF return code
 //
-RC PF_BufferMgr::WritePage(int fd, PageNum pageNum, char *source)
+RC PF_BufferMgr::WritePage(int fileId, PageNum pageNum, char *source)
 {
+   RC rc;
 
 #ifdef PF_LOG
    char psMessage[100];
-   sprintf (psMessage, "Writing (%d,%d).\n", fd, pageNum);
+   sprintf (psMessage, "Writing (%d,%d).\n", fileId, pageNum);
    WriteLog(psMessage);
 #endif
 
@@ -878,6 +1008,11 @@ RC PF_BufferMgr::WritePage(int fd, PageNum pageNum, char *source)
    pStatisticsMgr->Register(PF_WRITEPAGE, STAT_ADDONE);
 #endif
 
+   // Find a descriptor through which the file is open
+   int fd;
+   if ((rc = GetFd(fileId, fd)))
+      return (rc);
+
    // seek to the appropriate place (cast to long for PC's)
    long offset = pageNum * (long)pageSize + PF_FILE_HDR_SIZE;
    if (lseek(fd, offset, L_SET) < 0)
@@ -898,14 +1033,14 @@ RC PF_BufferMgr::WritePage(int fd, PageNum pageNum, char *source)
 //
 // Desc: Internal.  Initialize PF_BufPageDesc to a newly-pinned page
 //       for a newly pinned page
-// In:   fd - file descriptor
+// In:   fileId - buffer ID of the file
 //       pageNum - page number
 // Ret:  PF return code
 //
-RC PF_BufferMgr::InitPageDesc(int fd, PageNum pageNum, int slot)
+RC PF_BufferMgr::InitPageDesc(int fileId, PageNum pageNum, int slot)
 {
    // set the slot to refer to a newly-pinned page
-   bufTable[slot].fd       = fd;
+   bufTable[slot].fileId       = fileId;
    bufTable[slot].pageNum  = pageNum;
    bufTable[slot].bDirty   = FALSE;
    bufTable[slot].pinCount = 1;
@@ -950,8 +1085,9 @@ RC PF_BufferMgr::AllocateBlock(char *&buffer)
    if ((rc = InternalAlloc(slot)) != OK_RC)
       return rc;
 
-   // Create artificial page number (just needs to be unique for hash table)
-   PageNum pageNum = PageNum(bufTable[slot].pData);
+   // Create artificial page number (just needs to be unique for hash table,
+   // as the slot is while the block is allocated)
+   PageNum pageNum = slot;
 
    // Insert the page into the hash table, and initialize the page description entry
    if ((rc = hashTable.Insert(MEMORY_FD, pageNum, slot) != OK_RC) ||
@@ -976,5 +1112,8 @@ RC PF_BufferMgr::AllocateBlock(char *&buffer)
 //
 RC PF_BufferMgr::DisposeBlock(char* buffer)
 {
-   return UnpinPage(MEMORY_FD, PageNum(buffer));
+   for (int slot = 0; slot < numPages; slot++)
+      if (bufTable[slot].pData == buffer && bufTable[slot].fileId == MEMORY_FD)
+         return UnpinPage(MEMORY_FD, slot);
+   return PF_PAGENOTINBUF;
 }
@@ -10,11 +10,17 @@
 // 1998: Allow chunks from the buffer manager to not be associated with
 // a particular file.  Allows students to use main memory chunks that
 // are associated with (and limited by) the buffer.
+// Pages are identified by a buffer ID of their file instead of its
+// descriptor.  The ID is bound to the device and inode of the file, so
+// the clean pages of a closed file are found again when it is reopened.
 //
 
 #ifndef PF_BUFFERMGR_H
 #define PF_BUFFERMGR_H
 
+#include <map>
+#include <vector>
+#include <sys/types.h>
 #include "pf_internal.h"
 #include "pf_hashtable.h"
 
@@ -38,7 +44,7 @@ struct PF_BufPageDesc {
     int        bDirty;      // TRUE if page is dirty
     short int  pinCount;    // pin count
     PageNum    pageNum;     // page number for this page
-    int        fd;          // OS file descriptor of this page
+    int        fileId;      // buffer ID of the file of this page
 };
 
 //
@@ -52,17 +58,24 @@ public:
     ~PF_BufferMgr    ();                         // Destructor
 
     // Read pageNum into buffer, point *ppBuffer to location
-    RC  GetPage      (int fd, PageNum pageNum, char **ppBuffer,
+    RC  GetPage      (int fileId, PageNum pageNum, char **ppBuffer,
                       int bMultiplePins = TRUE);
     // Allocate a new page in the buffer, point *ppBuffer to its location
-    RC  AllocatePage (int fd, PageNum pageNum, char **ppBuffer);
+    RC  AllocatePage (int fileId, PageNum pageNum, char **ppBuffer);
 
-    RC  MarkDirty    (int fd, PageNum pageNum);  // Mark page dirty
-    RC  UnpinPage    (int fd, PageNum pageNum);  // Unpin page from the buffer
-    RC  FlushPages   (int fd);                   // Flush pages for file
+    RC  MarkDirty    (int fileId, PageNum pageNum);  // Mark page dirty
+    RC  UnpinPage    (int fileId, PageNum pageNum);  // Unpin page from the buffer
+    RC  FlushPages   (int fileId);                   // Flush pages for file
 
     // Force a page to the disk, but do not remove from the buffer pool
-    RC ForcePages    (int fd, PageNum pageNum);
+    RC ForcePages    (int fileId, PageNum pageNum);
+
+    // Get the buffer ID of the file just opened as fd
+    RC  AttachFile   (int fd, int &fileId);
+    // File fd is being closed: write its dirty pages, keep the clean ones
+    RC  DetachFile   (int fileId, int fd);
+    // Drop the pages of the file (dev, ino), being destroyed or created
+    RC  InvalidateFile(dev_t dev, ino_t ino);
 
 
     // Remove all entries from the Buffer Manager.
@@ -93,13 +106,16 @@ private:
     RC  InternalAlloc(int &slot);                // Get a slot to use
 
     // Read a page
-    RC  ReadPage     (int fd, PageNum pageNum, char *dest);
+    RC  ReadPage     (int fileId, PageNum pageNum, char *dest);
 
     // Write a page
-    RC  WritePage    (int fd, PageNum pageNum, char *source);
+    RC  WritePage    (int fileId, PageNum pageNum, char *source);
 
     // Init the page desc entry
-    RC  InitPageDesc (int fd, PageNum pageNum, int slot);
+    RC  InitPageDesc (int fileId, PageNum pageNum, int slot);
+
+    // Get a descriptor through which file fileId is open
+    RC  GetFd        (int fileId, int &fd);
 
     PF_BufPageDesc *bufTable;                     // info on buffer pages
     PF_HashTable   hashTable;                     // Hash table object
@@ -108,6 +124,10 @@ private:
     int            first;                         // MRU page slot
     int            last;                          // LRU page slot
     int            free;                          // head of free list
+
+    std::map<std::pair<dev_t, ino_t>, int> fileIds; // (dev, ino) -> buffer ID
+    std::map<int, std::vector<int> > openFds;     // buffer ID -> open fds
+    int            nextFileId;                    // next buffer ID to assign
 };
 
 #endif
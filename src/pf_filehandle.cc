@@ -9,6 +9,7 @@
 #include <sys/types.h>
 #include "pf_internal.h"
 #include "pf_buffermgr.h"
+#include "pf_flusher.h"
 
 //
 // PF_FileHandle
@@ -27,7 +28,9 @@ PF_FileHandle::PF_FileHandle()
 {
    // Initialize local variables
    bFileOpen = FALSE;
+   bSyncPending = FALSE;
    pBufferMgr = NULL;
+   pFlusher = NULL;
 }
 
 //
@@ -52,10 +55,13 @@ PF_FileHandle::PF_FileHandle(const PF_FileHandle &fileHandle)
 {
    // Just copy the data members since there is no memory allocation involved
    this->pBufferMgr  = fileHandle.pBufferMgr;
+   this->pFlusher    = fileHandle.pFlusher;
    this->hdr         = fileHandle.hdr;
    this->bFileOpen   = fileHandle.bFileOpen;
    this->bHdrChanged = fileHandle.bHdrChanged;
+   this->bSyncPending = fileHandle.bSyncPending;
    this->unixfd      = fileHandle.unixfd;
+   this->fileId      = fileHandle.fileId;
 }
 
 //
@@ -74,10 +80,13 @@ PF_FileHandle& PF_FileHandle::operator= (const PF_FileHandle &fileHandle)
 
       // Just copy the members since there is no memory allocation involved
       this->pBufferMgr  = fileHandle.pBufferMgr;
+      this->pFlusher    = fileHandle.pFlusher;
       this->hdr         = fileHandle.hdr;
       this->bFileOpen   = fileHandle.bFileOpen;
       this->bHdrChanged = fileHandle.bHdrChanged;
+      this->bSyncPending = fileHandle.bSyncPending;
       this->unixfd      = fileHandle.unixfd;
+      this->fileId      = fileHandle.fileId;
    }
 
    // Return a reference to this
@@ -215,7 +224,7 @@ RC PF_FileHandle::GetThisPage(PageNum pageNum, PF_PageHandle &pageHandle) const
       return (PF_INVALIDPAGE);
 
    // Get this page from the buffer manager
-   if ((rc = pBufferMgr->GetPage(unixfd, pageNum, &pPageBuf)))
+   if ((rc = pBufferMgr->GetPage(fileId, pageNum, &pPageBuf)))
       return (rc);
 
    // If the page is valid, then set pageHandle to this page and return ok
@@ -261,7 +270,7 @@ RC PF_FileHandle::AllocatePage(PF_PageHandle &pageHandle)
       pageNum = hdr.firstFree;
 
       // Get the first free page into the buffer
-      if ((rc = pBufferMgr->GetPage(unixfd,
+      if ((rc = pBufferMgr->GetPage(fileId,
             pageNum,
             &pPageBuf)))
          return (rc);
@@ -275,7 +284,7 @@ RC PF_FileHandle::AllocatePage(PF_PageHandle &pageHandle)
       pageNum = hdr.numPages;
 
       // Allocate a new page in the file
-      if ((rc = pBufferMgr->AllocatePage(unixfd,
+      if ((rc = pBufferMgr->AllocatePage(fileId,
             pageNum,
             &pPageBuf)))
          return (rc);
@@ -329,7 +338,7 @@ RC PF_FileHandle::DisposePage(PageNum pageNum)
       return (PF_INVALIDPAGE);
 
    // Get the page (but don't re-pin it if it's already pinned)
-   if ((rc = pBufferMgr->GetPage(unixfd,
+   if ((rc = pBufferMgr->GetPage(fileId,
          pageNum,
          &pPageBuf,
          FALSE)))
@@ -383,8 +392,12 @@ RC PF_FileHandle::MarkDirty(PageNum pageNum) const
    if (!IsValidPageNum(pageNum))
       return (PF_INVALIDPAGE);
 
+   // The file must be synced at its next commit.  This function is
+   // declared const, so cast away the constness
+   ((PF_FileHandle *)this)->bSyncPending = TRUE;
+
    // Tell the buffer manager to mark the page dirty
-   return (pBufferMgr->MarkDirty(unixfd, pageNum));
+   return (pBufferMgr->MarkDirty(fileId, pageNum));
 }
 
 //
@@ -409,7 +422,7 @@ RC PF_FileHandle::UnpinPage(PageNum pageNum) const
       return (PF_INVALIDPAGE);
 
    // Tell the buffer manager to unpin the page
-   return (pBufferMgr->UnpinPage(unixfd, pageNum));
+   return (pBufferMgr->UnpinPage(fileId, pageNum));
 }
 
 //
@@ -449,7 +462,7 @@ RC PF_FileHandle::FlushPages() const
    }
 
    // Tell Buffer Manager to flush pages
-   return (pBufferMgr->FlushPages(unixfd));
+   return (pBufferMgr->FlushPages(fileId));
 }
 
 //
@@ -464,6 +477,8 @@ RC PF_FileHandle::FlushPages() const
 //
 RC PF_FileHandle::ForcePages(PageNum pageNum) const
 {
+   RC rc;
+
    // File must be open
    if (!bFileOpen)
       return (PF_CLOSEDFILE);
@@ -491,7 +506,33 @@ RC PF_FileHandle::ForcePages(PageNum pageNum) const
    }
 
    // Tell Buffer Manager to Force the page
-   return (pBufferMgr->ForcePages(unixfd, pageNum));
+   if ((rc = pBufferMgr->ForcePages(fileId, pageNum)))
+      return (rc);
+
+   // Forced pages are committed: queue the file for group commit
+   return (RequestSync(pageNum == ALL_PAGES));
+}
+
+//
+// RequestSync
+//
+// Desc: Internal.  Ask the group commit flusher to sync the file if it
+//       was modified since the last request.  Called once the dirty
+//       pages have been written to the OS.
+// In:   bAllPages - TRUE if every dirty page was written, so that the
+//       file is clean once the batch is synced
+// Ret:  PF return code
+//
+RC PF_FileHandle::RequestSync(int bAllPages) const
+{
+   if (!bSyncPending)
+      return (0);
+   if (bAllPages) {
+      // Declared const; cast away the constness as in ForcePages
+      PF_FileHandle *dummy = (PF_FileHandle *)this;
+      dummy->bSyncPending = FALSE;
+   }
+   return (pFlusher->RequestSync(unixfd));
 }
 
 
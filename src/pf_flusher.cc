@@ -0,0 +1,291 @@
+//
+// File:        pf_flusher.cc
+// Description: PF_Flusher class implementation
+//
+
+#include <cstdio>
+#include <iostream>
+#include <chrono>
+#include <set>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "pf_flusher.h"
+
+using namespace std;
+
+//
+// PF_Flusher
+//
+// Desc: Constructor - group commit starts disabled; the flusher thread
+//       is only started by the first SetMaxDelay with a positive delay
+//
+PF_Flusher::PF_Flusher()
+{
+   maxDelay = 0;
+   bStop = FALSE;
+   pendingRequests = 0;
+   waitingCommits = 0;
+   bSyncing = FALSE;
+   takenBatches = 0;
+   syncedBatches = 0;
+   lastRC = 0;
+   numRequests = 0;
+   numBatches = 0;
+   numSyncs = 0;
+   maxBatch = 0;
+}
+
+//
+// ~PF_Flusher
+//
+// Desc: Destructor - stop the flusher thread and sync whatever is still
+//       pending, so that no committed request is lost at exit
+//
+PF_Flusher::~PF_Flusher()
+{
+   {
+      unique_lock<mutex> lock(mtx);
+      bStop = TRUE;
+   }
+   cond.notify_one();
+   if (worker.joinable())
+      worker.join();
+   Flush();
+}
+
+//
+// SetMaxDelay
+//
+// Desc: Set the longest time a request may wait for its fdatasync.
+//       A larger delay lets more commits share one sync.
+// In:   iMaxDelay - delay in milliseconds, <= 0 disables group commit
+// Ret:  PF return code
+//
+RC PF_Flusher::SetMaxDelay(int iMaxDelay)
+{
+   RC rc;
+
+   // Turning group commit off: make the pending requests durable first
+   if (iMaxDelay <= 0) {
+      if ((rc = Flush()))
+         return (rc);
+      unique_lock<mutex> lock(mtx);
+      maxDelay = 0;
+      return (0);
+   }
+
+   {
+      unique_lock<mutex> lock(mtx);
+      maxDelay = iMaxDelay;
+   }
+   if (!worker.joinable())
+      worker = thread(&PF_Flusher::Run, this);
+   return (0);
+}
+
+//
+// RequestSync
+//
+// Desc: Record that the pages of file fd have been written to the OS and
+//       must reach the disk.  Returns immediately; the flusher thread
+//       syncs the file within maxDelay ms, and WaitSync waits for it.
+//       The descriptor is dup'ed so that the file may be closed before
+//       the batch is synced.
+// In:   fd - OS file descriptor of the written file
+// Ret:  PF_UNIX
+//
+RC PF_Flusher::RequestSync(int fd)
+{
+   unique_lock<mutex> lock(mtx);
+
+   if (maxDelay <= 0)
+      return (0);
+
+   if (pendingFds.find(fd) == pendingFds.end()) {
+      int dupfd = dup(fd);
+      if (dupfd < 0)
+         return (PF_UNIX);
+      pendingFds[fd] = dupfd;
+   }
+
+   // The first request of a batch starts the delay timer
+   if (pendingRequests++ == 0)
+      cond.notify_one();
+   return (0);
+}
+
+//
+// WaitSync
+//
+// Desc: Called by a committing statement once its files are written.
+//       Waits until the batch holding the requests made so far, or the
+//       batch being synced if none is pending, has been synced.
+// Ret:  PF_UNIX if a batch failed since the last WaitSync
+//
+RC PF_Flusher::WaitSync()
+{
+   RC rc;
+   unique_lock<mutex> lock(mtx);
+
+   // Batches are synced in the order they are taken: the pending one is
+   // the next to be taken
+   long target = takenBatches;
+   if (pendingRequests > 0 || !detachedFds.empty())
+      target++;
+   if (syncedBatches >= target)
+      return (0);
+
+   // A waiting committer ends the delay of the pending batch
+   waitingCommits++;
+   cond.notify_one();
+   while (syncedBatches < target)
+      syncedCond.wait(lock);
+   waitingCommits--;
+
+   rc = lastRC;
+   lastRC = 0;
+   return (rc);
+}
+
+//
+// ReleaseFile
+//
+// Desc: Called before fd is closed.  Its pending sync is kept on the
+//       detached list so that a reused descriptor number is not mistaken
+//       for the old file.
+// In:   fd - OS file descriptor about to be closed
+// Ret:  PF return code
+//
+RC PF_Flusher::ReleaseFile(int fd)
+{
+   unique_lock<mutex> lock(mtx);
+   map<int, int>::iterator it = pendingFds.find(fd);
+
+   if (it != pendingFds.end()) {
+      detachedFds.push_back(it->second);
+      pendingFds.erase(it);
+   }
+   return (0);
+}
+
+//
+// Flush
+//
+// Desc: Sync every pending request from the calling thread
+// Ret:  PF_UNIX if a fdatasync failed
+//
+RC PF_Flusher::Flush()
+{
+   unique_lock<mutex> lock(mtx);
+   return (SyncBatch(lock));
+}
+
+//
+// PrintStats
+//
+// Desc: Display the group commit metrics
+// Ret:  PF return code
+//
+RC PF_Flusher::PrintStats()
+{
+   unique_lock<mutex> lock(mtx);
+
+   cout << "Group commit: ";
+   if (maxDelay > 0)
+      cout << "max delay " << maxDelay << " ms\n";
+   else
+      cout << "off\n";
+   cout << "  requests: " << numRequests
+        << ", batches: " << numBatches
+        << ", fdatasync calls: " << numSyncs << "\n";
+   cout << "  batch size: avg "
+        << (numBatches ? (double)numRequests / numBatches : 0.0)
+        << ", max " << maxBatch << "\n";
+   return (0);
+}
+
+//
+// Run
+//
+// Desc: Flusher thread.  Sleeps until a request arrives, then waits up
+//       to maxDelay ms, or until a committer waits for the batch, and
+//       syncs the whole batch at once.  The requests made meanwhile join
+//       the batch, and those made during its sync form the next one.
+//
+void PF_Flusher::Run()
+{
+   unique_lock<mutex> lock(mtx);
+
+   while (!bStop) {
+      if (pendingRequests == 0) {
+         cond.wait(lock);
+         continue;
+      }
+      cond.wait_for(lock, chrono::milliseconds(maxDelay),
+            [this] { return bStop != FALSE || waitingCommits > 0; });
+      SyncBatch(lock);
+   }
+}
+
+//
+// SyncBatch
+//
+// Desc: Internal.  Take the pending batch and issue one fdatasync per
+//       distinct file, then wake the committers waiting for it.  The
+//       lock is released during the syscalls so that new requests can
+//       form the next batch meanwhile; a second caller waits for the
+//       batch in progress, so that batches are synced in order.
+// In:   lock - held on mtx by the caller, held again on return
+// Ret:  PF_UNIX if a fdatasync failed
+//
+RC PF_Flusher::SyncBatch(unique_lock<mutex> &lock)
+{
+   RC rc = 0;
+   vector<int> fds;
+
+   while (bSyncing)
+      syncedCond.wait(lock);
+
+   int batch = pendingRequests;
+   if (batch == 0 && pendingFds.empty() && detachedFds.empty())
+      return (0);
+
+   fds.swap(detachedFds);
+   for (map<int, int>::iterator it = pendingFds.begin();
+         it != pendingFds.end(); ++it)
+      fds.push_back(it->second);
+   pendingFds.clear();
+   pendingRequests = 0;
+   takenBatches++;
+   bSyncing = TRUE;
+
+   // A file closed and reopened during the batch has several descriptors;
+   // sync each underlying file only once
+   lock.unlock();
+   set<pair<dev_t, ino_t> > synced;
+   int syncs = 0;
+   for (size_t i = 0; i < fds.size(); i++) {
+      struct stat st;
+      if (fstat(fds[i], &st) < 0 ||
+            synced.insert(make_pair(st.st_dev, st.st_ino)).second) {
+         if (fdatasync(fds[i]) < 0)
+            rc = PF_UNIX;
+         syncs++;
+      }
+      close(fds[i]);
+   }
+   lock.lock();
+
+   bSyncing = FALSE;
+   syncedBatches++;
+   if (rc)
+      lastRC = rc;
+   syncedCond.notify_all();
+
+   numRequests += batch;
+   numBatches++;
+   numSyncs += syncs;
+   if (batch > maxBatch)
+      maxBatch = batch;
+   return (rc);
+}
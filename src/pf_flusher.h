@@ -0,0 +1,77 @@
+//
+// File:        pf_flusher.h
+// Description: PF_Flusher class interface
+//              Group commit: a background thread that batches the
+//              durability requests of committed statements into a single
+//              fdatasync per file.
+//
+
+#ifndef PF_FLUSHER_H
+#define PF_FLUSHER_H
+
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "pf_internal.h"
+
+//
+// PF_Flusher - collect commit requests and sync them in batches
+//
+// A file handle calls RequestSync whenever it pushes its dirty pages to
+// the OS (end of statement close, or ForcePages).  The request only
+// records the file; the flusher thread issues one fdatasync per distinct
+// file, covering every request of the batch.  The committing statement
+// then calls WaitSync, which returns once the batch holding its requests
+// is synced, so a commit is durable when it returns.  A batch is synced
+// as soon as a committer waits for it and no other batch is syncing, so
+// a lone commit is not delayed and the commits arriving during a sync
+// form the next batch; requests nobody waits for are synced maxDelay
+// milliseconds after the first of them.
+//
+class PF_Flusher {
+public:
+    PF_Flusher     ();                           // Constructor
+    ~PF_Flusher    ();                           // Destructor - drains
+                                                  // pending requests
+
+    // Set the maximum delay (ms) of a commit; <= 0 turns group commit off
+    RC  SetMaxDelay  (int iMaxDelay);
+    int GetMaxDelay  () const { return maxDelay; }
+
+    RC  RequestSync  (int fd);                   // Pages of fd were written
+    RC  WaitSync     ();                         // Wait for the requests
+                                                  // made so far
+    RC  ReleaseFile  (int fd);                   // File fd is being closed
+    RC  Flush        ();                         // Sync all pending now
+
+    RC  PrintStats   ();                         // Display batch metrics
+
+private:
+    void Run         ();                         // Flusher thread body
+    RC   SyncBatch   (std::unique_lock<std::mutex> &lock);
+
+    std::thread             worker;              // flusher thread
+    std::mutex              mtx;                 // guards everything below
+    std::condition_variable cond;                // wakes the flusher
+    std::condition_variable syncedCond;          // wakes the committers
+    int                     maxDelay;            // max commit delay (ms)
+    int                     bStop;               // TRUE when shutting down
+    std::map<int, int>      pendingFds;          // open fd -> dup'ed fd
+    std::vector<int>        detachedFds;         // dup'ed fds of closed files
+    int                     pendingRequests;     // requests in current batch
+    int                     waitingCommits;      // committers in WaitSync
+    int                     bSyncing;            // TRUE while a batch syncs
+    long                    takenBatches;        // batches taken to sync
+    long                    syncedBatches;       // batches synced, in order
+    RC                      lastRC;              // error of a failed batch
+
+    // batch metrics
+    long                    numRequests;         // requests made durable
+    long                    numBatches;          // flush rounds
+    long                    numSyncs;            // fdatasync calls
+    int                     maxBatch;            // largest batch seen
+};
+
+#endif
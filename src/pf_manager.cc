@@ -12,6 +12,7 @@
 #include <sys/types.h>
 #include "pf_internal.h"
 #include "pf_buffermgr.h"
+#include "pf_flusher.h"
 
 //
 // PF_Manager
@@ -25,6 +26,9 @@ PF_Manager::PF_Manager()
 {
    // Create Buffer Manager
    pBufferMgr = new PF_BufferMgr(PF_BUFFER_SIZE);
+
+   // Create the group commit flusher (disabled until SetCommitDelay)
+   pFlusher = new PF_Flusher();
 }
 
 //
@@ -36,7 +40,8 @@ PF_Manager::PF_Manager()
 //
 PF_Manager::~PF_Manager()
 {
-   // Destroy the buffer manager objects
+   // Sync the pending commits, then destroy the buffer manager objects
+   delete pFlusher;
    delete pBufferMgr;
 }
 
@@ -72,6 +77,16 @@ RC PF_Manager::CreateFile (const char *fileName)
    hdr->firstFree = PF_PAGE_LIST_END;
    hdr->numPages = 0;
 
+   // The new file may reuse the inode of a file removed behind our back:
+   // drop whatever pages of that file are left in the buffer
+   struct stat st;
+   if (fstat(fd, &st) < 0 ||
+         pBufferMgr->InvalidateFile(st.st_dev, st.st_ino)) {
+      close(fd);
+      unlink(fileName);
+      return (PF_UNIX);
+   }
+
    // Write header to file
    if((numBytes = write(fd, hdrBuf, PF_FILE_HDR_SIZE))
          != PF_FILE_HDR_SIZE) {
@@ -104,6 +119,15 @@ RC PF_Manager::CreateFile (const char *fileName)
 //
 RC PF_Manager::DestroyFile (const char *fileName)
 {
+   RC rc;
+
+   // Drop the pages of the file left in the buffer
+   struct stat st;
+   if (stat(fileName, &st) < 0)
+      return (PF_UNIX);
+   if ((rc = pBufferMgr->InvalidateFile(st.st_dev, st.st_ino)))
+      return (rc);
+
    // Remove the file
    if (unlink(fileName) < 0)
       return (PF_UNIX);
@@ -112,16 +136,40 @@ RC PF_Manager::DestroyFile (const char *fileName)
    return (0);
 }
 
+//
+// RenameFile
+//
+// Desc: Rename the PF file oldName to newName (neither may be open).  An
+//       existing newName is replaced in one step, its pages left in the
+//       buffer are dropped.
+// In:   oldName - name of the file to rename
+//       newName - new name of the file
+// Ret:  PF return code
+//
+RC PF_Manager::RenameFile (const char *oldName, const char *newName)
+{
+   RC rc;
+
+   // Drop the pages of the replaced file left in the buffer
+   struct stat st;
+   if (stat(newName, &st) == 0 &&
+         (rc = pBufferMgr->InvalidateFile(st.st_dev, st.st_ino)))
+      return (rc);
+
+   if (rename(oldName, newName) < 0)
+      return (PF_UNIX);
+
+   // Return ok
+   return (0);
+}
+
 //
 // OpenFile
 //
 // Desc: Open the paged file whose name is "fileName".  It is possible to open
-//       a file more than once, however, it will be treated as 2 separate files
-//       (different file descriptors; different buffers).  Thus, opening a file
-//       more than once for writing may corrupt the file, and can, in certain
-//       circumstances, crash the PF layer. Note that even if only one instance
-//       of a file is for writing, problems may occur because some writes may
-//       not be seen by a reader of another instance of the file.
+//       a file more than once; the instances share the pages in the buffer,
+//       which is keyed by the inode of the file, not by the descriptor.
+//       Pages the file left in the buffer when last closed are reused.
 // In:   fileName - name of file to open
 // Out:  fileHandle - refer to the open file
 //                    this function modifies local var's in fileHandle
@@ -155,11 +203,17 @@ RC PF_Manager::OpenFile (const char *fileName, PF_FileHandle &fileHandle)
       }
    }
 
+   // Find the pages of the file in the buffer
+   if ((rc = pBufferMgr->AttachFile(fileHandle.unixfd, fileHandle.fileId)))
+      goto err;
+
    // Set file header to be not changed
    fileHandle.bHdrChanged = FALSE;
+   fileHandle.bSyncPending = FALSE;
 
    // Set local variables in file handle object to refer to open file
    fileHandle.pBufferMgr = pBufferMgr;
+   fileHandle.pFlusher = pFlusher;
    fileHandle.bFileOpen = TRUE;
 
    // Return ok
@@ -179,7 +233,8 @@ err:
 //
 // Desc: Close file associated with fileHandle
 //       The file should have been opened with OpenFile().
-//       Also, flush all pages for the file from the page buffer
+//       Also, write the dirty pages of the file; its clean pages stay in the
+//       page buffer until replaced, so a reopen does not read them again.
 //       It is an error to close a file with pages still fixed in the buffer.
 // In:   fileHandle - handle of file to close
 // Out:  fileHandle - no longer refers to an open file
@@ -194,8 +249,14 @@ RC PF_Manager::CloseFile(PF_FileHandle &fileHandle)
    if (!fileHandle.bFileOpen)
       return (PF_CLOSEDFILE);
 
-   // Flush all buffers for this file and write out the header
-   if ((rc = fileHandle.FlushPages()))
+   // Write out the header and the dirty pages of this file
+   if ((rc = fileHandle.ForcePages()) ||
+         (rc = pBufferMgr->DetachFile(fileHandle.fileId, fileHandle.unixfd)))
+      return (rc);
+
+   // Closing the file commits its changes: queue them for group commit
+   if ((rc = fileHandle.RequestSync(TRUE)) ||
+         (rc = pFlusher->ReleaseFile(fileHandle.unixfd)))
       return (rc);
 
    // Close the file
@@ -205,6 +266,7 @@ RC PF_Manager::CloseFile(PF_FileHandle &fileHandle)
 
    // Reset the buffer manager pointer in the file handle
    fileHandle.pBufferMgr = NULL;
+   fileHandle.pFlusher = NULL;
 
    // Return ok
    return 0;
@@ -258,6 +320,43 @@ RC PF_Manager::ResizeBuffer(int iNewSize)
    return pBufferMgr->ResizeBuffer(iNewSize);
 }
 
+//
+// SetCommitDelay
+//
+// Desc: Enable group commit.  Files written by a statement are no longer
+//       synced one by one; a flusher thread syncs them in one batch at
+//       most iMaxDelay ms later.
+// In:   iMaxDelay - max delay in milliseconds, <= 0 turns it off
+// Ret:  PF return code
+//
+RC PF_Manager::SetCommitDelay(int iMaxDelay)
+{
+   return pFlusher->SetMaxDelay(iMaxDelay);
+}
+
+//
+// WaitCommit
+//
+// Desc: Commit the statement that wrote its files: wait until the batch
+//       holding them has been synced
+// Ret:  PF return code
+//
+RC PF_Manager::WaitCommit()
+{
+   return pFlusher->WaitSync();
+}
+
+//
+// PrintCommitStats
+//
+// Desc: Display the number of sync requests, batches and the batch size
+// Ret:  PF return code
+//
+RC PF_Manager::PrintCommitStats()
+{
+   return pFlusher->PrintStats();
+}
+
 //------------------------------------------------------------------------------
 // Three Methods for manipulating raw memory buffers.  These memory
 // locations are handled by the buffer manager, but are not
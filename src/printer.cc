@@ -197,6 +197,15 @@ void Printer::Print(ostream &c, const void * const data[])
             else
                 Spaces(strlen(psHeader[i]), strlen(strSpace));
         }
+        if (attributes[i].attrType == DATE) {
+            memcpy (&a, data[i], sizeof(int));
+            Attr::FormatDate(a, strSpace);
+            c << strSpace;
+            if (strlen(psHeader[i]) < 12)
+                Spaces(12, strlen(strSpace));
+            else
+                Spaces(strlen(psHeader[i]), strlen(strSpace));
+        }
         if (attributes[i].attrType == FLOAT) {
             memcpy (&b, data[i], sizeof(float));
             sprintf(strSpace, "%f",b);
@@ -274,6 +283,20 @@ void Printer::Print(ostream &c, const char * const data)
             else
                 Spaces(strlen(psHeader[i]), strlen(strSpace));
         }
+        if (attributes[i].attrType == DATE) {
+            if (*(data+attributes[i].offset) == 0) {
+                sprintf(strSpace, "NULL");
+                c << "NULL";
+            } else {
+                memcpy (&a, (data+attributes[i].offset + 1), sizeof(int));
+                Attr::FormatDate(a, strSpace);
+                c << strSpace;
+            }
+            if (strlen(psHeader[i]) < 12)
+                Spaces(12, strlen(strSpace));
+            else
+                Spaces(strlen(psHeader[i]), strlen(strSpace));
+        }
         if (attributes[i].attrType == FLOAT) {
             if (*(data+attributes[i].offset) == 0) {
                 sprintf(strSpace, "NULL");
@@ -11,12 +11,43 @@
 #include <string.h>
 #include <string>
 #include <map>
+#include <vector>
 #include "global.h"
 #include "parser.h"
 #include "rm.h"
 #include "ix.h"
 #include "sm.h"
 
+//
+// LOAD DATA 每批检查约束并写入文件的记录数
+//
+#define QL_LOADBATCHSIZE 4096
+
+//
+// 属性索引等值条件的候选 RID 不多于此数时，直接读取记录检查其余条件，不再扫描其他索引求交集
+//
+#define QL_BITMAPMINRIDS 64
+
+struct QL_LoadContext;
+
+//
+// QL_UndoRecord: 事务中一次记录或索引项修改的撤销信息
+//
+struct QL_UndoRecord {
+    enum Kind {
+        RM_INSERT,              // 插入了记录 rid
+        RM_DELETE,              // 删除了记录 rid，data 为原记录
+        RM_UPDATE,              // 更新了记录 rid，data 为原记录
+        IX_INSERT,              // 在索引 indexNo 中插入了 (data, rid)
+        IX_DELETE               // 在索引 indexNo 中删除了 (data, rid)，data 为键及包含的属性值
+    };
+    Kind kind;
+    char relName[MAXNAME + 1];
+    int indexNo;
+    RID rid;
+    std::vector<char> data;
+};
+
 //
 // QL_Manager: query language (DML)
 //
@@ -62,11 +93,29 @@ public:
         int   nConditions,               // # conditions in where clause
         Condition conditions[]);   // conditions in where clause
 
+    RC Load    (const char *relName,     // relation to load into
+        const char *fileName);           // CSV file to load from
+
+    RC Begin   ();                       // start a transaction
+    RC Commit  ();                       // commit the transaction
+    RC Rollback();                       // undo the transaction
+
+    // Every DML statement runs as a single implicit transaction (or as
+    // a part of the open one): a failed statement is undone as a whole
+    RC BeginStatement();
+    RC EndStatement  (RC rc);            // rc - result of the statement
+
+    bool InTransaction() const { return inTransaction; }
+
 private:
     RM_Manager& rmManager;
     IX_Manager& ixManager;
     SM_Manager& smManager;
 
+    bool inTransaction;                  // BEGIN has been issued
+    size_t statementStart;               // undo log size at statement start
+    std::vector<QL_UndoRecord> undoLog;  // changes of the open transaction
+
     //
     // 检查数据库是否被打开
     //
@@ -113,9 +162,49 @@ private:
     RC GetRidSet(const char* relName, RM_FileHandle& rmFileHandle, const std::vector<FullCondition>& fullConditions, std::vector<RID>& rids);
 
     //
-    // 利用单表限制条件集合在某个数据表中提取满足条件的记录（尽可能使用索引，分配的空间需要在外部释放）
+    // 在完整单表限制条件集合中选择多列索引：前 matched 列为非空的等值条件，其后一列可有范围条件，
+    // lower 与 upper 为键的扫描范围；matched 为 -1 表示没有可用的多列索引
+    //
+    RC GetMultiIndexRange(const char* relName, const std::vector<FullCondition>& fullConditions, int& indexNo, int& matched,
+                          std::vector<char>& lower, std::vector<char>& upper);
+
+    //
+    // 在多列索引的键范围内扫描，提取按 RID 排序的候选 RID 集合
+    //
+    RC GetMultiIndexRids(const char* relName, int indexNo, std::vector<char>& lower, std::vector<char>& upper, std::vector<RID>& rids);
+
+    //
+    // 由索引得到按 RID 排序的候选 RID 集合（多个属性索引的等值条件取交集），
+    // 按此顺序读取记录时每个记录页只读入一次；isUsed 为假表示没有可用的索引
     //
-    RC GetDataSet(const RelCat& relCat, RM_FileHandle& rmFileHandle, const std::vector<FullCondition>& fullConditions, std::vector<char*>& data);
+    RC GetIndexRids(const char* relName, const std::vector<FullCondition>& fullConditions, std::vector<RID>& rids, bool& isUsed);
+
+    //
+    // 在各多列索引中插入、删除记录的项，或按新记录更新键或包含的属性值改变的项，并记入撤销日志
+    //
+    RC InsertMultiEntries(const char* relName, const char* recordData, const RID& rid);
+    RC DeleteMultiEntries(const char* relName, const char* recordData, const RID& rid);
+    RC UpdateMultiEntries(const char* relName, const char* oldData, const char* newData, const RID& rid);
+
+    //
+    // 只读属性索引的叶节点求单表聚集值：MIN/MAX 取首尾索引项，SUM/AVG 沿叶节点链扫描，
+    // 空值个数取自空值索引的叶节点项数；hasValue 为假表示没有非空值
+    //
+    RC GetIndexAggregate(FuncType func, const char* relName, const AttrCat& attr, char* value, bool& hasValue);
+
+    //
+    // 利用单表限制条件集合在某个数据表中提取满足条件的记录（尽可能使用索引，分配的空间需要在外部释放），
+    // usedAttrs 给出被引用的属性时，先尝试只读覆盖这些属性的索引
+    //
+    RC GetDataSet(const RelCat& relCat, RM_FileHandle& rmFileHandle, const std::vector<FullCondition>& fullConditions, std::vector<char*>& data,
+                  const std::vector<AttrCat>* usedAttrs = NULL);
+
+    //
+    // 被引用的属性都是某个属性索引的键或包含的属性时，只读该索引的叶节点构造记录，
+    // 不再按 RID 读记录文件（未引用的属性置为空）；covered 为假表示没有这样的索引
+    //
+    RC GetCoveredDataSet(const RelCat& relCat, const std::vector<FullCondition>& fullConditions, const std::vector<AttrCat>& usedAttrs,
+                         std::vector<char*>& data, bool& covered);
 
     //
     // 检查某条记录是否满足给定单表限制条件集合
@@ -131,6 +220,21 @@ private:
     // 将多个单表记录集合按照多表限制条件集合连接成结果数据集
     //
     RC GetJoinData(std::map<RelCat, std::vector<char*>>& data, std::map<std::pair<RelCat, RelCat>, std::vector<FullCondition>>& binaryRelConds, std::vector<std::map<RelCat, char*>>& joinData);
+
+    //
+    // LOAD DATA：批量检查一批记录的约束，再将其追加到记录文件并按序插入各索引
+    //
+    RC LoadBatch(QL_LoadContext& ctx);
+
+    //
+    // 记录一次修改的撤销信息（data 为原记录或索引键，长度为 length）
+    //
+    void LogUndo(QL_UndoRecord::Kind kind, const char* relName, int indexNo, const RID& rid, const void* data = NULL, int length = 0);
+
+    //
+    // 按逆序撤销撤销日志中 savepoint 之后的所有修改
+    //
+    RC RollbackTo(size_t savepoint);
 };
 
 //
@@ -151,5 +255,9 @@ void QL_PrintError(RC rc);
 #define QL_STRINGLENGTHWRONG (START_QL_WARN + 10)
 #define QL_FOREIGNKEYNOTEXIST (START_QL_WARN + 11)
 #define QL_DATEFORMATERROR  (START_QL_WARN + 12)
+#define QL_TRANSACTIONOPEN  (START_QL_WARN + 13)  // a transaction is in progress
+#define QL_NOTRANSACTION    (START_QL_WARN + 14)  // no transaction is in progress
+#define QL_LOADFILEERROR    (START_QL_WARN + 15)  // cannot read the data file
+#define QL_CSVFORMATERROR   (START_QL_WARN + 16)  // malformed CSV record
 
 #endif
@@ -27,7 +27,11 @@ static char* QL_WarnMsg[] = {
     (char*)"QL_PRIMARYKEYREPEAT",
     (char*)"QL_STRINGLENGTHWRONG",
     (char*)"QL_FOREIGNKEYNOTEXIST",
-    (char*)"date format error"
+    (char*)"date format error",
+    (char*)"a transaction is in progress",
+    (char*)"no transaction is in progress",
+    (char*)"cannot read the data file",
+    (char*)"malformed CSV record"
 };
 
 //
@@ -5,6 +5,9 @@
 //
 
 #include <cstdio>
+#include <cerrno>
+#include <climits>
+#include <strings.h>
 #include <iostream>
 #include <algorithm>
 #include <sys/times.h>
@@ -14,11 +17,11 @@
 #include <cassert>
 #include <unistd.h>
 #include "global.h"
-#include "printer.h"
 #include "ql.h"
 #include "sm.h"
 #include "ix.h"
 #include "rm.h"
+#include "printer.h"
 
 using namespace std;
 
@@ -27,7 +30,7 @@ using namespace std;
 //
 // Constructor for the QL Manager
 //
-QL_Manager::QL_Manager(SM_Manager &smm, IX_Manager &ixm, RM_Manager &rmm) : rmManager(rmm), ixManager(ixm), smManager(smm) {}
+QL_Manager::QL_Manager(SM_Manager &smm, IX_Manager &ixm, RM_Manager &rmm) : rmManager(rmm), ixManager(ixm), smManager(smm), inTransaction(false), statementStart(0) {}
 
 //
 // QL_Manager::~QL_Manager()
@@ -36,6 +39,67 @@ QL_Manager::QL_Manager(SM_Manager &smm, IX_Manager &ixm, RM_Manager &rmm) : rmMa
 //
 QL_Manager::~QL_Manager() {}
 
+//
+// 将 YYYY-MM-DD 字符串值原地转化为日期值（自 1970-01-01 起的天数）
+//
+static RC ConvertDate(Value& value) {
+    int day;
+    if (!Attr::ParseDate((char*)value.data + 1, day)) {
+        return QL_DATEFORMATERROR;
+    }
+    value.type = DATE;
+    *(int*)((char*)value.data + 1) = day;
+    return OK_RC;
+}
+
+//
+// 判断索引中是否有键为 key 的项，布隆过滤器排除的键不必查找 B+ 树
+//
+static RC IndexContains(IX_IndexHandle& indexHandle, void* key, bool& found) {
+    RC rc;
+    found = false;
+    if (!indexHandle.MayContain(key)) {
+        return OK_RC;
+    }
+    IX_IndexScan indexScan;
+    if ((rc = indexScan.OpenScan(indexHandle, EQ_OP, key))) {
+        return rc;
+    }
+    RID rid;
+    if ((rc = indexScan.GetNextEntry(rid)) && rc != IX_EOF) {
+        indexScan.CloseScan();
+        return rc;
+    }
+    found = rc != IX_EOF;
+    return indexScan.CloseScan();
+}
+
+//
+// 构造记录在多重主键索引中的键：非空标志，随后按主键顺序拼接各属性可按 memcmp 比较的编码
+//
+static void GetPrimaryKey(const vector<AttrCat>& attrs, int primaryKeyCount, const char* recordData, char* key) {
+    *key = 1;
+    int offset = 1;
+    for (int i = 1; i <= primaryKeyCount; ++i) {
+        for (const auto& attr : attrs) {
+            if (attr.primaryKey == i) {
+                Attr::EncodeKey(attr.attrType, attr.attrLength, recordData + attr.offset, key + offset);
+                offset += attr.attrLength + 1;
+                break;
+            }
+        }
+    }
+}
+
+//
+// 构造记录在属性索引中的项：属性值，随后为索引包含的属性值；删除的项连同包含的值记入撤销日志
+//
+static void GetIndexEntry(const IX_IndexHandle& indexHandle, const AttrCat& attr, const char* recordData, vector<char>& entry) {
+    entry.resize(attr.attrLength + 1 + indexHandle.GetIncludeLength());
+    memcpy(&entry[0], recordData + attr.offset, attr.attrLength + 1);
+    indexHandle.GetInclude(recordData, &entry[attr.attrLength + 1]);
+}
+
 RC QL_Manager::SelectFunc(FuncType func, const RelAttr relAttrFunc, int nRelations, const char * const relations[], int nConditions, Condition conditions[]) {
     RC rc;
     // check whether a db is open
@@ -61,33 +125,43 @@ RC QL_Manager::SelectFunc(FuncType func, const RelAttr relAttrFunc, int nRelatio
     if (attrs.begin()->second.begin()->attrType != INT && attrs.begin()->second.begin()->attrType != FLOAT) {
         return QL_ATTRTYPEWRONG;
     }
-    // check conditions
-    std::map<RelCat, std::vector<FullCondition>> singalRelConds;
-    std::map<std::pair<RelCat, RelCat>, std::vector<FullCondition>> binaryRelConds;
-    for (int i = 0; i < nConditions; ++i) {
-        if ((rc = GetFullCondition(conditions[i], relCats, singalRelConds, binaryRelConds))) {
-            return rc;
-        }
-    }
-    // get scan data
+    // 单表无条件且聚集属性带有索引时只读索引求值，不访问记录文件
+    bool byIndex = nRelations == 1 && nConditions == 0 && attrs.begin()->second.begin()->indexNo != -1;
+    char indexValue[sizeof(int)];
+    bool indexHasValue = false;
     std::map<RelCat, std::vector<char*>> data;
-    for (const auto& item : relCats) {
-        RM_FileHandle relFileHandle;
-        if ((rc = rmManager.OpenFile(item.first.relName, relFileHandle))) {
+    std::vector<std::map<RelCat, char*>> joinData{std::map<RelCat, char*>()};
+    if (byIndex) {
+        if ((rc = GetIndexAggregate(func, attrs.begin()->first.relName, *attrs.begin()->second.begin(), indexValue, indexHasValue))) {
             return rc;
         }
-        if ((rc = GetDataSet(item.first, relFileHandle, singalRelConds[item.first], data[item.first]))) {
+    } else {
+        // check conditions
+        std::map<RelCat, std::vector<FullCondition>> singalRelConds;
+        std::map<std::pair<RelCat, RelCat>, std::vector<FullCondition>> binaryRelConds;
+        for (int i = 0; i < nConditions; ++i) {
+            if ((rc = GetFullCondition(conditions[i], relCats, singalRelConds, binaryRelConds))) {
+                return rc;
+            }
+        }
+        // get scan data
+        for (const auto& item : relCats) {
+            RM_FileHandle* relFileHandle;
+            if ((rc = smManager.GetFileHandle(item.first.relName, relFileHandle))) {
+                return rc;
+            }
+            if ((rc = GetDataSet(item.first, *relFileHandle, singalRelConds[item.first], data[item.first]))) {
+                return rc;
+            }
+        }
+        if ((rc = smManager.ReleaseHandles(!inTransaction))) {
             return rc;
         }
-        if ((rc = rmManager.CloseFile(relFileHandle))) {
+        // join
+        if ((rc = GetJoinData(data, binaryRelConds, joinData))) {
             return rc;
         }
     }
-    // join
-    std::vector<std::map<RelCat, char*>> joinData{std::map<RelCat, char*>()};
-    if ((rc = GetJoinData(data, binaryRelConds, joinData))) {
-        return rc;
-    }
     // print
     DataAttrInfo* attributes = new DataAttrInfo[1];
     int index = 0;
@@ -112,37 +186,41 @@ RC QL_Manager::SelectFunc(FuncType func, const RelAttr relAttrFunc, int nRelatio
     RelCat funcRel = attrs.begin()->first;
     AttrCat funcAttr = *(attrs.begin()->second.begin());
     int nullCount = 0;
-    if (attributes[0].attrType == FLOAT) {
+    if (byIndex) {
+        memcpy(tuple + 1, indexValue, 4);
+    } else if (attributes[0].attrType == FLOAT) {
         switch (func) {
             case SUM: {
-                float result = 0;
+                // 用 double 累加，结果与累加顺序无关
+                double sum = 0;
                 for (auto& item : joinData) {
                     if (*(char*)(item[funcRel] + funcAttr.offset) == 0) {
                         ++nullCount;
                         continue;
                     }
                     float tmp = *(float*)(item[funcRel] + funcAttr.offset + 1);
-                    result += tmp;
+                    sum += tmp;
                 }
+                float result = sum;
                 memcpy(tuple + 1, &result, 4);
                 break;
             }
             case AVG: {
-                float result = 0;
+                double sum = 0;
                 for (auto& item : joinData) {
                     if (*(char*)(item[funcRel] + funcAttr.offset) == 0) {
                         ++nullCount;
                         continue;
                     }
                     float tmp = *(float*)(item[funcRel] + funcAttr.offset + 1);
-                    result += tmp;
+                    sum += tmp;
                 }
-                result /= joinData.size();
+                float result = sum / joinData.size();
                 memcpy(tuple + 1, &result, 4);
                 break;
             }
             case MAX: {
-                float result = (numeric_limits<float>::min)();
+                float result = (numeric_limits<float>::lowest)();
                 for (auto& item : joinData) {
                     if (*(char*)(item[funcRel] + funcAttr.offset) == 0) {
                         ++nullCount;
@@ -195,12 +273,13 @@ RC QL_Manager::SelectFunc(FuncType func, const RelAttr relAttrFunc, int nRelatio
                     int tmp = *(int*)(item[funcRel] + funcAttr.offset + 1);
                     result += tmp;
                 }
-                result /= joinData.size();
+                if (!joinData.empty())
+                    result /= (int)joinData.size();
                 memcpy(tuple + 1, &result, 4);
                 break;
             }
             case MAX: {
-                int result = (numeric_limits<float>::min)();
+                int result = (numeric_limits<int>::min)();
                 for (auto& item : joinData) {
                     if (*(char*)(item[funcRel] + funcAttr.offset) == 0) {
                         ++nullCount;
@@ -214,7 +293,7 @@ RC QL_Manager::SelectFunc(FuncType func, const RelAttr relAttrFunc, int nRelatio
                 break;
             }
             case MIN: {
-                int result = (numeric_limits<float>::max)();
+                int result = (numeric_limits<int>::max)();
                 for (auto& item : joinData) {
                     if (*(char*)(item[funcRel] + funcAttr.offset) == 0) {
                         ++nullCount;
@@ -229,7 +308,7 @@ RC QL_Manager::SelectFunc(FuncType func, const RelAttr relAttrFunc, int nRelatio
             }
         }
     }
-    if (nullCount != joinData.size())
+    if (byIndex ? indexHasValue : nullCount != joinData.size())
         printer.Print(cout, tuple);
     delete[] tuple;
     printer.PrintFooter(cout);
@@ -293,17 +372,17 @@ RC QL_Manager::SelectGroup(FuncType func, const RelAttr relAttrFunc, const RelAt
     // get scan data
     std::map<RelCat, std::vector<char*>> data;
     for (const auto& item : relCats) {
-        RM_FileHandle relFileHandle;
-        if ((rc = rmManager.OpenFile(item.first.relName, relFileHandle))) {
-            return rc;
-        }
-        if ((rc = GetDataSet(item.first, relFileHandle, singalRelConds[item.first], data[item.first]))) {
+        RM_FileHandle* relFileHandle;
+        if ((rc = smManager.GetFileHandle(item.first.relName, relFileHandle))) {
             return rc;
         }
-        if ((rc = rmManager.CloseFile(relFileHandle))) {
+        if ((rc = GetDataSet(item.first, *relFileHandle, singalRelConds[item.first], data[item.first]))) {
             return rc;
         }
     }
+    if ((rc = smManager.ReleaseHandles(!inTransaction))) {
+        return rc;
+    }
     // join
     std::vector<std::map<RelCat, char*>> joinData{std::map<RelCat, char*>()};
     if ((rc = GetJoinData(data, binaryRelConds, joinData))) {
@@ -346,7 +425,8 @@ RC QL_Manager::SelectGroup(FuncType func, const RelAttr relAttrFunc, const RelAt
     RelCat groupRel = groupAttrs.begin()->first;
     AttrCat groupAttr = *(groupAttrs.begin()->second.begin());
     switch (groupAttr.attrType) {
-        case INT: {
+        case INT:
+        case DATE: {
             switch (funcAttr.attrType) {
                 case INT: {
                     map<int, int> group;
@@ -716,8 +796,7 @@ RC QL_Manager::SelectGroup(FuncType func, const RelAttr relAttrFunc, const RelAt
             }
             break;
         }
-        case STRING:
-        case DATE: {
+        case STRING: {
             switch (funcAttr.attrType) {
                 case INT: {
                     map<string, int> group;
@@ -971,20 +1050,43 @@ RC QL_Manager::Select(int nSelAttrs, const RelAttr selAttrs[], int nRelations, c
             return rc;
         }
     }
+    // 每个数据表被引用的属性：选择的属性与限制条件中的属性
+    std::map<RelCat, std::vector<AttrCat>> usedAttrs = attrs;
+    auto useAttr = [&](const AttrCat& attr) {
+        for (const auto& item : relCats) {
+            if (!strcmp(item.first.relName, attr.relName)) {
+                usedAttrs[item.first].push_back(attr);
+            }
+        }
+    };
+    for (const auto& item : singalRelConds) {
+        for (const auto& condition : item.second) {
+            useAttr(condition.lhsAttr);
+            if (condition.bRhsIsAttr) {
+                useAttr(condition.rhsAttr);
+            }
+        }
+    }
+    for (const auto& item : binaryRelConds) {
+        for (const auto& condition : item.second) {
+            useAttr(condition.lhsAttr);
+            useAttr(condition.rhsAttr);
+        }
+    }
     // get scan data
     std::map<RelCat, std::vector<char*>> data;
     for (const auto& item : relCats) {
-        RM_FileHandle relFileHandle;
-        if ((rc = rmManager.OpenFile(item.first.relName, relFileHandle))) {
-            return rc;
-        }
-        if ((rc = GetDataSet(item.first, relFileHandle, singalRelConds[item.first], data[item.first]))) {
+        RM_FileHandle* relFileHandle;
+        if ((rc = smManager.GetFileHandle(item.first.relName, relFileHandle))) {
             return rc;
         }
-        if ((rc = rmManager.CloseFile(relFileHandle))) {
+        if ((rc = GetDataSet(item.first, *relFileHandle, singalRelConds[item.first], data[item.first], &usedAttrs[item.first]))) {
             return rc;
         }
     }
+    if ((rc = smManager.ReleaseHandles(!inTransaction))) {
+        return rc;
+    }
     // join
     std::vector<std::map<RelCat, char*>> joinData{std::map<RelCat, char*>()};
     if ((rc = GetJoinData(data, binaryRelConds, joinData))) {
@@ -1046,6 +1148,15 @@ RC QL_Manager::Select(int nSelAttrs, const RelAttr selAttrs[], int nRelations, c
 //
 // Insert the values into relName
 //
+//
+// 构造记录在多列索引中的项：各键属性编码后的键，随后为索引包含的属性值
+//
+static void GetMultiEntry(const IX_IndexHandle& indexHandle, const char* recordData, vector<char>& entry) {
+    entry.resize(indexHandle.GetKeyLength() + indexHandle.GetIncludeLength());
+    indexHandle.GetKey(recordData, &entry[0]);
+    indexHandle.GetInclude(recordData, &entry[indexHandle.GetKeyLength()]);
+}
+
 RC QL_Manager::Insert(const char *relName, int nValues, Value values[]) {
     RC rc;
     // 检查数据库是否打开
@@ -1092,26 +1203,8 @@ RC QL_Manager::Insert(const char *relName, int nValues, Value values[]) {
             *(float*)((char*)values[i].data + 1) = *(int*)((char*)values[i].data + 1);
         }
         // 判断日期类型是否合法
-        if (attrs[i].attrType == DATE && values[i].type == STRING) {
-            values[i].type = DATE;
-            if (strlen((char*)values[i].data + 1) != 10) {
-                return QL_DATEFORMATERROR;
-            }
-            for (int j = 1; j <= 10; ++j) {
-                char c = *((char*)values[i].data + j);
-                if (j == 5 || j == 8) {
-                    if (c != '-') return QL_DATEFORMATERROR;
-                } else {
-                    if (c < '0' || c > '9') return QL_DATEFORMATERROR;
-                }
-            }
-            int yyyy, mm, dd;
-            sscanf((char*)values[i].data + 1, "%d-%d-%d", &yyyy, &mm, &dd);
-            if (dd < 1 || mm < 1 || mm > 12) return QL_DATEFORMATERROR;
-            int end2 = yyyy % 4 == 0 && yyyy % 100 != 0 || yyyy % 400 == 0 ? 29 : 28;            
-            if (mm == 2 && dd > end2) return QL_DATEFORMATERROR;
-            if ((mm == 1 || mm == 3 || mm == 5 || mm == 7 || mm == 8 || mm == 10 || mm == 12) && dd > 31) return QL_DATEFORMATERROR;
-            if ((mm == 4 || mm == 6 || mm == 9 || mm == 11) && dd > 30) return QL_DATEFORMATERROR;
+        if (attrs[i].attrType == DATE && values[i].type == STRING && (rc = ConvertDate(values[i]))) {
+            return rc;
         }
         // 判断类型是否一致
         if (values[i].type != attrs[i].attrType) {
@@ -1121,140 +1214,115 @@ RC QL_Manager::Insert(const char *relName, int nValues, Value values[]) {
         if (attrs[i].attrType == STRING && strlen((char*)(values[i].data) + 1) >= attrs[i].attrLength) {
             return QL_STRINGLENGTHWRONG;
         }
-        // 判断单主键是否重复
-        if (attrs[i].primaryKey > 0 && primaryKeyCount == 1) {
-            IX_IndexHandle indexHandle;
-            if ((rc = ixManager.OpenIndex(relName, attrs[i].indexNo, indexHandle))) {
-                return rc;
-            }
-            IX_IndexScan indexScan;
-            if ((rc = indexScan.OpenScan(indexHandle, EQ_OP, values[i].data))) {
-                return rc;
-            }
-            RID rid;
-            // 如果重复，报错
-            if ((rc = indexScan.GetNextEntry(rid)) && rc != IX_EOF) {
-                return rc;
-            }
-            if (rc != IX_EOF) {
-                return QL_PRIMARYKEYREPEAT;
-            }
-            if ((rc = indexScan.CloseScan())) {
-                return rc;
-            }
-            if ((rc = ixManager.CloseIndex(indexHandle))) {
-                return rc;
-            }
-        }
         // 判断外键合法性
         if (attrs[i].refrel[0] != 0) {
             // 获取外键属性详细信息
-            vector<AttrCat> refAttrs;
-            if ((rc = smManager.GetAttrs(attrs[i].refrel, refAttrs))) {
+            AttrCat refAttr;
+            if ((rc = smManager.GetAttr(attrs[i].refrel, attrs[i].refattr, refAttr))) {
                 return rc;
             }
-            auto iter = find_if(refAttrs.begin(), refAttrs.end(), [&](const AttrCat& item) { return strcmp(item.attrName, attrs[i].refattr) == 0; });
-            IX_IndexHandle indexHandle;
-            if ((rc = ixManager.OpenIndex(attrs[i].refrel, iter->indexNo, indexHandle))) {
+            IX_IndexHandle* indexHandle;
+            if ((rc = smManager.GetIndexHandle(attrs[i].refrel, refAttr.indexNo, indexHandle))) {
                 return rc;
             }
-            IX_IndexScan indexScan;
-            if ((rc = indexScan.OpenScan(indexHandle, EQ_OP, values[i].data))) {
+            bool found;
+            if ((rc = IndexContains(*indexHandle, values[i].data, found))) {
                 return rc;
             }
-            RID rid;
             // 如果不存在，报错
-            if ((rc = indexScan.GetNextEntry(rid)) && rc != IX_EOF) {
-                return rc;
-            }
-            if (rc == IX_EOF) {
+            if (!found) {
                 return QL_FOREIGNKEYNOTEXIST;
             }
-            if ((rc = indexScan.CloseScan())) {
-                return rc;
-            }
-            if ((rc = ixManager.CloseIndex(indexHandle))) {
-                return rc;
-            }
         }
     }
     // 判断多重主键是否重复
     if (primaryKeyCount > 1) {
-        // 清零 ！！！
-        char *key = new char[primaryKeyTupleLength];
-        memset(key, 0, primaryKeyTupleLength);
-        // 构造
-        int offset = 0;
+        // 构造：非空标志，随后为各属性的编码
+        char *key = new char[primaryKeyTupleLength + primaryKeyCount + 1];
+        *key = 1;
+        int offset = 1;
         for (int i = 1; i <= primaryKeyCount; ++i) {
             for (int j = 0; j < nValues; ++j) {
                 if (attrs[j].primaryKey == i) {
-                    memcpy(key + offset, values[j].data, attrs[j].attrLength + 1);
+                    Attr::EncodeKey(attrs[j].attrType, attrs[j].attrLength, (char*)values[j].data, key + offset);
                     offset += attrs[j].attrLength + 1;
                     break;
                 }
             }
         }
-        IX_IndexHandle indexHandle;
-        if ((rc = ixManager.OpenIndex(relName, 0, indexHandle))) {
-            return rc;
-        }
-        IX_IndexScan indexScan;
-        if ((rc = indexScan.OpenScan(indexHandle, EQ_OP, key))) {
-            return rc;
-        }
-        RID rid;
-        // 如果重复，报错
-        if ((rc = indexScan.GetNextEntry(rid)) && rc != IX_EOF) {
-            return QL_PRIMARYKEYREPEAT;
-        }
-        if ((rc = indexScan.CloseScan())) {
-            return rc;
-        }
-        // 插入
-        if ((rc = indexHandle.InsertEntry(key, RID(0, 0)))) {
+        IX_IndexHandle* indexHandle;
+        if ((rc = smManager.GetIndexHandle(relName, 0, indexHandle))) {
             return rc;
         }
-        if ((rc = ixManager.CloseIndex(indexHandle))) {
-            return rc;
+        // 不重复则插入，如果重复，报错
+        if ((rc = indexHandle->InsertUnique(key, RID(0, 0)))) {
+            delete[] key;
+            return rc == IX_DUPLICATEKEY ? QL_PRIMARYKEYREPEAT : rc;
         }
+        LogUndo(QL_UndoRecord::IX_INSERT, relName, 0, RID(0, 0), key, primaryKeyTupleLength + primaryKeyCount + 1);
         delete[] key;
     }
-    // 构造记录数据
+    // 构造记录数据，对齐用的填充字节清零
     char *tuple = new char[relCat.tupleLength];
+    memset(tuple, 0, relCat.tupleLength);
     for (int i = 0; i < nValues; ++i) {
         memcpy(tuple + attrs[i].offset, values[i].data, attrs[i].attrLength + 1);
     }
     // 插入到记录文件
-    RM_FileHandle relFileHandle;
-    if ((rc = rmManager.OpenFile(relName, relFileHandle))) {
+    RM_FileHandle* relFileHandle;
+    if ((rc = smManager.GetFileHandle(relName, relFileHandle))) {
         return rc;
     }
     RID rid;
-    if ((rc = relFileHandle.InsertRec(tuple, rid))) {
+    if ((rc = relFileHandle->InsertRec(tuple, rid))) {
         return rc;
     }
-    if ((rc = rmManager.CloseFile(relFileHandle))) {
-        return rc;
-            return 2;
+    // 单主键插入索引的同时判断是否重复，如果重复，撤销记录并报错
+    IX_IndexHandle* relIndexHandle;
+    vector<char> entry;
+    int uniqueAttr = -1;
+    for (int i = 0; i < nValues; ++i) {
+        if (attrs[i].primaryKey > 0 && primaryKeyCount == 1 && *(char*)(values[i].data) != 0) {
+            uniqueAttr = i;
+            if ((rc = smManager.GetIndexHandle(relName, attrs[i].indexNo, relIndexHandle))) {
+                return rc;
+            }
+            GetIndexEntry(*relIndexHandle, attrs[i], tuple, entry);
+            if ((rc = relIndexHandle->InsertUnique(&entry[0], rid, &entry[attrs[i].attrLength + 1]))) {
+                delete[] tuple;
+                if (rc != IX_DUPLICATEKEY) {
+                    return rc;
+                }
+                if ((rc = relFileHandle->DeleteRec(rid))) {
+                    return rc;
+                }
+                return QL_PRIMARYKEYREPEAT;
+            }
+        }
+    }
+    LogUndo(QL_UndoRecord::RM_INSERT, relName, -1, rid);
+    if (uniqueAttr != -1) {
+        LogUndo(QL_UndoRecord::IX_INSERT, relName, attrs[uniqueAttr].indexNo, rid, values[uniqueAttr].data, attrs[uniqueAttr].attrLength + 1);
     }
     // 插入到索引文件
-    IX_IndexHandle relIndexHandle;
     for (int i = 0; i < nValues; ++i) {
         // 判断该属性是否有索引
-        if (attrs[i].indexNo != -1) {
+        if (attrs[i].indexNo != -1 && i != uniqueAttr) {
             // 按照是否为空插入不同的索引中
             int indexNo = *(char*)(values[i].data) == 0 ? attrs[i].indexNo + 1 : attrs[i].indexNo;
-            if ((rc = ixManager.OpenIndex(relName, indexNo, relIndexHandle))) {
-                return rc;
-            }
-            if ((rc = relIndexHandle.InsertEntry(values[i].data, rid))) {
+            if ((rc = smManager.GetIndexHandle(relName, indexNo, relIndexHandle))) {
                 return rc;
             }
-            if ((rc = ixManager.CloseIndex(relIndexHandle))) {
+            GetIndexEntry(*relIndexHandle, attrs[i], tuple, entry);
+            if ((rc = relIndexHandle->InsertEntry(&entry[0], rid, &entry[attrs[i].attrLength + 1]))) {
                 return rc;
             }
+            LogUndo(QL_UndoRecord::IX_INSERT, relName, indexNo, rid, values[i].data, attrs[i].attrLength + 1);
         }
     }
+    if ((rc = InsertMultiEntries(relName, tuple, rid))) {
+        return rc;
+    }
     delete[] tuple;
 
     // print
@@ -1307,98 +1375,92 @@ RC QL_Manager::Delete(const char *relName, int nConditions, Condition conditions
         return rc;
     }
     // scan the rid set
-    RM_FileHandle rmFileHandle;
-    if ((rc = rmManager.OpenFile(relName, rmFileHandle))) {
+    RM_FileHandle* rmFileHandle;
+    if ((rc = smManager.GetFileHandle(relName, rmFileHandle))) {
         return rc;
     }
     vector<RID> rids;
-    if ((rc = GetRidSet(relName, rmFileHandle, fullConditions, rids))) {
+    if ((rc = GetRidSet(relName, *rmFileHandle, fullConditions, rids))) {
         return rc;
     }
     // delete indexs
+    vector<char> entry;
     for (const auto &attr : attrs) {
         if (attr.indexNo != -1) {
-            IX_IndexHandle indexHandle;
-            if ((rc = ixManager.OpenIndex(relName, attr.indexNo, indexHandle))) {
+            IX_IndexHandle* indexHandle;
+            if ((rc = smManager.GetIndexHandle(relName, attr.indexNo, indexHandle))) {
                 return rc;
             }
-            IX_IndexHandle nullHandle;
-            if ((rc = ixManager.OpenIndex(relName, attr.indexNo + 1, nullHandle))) {
+            IX_IndexHandle* nullHandle;
+            if ((rc = smManager.GetIndexHandle(relName, attr.indexNo + 1, nullHandle))) {
                 return rc;
             }
             for (const auto& rid : rids) {
                 RM_Record record;
-                if ((rc = rmFileHandle.GetRec(rid, record))) {
+                if ((rc = rmFileHandle->GetRec(rid, record))) {
                     return rc;
                 }
                 char *recordData;
                 if ((rc = record.GetData(recordData))) {
                     return rc;
                 }
+                GetIndexEntry(*indexHandle, attr, recordData, entry);
                 if (*(char*)(recordData + attr.offset) == 0) {
-                    if ((rc = nullHandle.DeleteEntry(recordData + attr.offset, rid))) {
+                    if ((rc = nullHandle->DeleteEntry(recordData + attr.offset, rid))) {
                         return rc;
                     }
+                    LogUndo(QL_UndoRecord::IX_DELETE, relName, attr.indexNo + 1, rid, entry.data(), entry.size());
                 } else {
-                    if ((rc = indexHandle.DeleteEntry(recordData + attr.offset, rid))) {
+                    if ((rc = indexHandle->DeleteEntry(recordData + attr.offset, rid))) {
                         return rc;
                     }
+                    LogUndo(QL_UndoRecord::IX_DELETE, relName, attr.indexNo, rid, entry.data(), entry.size());
                 }
             }
-            if ((rc = ixManager.CloseIndex(indexHandle))) {
-                return rc;
-            }
-            if ((rc = ixManager.CloseIndex(nullHandle))) {
-                return rc;
-            }
         }
     }
     // 如果有多重主键的话，删除多重主键
     if (primaryKeyCount > 1) {
-        IX_IndexHandle primaryHandle;
-        if ((rc = ixManager.OpenIndex(relName, 0, primaryHandle))) {
+        IX_IndexHandle* primaryHandle;
+        if ((rc = smManager.GetIndexHandle(relName, 0, primaryHandle))) {
             return rc;
         }
-        char *key = new char[primaryKeyTupleLength];
+        char *key = new char[primaryKeyTupleLength + primaryKeyCount + 1];
         for (const auto& rid : rids) {
             RM_Record record;
-            if ((rc = rmFileHandle.GetRec(rid, record))) {
+            if ((rc = rmFileHandle->GetRec(rid, record))) {
                 return rc;
             }
             char *recordData;
             if ((rc = record.GetData(recordData))) {
                 return rc;
             }
-            // !!!
-            memset(key, 0, primaryKeyTupleLength);
-            // 构造
-            int offset = 0;
-            for (int i = 1; i <= primaryKeyCount; ++i) {
-                for (int j = 0; j < attrs.size(); ++j) {
-                    if (attrs[j].primaryKey == i) {
-                        memcpy(key + offset, recordData + attrs[j].offset, attrs[j].attrLength + 1);
-                        offset += attrs[j].attrLength + 1;
-                        break;
-                    }
-                }
-            }
-            if ((rc = primaryHandle.DeleteEntry(key, RID(0, 0)))) {
+            GetPrimaryKey(attrs, primaryKeyCount, recordData, key);
+            if ((rc = primaryHandle->DeleteEntry(key, RID(0, 0)))) {
                 return rc;
             }
+            LogUndo(QL_UndoRecord::IX_DELETE, relName, 0, RID(0, 0), key, primaryKeyTupleLength + primaryKeyCount + 1);
         }
         delete[] key;
-        if ((rc = ixManager.CloseIndex(primaryHandle))) {
-            return rc;
-        }
     }
     // delete records
     for (const auto &rid : rids) {
-        if ((rc = rmFileHandle.DeleteRec(rid))) {
+        // keep the old record for rollback
+        RM_Record record;
+        if ((rc = rmFileHandle->GetRec(rid, record))) {
             return rc;
         }
-    }
-    if ((rc = rmManager.CloseFile(rmFileHandle))) {
-        return rc;
+        char *recordData;
+        if ((rc = record.GetData(recordData))) {
+            return rc;
+        }
+        if ((rc = DeleteMultiEntries(relName, recordData, rid))) {
+            return rc;
+        }
+        if ((rc = rmFileHandle->DeleteRec(rid))) {
+            return rc;
+        }
+        LogUndo(QL_UndoRecord::RM_DELETE, relName, -1, rid, recordData, relCat.tupleLength);
     }
 
     // print
@@ -1468,26 +1530,8 @@ RC QL_Manager::Update(const char *relName, int nSetters, const RelAttr updAttrs[
             *(float*)((char*)rhsValues[i].data + 1) = *(int*)((char*)rhsValues[i].data + 1);
         }
         // 判断日期类型是否合法
-        if (iters[i]->attrType == DATE && rhsValues[i].type == STRING) {
-            rhsValues[i].type = DATE;
-            if (strlen((char*)rhsValues[i].data + 1) != 10) {
-                return QL_DATEFORMATERROR;
-            }
-            for (int j = 1; j <= 10; ++j) {
-                char c = *((char*)rhsValues[i].data + j);
-                if (j == 5 || j == 8) {
-                    if (c != '-') return QL_DATEFORMATERROR;
-                } else {
-                    if (c < '0' || c > '9') return QL_DATEFORMATERROR;
-                }
-            }
-            int yyyy, mm, dd;
-            sscanf((char*)rhsValues[i].data + 1, "%d-%d-%d", &yyyy, &mm, &dd);
-            if (dd < 1 || mm < 1 || mm > 12) return QL_DATEFORMATERROR;
-            int end2 = yyyy % 4 == 0 && yyyy % 100 != 0 || yyyy % 400 == 0 ? 29 : 28;            
-            if (mm == 2 && dd > end2) return QL_DATEFORMATERROR;
-            if ((mm == 1 || mm == 3 || mm == 5 || mm == 7 || mm == 8 || mm == 10 || mm == 12) && dd > 31) return QL_DATEFORMATERROR;
-            if ((mm == 4 || mm == 6 || mm == 9 || mm == 11) && dd > 30) return QL_DATEFORMATERROR;
+        if (iters[i]->attrType == DATE && rhsValues[i].type == STRING && (rc = ConvertDate(rhsValues[i]))) {
+            return rc;
         }
         // 类型不一致，报错
         if (iters[i]->attrType != rhsValues[i].type) {
@@ -1502,33 +1546,22 @@ RC QL_Manager::Update(const char *relName, int nSetters, const RelAttr updAttrs[
         // 判断外键合法性
         if (iters[i]->refrel[0] != 0) {
             // 获取外键属性详细信息
-            vector<AttrCat> refAttrs;
-            if ((rc = smManager.GetAttrs(iters[i]->refrel, refAttrs))) {
+            AttrCat refAttr;
+            if ((rc = smManager.GetAttr(iters[i]->refrel, iters[i]->refattr, refAttr))) {
                 return rc;
             }
-            auto iter = find_if(refAttrs.begin(), refAttrs.end(), [&](const AttrCat& item) { return strcmp(item.attrName, iters[i]->refattr) == 0; });
-            IX_IndexHandle indexHandle;
-            if ((rc = ixManager.OpenIndex(iters[i]->refrel, iter->indexNo, indexHandle))) {
+            IX_IndexHandle* indexHandle;
+            if ((rc = smManager.GetIndexHandle(iters[i]->refrel, refAttr.indexNo, indexHandle))) {
                 return rc;
             }
-            IX_IndexScan indexScan;
-            if ((rc = indexScan.OpenScan(indexHandle, EQ_OP, rhsValues[i].data))) {
+            bool found;
+            if ((rc = IndexContains(*indexHandle, rhsValues[i].data, found))) {
                 return rc;
             }
-            RID rid;
             // 如果不存在，报错
-            if ((rc = indexScan.GetNextEntry(rid)) && rc != IX_EOF) {
-                return rc;
-            }
-            if (rc == IX_EOF) {
+            if (!found) {
                 return QL_FOREIGNKEYNOTEXIST;
             }
-            if ((rc = indexScan.CloseScan())) {
-                return rc;
-            }
-            if ((rc = ixManager.CloseIndex(indexHandle))) {
-                return rc;
-            }
         }
         if (iters[i]->primaryKey > 0) {
             ++primaryKeyModifyCount;
@@ -1540,152 +1573,149 @@ RC QL_Manager::Update(const char *relName, int nSetters, const RelAttr updAttrs[
         return rc;
     }
     // 获取被更新的记录集合
-    RM_FileHandle rmFileHandle;
-    if ((rc = rmManager.OpenFile(relName, rmFileHandle))) {
+    RM_FileHandle* rmFileHandle;
+    if ((rc = smManager.GetFileHandle(relName, rmFileHandle))) {
         return rc;
     }
     vector<RID> rids;
-    if ((rc = GetRidSet(relName, rmFileHandle, fullConditions, rids))) {
+    if ((rc = GetRidSet(relName, *rmFileHandle, fullConditions, rids))) {
         return rc;
     }
     if (rids.size() > 1 && primaryKeyModifyCount > 0) {
         return QL_PRIMARYKEYREPEAT;
     }
-    // 更新索引
-    for (int i = 0; i < nSetters; ++i) {
-        if (iters[i]->indexNo != -1) {
-            IX_IndexHandle indexHandle;
-            if ((rc = ixManager.OpenIndex(relName, iters[i]->indexNo, indexHandle))) {
+    // 更新索引：键或包含的属性值改变的项，删除原项后按新记录插入
+    vector<char> newData(relCat.tupleLength);
+    vector<char> oldEntry;
+    vector<char> newEntry;
+    for (auto attr = attrs.begin(); attr != attrs.end(); ++attr) {
+        if (attr->indexNo == -1) {
+            continue;
+        }
+        IX_IndexHandle* indexHandle;
+        if ((rc = smManager.GetIndexHandle(relName, attr->indexNo, indexHandle))) {
+            return rc;
+        }
+        IX_IndexHandle* nullHandle;
+        if ((rc = smManager.GetIndexHandle(relName, attr->indexNo + 1, nullHandle))) {
+            return rc;
+        }
+        // 未被更新且不包含其他属性的索引不受影响
+        bool isSet = false;
+        for (int i = 0; i < nSetters; ++i) {
+            isSet = isSet || iters[i] == attr;
+        }
+        if (!isSet && indexHandle->GetIncludeLength() == 0) {
+            continue;
+        }
+        for (const auto& rid : rids) {
+            RM_Record record;
+            if ((rc = rmFileHandle->GetRec(rid, record))) {
                 return rc;
             }
-            IX_IndexHandle nullHandle;
-            if ((rc = ixManager.OpenIndex(relName, iters[i]->indexNo + 1, nullHandle))) {
+            char *recordData;
+            if ((rc = record.GetData(recordData))) {
                 return rc;
             }
-            for (const auto& rid : rids) {
-                RM_Record record;
-                if ((rc = rmFileHandle.GetRec(rid, record))) {
+            memcpy(newData.data(), recordData, relCat.tupleLength);
+            for (int i = 0; i < nSetters; ++i) {
+                memcpy(&newData[iters[i]->offset], rhsValues[i].data, iters[i]->attrLength + 1);
+            }
+            char *oldValue = recordData + attr->offset;
+            char *newValue = &newData[attr->offset];
+            GetIndexEntry(*indexHandle, *attr, recordData, oldEntry);
+            GetIndexEntry(*indexHandle, *attr, newData.data(), newEntry);
+            if (Attr::CompareAttr(attr->attrType, attr->attrLength, oldValue, EQ_OP, newValue) &&
+                equal(oldEntry.begin() + attr->attrLength + 1, oldEntry.end(), newEntry.begin() + attr->attrLength + 1)) {
+                continue;
+            }
+            if (*oldValue == 0) {
+                if ((rc = nullHandle->DeleteEntry(oldValue, rid))) {
                     return rc;
                 }
-                char *recordData;
-                if ((rc = record.GetData(recordData))) {
+                LogUndo(QL_UndoRecord::IX_DELETE, relName, attr->indexNo + 1, rid, oldEntry.data(), oldEntry.size());
+            } else {
+                if ((rc = indexHandle->DeleteEntry(oldValue, rid))) {
                     return rc;
                 }
-                if (Attr::CompareAttr(iters[i]->attrType, iters[i]->attrLength, recordData + iters[i]->offset, EQ_OP, rhsValues[i].data)) {
-                    continue;
-                }
-                if (iters[i]->primaryKey > 0) {
-                    IX_IndexScan indexScan;
-                    if ((rc = indexScan.OpenScan(indexHandle, EQ_OP, rhsValues[i].data))) {
-                        return rc;
-                    }
-                    RID r;
-                    if ((rc = indexScan.GetNextEntry(r)) && rc != IX_EOF) {
-                        return rc;
-                    }
-                    if (rc != IX_EOF) {
-                        return QL_PRIMARYKEYREPEAT;
-                    }
-                    if ((rc = indexScan.CloseScan())) {
-                        return rc;
-                    }
+                LogUndo(QL_UndoRecord::IX_DELETE, relName, attr->indexNo, rid, oldEntry.data(), oldEntry.size());
+            }
+            char *include = &newEntry[attr->attrLength + 1];
+            if (*newValue == 0) {
+                if ((rc = nullHandle->InsertEntry(newValue, rid, include))) {
+                    return rc;
                 }
-                if (*(char*)(recordData + iters[i]->offset) == 0) {
-                    if ((rc = nullHandle.DeleteEntry(recordData + iters[i]->offset, rid))) {
-                        return rc;
-                    }
-                } else {
-                    if ((rc = indexHandle.DeleteEntry(recordData + iters[i]->offset, rid))) {
-                        return rc;
-                    }
+                LogUndo(QL_UndoRecord::IX_INSERT, relName, attr->indexNo + 1, rid, newValue, attr->attrLength + 1);
+            } else {
+                // 主键插入索引的同时判断是否重复，如果重复，报错
+                rc = attr->primaryKey > 0 ? indexHandle->InsertUnique(newValue, rid, include) : indexHandle->InsertEntry(newValue, rid, include);
+                if (rc == IX_DUPLICATEKEY) {
+                    delete[] iters;
+                    return QL_PRIMARYKEYREPEAT;
                 }
-                if (*(char*)(rhsValues[i].data) == 0) {
-                    if ((rc = nullHandle.InsertEntry(rhsValues[i].data, rid))) {
-                        return rc;
-                    }
-                } else {
-                    if ((rc = indexHandle.InsertEntry(rhsValues[i].data, rid))) {
-                        return rc;
-                    }
+                if (rc) {
+                    return rc;
                 }
-            }
-            if ((rc = ixManager.CloseIndex(indexHandle))) {
-                return rc;
+                LogUndo(QL_UndoRecord::IX_INSERT, relName, attr->indexNo, rid, newValue, attr->attrLength + 1);
             }
         }
     }
     // 如果有多重主键并被影响的话，更新多重主键
-    char *key;
-    IX_IndexHandle primaryHandle;
+    char *key = NULL;
+    IX_IndexHandle* primaryHandle = NULL;
     if (primaryKeyCount > 1 && primaryKeyModifyCount > 0) {
-        if ((rc = ixManager.OpenIndex(relName, 0, primaryHandle))) {
+        if ((rc = smManager.GetIndexHandle(relName, 0, primaryHandle))) {
             return rc;
         }
-        key = new char[primaryKeyTupleLength];
+        key = new char[primaryKeyTupleLength + primaryKeyCount + 1];
     }
     // 更新记录文件
     for (const auto &rid : rids) {
         RM_Record record;
-        if ((rc = rmFileHandle.GetRec(rid, record))) {
+        if ((rc = rmFileHandle->GetRec(rid, record))) {
             return rc;
         }
         char *recordData;
         if ((rc = record.GetData(recordData))) {
             return rc;
         }
+        // 保留原记录以便回滚
+        vector<char> oldData(recordData, recordData + relCat.tupleLength);
         // 删除原有多重主键
         if (primaryKeyCount > 1 && primaryKeyModifyCount > 0) {
-            // !!!
-            memset(key, 0, primaryKeyTupleLength);
-            // 构造
-            int offset = 0;
-            for (int i = 1; i <= primaryKeyCount; ++i) {
-                for (int j = 0; j < attrs.size(); ++j) {
-                    if (attrs[j].primaryKey == i) {
-                        memcpy(key + offset, recordData + attrs[j].offset, attrs[j].attrLength + 1);
-                        offset += attrs[j].attrLength + 1;
-                        break;
-                    }
-                }
-            }
-            if ((rc = primaryHandle.DeleteEntry(key, RID(0, 0)))) {
+            GetPrimaryKey(attrs, primaryKeyCount, recordData, key);
+            if ((rc = primaryHandle->DeleteEntry(key, RID(0, 0)))) {
                 return rc;
             }
+            LogUndo(QL_UndoRecord::IX_DELETE, relName, 0, RID(0, 0), key, primaryKeyTupleLength + primaryKeyCount + 1);
         }
         for (int i = 0; i < nSetters; ++i) {
             memcpy(recordData + iters[i]->offset, rhsValues[i].data, iters[i]->attrLength + 1);
         }
         // 插入多重主键
         if (primaryKeyCount > 1 && primaryKeyModifyCount > 0) {
-            // !!!
-            memset(key, 0, primaryKeyTupleLength);
-            // 构造
-            int offset = 0;
-            for (int i = 1; i <= primaryKeyCount; ++i) {
-                for (int j = 0; j < attrs.size(); ++j) {
-                    if (attrs[j].primaryKey == i) {
-                        memcpy(key + offset, recordData + attrs[j].offset, attrs[j].attrLength + 1);
-                        offset += attrs[j].attrLength + 1;
-                        break;
-                    }
+            GetPrimaryKey(attrs, primaryKeyCount, recordData, key);
+            // 不重复则插入，如果重复，报错
+            if ((rc = primaryHandle->InsertUnique(key, RID(0, 0)))) {
+                if (rc != IX_DUPLICATEKEY) {
+                    return rc;
                 }
+                delete[] key;
+                delete[] iters;
+                return QL_PRIMARYKEYREPEAT;
             }
-            if ((rc = primaryHandle.InsertEntry(key, RID(0, 0)))) {
-                return rc;
-            }
+            LogUndo(QL_UndoRecord::IX_INSERT, relName, 0, RID(0, 0), key, primaryKeyTupleLength + primaryKeyCount + 1);
         }
-        if ((rc = rmFileHandle.UpdateRec(record))) {
+        if ((rc = UpdateMultiEntries(relName, oldData.data(), recordData, rid))) {
             return rc;
         }
-    }
-    if (primaryKeyCount > 1 && primaryKeyModifyCount > 0) {
-        delete[] key;
-        if ((rc = ixManager.CloseIndex(primaryHandle))) {
+        if ((rc = rmFileHandle->UpdateRec(record))) {
             return rc;
         }
+        LogUndo(QL_UndoRecord::RM_UPDATE, relName, -1, rid, oldData.data(), relCat.tupleLength);
     }
-    if ((rc = rmManager.CloseFile(rmFileHandle))) {
-        return rc;
+    if (primaryKeyCount > 1 && primaryKeyModifyCount > 0) {
+        delete[] key;
     }
     delete[] iters;
     
@@ -1710,35 +1740,526 @@ RC QL_Manager::Update(const char *relName, int nSetters, const RelAttr updAttrs[
 }
 
 //
-// 检查数据库是否被打开
+// LOAD DATA 过程中保持打开的记录文件、索引与当前批次的记录
 //
-RC QL_Manager::CheckSMManagerIsOpen() {
-    if (!smManager.isOpen) {
-        return QL_DBNOTOPEN;
-    }
-    return OK_RC;
-}
+struct QL_LoadContext {
+    const char* relName;
+    RelCat relCat;
+    vector<AttrCat> attrs;
+    int primaryKeyCount;
+    int primaryKeyTupleLength;
+    RM_FileHandle* fileHandle;
+    vector<IX_IndexHandle*> indexHandles;    // 按索引号，未使用的为 NULL
+    vector<IX_IndexHandle*> refIndexHandles; // 按属性，外键所引用的索引，无外键为 NULL
+    vector<int> multiIndexNos;               // 多列索引的索引号
+    vector<char> tuples;                     // 当前批次的记录
+    vector<int> lines;                       // 当前批次各记录所在行
+    int nTuples;
+    long nLoaded;
+};
 
 //
-// 检查数据表是否存在，如果存在，提取数据表信息
+// 从 CSV 文件中读取一条记录：逗号分隔，双引号内可包含逗号、换行与转义的 ""，
+// quoted 标记字段是否带引号；空行被跳过，文件结束时 eof 为真
 //
-RC QL_Manager::CheckRelCat(const char* relName, RelCat& relCat) {
-    RC rc;
-    RM_Record relCatRec;
-    // 检查数据表是否存在
-    if ((rc = smManager.CheckRelExist(relName, relCatRec))) {
-        return rc;
-    }
-    // 获取数据表数据
-    char* relCatData;
-    if ((rc = relCatRec.GetData(relCatData))) {
-        return rc;
-    }
-    // 格式化数据表数据
-    relCat = RelCat(relCatData);
+static RC ReadCSVRecord(FILE* file, vector<string>& fields, vector<bool>& quoted, int& lineNo, bool& eof) {
+    fields.clear();
+    quoted.clear();
+    eof = false;
+    int c = getc(file);
+    // 跳过空行
+    while (c == '\n' || c == '\r') {
+        if (c == '\n') {
+            ++lineNo;
+        }
+        c = getc(file);
+    }
+    if (c == EOF) {
+        eof = true;
+        return OK_RC;
+    }
+    ++lineNo;
+    while (true) {
+        string field;
+        bool isQuoted = c == '"';
+        if (isQuoted) {
+            while (true) {
+                c = getc(file);
+                if (c == EOF) {
+                    return QL_CSVFORMATERROR;
+                }
+                if (c == '"') {
+                    c = getc(file);
+                    if (c != '"') {
+                        break;
+                    }
+                } else if (c == '\n') {
+                    ++lineNo;
+                }
+                field += (char)c;
+            }
+            if (c == '\r') {
+                c = getc(file);
+            }
+            if (c != ',' && c != '\n' && c != EOF) {
+                return QL_CSVFORMATERROR;
+            }
+        } else {
+            while (c != ',' && c != '\n' && c != EOF) {
+                if (c == '"') {
+                    return QL_CSVFORMATERROR;
+                }
+                field += (char)c;
+                c = getc(file);
+            }
+            if (!field.empty() && field[field.size() - 1] == '\r') {
+                field.erase(field.size() - 1);
+            }
+        }
+        fields.push_back(field);
+        quoted.push_back(isQuoted);
+        if (c != ',') {
+            break;
+        }
+        c = getc(file);
+    }
+    return OK_RC;
+}
+
+//
+// 将 CSV 字段转化为记录中的属性值（首字节为空标记）。不带引号的空字段或 NULL 为空值
+//
+static RC ParseCSVField(const string& field, bool quoted, const AttrCat& attr, char* data) {
+    memset(data, 0, attr.attrLength + 1);
+    if (!quoted && (field.empty() || strcasecmp(field.c_str(), "null") == 0)) {
+        return attr.isNotNull ? QL_ATTRISNULL : OK_RC;
+    }
+    *data = 1;
+    const char* text = field.c_str();
+    char* end;
+    errno = 0;
+    switch (attr.attrType) {
+        case INT: {
+            long value = strtol(text, &end, 10);
+            if (end == text || *end != 0 || errno == ERANGE || value < INT_MIN || value > INT_MAX) {
+                return QL_ATTRTYPEWRONG;
+            }
+            *(int*)(data + 1) = (int)value;
+            break;
+        }
+        case FLOAT: {
+            float value = strtof(text, &end);
+            if (end == text || *end != 0 || errno == ERANGE) {
+                return QL_ATTRTYPEWRONG;
+            }
+            *(float*)(data + 1) = value;
+            break;
+        }
+        case DATE: {
+            int day;
+            if (!Attr::ParseDate(text, day)) {
+                return QL_DATEFORMATERROR;
+            }
+            *(int*)(data + 1) = day;
+            break;
+        }
+        default:
+            if ((int)field.size() >= attr.attrLength || strlen(text) != field.size()) {
+                return QL_STRINGLENGTHWRONG;
+            }
+            strcpy(data + 1, text);
+            break;
+    }
+    return OK_RC;
+}
+
+//
+// Load the tuples of a CSV file into relName.  The file is read as a
+// stream; every QL_LOADBATCHSIZE tuples the constraints of the batch are
+// checked together, the tuples are appended page by page and the index
+// entries are inserted in key order.
+//
+RC QL_Manager::Load(const char *relName, const char *fileName) {
+    RC rc;
+    // 检查数据库是否打开
+    if ((rc = CheckSMManagerIsOpen())) {
+        return rc;
+    }
+    // 检查数据表是否存在，只读取一次数据表与属性信息
+    QL_LoadContext ctx;
+    ctx.relName = relName;
+    if ((rc = CheckRelCat(relName, ctx.relCat))) {
+        return rc;
+    }
+    if ((rc = smManager.GetAttrs(relName, ctx.attrs))) {
+        return rc;
+    }
+    const vector<AttrCat>& attrs = ctx.attrs;
+    ctx.primaryKeyCount = 0;
+    ctx.primaryKeyTupleLength = 0;
+    for (const auto& attr: attrs) {
+        if (attr.primaryKey > 0) {
+            ctx.primaryKeyTupleLength += attr.attrLength;
+            if (attr.primaryKey > ctx.primaryKeyCount)
+                ctx.primaryKeyCount = attr.primaryKey;
+        }
+    }
+    ctx.nTuples = 0;
+    ctx.nLoaded = 0;
+    FILE* file = fopen(fileName, "r");
+    if (file == NULL) {
+        return QL_LOADFILEERROR;
+    }
+    // 取得记录文件、全部索引与外键引用的索引
+    ctx.indexHandles.assign(ctx.relCat.indexCount, NULL);
+    ctx.refIndexHandles.assign(attrs.size(), NULL);
+    rc = smManager.GetFileHandle(relName, ctx.fileHandle);
+    if (!rc && ctx.primaryKeyCount > 1) {
+        rc = smManager.GetIndexHandle(relName, 0, ctx.indexHandles[0]);
+    }
+    if (!rc) {
+        rc = smManager.GetMultiIndexes(relName, ctx.multiIndexNos);
+    }
+    for (size_t i = 0; !rc && i < ctx.multiIndexNos.size(); ++i) {
+        rc = smManager.GetIndexHandle(relName, ctx.multiIndexNos[i], ctx.indexHandles[ctx.multiIndexNos[i]]);
+    }
+    for (size_t i = 0; !rc && i < attrs.size(); ++i) {
+        if (attrs[i].indexNo != -1) {
+            for (int indexNo = attrs[i].indexNo; !rc && indexNo <= attrs[i].indexNo + 1; ++indexNo) {
+                rc = smManager.GetIndexHandle(relName, indexNo, ctx.indexHandles[indexNo]);
+            }
+        }
+        if (!rc && attrs[i].refrel[0] != 0) {
+            AttrCat refAttr;
+            if ((rc = smManager.GetAttr(attrs[i].refrel, attrs[i].refattr, refAttr))) {
+                break;
+            }
+            rc = smManager.GetIndexHandle(attrs[i].refrel, refAttr.indexNo, ctx.refIndexHandles[i]);
+        }
+    }
+    // 逐条读取记录，攒满一批后统一检查与写入
+    vector<char> buffer(1 << 16);
+    setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+    int lineNo = 0;
+    vector<string> fields;
+    vector<bool> quoted;
+    ctx.tuples.resize((size_t)QL_LOADBATCHSIZE * ctx.relCat.tupleLength);
+    while (!rc) {
+        bool eof;
+        if ((rc = ReadCSVRecord(file, fields, quoted, lineNo, eof))) {
+            cerr << "[Load] line " << lineNo << endl;
+            break;
+        }
+        if (!eof) {
+            if (fields.size() != attrs.size()) {
+                cerr << "[Load] line " << lineNo << endl;
+                rc = QL_ATTRSNUMBERWRONG;
+                break;
+            }
+            char* tuple = &ctx.tuples[(size_t)ctx.nTuples * ctx.relCat.tupleLength];
+            memset(tuple, 0, ctx.relCat.tupleLength);
+            for (size_t i = 0; !rc && i < attrs.size(); ++i) {
+                rc = ParseCSVField(fields[i], quoted[i], attrs[i], tuple + attrs[i].offset);
+            }
+            if (rc) {
+                cerr << "[Load] line " << lineNo << endl;
+                break;
+            }
+            ctx.lines.push_back(lineNo);
+            ++ctx.nTuples;
+        }
+        if (ctx.nTuples == QL_LOADBATCHSIZE || (eof && ctx.nTuples > 0)) {
+            rc = LoadBatch(ctx);
+        }
+        if (eof) {
+            break;
+        }
+    }
+    fclose(file);
+    if (rc) {
+        return rc;
+    }
+    cout << ctx.nLoaded << " tuple(s) loaded." << endl;
     return OK_RC;
 }
 
+//
+// LOAD DATA：批量检查一批记录的约束，再将其追加到记录文件并按序插入各索引
+//
+RC QL_Manager::LoadBatch(QL_LoadContext& ctx) {
+    RC rc;
+    const vector<AttrCat>& attrs = ctx.attrs;
+    int tupleLength = ctx.relCat.tupleLength;
+    int n = ctx.nTuples;
+    char* base = ctx.tuples.data();
+    vector<int> order(n);
+    // 外键：按值排序，每个不同的非空值只在被引用的索引中查找一次
+    for (size_t i = 0; i < attrs.size(); ++i) {
+        if (ctx.refIndexHandles[i] == NULL) {
+            continue;
+        }
+        const AttrCat& attr = attrs[i];
+        order.clear();
+        for (int j = 0; j < n; ++j) {
+            if (base[j * tupleLength + attr.offset] != 0) {
+                order.push_back(j);
+            }
+        }
+        sort(order.begin(), order.end(), [&](int a, int b) {
+            return Attr::CompareAttr(attr.attrType, attr.attrLength, base + a * tupleLength + attr.offset, LT_OP, base + b * tupleLength + attr.offset);
+        });
+        for (size_t j = 0; j < order.size(); ++j) {
+            char* value = base + order[j] * tupleLength + attr.offset;
+            if (j > 0 && Attr::CompareAttr(attr.attrType, attr.attrLength, base + order[j - 1] * tupleLength + attr.offset, EQ_OP, value)) {
+                continue;
+            }
+            bool found;
+            if ((rc = IndexContains(*ctx.refIndexHandles[i], value, found))) {
+                return rc;
+            }
+            if (!found) {
+                cerr << "[Load] line " << ctx.lines[order[j]] << endl;
+                return QL_FOREIGNKEYNOTEXIST;
+            }
+        }
+    }
+    // 主键：构造主键值，批内排序查重，再按序在主键索引中查找
+    vector<char> keys;
+    int keyLength = 0;
+    AttrType keyType = STRING;
+    int keyAttrLength = 0;
+    int keyIndexNo = 0;
+    if (ctx.primaryKeyCount == 1) {
+        for (const auto& attr: attrs) {
+            if (attr.primaryKey == 1) {
+                keyType = attr.attrType;
+                keyAttrLength = attr.attrLength;
+                keyIndexNo = attr.indexNo;
+                keyLength = attr.attrLength + 1;
+                keys.resize((size_t)n * keyLength);
+                for (int j = 0; j < n; ++j) {
+                    memcpy(&keys[j * keyLength], base + j * tupleLength + attr.offset, keyLength);
+                }
+            }
+        }
+    } else if (ctx.primaryKeyCount > 1) {
+        keyType = PRIMARYKEY;
+        keyAttrLength = ctx.primaryKeyTupleLength + ctx.primaryKeyCount;
+        keyLength = keyAttrLength + 1;
+        keys.resize((size_t)n * keyLength);
+        for (int j = 0; j < n; ++j) {
+            GetPrimaryKey(attrs, ctx.primaryKeyCount, base + j * tupleLength, &keys[j * keyLength]);
+        }
+    }
+    if (ctx.primaryKeyCount > 0) {
+        order.resize(n);
+        for (int j = 0; j < n; ++j) {
+            order[j] = j;
+        }
+        sort(order.begin(), order.end(), [&](int a, int b) {
+            return Attr::CompareAttr(keyType, keyAttrLength, &keys[a * keyLength], LT_OP, &keys[b * keyLength]);
+        });
+        for (int j = 0; j < n; ++j) {
+            char* key = &keys[order[j] * keyLength];
+            if (j > 0 && Attr::CompareAttr(keyType, keyAttrLength, &keys[order[j - 1] * keyLength], EQ_OP, key)) {
+                cerr << "[Load] line " << ctx.lines[order[j]] << endl;
+                return QL_PRIMARYKEYREPEAT;
+            }
+            bool found;
+            if ((rc = IndexContains(*ctx.indexHandles[keyIndexNo], key, found))) {
+                return rc;
+            }
+            if (found) {
+                cerr << "[Load] line " << ctx.lines[order[j]] << endl;
+                return QL_PRIMARYKEYREPEAT;
+            }
+        }
+    }
+    // 整批追加到记录文件，逐页填满空闲槽
+    vector<RID> rids(n);
+    if ((rc = ctx.fileHandle->InsertRecs(base, n, rids.data()))) {
+        return rc;
+    }
+    for (int j = 0; j < n; ++j) {
+        LogUndo(QL_UndoRecord::RM_INSERT, ctx.relName, -1, rids[j]);
+    }
+    // 多重主键索引：按键序插入
+    if (ctx.primaryKeyCount > 1) {
+        for (int j = 0; j < n; ++j) {
+            char* key = &keys[order[j] * keyLength];
+            if ((rc = ctx.indexHandles[0]->InsertEntry(key, RID(0, 0)))) {
+                return rc;
+            }
+            LogUndo(QL_UndoRecord::IX_INSERT, ctx.relName, 0, RID(0, 0), key, ctx.primaryKeyTupleLength + ctx.primaryKeyCount + 1);
+        }
+    }
+    // 属性索引：按 (键, RID) 排序后插入，相邻的插入落在相同的叶节点上
+    for (const auto& attr: attrs) {
+        if (attr.indexNo == -1) {
+            continue;
+        }
+        order.resize(n);
+        for (int j = 0; j < n; ++j) {
+            order[j] = j;
+        }
+        sort(order.begin(), order.end(), [&](int a, int b) {
+            char* valueA = base + a * tupleLength + attr.offset;
+            char* valueB = base + b * tupleLength + attr.offset;
+            if (*valueA != *valueB) {
+                return *valueA < *valueB;
+            }
+            if (Attr::CompareAttr(attr.attrType, attr.attrLength, valueA, LT_OP, valueB)) {
+                return true;
+            }
+            if (Attr::CompareAttr(attr.attrType, attr.attrLength, valueB, LT_OP, valueA)) {
+                return false;
+            }
+            return rids[a] < rids[b];
+        });
+        vector<char> include(ctx.indexHandles[attr.indexNo]->GetIncludeLength() + 1);
+        for (int j = 0; j < n; ++j) {
+            char* value = base + order[j] * tupleLength + attr.offset;
+            // 按照是否为空插入不同的索引中
+            int indexNo = *value == 0 ? attr.indexNo + 1 : attr.indexNo;
+            ctx.indexHandles[indexNo]->GetInclude(base + order[j] * tupleLength, include.data());
+            if ((rc = ctx.indexHandles[indexNo]->InsertEntry(value, rids[order[j]], include.data()))) {
+                return rc;
+            }
+            LogUndo(QL_UndoRecord::IX_INSERT, ctx.relName, indexNo, rids[order[j]], value, attr.attrLength + 1);
+        }
+    }
+    // 多列索引：同样按 (键, RID) 排序后插入
+    for (int indexNo : ctx.multiIndexNos) {
+        IX_IndexHandle* indexHandle = ctx.indexHandles[indexNo];
+        int multiKeyLength = indexHandle->GetKeyLength();
+        vector<char> multiKeys((size_t)n * multiKeyLength);
+        order.resize(n);
+        for (int j = 0; j < n; ++j) {
+            indexHandle->GetKey(base + j * tupleLength, &multiKeys[j * multiKeyLength]);
+            order[j] = j;
+        }
+        sort(order.begin(), order.end(), [&](int a, int b) {
+            int cmp = memcmp(&multiKeys[a * multiKeyLength], &multiKeys[b * multiKeyLength], multiKeyLength);
+            return cmp != 0 ? cmp < 0 : rids[a] < rids[b];
+        });
+        vector<char> include(indexHandle->GetIncludeLength() + 1);
+        for (int j = 0; j < n; ++j) {
+            char* key = &multiKeys[order[j] * multiKeyLength];
+            indexHandle->GetInclude(base + order[j] * tupleLength, include.data());
+            if ((rc = indexHandle->InsertEntry(key, rids[order[j]], include.data()))) {
+                return rc;
+            }
+            LogUndo(QL_UndoRecord::IX_INSERT, ctx.relName, indexNo, rids[order[j]], key, multiKeyLength);
+        }
+    }
+    ctx.nLoaded += n;
+    ctx.nTuples = 0;
+    ctx.lines.clear();
+    return OK_RC;
+}
+
+//
+// Start a transaction: the following statements are undone together by
+// Rollback, or kept by Commit
+//
+RC QL_Manager::Begin() {
+    RC rc;
+    // 检查数据库是否打开
+    if ((rc = CheckSMManagerIsOpen())) {
+        return rc;
+    }
+    if (inTransaction) {
+        return QL_TRANSACTIONOPEN;
+    }
+    inTransaction = true;
+    undoLog.clear();
+    return OK_RC;
+}
+
+//
+// Commit the transaction: its changes are already in the files, which are
+// forced now, and the undo log is dropped
+//
+RC QL_Manager::Commit() {
+    RC rc;
+    if (!inTransaction) {
+        return QL_NOTRANSACTION;
+    }
+    inTransaction = false;
+    undoLog.clear();
+    if ((rc = smManager.ReleaseHandles())) {
+        return rc;
+    }
+    return OK_RC;
+}
+
+//
+// Undo every change of the transaction
+//
+RC QL_Manager::Rollback() {
+    RC rc;
+    if (!inTransaction) {
+        return QL_NOTRANSACTION;
+    }
+    inTransaction = false;
+    if ((rc = RollbackTo(0))) {
+        return rc;
+    }
+    if ((rc = smManager.ReleaseHandles())) {
+        return rc;
+    }
+    return OK_RC;
+}
+
+//
+// Mark the start of a DML statement
+//
+RC QL_Manager::BeginStatement() {
+    statementStart = undoLog.size();
+    return OK_RC;
+}
+
+//
+// Finish a DML statement: if it failed, undo its partial changes; outside
+// of a transaction the statement commits on its own.  The files stay open
+// in the handle cache, their modified pages are forced here, or by Commit
+// inside a transaction.  The undo log is only in memory: a crash during a
+// transaction keeps the changes whose pages were written out before it,
+// by the buffer pool or by closing a file of the handle cache.
+//
+RC QL_Manager::EndStatement(RC rc) {
+    RC undoRc;
+    if (rc && (undoRc = RollbackTo(statementStart))) {
+        return undoRc;
+    }
+    if (!inTransaction) {
+        undoLog.clear();
+    }
+    RC releaseRc;
+    if ((releaseRc = smManager.ReleaseHandles(!inTransaction)) && !rc) {
+        return releaseRc;
+    }
+    return rc;
+}
+
+//
+// 检查数据库是否被打开
+//
+RC QL_Manager::CheckSMManagerIsOpen() {
+    if (!smManager.isOpen) {
+        return QL_DBNOTOPEN;
+    }
+    return OK_RC;
+}
+
+//
+// 检查数据表是否存在，如果存在，提取数据表信息
+//
+RC QL_Manager::CheckRelCat(const char* relName, RelCat& relCat) {
+    // 从目录缓存中获取数据表信息
+    return smManager.GetRelCat(relName, relCat);
+}
+
 //
 // 检查数据表是否存在，如果存在，提取数据表信息（并不提取属性信息，属性值为空）
 //
@@ -1849,6 +2370,7 @@ RC QL_Manager::CheckAttrCats(const RelAttr& relAttr, const std::map<RelCat, std:
 // 将原始单表限定条件（delete 与 update 的 where 字句）集合补充为完整单表限制条件集合
 //
 RC QL_Manager::GetFullConditions(const char* relName, const vector<AttrCat>& attrs, int nConditions, Condition conditions[], vector<FullCondition>& fullConditions) {
+    RC rc;
     // 遍历每一个原始条件
     for (int i = 0; i < nConditions; ++i) {
         // 在完整属性集合中查找条件中左属性名是否存在
@@ -1886,26 +2408,8 @@ RC QL_Manager::GetFullConditions(const char* relName, const vector<AttrCat>& att
                 *(float*)((char*)conditions[i].rhsValue.data + 1) = *(int*)((char*)conditions[i].rhsValue.data + 1);
             }
             // 判断日期类型是否合法
-            if (iter->attrType == DATE && conditions[i].rhsValue.type == STRING) {
-                conditions[i].rhsValue.type = DATE;
-                if (strlen((char*)conditions[i].rhsValue.data + 1) != 10) {
-                    return QL_DATEFORMATERROR;
-                }
-                for (int j = 1; j <= 10; ++j) {
-                    char c = *((char*)conditions[i].rhsValue.data + j);
-                    if (j == 5 || j == 8) {
-                        if (c != '-') return QL_DATEFORMATERROR;
-                    } else {
-                        if (c < '0' || c > '9') return QL_DATEFORMATERROR;
-                    }
-                }
-                int yyyy, mm, dd;
-                sscanf((char*)conditions[i].rhsValue.data + 1, "%d-%d-%d", &yyyy, &mm, &dd);
-                if (dd < 1 || mm < 1 || mm > 12) return QL_DATEFORMATERROR;
-                int end2 = yyyy % 4 == 0 && yyyy % 100 != 0 || yyyy % 400 == 0 ? 29 : 28;            
-                if (mm == 2 && dd > end2) return QL_DATEFORMATERROR;
-                if ((mm == 1 || mm == 3 || mm == 5 || mm == 7 || mm == 8 || mm == 10 || mm == 12) && dd > 31) return QL_DATEFORMATERROR;
-                if ((mm == 4 || mm == 6 || mm == 9 || mm == 11) && dd > 30) return QL_DATEFORMATERROR;
+            if (iter->attrType == DATE && conditions[i].rhsValue.type == STRING && (rc = ConvertDate(conditions[i].rhsValue))) {
+                return rc;
             }
             // 类型不一致，报错
             if (iter->attrType != conditions[i].rhsValue.type) {
@@ -1948,26 +2452,8 @@ RC QL_Manager::GetFullCondition(Condition& condition, const std::map<RelCat, std
             *(float*)((char*)condition.rhsValue.data + 1) = *(int*)((char*)condition.rhsValue.data + 1);
         }
         // 判断日期类型是否合法
-        if (attrCat.attrType == DATE && condition.rhsValue.type == STRING) {
-            condition.rhsValue.type = DATE;
-            if (strlen((char*)condition.rhsValue.data + 1) != 10) {
-                return QL_DATEFORMATERROR;
-            }
-            for (int j = 1; j <= 10; ++j) {
-                char c = *((char*)condition.rhsValue.data + j);
-                if (j == 5 || j == 8) {
-                    if (c != '-') return QL_DATEFORMATERROR;
-                } else {
-                    if (c < '0' || c > '9') return QL_DATEFORMATERROR;
-                }
-            }
-            int yyyy, mm, dd;
-            sscanf((char*)condition.rhsValue.data + 1, "%d-%d-%d", &yyyy, &mm, &dd);
-            if (dd < 1 || mm < 1 || mm > 12) return QL_DATEFORMATERROR;
-            int end2 = yyyy % 4 == 0 && yyyy % 100 != 0 || yyyy % 400 == 0 ? 29 : 28;            
-            if (mm == 2 && dd > end2) return QL_DATEFORMATERROR;
-            if ((mm == 1 || mm == 3 || mm == 5 || mm == 7 || mm == 8 || mm == 10 || mm == 12) && dd > 31) return QL_DATEFORMATERROR;
-            if ((mm == 4 || mm == 6 || mm == 9 || mm == 11) && dd > 30) return QL_DATEFORMATERROR;
+        if (attrCat.attrType == DATE && condition.rhsValue.type == STRING && (rc = ConvertDate(condition.rhsValue))) {
+            return rc;
         }
         // 类型不一致，报错
         if (attrCat.attrType != condition.rhsValue.type) {
@@ -2071,16 +2557,13 @@ int ToLevel(CompOp op) {
 //
 RC QL_Manager::GetRidSet(const char* relName, RM_FileHandle& rmFileHandle, const std::vector<FullCondition>& fullConditions, std::vector<RID>& rids) {
     RC rc;
-    // 查找出带有索引的属性值
-    int index = -1;
-    int indexLevel = 2;
-    for (unsigned int i = 0; i < fullConditions.size(); ++i) {
-        if (fullConditions[i].lhsAttr.indexNo >= 0 && fullConditions[i].bRhsIsAttr == 0 && ToLevel(fullConditions[i].op) < indexLevel) {
-            index = i;
-            indexLevel = ToLevel(fullConditions[i].op);
-        }
+    // 由索引得到按 RID 排序的候选集合
+    vector<RID> candidates;
+    bool isUsed;
+    if ((rc = GetIndexRids(relName, fullConditions, candidates, isUsed))) {
+        return rc;
     }
-    if (index == -1) {
+    if (!isUsed) {
         // 如果没有属性带有索引，使用记录文件暴力扫描
         RM_FileScan rmFileScan;
         if ((rc = rmFileScan.OpenScan(rmFileHandle, fullConditions))) {
@@ -2103,69 +2586,399 @@ RC QL_Manager::GetRidSet(const char* relName, RM_FileHandle& rmFileHandle, const
         if ((rc = rmFileScan.CloseScan())) {
             return rc;
         }
-    } else {
-        // 发现属性带有索引
-        // 先使用索引缩小查找范围，然后确定最终集合
-        int indexNo = *(char*)fullConditions[index].rhsValue.data == 0 ? fullConditions[index].lhsAttr.indexNo + 1 : fullConditions[index].lhsAttr.indexNo;
-        IX_IndexHandle indexHandle;
-        if ((rc = ixManager.OpenIndex(relName, indexNo, indexHandle))) {
+        return OK_RC;
+    }
+    // 按 RID 顺序读取候选记录，同一页上的记录相邻，每页只读入一次
+    for (const auto& rid : candidates) {
+        // 判断该条记录是否满足条件
+        RM_Record record;
+        if ((rc = rmFileHandle.GetRec(rid, record))) {
+            return rc;
+        }
+        char *recordData;
+        if ((rc = record.GetData(recordData))) {
+            return rc;
+        }
+        bool result;
+        if ((rc = CheckFullConditions(recordData, fullConditions, result))) {
+            return rc;
+        }
+        if (result) {
+            rids.push_back(rid);
+        }
+    }
+    return OK_RC;
+}
+
+//
+// 扫描属性索引中满足 op value 的项，将其 RID 排序后放入 rids
+//
+static RC ScanIndexRids(IX_IndexHandle& indexHandle, CompOp op, void* value, vector<RID>& rids) {
+    RC rc;
+    IX_IndexScan indexScan;
+    if ((rc = indexScan.OpenScan(indexHandle, op, value))) {
+        return rc;
+    }
+    while (true) {
+        RID rid;
+        if ((rc = indexScan.GetNextEntry(rid)) && rc != IX_EOF) {
+            return rc;
+        }
+        if (rc == IX_EOF) {
+            break;
+        }
+        rids.push_back(rid);
+    }
+    if ((rc = indexScan.CloseScan())) {
+        return rc;
+    }
+    sort(rids.begin(), rids.end());
+    return OK_RC;
+}
+
+//
+// 由索引得到候选 RID 集合：多列索引匹配两列以上的等值条件，或没有等值条件可用属性索引时，
+// 取多列索引键范围内的项；否则取各属性索引等值条件的 RID 集合之交，候选已足够少时不再扫描其余索引
+//
+RC QL_Manager::GetIndexRids(const char* relName, const std::vector<FullCondition>& fullConditions, std::vector<RID>& rids, bool& isUsed) {
+    RC rc;
+    isUsed = false;
+    rids.clear();
+    // 查找出带有索引的等值条件
+    vector<int> indexConds;
+    for (unsigned int i = 0; i < fullConditions.size(); ++i) {
+        if (fullConditions[i].lhsAttr.indexNo >= 0 && fullConditions[i].bRhsIsAttr == 0 && ToLevel(fullConditions[i].op) == 0) {
+            indexConds.push_back(i);
+        }
+    }
+    int multiIndexNo;
+    int matched;
+    vector<char> lower;
+    vector<char> upper;
+    if ((rc = GetMultiIndexRange(relName, fullConditions, multiIndexNo, matched, lower, upper))) {
+        return rc;
+    }
+    if (matched >= 2 || (indexConds.empty() && matched >= 0)) {
+        isUsed = true;
+        if ((rc = GetMultiIndexRids(relName, multiIndexNo, lower, upper, rids))) {
+            return rc;
+        }
+    }
+    vector<RID> condRids;
+    vector<RID> both;
+    for (unsigned int i = 0; !isUsed && i < indexConds.size(); ++i) {
+        const FullCondition& cond = fullConditions[indexConds[i]];
+        if (i > 0 && rids.size() <= QL_BITMAPMINRIDS) {
+            break;
+        }
+        int indexNo = *(char*)cond.rhsValue.data == 0 ? cond.lhsAttr.indexNo + 1 : cond.lhsAttr.indexNo;
+        IX_IndexHandle* indexHandle;
+        if ((rc = smManager.GetIndexHandle(relName, indexNo, indexHandle))) {
+            return rc;
+        }
+        condRids.clear();
+        if ((rc = ScanIndexRids(*indexHandle, cond.op, cond.rhsValue.data, condRids))) {
+            return rc;
+        }
+        if (i == 0) {
+            rids.swap(condRids);
+            continue;
+        }
+        both.clear();
+        set_intersection(rids.begin(), rids.end(), condRids.begin(), condRids.end(), back_inserter(both));
+        rids.swap(both);
+    }
+    isUsed = isUsed || !indexConds.empty();
+    return OK_RC;
+}
+
+//
+// 选择多列索引：逐列匹配非空的等值条件，其后一列可匹配范围条件；
+// 扫描范围为已匹配列的编码，其余各列下界补 0x00、上界补 0xFF
+//
+RC QL_Manager::GetMultiIndexRange(const char* relName, const std::vector<FullCondition>& fullConditions, int& indexNo, int& matched,
+                                  std::vector<char>& lower, std::vector<char>& upper) {
+    RC rc;
+    indexNo = -1;
+    matched = -1;
+    vector<int> indexNos;
+    if ((rc = smManager.GetMultiIndexes(relName, indexNos))) {
+        return rc;
+    }
+    bool hasRange = false;
+    for (int n : indexNos) {
+        IX_IndexHandle* indexHandle;
+        if ((rc = smManager.GetIndexHandle(relName, n, indexHandle))) {
+            return rc;
+        }
+        vector<IX_KeyField> keyFields = indexHandle->GetKeyFields();
+        vector<char> lowerKey(1, 1);
+        vector<char> upperKey(1, 1);
+        int eqCount = 0;
+        bool isRange = false;
+        for (const auto& field : keyFields) {
+            // 等值条件
+            const FullCondition* eqCond = NULL;
+            for (const auto& cond : fullConditions) {
+                if (cond.lhsAttr.offset == field.offset && cond.bRhsIsAttr == 0 && cond.op == EQ_OP && *(char*)cond.rhsValue.data != 0) {
+                    eqCond = &cond;
+                }
+            }
+            if (eqCond != NULL) {
+                lowerKey.resize(lowerKey.size() + field.length + 1);
+                Attr::EncodeKey(field.attrType, field.length, (char*)eqCond->rhsValue.data, &lowerKey[lowerKey.size() - field.length - 1]);
+                upperKey.insert(upperKey.end(), lowerKey.end() - field.length - 1, lowerKey.end());
+                ++eqCount;
+                continue;
+            }
+            // 范围条件，有范围条件时下界跳过该列的空值
+            size_t pos = lowerKey.size();
+            lowerKey.resize(pos + field.length + 1, 0);
+            upperKey.resize(pos + field.length + 1, (char)0xFF);
+            for (const auto& cond : fullConditions) {
+                if (cond.lhsAttr.offset != field.offset || cond.bRhsIsAttr != 0 || *(char*)cond.rhsValue.data == 0) {
+                    continue;
+                }
+                if (cond.op == GT_OP || cond.op == GE_OP) {
+                    Attr::EncodeKey(field.attrType, field.length, (char*)cond.rhsValue.data, &lowerKey[pos]);
+                    isRange = true;
+                } else if (cond.op == LT_OP || cond.op == LE_OP) {
+                    Attr::EncodeKey(field.attrType, field.length, (char*)cond.rhsValue.data, &upperKey[pos]);
+                    isRange = true;
+                }
+            }
+            if (isRange) {
+                lowerKey[pos] = 1;
+            }
+            break;
+        }
+        if (eqCount == 0 && !isRange) {
+            continue;
+        }
+        // 等值列多者优先，其次为有范围条件者
+        if (eqCount > matched || (eqCount == matched && isRange && !hasRange)) {
+            int keyLength = indexHandle->GetKeyLength();
+            lowerKey.resize(keyLength, 0);
+            upperKey.resize(keyLength, (char)0xFF);
+            indexNo = n;
+            matched = eqCount;
+            hasRange = isRange;
+            lower.swap(lowerKey);
+            upper.swap(upperKey);
+        }
+    }
+    return OK_RC;
+}
+
+//
+// 在多列索引的键范围内扫描，将项的 RID 排序后放入 rids
+//
+RC QL_Manager::GetMultiIndexRids(const char* relName, int indexNo, std::vector<char>& lower, std::vector<char>& upper, std::vector<RID>& rids) {
+    RC rc;
+    IX_IndexHandle* indexHandle;
+    if ((rc = smManager.GetIndexHandle(relName, indexNo, indexHandle))) {
+        return rc;
+    }
+    int keyLength = indexHandle->GetKeyLength();
+    IX_IndexScan indexScan;
+    if ((rc = indexScan.OpenScan(*indexHandle, GE_OP, &lower[0]))) {
+        return rc;
+    }
+    vector<char> key(keyLength);
+    while (true) {
+        RID rid;
+        if ((rc = indexScan.GetNextEntry(rid, &key[0])) && rc != IX_EOF) {
+            return rc;
+        }
+        if (rc == IX_EOF || Attr::CompareAttr(PRIMARYKEY, keyLength - 1, &key[0], GT_OP, &upper[0])) {
+            break;
+        }
+        rids.push_back(rid);
+    }
+    if ((rc = indexScan.CloseScan())) {
+        return rc;
+    }
+    sort(rids.begin(), rids.end());
+    return OK_RC;
+}
+
+//
+// 在各多列索引中插入记录的项
+//
+RC QL_Manager::InsertMultiEntries(const char* relName, const char* recordData, const RID& rid) {
+    RC rc;
+    vector<int> indexNos;
+    if ((rc = smManager.GetMultiIndexes(relName, indexNos))) {
+        return rc;
+    }
+    vector<char> entry;
+    for (int indexNo : indexNos) {
+        IX_IndexHandle* indexHandle;
+        if ((rc = smManager.GetIndexHandle(relName, indexNo, indexHandle))) {
+            return rc;
+        }
+        GetMultiEntry(*indexHandle, recordData, entry);
+        int keyLength = indexHandle->GetKeyLength();
+        if ((rc = indexHandle->InsertEntry(&entry[0], rid, &entry[0] + keyLength))) {
             return rc;
         }
+        LogUndo(QL_UndoRecord::IX_INSERT, relName, indexNo, rid, &entry[0], keyLength);
+    }
+    return OK_RC;
+}
+
+//
+// 从各多列索引中删除记录的项，撤销日志中保存键与包含的属性值
+//
+RC QL_Manager::DeleteMultiEntries(const char* relName, const char* recordData, const RID& rid) {
+    RC rc;
+    vector<int> indexNos;
+    if ((rc = smManager.GetMultiIndexes(relName, indexNos))) {
+        return rc;
+    }
+    vector<char> entry;
+    for (int indexNo : indexNos) {
+        IX_IndexHandle* indexHandle;
+        if ((rc = smManager.GetIndexHandle(relName, indexNo, indexHandle))) {
+            return rc;
+        }
+        GetMultiEntry(*indexHandle, recordData, entry);
+        if ((rc = indexHandle->DeleteEntry(&entry[0], rid))) {
+            return rc;
+        }
+        LogUndo(QL_UndoRecord::IX_DELETE, relName, indexNo, rid, entry.data(), entry.size());
+    }
+    return OK_RC;
+}
+
+//
+// 按新记录更新各多列索引中键或包含的属性值改变的项
+//
+RC QL_Manager::UpdateMultiEntries(const char* relName, const char* oldData, const char* newData, const RID& rid) {
+    RC rc;
+    vector<int> indexNos;
+    if ((rc = smManager.GetMultiIndexes(relName, indexNos))) {
+        return rc;
+    }
+    vector<char> oldEntry;
+    vector<char> newEntry;
+    for (int indexNo : indexNos) {
+        IX_IndexHandle* indexHandle;
+        if ((rc = smManager.GetIndexHandle(relName, indexNo, indexHandle))) {
+            return rc;
+        }
+        GetMultiEntry(*indexHandle, oldData, oldEntry);
+        GetMultiEntry(*indexHandle, newData, newEntry);
+        if (oldEntry == newEntry) {
+            continue;
+        }
+        int keyLength = indexHandle->GetKeyLength();
+        if ((rc = indexHandle->DeleteEntry(&oldEntry[0], rid))) {
+            return rc;
+        }
+        LogUndo(QL_UndoRecord::IX_DELETE, relName, indexNo, rid, oldEntry.data(), oldEntry.size());
+        if ((rc = indexHandle->InsertEntry(&newEntry[0], rid, &newEntry[0] + keyLength))) {
+            return rc;
+        }
+        LogUndo(QL_UndoRecord::IX_INSERT, relName, indexNo, rid, &newEntry[0], keyLength);
+    }
+    return OK_RC;
+}
+
+//
+// 只读属性索引的叶节点求单表聚集值（属性为 INT 或 FLOAT）
+//
+RC QL_Manager::GetIndexAggregate(FuncType func, const char* relName, const AttrCat& attr, char* value, bool& hasValue) {
+    RC rc;
+    IX_IndexHandle* indexHandle;
+    if ((rc = smManager.GetIndexHandle(relName, attr.indexNo, indexHandle))) {
+        return rc;
+    }
+    char key[MAXSTRINGLEN + 1];
+    if (func == MIN || func == MAX) {
+        // 非空值索引的第一项最小，最后一项最大
+        if ((rc = (func == MIN ? indexHandle->GetFirstKey(key) : indexHandle->GetLastKey(key))) && rc != IX_EOF) {
+            return rc;
+        }
+        hasValue = rc != IX_EOF;
+        memcpy(value, key + 1, 4);
+    } else {
+        // 沿叶节点链累加非空值
         IX_IndexScan indexScan;
-        if ((rc = indexScan.OpenScan(indexHandle, fullConditions[index].op, fullConditions[index].rhsValue.data))) {
+        if ((rc = indexScan.OpenScan(*indexHandle, NO_OP, NULL))) {
             return rc;
         }
-        // 索引扫描
+        int count = 0;
+        int intResult = 0;
+        double floatResult = 0;
         while (true) {
             RID rid;
-            if ((rc = indexScan.GetNextEntry(rid)) && rc != IX_EOF) {
+            if ((rc = indexScan.GetNextEntry(rid, key)) && rc != IX_EOF) {
                 return rc;
             }
             if (rc == IX_EOF) {
                 break;
             }
-            // 判断该条记录是否满足条件
-            RM_Record record;
-            if ((rc = rmFileHandle.GetRec(rid, record))) {
-                return rc;
+            ++count;
+            if (attr.attrType == INT) {
+                intResult += *(int*)(key + 1);
+            } else {
+                floatResult += *(float*)(key + 1);
             }
-            char *recordData;
-            if ((rc = record.GetData(recordData))) {
+        }
+        if ((rc = indexScan.CloseScan())) {
+            return rc;
+        }
+        hasValue = count > 0;
+        // AVG 的分母是全部记录数，包括空值索引中的项
+        if (func == AVG && hasValue) {
+            IX_IndexHandle* nullHandle;
+            if ((rc = smManager.GetIndexHandle(relName, attr.indexNo + 1, nullHandle))) {
                 return rc;
             }
-            bool result;
-            if ((rc = CheckFullConditions(recordData, fullConditions, result))) {
+            int nullCount;
+            if ((rc = nullHandle->GetNumEntries(nullCount))) {
                 return rc;
             }
-            if (result) {
-                rids.push_back(rid);
-            }
-        }
-        if ((rc = indexScan.CloseScan())) {
-            return rc;
+            intResult /= count + nullCount;
+            floatResult /= count + nullCount;
         }
-        if ((rc = ixManager.CloseIndex(indexHandle))) {
-            return rc;
+        if (attr.attrType == INT) {
+            memcpy(value, &intResult, 4);
+        } else {
+            float result = floatResult;
+            memcpy(value, &result, 4);
         }
     }
+    if ((rc = smManager.ReleaseHandles(!inTransaction))) {
+        return rc;
+    }
     return OK_RC;
 }
 
 //
 // 利用单表限制条件集合在某个数据表中提取满足条件的记录（尽可能使用索引，分配的空间需要在外部释放）
 //
-RC QL_Manager::GetDataSet(const RelCat& relCat, RM_FileHandle& rmFileHandle, const std::vector<FullCondition>& fullConditions, std::vector<char*>& data) {
+RC QL_Manager::GetDataSet(const RelCat& relCat, RM_FileHandle& rmFileHandle, const std::vector<FullCondition>& fullConditions, std::vector<char*>& data,
+                          const std::vector<AttrCat>* usedAttrs) {
     RC rc;
-    // 查找出带有索引的属性值
-    int index = -1;
-    int indexLevel = 2;
-    for (unsigned int i = 0; i < fullConditions.size(); ++i) {
-        if (fullConditions[i].lhsAttr.indexNo >= 0 && fullConditions[i].bRhsIsAttr == 0 && ToLevel(fullConditions[i].op) < indexLevel) {
-            index = i;
-            indexLevel = ToLevel(fullConditions[i].op);
+    // 有覆盖被引用属性的索引时不读记录文件
+    if (usedAttrs != NULL) {
+        bool covered;
+        if ((rc = GetCoveredDataSet(relCat, fullConditions, *usedAttrs, data, covered))) {
+            return rc;
+        }
+        if (covered) {
+            return OK_RC;
         }
     }
-    if (index == -1) {
+    // 由索引得到按 RID 排序的候选集合
+    vector<RID> candidates;
+    bool isUsed;
+    if ((rc = GetIndexRids(relCat.relName, fullConditions, candidates, isUsed))) {
+        return rc;
+    }
+    if (!isUsed) {
         // 如果没有属性带有索引，使用记录文件暴力扫描
         RM_FileScan rmFileScan;
         if ((rc = rmFileScan.OpenScan(rmFileHandle, fullConditions))) {
@@ -2191,52 +3004,132 @@ RC QL_Manager::GetDataSet(const RelCat& relCat, RM_FileHandle& rmFileHandle, con
         if ((rc = rmFileScan.CloseScan())) {
             return rc;
         }
-    } else {
-        // 发现属性带有索引
-        // 先使用索引缩小查找范围，然后确定最终集合
-        int indexNo = *(char*)fullConditions[index].rhsValue.data == 0 ? fullConditions[index].lhsAttr.indexNo + 1 : fullConditions[index].lhsAttr.indexNo;
-        IX_IndexHandle indexHandle;
-        if ((rc = ixManager.OpenIndex(relCat.relName, indexNo, indexHandle))) {
+        return OK_RC;
+    }
+    // 按 RID 顺序读取候选记录，同一页上的记录相邻，每页只读入一次
+    for (const auto& rid : candidates) {
+        // 判断该条记录是否满足条件
+        RM_Record record;
+        if ((rc = rmFileHandle.GetRec(rid, record))) {
+            return rc;
+        }
+        char *recordData;
+        if ((rc = record.GetData(recordData))) {
+            return rc;
+        }
+        bool result;
+        if ((rc = CheckFullConditions(recordData, fullConditions, result))) {
             return rc;
         }
+        if (result) {
+            char *d = new char[relCat.tupleLength];
+            memcpy(d, recordData, relCat.tupleLength);
+            data.push_back(d);
+        }
+    }
+    return OK_RC;
+}
+
+//
+// 只读覆盖被引用属性的索引的叶节点构造记录：键与包含的属性值放回记录中的位置
+//
+RC QL_Manager::GetCoveredDataSet(const RelCat& relCat, const std::vector<FullCondition>& fullConditions, const std::vector<AttrCat>& usedAttrs,
+                                 std::vector<char*>& data, bool& covered) {
+    RC rc;
+    covered = false;
+    vector<AttrCat> attrs;
+    if ((rc = smManager.GetAttrs(relCat.relName, attrs))) {
+        return rc;
+    }
+    // 查找覆盖被引用属性的索引，优先选择键上有限制条件的索引
+    int coverAttr = -1;
+    int index = -1;
+    int indexLevel = 2;
+    for (unsigned int i = 0; i < attrs.size(); ++i) {
+        if (attrs[i].indexNo == -1) {
+            continue;
+        }
+        IX_IndexHandle* indexHandle;
+        if ((rc = smManager.GetIndexHandle(relCat.relName, attrs[i].indexNo, indexHandle))) {
+            return rc;
+        }
+        vector<IX_IncludeField> includeFields = indexHandle->GetIncludeFields();
+        bool covers = true;
+        for (const auto& used : usedAttrs) {
+            covers = covers && (used.offset == attrs[i].offset ||
+                                any_of(includeFields.begin(), includeFields.end(), [&](const IX_IncludeField& field) { return field.offset == used.offset; }));
+        }
+        if (!covers) {
+            continue;
+        }
+        if (coverAttr == -1) {
+            coverAttr = i;
+        }
+        for (unsigned int j = 0; j < fullConditions.size(); ++j) {
+            if (fullConditions[j].lhsAttr.offset == attrs[i].offset && fullConditions[j].bRhsIsAttr == 0 && ToLevel(fullConditions[j].op) < indexLevel) {
+                coverAttr = i;
+                index = j;
+                indexLevel = ToLevel(fullConditions[j].op);
+            }
+        }
+    }
+    if (coverAttr == -1) {
+        return OK_RC;
+    }
+    covered = true;
+    const AttrCat& attr = attrs[coverAttr];
+    // 有限制条件时只扫描条件对应的索引，否则依次扫描非空值与空值两个索引
+    int firstIndexNo = attr.indexNo;
+    int lastIndexNo = attr.indexNo + 1;
+    CompOp op = NO_OP;
+    void* value = NULL;
+    if (index != -1) {
+        op = fullConditions[index].op;
+        value = fullConditions[index].rhsValue.data;
+        firstIndexNo = lastIndexNo = *(char*)value == 0 ? attr.indexNo + 1 : attr.indexNo;
+    }
+    for (int indexNo = firstIndexNo; indexNo <= lastIndexNo; ++indexNo) {
+        IX_IndexHandle* indexHandle;
+        if ((rc = smManager.GetIndexHandle(relCat.relName, indexNo, indexHandle))) {
+            return rc;
+        }
+        vector<IX_IncludeField> includeFields = indexHandle->GetIncludeFields();
+        vector<char> include(indexHandle->GetIncludeLength() + 1);
         IX_IndexScan indexScan;
-        if ((rc = indexScan.OpenScan(indexHandle, fullConditions[index].op, fullConditions[index].rhsValue.data))) {
+        if ((rc = indexScan.OpenScan(*indexHandle, op, value))) {
             return rc;
         }
-        // 索引扫描
         while (true) {
+            char *d = new char[relCat.tupleLength];
+            memset(d, 0, relCat.tupleLength);
             RID rid;
-            if ((rc = indexScan.GetNextEntry(rid)) && rc != IX_EOF) {
+            if ((rc = indexScan.GetNextEntry(rid, d + attr.offset, include.data())) && rc != IX_EOF) {
+                delete[] d;
                 return rc;
             }
             if (rc == IX_EOF) {
+                delete[] d;
                 break;
             }
-            // 判断该条记录是否满足条件
-            RM_Record record;
-            if ((rc = rmFileHandle.GetRec(rid, record))) {
-                return rc;
-            }
-            char *recordData;
-            if ((rc = record.GetData(recordData))) {
-                return rc;
+            const char *includeData = include.data();
+            for (const auto& field : includeFields) {
+                memcpy(d + field.offset, includeData, field.length + 1);
+                includeData += field.length + 1;
             }
             bool result;
-            if ((rc = CheckFullConditions(recordData, fullConditions, result))) {
+            if ((rc = CheckFullConditions(d, fullConditions, result))) {
+                delete[] d;
                 return rc;
             }
             if (result) {
-                char *d = new char[relCat.tupleLength];
-                memcpy(d, recordData, relCat.tupleLength);
                 data.push_back(d);
+            } else {
+                delete[] d;
             }
         }
         if ((rc = indexScan.CloseScan())) {
             return rc;
         }
-        if ((rc = ixManager.CloseIndex(indexHandle))) {
-            return rc;
-        }
     }
     return OK_RC;
 }
@@ -2369,3 +3262,66 @@ RC QL_Manager::GetJoinData(std::map<RelCat, std::vector<char*>>& data, std::map<
     }
     return OK_RC;
 }
+
+//
+// 记录一次修改的撤销信息
+//
+void QL_Manager::LogUndo(QL_UndoRecord::Kind kind, const char* relName, int indexNo, const RID& rid, const void* data, int length) {
+    undoLog.emplace_back();
+    QL_UndoRecord& undo = undoLog.back();
+    undo.kind = kind;
+    strncpy(undo.relName, relName, MAXNAME);
+    undo.relName[MAXNAME] = 0;
+    undo.indexNo = indexNo;
+    undo.rid = rid;
+    if (data != NULL) {
+        undo.data.assign((const char*)data, (const char*)data + length);
+    }
+}
+
+//
+// 按逆序撤销 savepoint 之后的所有修改
+//
+RC QL_Manager::RollbackTo(size_t savepoint) {
+    RC rc = OK_RC;
+    while (undoLog.size() > savepoint) {
+        const QL_UndoRecord& undo = undoLog.back();
+        if (undo.kind == QL_UndoRecord::IX_INSERT || undo.kind == QL_UndoRecord::IX_DELETE) {
+            IX_IndexHandle* indexHandle;
+            if ((rc = smManager.GetIndexHandle(undo.relName, undo.indexNo, indexHandle))) {
+                break;
+            }
+            char* key = (char*)undo.data.data();
+            if (undo.kind == QL_UndoRecord::IX_INSERT) {
+                rc = indexHandle->DeleteEntry(key, undo.rid);
+            } else {
+                // 删除的项随键保存了包含的属性值
+                rc = indexHandle->InsertEntry(key, undo.rid, key + undo.data.size() - indexHandle->GetIncludeLength());
+            }
+        } else {
+            RM_FileHandle* fileHandle;
+            if ((rc = smManager.GetFileHandle(undo.relName, fileHandle))) {
+                break;
+            }
+            if (undo.kind == QL_UndoRecord::RM_INSERT) {
+                rc = fileHandle->DeleteRec(undo.rid);
+            } else if (undo.kind == QL_UndoRecord::RM_DELETE) {
+                rc = fileHandle->InsertRecAt(undo.data.data(), undo.rid);
+            } else {
+                RM_Record record;
+                char* recordData;
+                if (!(rc = fileHandle->GetRec(undo.rid, record)) && !(rc = record.GetData(recordData))) {
+                    memcpy(recordData, undo.data.data(), undo.data.size());
+                    rc = fileHandle->UpdateRec(record);
+                }
+            }
+        }
+        if (rc) {
+            break;
+        }
+        undoLog.pop_back();
+    }
+    // 撤销失败时无法恢复一致状态，丢弃剩余的撤销信息
+    undoLog.resize(savepoint);
+    return rc;
+}
@@ -7,6 +7,7 @@
 #include <iostream>
 #include <cstdio>
 #include <cstring>
+#include <cstdlib>
 #include <unistd.h>
 #include "global.h"
 #include "rm.h"
@@ -18,6 +19,20 @@ using namespace std;
 
 int main(int argc, char* argv[]) {
     RC rc;
+    int opt;
+    int commitDelay = 0;
+
+    // -d <ms>: enable group commit with the given max delay
+    while ((opt = getopt(argc, argv, "d:")) != -1) {
+        switch (opt) {
+            case 'd':
+                commitDelay = atoi(optarg);
+                break;
+            default:
+                cerr << "Usage: " << argv[0] << " [-d commit_delay_ms]\n";
+                return 1;
+        }
+    }
 
     // initialize RippleDB components
     PF_Manager pfm;
@@ -25,12 +40,23 @@ int main(int argc, char* argv[]) {
     IX_Manager ixm(pfm);
     SM_Manager smm(ixm, rmm);
     QL_Manager qlm(smm, ixm, rmm);
+    if (commitDelay > 0 && (rc = pfm.SetCommitDelay(commitDelay))) {
+        PF_PrintError(rc);
+        return 1;
+    }
     // call the parser
     RippleDBparse(pfm, smm, qlm);
+    // roll back the transaction that was not committed
+    if (qlm.InTransaction() && (rc = qlm.Rollback())) {
+        PrintError(rc);
+    }
     // close the database
     if ((rc = smm.CloseDb()) != SM_DBNOTOPEN) {
         SM_PrintError(rc);
     }
+    if (commitDelay > 0) {
+        pfm.PrintCommitStats();
+    }
     cout << "Bye.\n";
     return OK_RC;
 }
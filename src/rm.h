@@ -13,6 +13,8 @@
 #include "pf.h"
 #include "parser.h"
 
+#include <cstdint>
+
 //
 // RelCat: Relation Catalog
 //
@@ -88,26 +90,144 @@ struct FullCondition {
     Value rhsValue;
 };
 
+//
+// RM_VarField: a STRING attribute of a variable-length record file, stored
+// with the actual length of its value
+//
+struct RM_VarField {
+    short offset;             // offset of the attribute (its null flag) in the record
+    short length;             // attribute length
+};
+
+//
+// RM_ZoneField: an INT, FLOAT or DATE attribute whose range of values in
+// each page is kept in the zone map of the file
+//
+struct RM_ZoneField {
+    short offset;             // offset of the attribute (its null flag) in the record
+    short attrType;           // type of the attribute
+};
+
+#define RM_MAXZONEFIELDS 8
+
+// Format of the record files.  A file of the first format has no
+// formatVersion: its header held recordSize, numRecordsPerPage, the first
+// page of a list of free pages and bitmapSize, and it is converted when it
+// is opened.
+#define RM_FORMATVERSION 0x524d0201
+
 //
 // RM_FileHeader: Header structure for files
 //
-#define RM_PAGE_LIST_END -1
-#define RM_PAGE_FULL     -2
 struct RM_FileHeader {
     int recordSize;           // record size
-    int numRecordsPerPage;    // number of records per page
-    PageNum firstFreePageNum; // firstFreePageNum can be any of these values:
-                              //  - the number of the first free page
-                              //  - RM_PAGE_LIST_END if there is no free page
-    int bitmapSize;           // sizeof(bitmap)
+    int numRecordsPerPage;    // number of records per page (fixed-length records only)
+    PageNum numPages;         // number of pages in the file, including the
+                              // header page and the free-space map pages
+    int bitmapSize;           // sizeof(bitmap), padded so that the records start aligned
+    int isVariable;           // whether records are stored in slotted pages with variable length
+    int numVarFields;         // number of attributes in varFields
+    RM_VarField varFields[MAXATTRS]; // attributes stored with variable length, by offset
+    int numZoneFields;        // number of attributes in zoneFields
+    RM_ZoneField zoneFields[RM_MAXZONEFIELDS]; // attributes kept in the zone map
+    PageNum numZonePages;     // number of pages in the zone map file
+    int formatVersion;        // RM_FORMATVERSION
 
     RM_FileHeader() {
     }
-    RM_FileHeader(int recordSize, int numRecordsPerPage, PageNum firstFreePageNum = RM_PAGE_LIST_END) :
-        recordSize(recordSize), numRecordsPerPage(numRecordsPerPage), firstFreePageNum(firstFreePageNum), bitmapSize((numRecordsPerPage - 1 / 8) + 1) {
+    RM_FileHeader(int recordSize, int numRecordsPerPage, int bitmapSize, PageNum numPages = 1) :
+        recordSize(recordSize), numRecordsPerPage(numRecordsPerPage), numPages(numPages), bitmapSize(bitmapSize),
+        isVariable(0), numVarFields(0), numZoneFields(0), numZonePages(0), formatVersion(RM_FORMATVERSION) {
     }
 };
 
+//
+// Free-space map: one bit per page, set if the page has a free slot (for
+// variable-length records: room for the largest record).  The bits of pages
+// [k * RM_FSM_PAGES, (k + 1) * RM_FSM_PAGES) are stored at RM_FSM_OFFSET in
+// page k * RM_FSM_PAGES, so page 0 (the header page) holds the first part
+// of the map after the file header and every RM_FSM_PAGES-th page is a map
+// page.  The first int of a data page is its number of free slots (for
+// variable-length records: its number of free bytes).
+//
+#define RM_FSM_OFFSET 256
+#define RM_FSM_WORDS  ((PF_PAGE_SIZE - RM_FSM_OFFSET) / 8)
+#define RM_FSM_PAGES  (RM_FSM_WORDS * 64)
+#define RM_NO_PAGE    -1
+
+static_assert(sizeof(RM_FileHeader) <= RM_FSM_OFFSET, "the file header overlaps the free-space map");
+
+//
+// Zone map: for each page and each zone field, the number of records (and
+// of null values) in the page and the smallest and largest value bytes
+// among them, null values (stored as zero bytes) included, so that a scan
+// can skip the pages whose range rules out its conditions.  The range only
+// grows while the page has records.  The entries are kept in the file
+// fileName.zone, RM_ZONE_PAGEENTRIES(n) pages per page of it.
+//
+struct RM_ZoneEntry {
+    short numRecords;         // records in the page
+    short numNulls;           // of which the value is null
+    char minValue[1 + sizeof(int)]; // smallest value, with a null flag of 1
+    char maxValue[1 + sizeof(int)]; // largest value, with a null flag of 1
+};
+
+struct RM_ZoneCondition {
+    int fieldNo;              // zone field compared
+    CompOp compOp;            // comparing operator
+    const char* value;        // value compared with
+};
+
+#define RM_ZONE_PAGEENTRIES(numZoneFields) (PF_PAGE_SIZE / (int)(sizeof(RM_ZoneEntry) * (numZoneFields)))
+
+//
+// Slotted pages of variable-length record files: an RM_VarPageHeader, the
+// slot directory growing forward after it and the records growing backward
+// from the end of the page.  A slot with offset 0 is free; holes left by
+// deleted or shrunk records are compacted when an insert needs the room.
+// A record too large for a page is stored in a chain of overflow pages and
+// its slot holds an RM_OverflowStub; a record grown out of its page by an
+// update is moved to a slot of another page and its slot holds an
+// RM_ForwardStub, so that its RID never changes; the moved record starts
+// with an RM_ForwardStub back to that slot.
+//
+struct RM_VarPageHeader {
+    int freeBytes;            // free bytes in the page, including holes
+    short numSlots;           // size of the slot directory, RM_OVERFLOWPAGE for an overflow page
+    short heapOffset;         // offset of the lowest record in the page
+};
+
+struct RM_VarSlot {
+    short offset;             // offset of the record, 0 if the slot is free
+    short length;             // length of the record, with the RM_VARSLOT flags
+};
+
+struct RM_OverflowPageHeader {
+    int freeBytes;            // always 0, an overflow page is never free
+    short numSlots;           // RM_OVERFLOWPAGE
+    short length;             // bytes of the record in this page
+    PageNum nextPageNum;      // next overflow page of the record, RM_NO_PAGE for the last one
+};
+
+struct RM_OverflowStub {
+    PageNum firstPageNum;     // first overflow page of the record
+    int length;               // length of the encoded record
+};
+
+struct RM_ForwardStub {
+    PageNum pageNum;          // page the record is moved to (from, before a moved record)
+    SlotNum slotNum;          // slot the record is moved to (from, before a moved record)
+};
+
+#define RM_OVERFLOWPAGE      -1
+#define RM_VARSLOT_OVERFLOW  0x4000 // the slot holds an RM_OverflowStub
+#define RM_VARSLOT_FORWARD   0x2000 // the slot holds an RM_ForwardStub
+#define RM_VARSLOT_MOVED     0x1000 // the slot holds a record moved from another slot
+#define RM_VARSLOT_LENGTH    0x0fff
+#define RM_VAR_MINLENGTH     ((int)sizeof(RM_OverflowStub)) // a record can always turn into a stub
+#define RM_VAR_MAXINLINE     (PF_PAGE_SIZE - (int)sizeof(RM_VarPageHeader) - (int)sizeof(RM_VarSlot))
+#define RM_OVERFLOW_CAPACITY (PF_PAGE_SIZE - (int)sizeof(RM_OverflowPageHeader))
+
 //
 // RM_Record: RM Record interface
 //
@@ -148,13 +268,31 @@ public:
     RC GetRec(const RID& rid, RM_Record& rec) const;
     // Insert a new record and return its RID.
     RC InsertRec(const char* pData, RID& rid);
+    // Insert nRecs records stored back to back in pData, filling each free
+    // page before moving to the next one; their RIDs are stored in rids.
+    RC InsertRecs(const char* pData, int nRecs, RID* rids);
+    // Insert a record into the free slot with given RID (used to undo a delete).
+    RC InsertRecAt(const char* pData, const RID& rid);
     // Delete the record with given RID.
     RC DeleteRec(const RID& rid);
     // Update the record with given RID.
     RC UpdateRec(const RM_Record& rec);
+    // Whether the records are stored with variable length.
+    bool IsVariable() const;
+    // Get the lowest page with a free slot, RM_NO_PAGE if there is none.
+    RC GetFirstFreePage(PageNum& pageNum);
+    // Get the RIDs of the records in the page with given pageNum (of a
+    // variable-length file: including the records moved there).
+    RC GetPageRids(PageNum pageNum, std::vector<RID>& rids) const;
+    // Dispose the empty pages at the end of the file and return the last
+    // page left (0, the header page, if the file has no records).
+    RC TrimPages(PageNum& lastPageNum);
     // Forces a page (along with any contents stored in this class)
     // from the buffer pool to disk. Default value forces all pages.
     RC ForcePages(PageNum pageNum = ALL_PAGES);
+    // Whether the zone map of the page with given pageNum allows a record
+    // satisfying all given conditions.
+    bool ZoneMayMatch(PageNum pageNum, const std::vector<RM_ZoneCondition>& conditions) const;
 
 private:
     // Disable copy constructor and overloaded =.
@@ -163,11 +301,70 @@ private:
 
     // Check whether record with given rid is exist and get its info if exist.
     RC CheckRecExist(const RID& rid, PageNum& pageNum, SlotNum& slotNum, char*& pData) const;
+    // Write fileHeader back to the header page if it is modified.
+    RC WriteHeader();
+    // Convert a file of the first format, whose header is in fileHeader.
+    // A file of RM_FSM_PAGES pages or more is refused (RM_FILETOOLARGE):
+    // page RM_FSM_PAGES holds records whose RIDs the indexes refer to.
+    RC ConvertFile();
+    // Get a page with a free slot (allocate one if there is none), pinned.
+    RC GetFreePage(PageNum& pageNum, char*& pData);
+    // Read the free-space map from its pages.
+    RC ReadFsm();
+    // Write the free-space map back to its pages.
+    RC WriteFsm();
+    // Set whether the page with given pageNum has a free slot.
+    void SetPageFree(PageNum pageNum, bool isFree);
+    // Allocate a new page (after a new free-space map page if one is due), pinned.
+    RC AllocatePage(PageNum& pageNum, char*& pData);
+    // Read the zone map from the zone map file.
+    RC ReadZones();
+    // Write the modified pages of the zone map back to the zone map file.
+    RC WriteZones();
+    // Add a record to, or remove it from, the zone map of its page.
+    void ZoneAdd(PageNum pageNum, const char* pRecData);
+    void ZoneRemove(PageNum pageNum, const char* pRecData);
+
+    // Variable-length records
+    RC InsertVarRec(const char* pData, RID& rid);
+    RC InsertVarRecAt(const char* pData, const RID& rid);
+    RC DeleteVarRec(const RID& rid);
+    RC UpdateVarRec(const RM_Record& rec);
+    // Encode a record into varBuffer and return its length.
+    int EncodeVarRec(const char* pRecData);
+    // Length of the largest encoded record.
+    int MaxVarRecLength() const;
+    // Decode the record in given slot of a pinned slotted page.
+    RC ReadVarRec(const char* pData, SlotNum slotNum, char* pRecData) const;
+    // Pin a slotted page other than exceptPage with room for bodyLength
+    // bytes, allocating one if needed, and return a free slot of it.
+    RC FindVarPage(int bodyLength, PageNum exceptPage, PageNum& pageNum, char*& pData, SlotNum& slotNum);
+    // Store the encoded record in varBuffer into a free slot of pinned
+    // slotted page pageNum, which has room for it (or for a stub if
+    // isOutside, the record then goes to overflow pages or another page).
+    RC PlaceVarRec(PageNum pageNum, char* pData, SlotNum slotNum, int length, bool isOutside);
+    // Free the room of the record in given slot of a pinned slotted page.
+    RC FreeVarRec(char* pData, SlotNum slotNum);
+    // Move the largest record kept in a pinned slotted page (but the one in
+    // exceptSlot) to overflow pages, isSpilled is false if there is none.
+    RC SpillVarRec(PageNum pageNum, char* pData, SlotNum exceptSlot, bool& isSpilled);
+    // Move the record moved to given slot of a pinned slotted page from
+    // another page back to that page, or on to a third page.
+    RC RelocateVarRec(PageNum pageNum, char* pData, SlotNum slotNum);
+    // Update the free-space map bit of a slotted page.
+    void SetVarPageFree(PageNum pageNum, const char* pData);
 
     RM_FileHeader fileHeader; // header of the file
     PF_FileHandle pfFileHandle; // internal PF_FileHandle
     bool isOpen; // whether this fileHandle is open for a file (which means valid)
     bool isHeaderModified; // whether header of the file is modified
+    std::vector<uint64_t> fsm; // free-space map, bit i of fsm[w] is page w * 64 + i
+    int fsmCursor; // no word of fsm before this one has a bit set
+    bool isFsmModified; // whether fsm is modified
+    std::vector<char> varBuffer; // encoded variable-length record
+    PF_FileHandle zoneFileHandle; // zone map file, open if there are zone fields
+    std::vector<RM_ZoneEntry> zones; // zone map, entry k of page p is zones[p * numZoneFields + k]
+    std::vector<bool> isZonePageModified; // whether a page of the zone map file is modified
 };
 
 //
@@ -195,6 +392,7 @@ private:
     RM_FileScan(const RM_FileScan&);
     RM_FileScan& operator =(const RM_FileScan&);
 
+    const RM_FileHandle* fileHandle; // file being scanned
     RM_FileHeader fileHeader; // header of the file
     PF_FileHandle pfFileHandle; // internal PF_FileHandle
     AttrType attrType; // type of the attribute being compared
@@ -206,9 +404,12 @@ private:
     char *pData; // current page data pointer
     PageNum pageNum; // current pageNum;
     SlotNum slotNum; // current slotNum
+    int numSlots; // number of slots in the current page
+    std::vector<char> varRecord; // current variable-length record, decoded
     int isOpen; // whether this fileScan is open
     bool isEOF; // whether there are no records left satisfying the scan condition
     std::vector<FullCondition> conditions; // multiple scan conditions
+    std::vector<RM_ZoneCondition> zoneConditions; // conditions on zone fields, checked per page
 };
 
 //
@@ -219,10 +420,16 @@ public:
     RM_Manager(PF_Manager& pfm);
     ~RM_Manager();
 
-    // Create a file with given fileName and recordSize.
-    RC CreateFile(const char* fileName, int recordSize);
+    // Create a file with given fileName and recordSize, in slotted pages
+    // with the attributes in varFields stored with variable length if
+    // isVariable, with a zone map on the attributes in zoneFields.
+    RC CreateFile(const char* fileName, int recordSize, bool isVariable = false,
+                  const std::vector<RM_VarField>& varFields = std::vector<RM_VarField>(),
+                  const std::vector<RM_ZoneField>& zoneFields = std::vector<RM_ZoneField>());
     // Destroy the file with given fileName.
     RC DestroyFile(const char* fileName);
+    // Rename the closed file oldName to newName, replacing it if it exists.
+    RC RenameFile(const char* oldName, const char* newName);
     // Open the file with given fileName and return its fileHandle.
     RC OpenFile(const char* fileName, RM_FileHandle& fileHandle);
     // Close the file with given fileHandle.
@@ -250,5 +457,9 @@ void RM_PrintError(RC rc);
 #define RM_FILESCANCLOSED     (START_RM_WARN + 6)  // file scan is not open
 #define RM_ATTRINVALID        (START_RM_WARN + 7)  // attr is invalid (offset or length)
 #define RM_EOF                (START_RM_WARN + 8)  // there are no records left satisfying the scan condition
+#define RM_RECORDEXIST        (START_RM_WARN + 9)  // there is already a record with given RID
+#define RM_PAGEFULL           (START_RM_WARN + 10) // there is no room for the record in its page
+#define RM_SYSERROR           (START_RM_WARN + 11) // system error
+#define RM_FILETOOLARGE       (START_RM_WARN + 12) // file of the first format of RM_FSM_PAGES pages or more
 
 #endif
@@ -23,7 +23,11 @@ static char* RM_WarnMsg[] = {
     (char*)"file scan is already open",
     (char*)"file scan is not open",
     (char*)"attr is invalid (offset or length)",
-    (char*)"there are no records left satisfying the scan condition"
+    (char*)"there are no records left satisfying the scan condition",
+    (char*)"there is already a record with given RID",
+    (char*)"there is no room for the record in its page",
+    (char*)"system error",
+    (char*)"file of the first format with 30656 pages or more cannot be converted"
 };
 
 //
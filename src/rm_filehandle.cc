@@ -6,6 +6,112 @@
 
 #include "rm.h"
 #include <cstring>
+#include <endian.h>
+
+// Find the first bit equal to isSet at or after bit from among the first
+// nBits bits of bitmap (bit i is bit i & 7 of byte i / 8), 64 bits at a
+// time.  Return -1 if there is none.
+static int RM_FindBit(const char* bitmap, int from, int nBits, bool isSet) {
+    for (int w = from / 64; w * 64 < nBits; ++w) {
+        uint64_t word;
+        memcpy(&word, bitmap + w * 8, sizeof(word));
+        word = le64toh(word);
+        if (!isSet) {
+            word = ~word;
+        }
+        if (w == from / 64) {
+            word &= ~0ULL << (from & 63);
+        }
+        if (word) {
+            int bit = w * 64 + __builtin_ctzll(word);
+            return bit < nBits ? bit : -1;
+        }
+    }
+    return -1;
+}
+
+// Initialize an empty slotted page.
+static void RM_InitVarPage(char* pData) {
+    RM_VarPageHeader* header = (RM_VarPageHeader*)pData;
+    header->freeBytes = PF_PAGE_SIZE - sizeof(RM_VarPageHeader);
+    header->numSlots = 0;
+    header->heapOffset = PF_PAGE_SIZE;
+}
+
+// Return the first free slot of a slotted page, the slot after the
+// directory if there is none.
+static SlotNum RM_FindFreeSlot(const char* pData) {
+    const RM_VarPageHeader* header = (const RM_VarPageHeader*)pData;
+    const RM_VarSlot* slots = (const RM_VarSlot*)(pData + sizeof(RM_VarPageHeader));
+    SlotNum slotNum = 0;
+    while (slotNum < header->numSlots && slots[slotNum].offset != 0) {
+        ++slotNum;
+    }
+    return slotNum;
+}
+
+// Whether a record of bodyLength bytes fits into the free slot slotNum of a
+// slotted page, counting the slots the directory has to grow by.
+static bool RM_VarPageFits(const char* pData, SlotNum slotNum, int bodyLength) {
+    const RM_VarPageHeader* header = (const RM_VarPageHeader*)pData;
+    if (header->numSlots == RM_OVERFLOWPAGE) {
+        return false;
+    }
+    int newSlots = slotNum >= header->numSlots ? slotNum + 1 - header->numSlots : 0;
+    return header->freeBytes >= bodyLength + newSlots * (int)sizeof(RM_VarSlot);
+}
+
+// Move the records of a slotted page to its end, leaving the free bytes
+// between the slot directory and the records.
+static void RM_CompactVarPage(char* pData) {
+    char buffer[PF_PAGE_SIZE];
+    memcpy(buffer, pData, PF_PAGE_SIZE);
+    RM_VarPageHeader* header = (RM_VarPageHeader*)pData;
+    RM_VarSlot* slots = (RM_VarSlot*)(pData + sizeof(RM_VarPageHeader));
+    int offset = PF_PAGE_SIZE;
+    for (int i = 0; i < header->numSlots; ++i) {
+        if (slots[i].offset != 0) {
+            int length = slots[i].length & RM_VARSLOT_LENGTH;
+            offset -= length;
+            memcpy(pData + offset, buffer + slots[i].offset, length);
+            slots[i].offset = offset;
+        }
+    }
+    header->heapOffset = offset;
+}
+
+// Store bodyLength bytes into a free slot of a slotted page, which has room
+// for them, growing the slot directory if needed and compacting the page
+// when the records are in the way.
+static void RM_PutVarSlot(char* pData, SlotNum slotNum, const char* pBody, int bodyLength, int flags) {
+    RM_VarPageHeader* header = (RM_VarPageHeader*)pData;
+    RM_VarSlot* slots = (RM_VarSlot*)(pData + sizeof(RM_VarPageHeader));
+    int numSlots = slotNum >= header->numSlots ? slotNum + 1 : header->numSlots;
+    if (header->heapOffset - bodyLength < (int)(sizeof(RM_VarPageHeader) + numSlots * sizeof(RM_VarSlot))) {
+        RM_CompactVarPage(pData);
+    }
+    for (int i = header->numSlots; i < numSlots; ++i) {
+        slots[i].offset = 0;
+        slots[i].length = 0;
+    }
+    header->freeBytes -= (numSlots - header->numSlots) * sizeof(RM_VarSlot) + bodyLength;
+    header->numSlots = numSlots;
+    // store the record below the others
+    header->heapOffset -= bodyLength;
+    memcpy(pData + header->heapOffset, pBody, bodyLength);
+    slots[slotNum].offset = header->heapOffset;
+    slots[slotNum].length = bodyLength | flags;
+}
+
+// Shrink the slot directory of a slotted page past its free slots at the end.
+static void RM_TrimVarSlots(char* pData) {
+    RM_VarPageHeader* header = (RM_VarPageHeader*)pData;
+    const RM_VarSlot* slots = (const RM_VarSlot*)(pData + sizeof(RM_VarPageHeader));
+    while (header->numSlots > 0 && slots[header->numSlots - 1].offset == 0) {
+        --header->numSlots;
+        header->freeBytes += sizeof(RM_VarSlot);
+    }
+}
 
 RM_FileHandle::RM_FileHandle() {
     isOpen = false;
@@ -33,7 +139,13 @@ RC RM_FileHandle::GetRec(const RID& rid, RM_Record& rec) const {
         delete[] rec.pData;
     }
     rec.pData = new char[fileHeader.recordSize];
-    memcpy(rec.pData, pData + sizeof(PageNum) + fileHeader.bitmapSize + slotNum * fileHeader.recordSize, fileHeader.recordSize);
+    if (fileHeader.isVariable) {
+        if ((rc = ReadVarRec(pData, slotNum, rec.pData))) {
+            return rc;
+        }
+    } else {
+        memcpy(rec.pData, pData + sizeof(PageNum) + fileHeader.bitmapSize + slotNum * fileHeader.recordSize, fileHeader.recordSize);
+    }
     // unpin page
     if ((rc = pfFileHandle.UnpinPage(pageNum))) {
         return rc;
@@ -48,70 +160,145 @@ RC RM_FileHandle::InsertRec(const char *pRecData, RID &rid) {
     if (!isOpen) {
         return RM_FILEHANDLECLOSED;
     }
+    if (fileHeader.isVariable) {
+        if ((rc = InsertVarRec(pRecData, rid))) {
+            return rc;
+        }
+        ZoneAdd(rid.pageNum, pRecData);
+        return OK_RC;
+    }
     // get data pointer of first free page
+    PageNum pageNum;
     char* pData;
-    if (fileHeader.firstFreePageNum == RM_PAGE_LIST_END) {
-        // allocate a new page
-        PF_PageHandle pageHandle;
-        if ((rc = pfFileHandle.AllocatePage(pageHandle))) {
-            return rc;
+    if ((rc = GetFreePage(pageNum, pData))) {
+        return rc;
+    }
+    // find first available slot and insert the record
+    char* bitmap = pData + sizeof(PageNum);
+    int slot = RM_FindBit(bitmap, 0, fileHeader.numRecordsPerPage, false);
+    bitmap[slot / 8] |= 1 << (slot & 7);
+    memcpy(bitmap + fileHeader.bitmapSize + slot * fileHeader.recordSize, pRecData, fileHeader.recordSize);
+    rid.pageNum = pageNum;
+    rid.slotNum = slot;
+    ZoneAdd(pageNum, pRecData);
+    // if page is full, remove it from the free-space map
+    if (--*(int*)pData == 0) {
+        SetPageFree(pageNum, false);
+    }
+    // mark page dirty
+    if ((rc = pfFileHandle.MarkDirty(pageNum))) {
+        return rc;
+    }
+    // unpin page
+    if ((rc = pfFileHandle.UnpinPage(pageNum))) {
+        return rc;
+    }
+    // success
+    return OK_RC;
+}
+
+RC RM_FileHandle::InsertRecs(const char *pRecData, int nRecs, RID *rids) {
+    RC rc;
+    // check whether fileHandle is open
+    if (!isOpen) {
+        return RM_FILEHANDLECLOSED;
+    }
+    // variable-length records are placed one by one
+    if (fileHeader.isVariable) {
+        for (int i = 0; i < nRecs; ++i) {
+            if ((rc = InsertVarRec(pRecData + i * fileHeader.recordSize, rids[i]))) {
+                return rc;
+            }
+            ZoneAdd(rids[i].pageNum, pRecData + i * fileHeader.recordSize);
         }
-        // get pageNum of the page
-        if ((rc = pageHandle.GetPageNum(fileHeader.firstFreePageNum))) {
+        return OK_RC;
+    }
+    int n = 0;
+    while (n < nRecs) {
+        // get data pointer of first free page
+        PageNum pageNum;
+        char* pData;
+        if ((rc = GetFreePage(pageNum, pData))) {
             return rc;
         }
-        // get data pointer of the page
-        if ((rc = pageHandle.GetData(pData))) {
-           return rc;
-        }
-        // initialize the page
-        *(PageNum*)pData = RM_PAGE_LIST_END;
-        for (int i = 0; i < fileHeader.bitmapSize; ++i) {
-            pData[sizeof(PageNum) + i] = 0xff;
+        // fill the free slots of the page in order
+        char* bitmap = pData + sizeof(PageNum);
+        char* slots = bitmap + fileHeader.bitmapSize;
+        int slot = -1;
+        while (n < nRecs && (slot = RM_FindBit(bitmap, slot + 1, fileHeader.numRecordsPerPage, false)) >= 0) {
+            bitmap[slot / 8] |= 1 << (slot & 7);
+            memcpy(slots + slot * fileHeader.recordSize, pRecData + n * fileHeader.recordSize, fileHeader.recordSize);
+            rids[n].pageNum = pageNum;
+            rids[n].slotNum = slot;
+            ZoneAdd(pageNum, pRecData + n * fileHeader.recordSize);
+            --*(int*)pData;
+            ++n;
         }
-        for (int i = 0; i < fileHeader.numRecordsPerPage; ++i) {
-            pData[sizeof(PageNum) + i / 8] ^= 1 << (i & 7);
+        // if page is full, remove it from the free-space map
+        if (*(int*)pData == 0) {
+            SetPageFree(pageNum, false);
         }
-        isHeaderModified = true;
-    } else {
-        // get pageHandle of first free page
-        PF_PageHandle pageHandle;
-        if ((rc = pfFileHandle.GetThisPage(fileHeader.firstFreePageNum, pageHandle))) {
+        // mark page dirty
+        if ((rc = pfFileHandle.MarkDirty(pageNum))) {
             return rc;
         }
-        // get data pointer of the page
-        if ((rc = pageHandle.GetData(pData))) {
-           return rc;
+        // unpin page
+        if ((rc = pfFileHandle.UnpinPage(pageNum))) {
+            return rc;
         }
     }
-    // find first available slot and insert the record
-    PageNum pageNum = fileHeader.firstFreePageNum;
-    int i = 0;
-    for (; i < fileHeader.bitmapSize; ++i) {
-        if ((unsigned char)pData[sizeof(PageNum) + i] != 0xff) {
-            break;
-        }
+    // success
+    return OK_RC;
+}
+
+RC RM_FileHandle::InsertRecAt(const char *pRecData, const RID &rid) {
+    RC rc;
+    // check whether fileHandle is open
+    if (!isOpen) {
+        return RM_FILEHANDLECLOSED;
     }
-    for (int j = 0; j < 8; ++j) {
-        if (!(pData[sizeof(PageNum) + i] & (1 << j))) {
-            pData[sizeof(PageNum) + i] ^= 1 << j;
-            memcpy(pData + sizeof(PageNum) + fileHeader.bitmapSize + (i * 8 + j) * fileHeader.recordSize, pRecData, fileHeader.recordSize);
-            rid.pageNum = pageNum;
-            rid.slotNum = i * 8 + j;
-            break;
+    if (fileHeader.isVariable) {
+        if ((rc = InsertVarRecAt(pRecData, rid))) {
+            return rc;
         }
+        ZoneAdd(rid.pageNum, pRecData);
+        return OK_RC;
+    }
+    // check whether rid is legal
+    PageNum pageNum;
+    SlotNum slotNum;
+    if ((rc = rid.GetPageNum(pageNum))) {
+        return rc;
+    }
+    if ((rc = rid.GetSlotNum(slotNum))) {
+        return rc;
+    }
+    if (pageNum % RM_FSM_PAGES == 0 || slotNum < 0 || slotNum >= fileHeader.numRecordsPerPage) {
+        return RM_RECORDNOTEXIST;
+    }
+    // get data pointer of the page
+    PF_PageHandle pageHandle;
+    if ((rc = pfFileHandle.GetThisPage(pageNum, pageHandle))) {
+        return rc;
     }
-    // if page is full, update firstFreePageNum
-    bool isFull = true;
-    for (; isFull && i < fileHeader.bitmapSize; ++i) {
-        if ((unsigned char)pData[sizeof(PageNum) + i] != 0xff) {
-            isFull = false;
+    char* pData;
+    if ((rc = pageHandle.GetData(pData))) {
+        return rc;
+    }
+    // the slot must be free
+    if (pData[sizeof(PageNum) + slotNum / 8] & (1 << (slotNum & 7))) {
+        if ((rc = pfFileHandle.UnpinPage(pageNum))) {
+            return rc;
         }
+        return RM_RECORDEXIST;
     }
-    if (isFull) {
-        fileHeader.firstFreePageNum = *(PageNum*)pData;
-        *(PageNum*)pData = RM_PAGE_FULL;
-        isHeaderModified = true;
+    // insert the record
+    pData[sizeof(PageNum) + slotNum / 8] ^= 1 << (slotNum & 7);
+    memcpy(pData + sizeof(PageNum) + fileHeader.bitmapSize + slotNum * fileHeader.recordSize, pRecData, fileHeader.recordSize);
+    ZoneAdd(pageNum, pRecData);
+    // if page is full, remove it from the free-space map
+    if (--*(int*)pData == 0) {
+        SetPageFree(pageNum, false);
     }
     // mark page dirty
     if ((rc = pfFileHandle.MarkDirty(pageNum))) {
@@ -131,6 +318,18 @@ RC RM_FileHandle::DeleteRec(const RID &rid) {
     if (!isOpen) {
         return RM_FILEHANDLECLOSED;
     }
+    if (fileHeader.isVariable) {
+        // read the record first to remove it from the zone map
+        RM_Record oldRec;
+        if (fileHeader.numZoneFields > 0 && (rc = GetRec(rid, oldRec))) {
+            return rc;
+        }
+        if ((rc = DeleteVarRec(rid))) {
+            return rc;
+        }
+        ZoneRemove(rid.pageNum, oldRec.pData);
+        return OK_RC;
+    }
     // check whether record with given rid is exist and get its info if exist
     PageNum pageNum;
     SlotNum slotNum;
@@ -138,14 +337,11 @@ RC RM_FileHandle::DeleteRec(const RID &rid) {
     if ((rc = CheckRecExist(rid, pageNum, slotNum, pData))) {
         return rc;
     }
-    // if page is full, it will become another free page
-    if (*(PageNum*)pData == RM_PAGE_FULL) {
-        *(PageNum*)pData = fileHeader.firstFreePageNum;
-        fileHeader.firstFreePageNum = pageNum;
-        isHeaderModified = true;
-    }
-    // mark slot as available
+    // mark slot as available, the page now has a free slot
+    ZoneRemove(pageNum, pData + sizeof(PageNum) + fileHeader.bitmapSize + slotNum * fileHeader.recordSize);
     pData[sizeof(PageNum) + slotNum / 8] ^= 1 << (slotNum & 7);
+    ++*(int*)pData;
+    SetPageFree(pageNum, true);
     // mark page dirty
     if ((rc = pfFileHandle.MarkDirty(pageNum))) {
         return rc;
@@ -164,6 +360,19 @@ RC RM_FileHandle::UpdateRec(const RM_Record& rec) {
     if (!isOpen) {
         return RM_FILEHANDLECLOSED;
     }
+    if (fileHeader.isVariable) {
+        // read the record first to replace it in the zone map
+        RM_Record oldRec;
+        if (fileHeader.numZoneFields > 0 && (rc = GetRec(rec.rid, oldRec))) {
+            return rc;
+        }
+        if ((rc = UpdateVarRec(rec))) {
+            return rc;
+        }
+        ZoneRemove(rec.rid.pageNum, oldRec.pData);
+        ZoneAdd(rec.rid.pageNum, rec.pData);
+        return OK_RC;
+    }
     // check whether rec has been read and get its rid if success
     RID rid;
     if ((rc = rec.GetRid(rid))) {
@@ -177,7 +386,9 @@ RC RM_FileHandle::UpdateRec(const RM_Record& rec) {
         return rc;
     }
     // update rec
+    ZoneRemove(pageNum, pData + sizeof(PageNum) + fileHeader.bitmapSize + slotNum * fileHeader.recordSize);
     memcpy(pData + sizeof(PageNum) + fileHeader.bitmapSize + slotNum * fileHeader.recordSize, rec.pData, fileHeader.recordSize);
+    ZoneAdd(pageNum, rec.pData);
     // mark page dirty
     if ((rc = pfFileHandle.MarkDirty(pageNum))) {
         return rc;
@@ -196,38 +407,1134 @@ RC RM_FileHandle::ForcePages(PageNum pageNum) {
     if (!isOpen) {
         return RM_FILEHANDLECLOSED;
     }
+    // write back fileHeader with the pages
+    if (pageNum == ALL_PAGES && (rc = WriteHeader())) {
+        return rc;
+    }
     // do ForcePages
     if ((rc = pfFileHandle.ForcePages(pageNum))) {
         return rc;
     }
+    if (pageNum == ALL_PAGES && fileHeader.numZoneFields > 0 && (rc = zoneFileHandle.ForcePages(ALL_PAGES))) {
+        return rc;
+    }
     // success
     return OK_RC;
 }
 
-RC RM_FileHandle::CheckRecExist(const RID& rid, PageNum& pageNum, SlotNum& slotNum, char*& pData) const {
+RC RM_FileHandle::WriteHeader() {
     RC rc;
-    // check whether rid is legal
-    if ((rc = rid.GetPageNum(pageNum))) {
+    // write back the free-space map and the zone map
+    if ((rc = WriteFsm())) {
         return rc;
     }
-    if ((rc = rid.GetSlotNum(slotNum))) {
+    if ((rc = WriteZones())) {
         return rc;
     }
-    // get pageHandle
+    // check whether fileHeader is modified
+    if (!isHeaderModified) {
+        return OK_RC;
+    }
+    // get header page
     PF_PageHandle pageHandle;
-    if ((rc = pfFileHandle.GetThisPage(pageNum, pageHandle))) {
+    if ((rc = pfFileHandle.GetFirstPage(pageHandle))) {
+        return rc;
+    }
+    // get header page data pointer
+    char* pData;
+    if ((rc = pageHandle.GetData(pData))) {
+        return rc;
+    }
+    // write header page data
+    *(RM_FileHeader*)pData = fileHeader;
+    // get header page num
+    PageNum pageNum;
+    if ((rc = pageHandle.GetPageNum(pageNum))) {
+        return rc;
+    }
+    // mark header page dirty
+    if ((rc = pfFileHandle.MarkDirty(pageNum))) {
+        return rc;
+    }
+    // unpin header page
+    if ((rc = pfFileHandle.UnpinPage(pageNum))) {
+        return rc;
+    }
+    isHeaderModified = false;
+    // success
+    return OK_RC;
+}
+
+RC RM_FileHandle::ConvertFile() {
+    RC rc;
+    // the first format kept no page count: every page after the header
+    // page holds records, and its map page would be one of them
+    PF_PageHandle pageHandle;
+    if ((rc = pfFileHandle.GetLastPage(pageHandle))) {
+        return rc;
+    }
+    PageNum lastPageNum;
+    if ((rc = pageHandle.GetPageNum(lastPageNum))) {
+        return rc;
+    }
+    if ((rc = pfFileHandle.UnpinPage(lastPageNum))) {
         return rc;
     }
+    if (lastPageNum >= RM_FSM_PAGES) {
+        return RM_FILETOOLARGE;
+    }
+    // the third int of the header was the first free page
+    RM_FileHeader oldHeader = fileHeader;
+    fileHeader = RM_FileHeader(oldHeader.recordSize, oldHeader.numRecordsPerPage, oldHeader.bitmapSize, lastPageNum + 1);
+    fsm.assign((fileHeader.numPages + 63) / 64, 0);
+    fsmCursor = 0;
+    // the first int of a page linked the free pages, it now counts the
+    // free slots of the page
+    for (PageNum pageNum = 1; pageNum < fileHeader.numPages; ++pageNum) {
+        if ((rc = pfFileHandle.GetThisPage(pageNum, pageHandle))) {
+            return rc;
+        }
+        char* pData;
+        if ((rc = pageHandle.GetData(pData))) {
+            return rc;
+        }
+        int numFreeSlots = 0;
+        int slot = -1;
+        while ((slot = RM_FindBit(pData + sizeof(PageNum), slot + 1, fileHeader.numRecordsPerPage, false)) >= 0) {
+            ++numFreeSlots;
+        }
+        *(int*)pData = numFreeSlots;
+        SetPageFree(pageNum, numFreeSlots > 0);
+        if ((rc = pfFileHandle.MarkDirty(pageNum))) {
+            return rc;
+        }
+        if ((rc = pfFileHandle.UnpinPage(pageNum))) {
+            return rc;
+        }
+    }
+    isHeaderModified = true;
+    isFsmModified = true;
+    return WriteHeader();
+}
+
+bool RM_FileHandle::IsVariable() const {
+    return fileHeader.isVariable;
+}
+
+RC RM_FileHandle::GetFirstFreePage(PageNum& pageNum) {
+    // check whether fileHandle is open
+    if (!isOpen) {
+        return RM_FILEHANDLECLOSED;
+    }
+    // find the first page with a free slot in the free-space map
+    while (fsmCursor < (int)fsm.size() && fsm[fsmCursor] == 0) {
+        ++fsmCursor;
+    }
+    if (fsmCursor < (int)fsm.size()) {
+        pageNum = fsmCursor * 64 + __builtin_ctzll(fsm[fsmCursor]);
+    } else {
+        pageNum = RM_NO_PAGE;
+    }
+    return OK_RC;
+}
+
+RC RM_FileHandle::GetPageRids(PageNum pageNum, std::vector<RID>& rids) const {
+    RC rc;
+    // check whether fileHandle is open
+    if (!isOpen) {
+        return RM_FILEHANDLECLOSED;
+    }
+    // the header page and the free-space map pages hold no records
+    if (pageNum % RM_FSM_PAGES == 0) {
+        return OK_RC;
+    }
     // get data pointer of the page
+    PF_PageHandle pageHandle;
+    if ((rc = pfFileHandle.GetThisPage(pageNum, pageHandle))) {
+        return rc;
+    }
+    char* pData;
     if ((rc = pageHandle.GetData(pData))) {
         return rc;
     }
-    // check whether record with given rid is exist
-    if (slotNum < 0 || slotNum >= fileHeader.numRecordsPerPage) {
-        return RM_RECORDNOTEXIST;
+    // collect the used slots, an overflow page has none and a moved record
+    // is listed by the RID it is moved from
+    if (fileHeader.isVariable) {
+        const RM_VarPageHeader* header = (const RM_VarPageHeader*)pData;
+        const RM_VarSlot* slots = (const RM_VarSlot*)(pData + sizeof(RM_VarPageHeader));
+        for (int slot = 0; slot < header->numSlots; ++slot) {
+            if (slots[slot].length & RM_VARSLOT_MOVED) {
+                RM_ForwardStub home;
+                memcpy(&home, pData + slots[slot].offset, sizeof(RM_ForwardStub));
+                rids.push_back(RID(home.pageNum, home.slotNum));
+            } else if (slots[slot].offset != 0) {
+                rids.push_back(RID(pageNum, slot));
+            }
+        }
+    } else {
+        char* bitmap = pData + sizeof(PageNum);
+        int slot = -1;
+        while ((slot = RM_FindBit(bitmap, slot + 1, fileHeader.numRecordsPerPage, true)) >= 0) {
+            rids.push_back(RID(pageNum, slot));
+        }
     }
-    if (!(pData[sizeof(PageNum) + slotNum / 8] & (1 << (slotNum & 7)))) {
-        return RM_RECORDNOTEXIST;
+    // unpin page
+    if ((rc = pfFileHandle.UnpinPage(pageNum))) {
+        return rc;
+    }
+    // success
+    return OK_RC;
+}
+
+RC RM_FileHandle::TrimPages(PageNum& lastPageNum) {
+    RC rc;
+    // check whether fileHandle is open
+    if (!isOpen) {
+        return RM_FILEHANDLECLOSED;
+    }
+    while (fileHeader.numPages > 1) {
+        PageNum pageNum = fileHeader.numPages - 1;
+        // stop at the last page holding a record
+        if (pageNum % RM_FSM_PAGES != 0) {
+            PF_PageHandle pageHandle;
+            if ((rc = pfFileHandle.GetThisPage(pageNum, pageHandle))) {
+                return rc;
+            }
+            char* pData;
+            if ((rc = pageHandle.GetData(pData))) {
+                return rc;
+            }
+            bool isEmpty = fileHeader.isVariable ? ((RM_VarPageHeader*)pData)->numSlots == 0 :
+                                                   *(int*)pData == fileHeader.numRecordsPerPage;
+            if ((rc = pfFileHandle.UnpinPage(pageNum))) {
+                return rc;
+            }
+            if (!isEmpty) {
+                break;
+            }
+        }
+        // dispose the pages from the end, so that the PF free list hands
+        // them out again in increasing order
+        SetPageFree(pageNum, false);
+        if ((rc = pfFileHandle.DisposePage(pageNum))) {
+            return rc;
+        }
+        fileHeader.numPages = pageNum;
+        isHeaderModified = true;
+    }
+    fsm.resize((fileHeader.numPages + 63) / 64);
+    if (zones.size() > (size_t)fileHeader.numPages * fileHeader.numZoneFields) {
+        zones.resize(fileHeader.numPages * fileHeader.numZoneFields);
+    }
+    lastPageNum = fileHeader.numPages - 1;
+    // success
+    return OK_RC;
+}
+
+RC RM_FileHandle::GetFreePage(PageNum& pageNum, char*& pData) {
+    RC rc;
+    // find the first page with a free slot in the free-space map
+    if ((rc = GetFirstFreePage(pageNum))) {
+        return rc;
+    }
+    if (pageNum != RM_NO_PAGE) {
+        // get pageHandle of the page
+        PF_PageHandle pageHandle;
+        if ((rc = pfFileHandle.GetThisPage(pageNum, pageHandle))) {
+            return rc;
+        }
+        // get data pointer of the page
+        if ((rc = pageHandle.GetData(pData))) {
+           return rc;
+        }
+        return OK_RC;
+    }
+    // allocate a new page
+    if ((rc = AllocatePage(pageNum, pData))) {
+        return rc;
+    }
+    // initialize the page
+    *(int*)pData = fileHeader.numRecordsPerPage;
+    for (int i = 0; i < fileHeader.bitmapSize; ++i) {
+        pData[sizeof(PageNum) + i] = 0xff;
+    }
+    for (int i = 0; i < fileHeader.numRecordsPerPage; ++i) {
+        pData[sizeof(PageNum) + i / 8] ^= 1 << (i & 7);
+    }
+    SetPageFree(pageNum, true);
+    return OK_RC;
+}
+
+RC RM_FileHandle::AllocatePage(PageNum& pageNum, char*& pData) {
+    RC rc;
+    // allocate a new page
+    PF_PageHandle pageHandle;
+    if ((rc = pfFileHandle.AllocatePage(pageHandle))) {
+        return rc;
+    }
+    // get pageNum of the page
+    if ((rc = pageHandle.GetPageNum(pageNum))) {
+        return rc;
+    }
+    // get data pointer of the page
+    if ((rc = pageHandle.GetData(pData))) {
+       return rc;
+    }
+    if (pageNum % RM_FSM_PAGES == 0) {
+        // the page holds the next part of the free-space map, the records
+        // go to the page after it
+        memset(pData, 0, PF_PAGE_SIZE);
+        if ((rc = pfFileHandle.MarkDirty(pageNum))) {
+            return rc;
+        }
+        if ((rc = pfFileHandle.UnpinPage(pageNum))) {
+            return rc;
+        }
+        if ((rc = pfFileHandle.AllocatePage(pageHandle))) {
+            return rc;
+        }
+        if ((rc = pageHandle.GetPageNum(pageNum))) {
+            return rc;
+        }
+        if ((rc = pageHandle.GetData(pData))) {
+           return rc;
+        }
+    }
+    fileHeader.numPages = pageNum + 1;
+    isHeaderModified = true;
+    return OK_RC;
+}
+
+RC RM_FileHandle::ReadFsm() {
+    RC rc;
+    fsm.assign((fileHeader.numPages + 63) / 64, 0);
+    for (PageNum mapPageNum = 0; mapPageNum < fileHeader.numPages; mapPageNum += RM_FSM_PAGES) {
+        // get the map page
+        PF_PageHandle pageHandle;
+        if ((rc = pfFileHandle.GetThisPage(mapPageNum, pageHandle))) {
+            return rc;
+        }
+        char* pData;
+        if ((rc = pageHandle.GetData(pData))) {
+            return rc;
+        }
+        // copy its part of the map
+        int first = mapPageNum / 64;
+        int nWords = (int)fsm.size() - first < RM_FSM_WORDS ? (int)fsm.size() - first : RM_FSM_WORDS;
+        memcpy(&fsm[first], pData + RM_FSM_OFFSET, nWords * sizeof(uint64_t));
+        if ((rc = pfFileHandle.UnpinPage(mapPageNum))) {
+            return rc;
+        }
+    }
+    fsmCursor = 0;
+    isFsmModified = false;
+    return OK_RC;
+}
+
+RC RM_FileHandle::WriteFsm() {
+    RC rc;
+    // check whether fsm is modified
+    if (!isFsmModified) {
+        return OK_RC;
+    }
+    for (PageNum mapPageNum = 0; mapPageNum < fileHeader.numPages; mapPageNum += RM_FSM_PAGES) {
+        // get the map page
+        PF_PageHandle pageHandle;
+        if ((rc = pfFileHandle.GetThisPage(mapPageNum, pageHandle))) {
+            return rc;
+        }
+        char* pData;
+        if ((rc = pageHandle.GetData(pData))) {
+            return rc;
+        }
+        // write back its part of the map, pages past the end have no bit
+        int first = mapPageNum / 64;
+        int nWords = (int)fsm.size() - first < RM_FSM_WORDS ? (int)fsm.size() - first : RM_FSM_WORDS;
+        memcpy(pData + RM_FSM_OFFSET, &fsm[first], nWords * sizeof(uint64_t));
+        memset(pData + RM_FSM_OFFSET + nWords * sizeof(uint64_t), 0, (RM_FSM_WORDS - nWords) * sizeof(uint64_t));
+        if ((rc = pfFileHandle.MarkDirty(mapPageNum))) {
+            return rc;
+        }
+        if ((rc = pfFileHandle.UnpinPage(mapPageNum))) {
+            return rc;
+        }
+    }
+    isFsmModified = false;
+    return OK_RC;
+}
+
+void RM_FileHandle::SetPageFree(PageNum pageNum, bool isFree) {
+    int w = pageNum / 64;
+    uint64_t bit = 1ULL << (pageNum & 63);
+    if (w >= (int)fsm.size()) {
+        fsm.resize(w + 1, 0);
+    }
+    if (((fsm[w] & bit) != 0) == isFree) {
+        return;
+    }
+    fsm[w] ^= bit;
+    if (isFree && w < fsmCursor) {
+        fsmCursor = w;
+    }
+    isFsmModified = true;
+}
+
+RC RM_FileHandle::ReadZones() {
+    RC rc;
+    int numFields = fileHeader.numZoneFields;
+    int numPageEntries = RM_ZONE_PAGEENTRIES(numFields) * numFields;
+    zones.assign(fileHeader.numZonePages * numPageEntries, RM_ZoneEntry());
+    isZonePageModified.assign(fileHeader.numZonePages, false);
+    for (PageNum zonePageNum = 0; zonePageNum < fileHeader.numZonePages; ++zonePageNum) {
+        // get the zone map page
+        PF_PageHandle pageHandle;
+        if ((rc = zoneFileHandle.GetThisPage(zonePageNum, pageHandle))) {
+            return rc;
+        }
+        char* pData;
+        if ((rc = pageHandle.GetData(pData))) {
+            return rc;
+        }
+        // copy its part of the map
+        memcpy(&zones[zonePageNum * numPageEntries], pData, numPageEntries * sizeof(RM_ZoneEntry));
+        if ((rc = zoneFileHandle.UnpinPage(zonePageNum))) {
+            return rc;
+        }
+    }
+    return OK_RC;
+}
+
+RC RM_FileHandle::WriteZones() {
+    RC rc;
+    int numFields = fileHeader.numZoneFields;
+    if (numFields == 0) {
+        return OK_RC;
+    }
+    int numPageEntries = RM_ZONE_PAGEENTRIES(numFields) * numFields;
+    for (PageNum zonePageNum = 0; zonePageNum < (int)isZonePageModified.size(); ++zonePageNum) {
+        // check whether the zone map page is modified
+        if (!isZonePageModified[zonePageNum]) {
+            continue;
+        }
+        // allocate the zone map pages up to this one, they are never disposed
+        PF_PageHandle pageHandle;
+        char* pData;
+        while (fileHeader.numZonePages <= zonePageNum) {
+            if ((rc = zoneFileHandle.AllocatePage(pageHandle))) {
+                return rc;
+            }
+            if ((rc = pageHandle.GetData(pData))) {
+                return rc;
+            }
+            memset(pData, 0, PF_PAGE_SIZE);
+            if ((rc = zoneFileHandle.MarkDirty(fileHeader.numZonePages))) {
+                return rc;
+            }
+            if ((rc = zoneFileHandle.UnpinPage(fileHeader.numZonePages))) {
+                return rc;
+            }
+            ++fileHeader.numZonePages;
+            isHeaderModified = true;
+        }
+        // get the zone map page
+        if ((rc = zoneFileHandle.GetThisPage(zonePageNum, pageHandle))) {
+            return rc;
+        }
+        if ((rc = pageHandle.GetData(pData))) {
+            return rc;
+        }
+        // write back its part of the map, pages past the end have no records
+        int first = zonePageNum * numPageEntries;
+        int nEntries = (int)zones.size() - first < numPageEntries ? (int)zones.size() - first : numPageEntries;
+        if (nEntries < 0) {
+            nEntries = 0;
+        }
+        memset(pData, 0, PF_PAGE_SIZE);
+        if (nEntries > 0) {
+            memcpy(pData, &zones[first], nEntries * sizeof(RM_ZoneEntry));
+        }
+        if ((rc = zoneFileHandle.MarkDirty(zonePageNum))) {
+            return rc;
+        }
+        if ((rc = zoneFileHandle.UnpinPage(zonePageNum))) {
+            return rc;
+        }
+        isZonePageModified[zonePageNum] = false;
+    }
+    return OK_RC;
+}
+
+void RM_FileHandle::ZoneAdd(PageNum pageNum, const char* pRecData) {
+    int numFields = fileHeader.numZoneFields;
+    if (numFields == 0) {
+        return;
+    }
+    if (zones.size() < (size_t)(pageNum + 1) * numFields) {
+        zones.resize((pageNum + 1) * numFields, RM_ZoneEntry());
+    }
+    for (int i = 0; i < numFields; ++i) {
+        RM_ZoneEntry& entry = zones[pageNum * numFields + i];
+        const RM_ZoneField& field = fileHeader.zoneFields[i];
+        // the value bytes of a null value are kept in the range as well,
+        // since the scans compare them like any other value
+        char value[1 + sizeof(int)];
+        memcpy(value, pRecData + field.offset, sizeof(value));
+        if (value[0] == 0) {
+            ++entry.numNulls;
+        }
+        value[0] = 1;
+        if (entry.numRecords++ == 0) {
+            memcpy(entry.minValue, value, sizeof(value));
+            memcpy(entry.maxValue, value, sizeof(value));
+        } else if (Attr::CompareAttr((AttrType)field.attrType, sizeof(int), value, LT_OP, entry.minValue)) {
+            memcpy(entry.minValue, value, sizeof(value));
+        } else if (Attr::CompareAttr((AttrType)field.attrType, sizeof(int), value, GT_OP, entry.maxValue)) {
+            memcpy(entry.maxValue, value, sizeof(value));
+        }
+    }
+    int zonePageNum = pageNum / RM_ZONE_PAGEENTRIES(numFields);
+    if (zonePageNum >= (int)isZonePageModified.size()) {
+        isZonePageModified.resize(zonePageNum + 1, false);
+    }
+    isZonePageModified[zonePageNum] = true;
+}
+
+void RM_FileHandle::ZoneRemove(PageNum pageNum, const char* pRecData) {
+    int numFields = fileHeader.numZoneFields;
+    if (numFields == 0 || zones.size() < (size_t)(pageNum + 1) * numFields) {
+        return;
+    }
+    for (int i = 0; i < numFields; ++i) {
+        RM_ZoneEntry& entry = zones[pageNum * numFields + i];
+        // the range is not narrowed, it is reset when the page is empty
+        if (pRecData[fileHeader.zoneFields[i].offset] == 0) {
+            --entry.numNulls;
+        }
+        if (--entry.numRecords == 0) {
+            entry = RM_ZoneEntry();
+        }
+    }
+    isZonePageModified[pageNum / RM_ZONE_PAGEENTRIES(numFields)] = true;
+}
+
+bool RM_FileHandle::ZoneMayMatch(PageNum pageNum, const std::vector<RM_ZoneCondition>& conditions) const {
+    int numFields = fileHeader.numZoneFields;
+    if (numFields == 0) {
+        return true;
+    }
+    // a page without an entry has no records
+    if (zones.size() < (size_t)(pageNum + 1) * numFields) {
+        return false;
+    }
+    for (const auto& condition : conditions) {
+        const RM_ZoneEntry& entry = zones[pageNum * numFields + condition.fieldNo];
+        if (entry.numRecords == 0) {
+            return false;
+        }
+        // a null value only matches (or, with NE_OP, does not match) null values
+        if (condition.value[0] == 0) {
+            if (condition.compOp == NE_OP ? entry.numRecords == entry.numNulls : entry.numNulls == 0) {
+                return false;
+            }
+            continue;
+        }
+        AttrType attrType = (AttrType)fileHeader.zoneFields[condition.fieldNo].attrType;
+        void* minValue = (void*)entry.minValue;
+        void* maxValue = (void*)entry.maxValue;
+        void* value = (void*)condition.value;
+        bool mayMatch = true;
+        switch (condition.compOp) {
+            case EQ_OP:
+                mayMatch = Attr::CompareAttr(attrType, sizeof(int), minValue, LE_OP, value) &&
+                           Attr::CompareAttr(attrType, sizeof(int), maxValue, GE_OP, value);
+                break;
+            case NE_OP:
+                mayMatch = !Attr::CompareAttr(attrType, sizeof(int), minValue, EQ_OP, value) ||
+                           !Attr::CompareAttr(attrType, sizeof(int), maxValue, EQ_OP, value);
+                break;
+            case LT_OP:
+                mayMatch = Attr::CompareAttr(attrType, sizeof(int), minValue, LT_OP, value);
+                break;
+            case LE_OP:
+                mayMatch = Attr::CompareAttr(attrType, sizeof(int), minValue, LE_OP, value);
+                break;
+            case GT_OP:
+                mayMatch = Attr::CompareAttr(attrType, sizeof(int), maxValue, GT_OP, value);
+                break;
+            case GE_OP:
+                mayMatch = Attr::CompareAttr(attrType, sizeof(int), maxValue, GE_OP, value);
+                break;
+            default:
+                break;
+        }
+        if (!mayMatch) {
+            return false;
+        }
+    }
+    return true;
+}
+
+RC RM_FileHandle::CheckRecExist(const RID& rid, PageNum& pageNum, SlotNum& slotNum, char*& pData) const {
+    RC rc;
+    // check whether rid is legal
+    if ((rc = rid.GetPageNum(pageNum))) {
+        return rc;
+    }
+    if ((rc = rid.GetSlotNum(slotNum))) {
+        return rc;
+    }
+    // the header page and the free-space map pages hold no records
+    if (pageNum % RM_FSM_PAGES == 0) {
+        return RM_RECORDNOTEXIST;
+    }
+    // get pageHandle
+    PF_PageHandle pageHandle;
+    if ((rc = pfFileHandle.GetThisPage(pageNum, pageHandle))) {
+        return rc;
+    }
+    // get data pointer of the page
+    if ((rc = pageHandle.GetData(pData))) {
+        return rc;
+    }
+    // check whether record with given rid is exist, an overflow page has
+    // no slot and a moved record is reached from the slot it is moved from
+    bool isExist;
+    if (fileHeader.isVariable) {
+        const RM_VarSlot* slots = (const RM_VarSlot*)(pData + sizeof(RM_VarPageHeader));
+        isExist = slotNum >= 0 && slotNum < ((RM_VarPageHeader*)pData)->numSlots && slots[slotNum].offset != 0 &&
+                  !(slots[slotNum].length & RM_VARSLOT_MOVED);
+    } else {
+        isExist = slotNum >= 0 && slotNum < fileHeader.numRecordsPerPage &&
+                  (pData[sizeof(PageNum) + slotNum / 8] & (1 << (slotNum & 7)));
+    }
+    if (!isExist) {
+        if ((rc = pfFileHandle.UnpinPage(pageNum))) {
+            return rc;
+        }
+        return RM_RECORDNOTEXIST;
+    }
+    // success
+    return OK_RC;
+}
+
+int RM_FileHandle::MaxVarRecLength() const {
+    // each attribute in varFields takes a length byte more at most
+    return fileHeader.recordSize + fileHeader.numVarFields;
+}
+
+int RM_FileHandle::EncodeVarRec(const char* pRecData) {
+    // the record is stored as is, except that the value of each attribute
+    // in varFields is stored as a length byte and the string (nothing if
+    // the value is null); the buffer is never shorter than a stub
+    varBuffer.resize(MaxVarRecLength() + RM_VAR_MINLENGTH);
+    char* pEncoded = &varBuffer[0];
+    int length = 0;
+    int pos = 0;
+    for (int i = 0; i < fileHeader.numVarFields; ++i) {
+        const RM_VarField& field = fileHeader.varFields[i];
+        memcpy(pEncoded + length, pRecData + pos, field.offset - pos);
+        length += field.offset - pos;
+        pEncoded[length++] = pRecData[field.offset];
+        if (pRecData[field.offset]) {
+            int n = strnlen(pRecData + field.offset + 1, field.length);
+            pEncoded[length++] = (unsigned char)n;
+            memcpy(pEncoded + length, pRecData + field.offset + 1, n);
+            length += n;
+        }
+        pos = field.offset + 1 + field.length;
+    }
+    memcpy(pEncoded + length, pRecData + pos, fileHeader.recordSize - pos);
+    return length + fileHeader.recordSize - pos;
+}
+
+RC RM_FileHandle::ReadVarRec(const char* pData, SlotNum slotNum, char* pRecData) const {
+    RC rc;
+    const RM_VarSlot& slot = ((const RM_VarSlot*)(pData + sizeof(RM_VarPageHeader)))[slotNum];
+    const char* pEncoded = pData + slot.offset;
+    // gather a record in overflow pages, or copy a record moved to another
+    // page
+    std::vector<char> overflow;
+    if (slot.length & RM_VARSLOT_FORWARD) {
+        RM_ForwardStub stub;
+        memcpy(&stub, pEncoded, sizeof(RM_ForwardStub));
+        PF_PageHandle pageHandle;
+        if ((rc = pfFileHandle.GetThisPage(stub.pageNum, pageHandle))) {
+            return rc;
+        }
+        char* pMoved;
+        if ((rc = pageHandle.GetData(pMoved))) {
+            return rc;
+        }
+        // skip the RID the record is moved from
+        const RM_VarSlot& moved = ((const RM_VarSlot*)(pMoved + sizeof(RM_VarPageHeader)))[stub.slotNum];
+        overflow.assign(pMoved + moved.offset + sizeof(RM_ForwardStub), pMoved + moved.offset + (moved.length & RM_VARSLOT_LENGTH));
+        if ((rc = pfFileHandle.UnpinPage(stub.pageNum))) {
+            return rc;
+        }
+        pEncoded = &overflow[0];
+    } else if (slot.length & RM_VARSLOT_OVERFLOW) {
+        RM_OverflowStub stub;
+        memcpy(&stub, pEncoded, sizeof(RM_OverflowStub));
+        overflow.resize(stub.length);
+        int length = 0;
+        PageNum pageNum = stub.firstPageNum;
+        while (pageNum != RM_NO_PAGE) {
+            PF_PageHandle pageHandle;
+            if ((rc = pfFileHandle.GetThisPage(pageNum, pageHandle))) {
+                return rc;
+            }
+            char* pOverflow;
+            if ((rc = pageHandle.GetData(pOverflow))) {
+                return rc;
+            }
+            const RM_OverflowPageHeader* header = (const RM_OverflowPageHeader*)pOverflow;
+            memcpy(&overflow[length], pOverflow + sizeof(RM_OverflowPageHeader), header->length);
+            length += header->length;
+            PageNum nextPageNum = header->nextPageNum;
+            if ((rc = pfFileHandle.UnpinPage(pageNum))) {
+                return rc;
+            }
+            pageNum = nextPageNum;
+        }
+        pEncoded = &overflow[0];
+    }
+    // decode the record, the strings are padded with zeros
+    int length = 0;
+    int pos = 0;
+    for (int i = 0; i < fileHeader.numVarFields; ++i) {
+        const RM_VarField& field = fileHeader.varFields[i];
+        memcpy(pRecData + pos, pEncoded + length, field.offset - pos);
+        length += field.offset - pos;
+        pRecData[field.offset] = pEncoded[length++];
+        memset(pRecData + field.offset + 1, 0, field.length);
+        if (pRecData[field.offset]) {
+            int n = (unsigned char)pEncoded[length++];
+            memcpy(pRecData + field.offset + 1, pEncoded + length, n);
+            length += n;
+        }
+        pos = field.offset + 1 + field.length;
+    }
+    memcpy(pRecData + pos, pEncoded + length, fileHeader.recordSize - pos);
+    return OK_RC;
+}
+
+RC RM_FileHandle::PlaceVarRec(PageNum pageNum, char* pData, SlotNum slotNum, int length, bool isOutside) {
+    RC rc;
+    if (!isOutside) {
+        RM_PutVarSlot(pData, slotNum, &varBuffer[0], length > RM_VAR_MINLENGTH ? length : RM_VAR_MINLENGTH, 0);
+        return OK_RC;
+    }
+    if (length + (int)sizeof(RM_ForwardStub) <= RM_VAR_MAXINLINE) {
+        // move the record to another page, after the RID it is moved from
+        std::vector<char> moved(sizeof(RM_ForwardStub) + length);
+        RM_ForwardStub home = {pageNum, slotNum};
+        memcpy(&moved[0], &home, sizeof(RM_ForwardStub));
+        memcpy(&moved[sizeof(RM_ForwardStub)], &varBuffer[0], length);
+        RM_ForwardStub stub;
+        char* pMoved;
+        if ((rc = FindVarPage(moved.size(), pageNum, stub.pageNum, pMoved, stub.slotNum))) {
+            return rc;
+        }
+        RM_PutVarSlot(pMoved, stub.slotNum, &moved[0], moved.size(), RM_VARSLOT_MOVED);
+        SetVarPageFree(stub.pageNum, pMoved);
+        if ((rc = pfFileHandle.MarkDirty(stub.pageNum))) {
+            return rc;
+        }
+        if ((rc = pfFileHandle.UnpinPage(stub.pageNum))) {
+            return rc;
+        }
+        RM_PutVarSlot(pData, slotNum, (const char*)&stub, sizeof(RM_ForwardStub), RM_VARSLOT_FORWARD);
+        return OK_RC;
+    }
+    // write the record to overflow pages from its end, so that each page
+    // can point to the next one
+    RM_OverflowStub stub;
+    stub.firstPageNum = RM_NO_PAGE;
+    stub.length = length;
+    for (int begin = (length - 1) / RM_OVERFLOW_CAPACITY * RM_OVERFLOW_CAPACITY; begin >= 0; begin -= RM_OVERFLOW_CAPACITY) {
+        PageNum overflowPageNum;
+        char* pOverflow;
+        if ((rc = AllocatePage(overflowPageNum, pOverflow))) {
+            return rc;
+        }
+        RM_OverflowPageHeader* header = (RM_OverflowPageHeader*)pOverflow;
+        header->freeBytes = 0;
+        header->numSlots = RM_OVERFLOWPAGE;
+        header->length = length - begin < RM_OVERFLOW_CAPACITY ? length - begin : RM_OVERFLOW_CAPACITY;
+        header->nextPageNum = stub.firstPageNum;
+        memcpy(pOverflow + sizeof(RM_OverflowPageHeader), &varBuffer[begin], header->length);
+        SetPageFree(overflowPageNum, false);
+        if ((rc = pfFileHandle.MarkDirty(overflowPageNum))) {
+            return rc;
+        }
+        if ((rc = pfFileHandle.UnpinPage(overflowPageNum))) {
+            return rc;
+        }
+        stub.firstPageNum = overflowPageNum;
+    }
+    RM_PutVarSlot(pData, slotNum, (const char*)&stub, sizeof(RM_OverflowStub), RM_VARSLOT_OVERFLOW);
+    return OK_RC;
+}
+
+RC RM_FileHandle::FreeVarRec(char* pData, SlotNum slotNum) {
+    RC rc;
+    RM_VarPageHeader* header = (RM_VarPageHeader*)pData;
+    RM_VarSlot& slot = ((RM_VarSlot*)(pData + sizeof(RM_VarPageHeader)))[slotNum];
+    // free the record moved to another page
+    if (slot.length & RM_VARSLOT_FORWARD) {
+        RM_ForwardStub stub;
+        memcpy(&stub, pData + slot.offset, sizeof(RM_ForwardStub));
+        PF_PageHandle pageHandle;
+        if ((rc = pfFileHandle.GetThisPage(stub.pageNum, pageHandle))) {
+            return rc;
+        }
+        char* pMoved;
+        if ((rc = pageHandle.GetData(pMoved))) {
+            return rc;
+        }
+        if ((rc = FreeVarRec(pMoved, stub.slotNum))) {
+            return rc;
+        }
+        RM_TrimVarSlots(pMoved);
+        SetVarPageFree(stub.pageNum, pMoved);
+        if ((rc = pfFileHandle.MarkDirty(stub.pageNum))) {
+            return rc;
+        }
+        if ((rc = pfFileHandle.UnpinPage(stub.pageNum))) {
+            return rc;
+        }
+    }
+    // the overflow pages of the record become empty slotted pages
+    if (slot.length & RM_VARSLOT_OVERFLOW) {
+        RM_OverflowStub stub;
+        memcpy(&stub, pData + slot.offset, sizeof(RM_OverflowStub));
+        PageNum pageNum = stub.firstPageNum;
+        while (pageNum != RM_NO_PAGE) {
+            PF_PageHandle pageHandle;
+            if ((rc = pfFileHandle.GetThisPage(pageNum, pageHandle))) {
+                return rc;
+            }
+            char* pOverflow;
+            if ((rc = pageHandle.GetData(pOverflow))) {
+                return rc;
+            }
+            PageNum nextPageNum = ((RM_OverflowPageHeader*)pOverflow)->nextPageNum;
+            RM_InitVarPage(pOverflow);
+            SetVarPageFree(pageNum, pOverflow);
+            if ((rc = pfFileHandle.MarkDirty(pageNum))) {
+                return rc;
+            }
+            if ((rc = pfFileHandle.UnpinPage(pageNum))) {
+                return rc;
+            }
+            pageNum = nextPageNum;
+        }
+    }
+    // free the room of the record, at once if it is the lowest one
+    int length = slot.length & RM_VARSLOT_LENGTH;
+    if (slot.offset == header->heapOffset) {
+        header->heapOffset += length;
+    }
+    header->freeBytes += length;
+    slot.offset = 0;
+    slot.length = 0;
+    return OK_RC;
+}
+
+RC RM_FileHandle::SpillVarRec(PageNum pageNum, char* pData, SlotNum exceptSlot, bool& isSpilled) {
+    RC rc;
+    // find the largest record of the page kept in its own slot
+    const RM_VarPageHeader* header = (const RM_VarPageHeader*)pData;
+    const RM_VarSlot* slots = (const RM_VarSlot*)(pData + sizeof(RM_VarPageHeader));
+    SlotNum slotNum = -1;
+    int length = RM_VAR_MINLENGTH;
+    for (int i = 0; i < header->numSlots; ++i) {
+        if (i != exceptSlot && slots[i].offset != 0 && (slots[i].length & ~RM_VARSLOT_LENGTH) == 0 && slots[i].length > length) {
+            slotNum = i;
+            length = slots[i].length;
+        }
+    }
+    isSpilled = slotNum != -1;
+    if (!isSpilled) {
+        return OK_RC;
+    }
+    // move it out of the page, leaving a stub in its slot
+    varBuffer.resize(length);
+    memcpy(&varBuffer[0], pData + slots[slotNum].offset, length);
+    if ((rc = FreeVarRec(pData, slotNum))) {
+        return rc;
+    }
+    return PlaceVarRec(pageNum, pData, slotNum, length, true);
+}
+
+RC RM_FileHandle::RelocateVarRec(PageNum pageNum, char* pData, SlotNum slotNum) {
+    RC rc;
+    // take the record out of its slot
+    const RM_VarSlot& slot = ((const RM_VarSlot*)(pData + sizeof(RM_VarPageHeader)))[slotNum];
+    int length = (slot.length & RM_VARSLOT_LENGTH) - sizeof(RM_ForwardStub);
+    int bodyLength = length > RM_VAR_MINLENGTH ? length : RM_VAR_MINLENGTH;
+    std::vector<char> moved(sizeof(RM_ForwardStub) + bodyLength);
+    memcpy(&moved[0], pData + slot.offset, sizeof(RM_ForwardStub) + length);
+    RM_ForwardStub home;
+    memcpy(&home, &moved[0], sizeof(RM_ForwardStub));
+    if ((rc = FreeVarRec(pData, slotNum))) {
+        return rc;
+    }
+    // take the stub out of the slot the record is moved from
+    PF_PageHandle pageHandle;
+    if ((rc = pfFileHandle.GetThisPage(home.pageNum, pageHandle))) {
+        return rc;
+    }
+    char* pHome;
+    if ((rc = pageHandle.GetData(pHome))) {
+        return rc;
+    }
+    ((RM_VarSlot*)(pHome + sizeof(RM_VarPageHeader)))[home.slotNum].length &= RM_VARSLOT_LENGTH;
+    if ((rc = FreeVarRec(pHome, home.slotNum))) {
+        return rc;
+    }
+    // put the record back there if it fits, else into a third page
+    if (RM_VarPageFits(pHome, home.slotNum, bodyLength)) {
+        RM_PutVarSlot(pHome, home.slotNum, &moved[sizeof(RM_ForwardStub)], bodyLength, 0);
+    } else {
+        RM_ForwardStub stub;
+        char* pMoved;
+        if ((rc = FindVarPage(sizeof(RM_ForwardStub) + length, pageNum, stub.pageNum, pMoved, stub.slotNum))) {
+            return rc;
+        }
+        RM_PutVarSlot(pMoved, stub.slotNum, &moved[0], sizeof(RM_ForwardStub) + length, RM_VARSLOT_MOVED);
+        SetVarPageFree(stub.pageNum, pMoved);
+        if ((rc = pfFileHandle.MarkDirty(stub.pageNum))) {
+            return rc;
+        }
+        if ((rc = pfFileHandle.UnpinPage(stub.pageNum))) {
+            return rc;
+        }
+        RM_PutVarSlot(pHome, home.slotNum, (const char*)&stub, sizeof(RM_ForwardStub), RM_VARSLOT_FORWARD);
+    }
+    SetVarPageFree(home.pageNum, pHome);
+    if ((rc = pfFileHandle.MarkDirty(home.pageNum))) {
+        return rc;
+    }
+    return pfFileHandle.UnpinPage(home.pageNum);
+}
+
+void RM_FileHandle::SetVarPageFree(PageNum pageNum, const char* pData) {
+    // a page is free if any record fits into it
+    int maxLength = MaxVarRecLength();
+    if (maxLength > RM_VAR_MAXINLINE) {
+        maxLength = RM_VAR_MAXINLINE;
+    }
+    if (maxLength < RM_VAR_MINLENGTH) {
+        maxLength = RM_VAR_MINLENGTH;
+    }
+    SetPageFree(pageNum, ((const RM_VarPageHeader*)pData)->freeBytes >= maxLength + (int)sizeof(RM_VarSlot));
+}
+
+RC RM_FileHandle::FindVarPage(int bodyLength, PageNum exceptPage, PageNum& pageNum, char*& pData, SlotNum& slotNum) {
+    RC rc;
+    // take the first page any record fits into, else the last page if this
+    // record fits into it, else a new page
+    if ((rc = GetFirstFreePage(pageNum))) {
+        return rc;
+    }
+    if ((pageNum == RM_NO_PAGE || pageNum == exceptPage) && fileHeader.numPages > 1 && (fileHeader.numPages - 1) % RM_FSM_PAGES != 0) {
+        pageNum = fileHeader.numPages - 1;
+    }
+    pData = NULL;
+    if (pageNum != RM_NO_PAGE && pageNum != exceptPage) {
+        PF_PageHandle pageHandle;
+        if ((rc = pfFileHandle.GetThisPage(pageNum, pageHandle))) {
+            return rc;
+        }
+        if ((rc = pageHandle.GetData(pData))) {
+            return rc;
+        }
+        slotNum = RM_FindFreeSlot(pData);
+        if (!RM_VarPageFits(pData, slotNum, bodyLength)) {
+            if ((rc = pfFileHandle.UnpinPage(pageNum))) {
+                return rc;
+            }
+            pData = NULL;
+        }
+    }
+    if (pData == NULL) {
+        if ((rc = AllocatePage(pageNum, pData))) {
+            return rc;
+        }
+        RM_InitVarPage(pData);
+        slotNum = 0;
+    }
+    // success
+    return OK_RC;
+}
+
+RC RM_FileHandle::InsertVarRec(const char* pRecData, RID& rid) {
+    RC rc;
+    int length = EncodeVarRec(pRecData);
+    bool isOverflow = length > RM_VAR_MAXINLINE;
+    int bodyLength = isOverflow || length < RM_VAR_MINLENGTH ? RM_VAR_MINLENGTH : length;
+    // find a page with room for the record, or for a stub
+    PageNum pageNum;
+    char* pData;
+    SlotNum slotNum;
+    if ((rc = FindVarPage(bodyLength, RM_NO_PAGE, pageNum, pData, slotNum))) {
+        return rc;
+    }
+    // insert the record
+    if ((rc = PlaceVarRec(pageNum, pData, slotNum, length, isOverflow))) {
+        return rc;
+    }
+    SetVarPageFree(pageNum, pData);
+    rid.pageNum = pageNum;
+    rid.slotNum = slotNum;
+    // mark page dirty
+    if ((rc = pfFileHandle.MarkDirty(pageNum))) {
+        return rc;
+    }
+    // unpin page
+    if ((rc = pfFileHandle.UnpinPage(pageNum))) {
+        return rc;
+    }
+    // success
+    return OK_RC;
+}
+
+RC RM_FileHandle::InsertVarRecAt(const char* pRecData, const RID& rid) {
+    RC rc;
+    // check whether rid is legal
+    PageNum pageNum;
+    SlotNum slotNum;
+    if ((rc = rid.GetPageNum(pageNum))) {
+        return rc;
+    }
+    if ((rc = rid.GetSlotNum(slotNum))) {
+        return rc;
+    }
+    if (pageNum % RM_FSM_PAGES == 0 || slotNum < 0) {
+        return RM_RECORDNOTEXIST;
+    }
+    // get data pointer of the page
+    PF_PageHandle pageHandle;
+    if ((rc = pfFileHandle.GetThisPage(pageNum, pageHandle))) {
+        return rc;
+    }
+    char* pData;
+    if ((rc = pageHandle.GetData(pData))) {
+        return rc;
+    }
+    // the slot must be free, a record moved there from another page is
+    // moved on
+    const RM_VarPageHeader* header = (const RM_VarPageHeader*)pData;
+    const RM_VarSlot* slots = (const RM_VarSlot*)(pData + sizeof(RM_VarPageHeader));
+    if (header->numSlots != RM_OVERFLOWPAGE && slotNum < header->numSlots && slots[slotNum].offset != 0) {
+        if (!(slots[slotNum].length & RM_VARSLOT_MOVED)) {
+            if ((rc = pfFileHandle.UnpinPage(pageNum))) {
+                return rc;
+            }
+            return RM_RECORDEXIST;
+        }
+        if ((rc = RelocateVarRec(pageNum, pData, slotNum))) {
+            return rc;
+        }
+    }
+    // insert the record, out of its page if the page is short of room;
+    // when even a stub does not fit (records grown in place since the slot
+    // was freed), move other records out of the page
+    int length = EncodeVarRec(pRecData);
+    int bodyLength = length < RM_VAR_MINLENGTH ? RM_VAR_MINLENGTH : length;
+    bool isOutside = length > RM_VAR_MAXINLINE || !RM_VarPageFits(pData, slotNum, bodyLength);
+    if (isOutside && !RM_VarPageFits(pData, slotNum, RM_VAR_MINLENGTH)) {
+        while (!RM_VarPageFits(pData, slotNum, RM_VAR_MINLENGTH)) {
+            bool isSpilled;
+            if ((rc = SpillVarRec(pageNum, pData, slotNum, isSpilled))) {
+                return rc;
+            }
+            if (!isSpilled) {
+                if ((rc = pfFileHandle.UnpinPage(pageNum))) {
+                    return rc;
+                }
+                return RM_PAGEFULL;
+            }
+        }
+        length = EncodeVarRec(pRecData);
+    }
+    if ((rc = PlaceVarRec(pageNum, pData, slotNum, length, isOutside))) {
+        return rc;
+    }
+    SetVarPageFree(pageNum, pData);
+    // mark page dirty
+    if ((rc = pfFileHandle.MarkDirty(pageNum))) {
+        return rc;
+    }
+    // unpin page
+    if ((rc = pfFileHandle.UnpinPage(pageNum))) {
+        return rc;
+    }
+    // success
+    return OK_RC;
+}
+
+RC RM_FileHandle::DeleteVarRec(const RID& rid) {
+    RC rc;
+    // check whether record with given rid is exist and get its info if exist
+    PageNum pageNum;
+    SlotNum slotNum;
+    char* pData;
+    if ((rc = CheckRecExist(rid, pageNum, slotNum, pData))) {
+        return rc;
+    }
+    // free the record and the free slots at the end of the directory
+    if ((rc = FreeVarRec(pData, slotNum))) {
+        return rc;
+    }
+    RM_TrimVarSlots(pData);
+    SetVarPageFree(pageNum, pData);
+    // mark page dirty
+    if ((rc = pfFileHandle.MarkDirty(pageNum))) {
+        return rc;
+    }
+    // unpin page
+    if ((rc = pfFileHandle.UnpinPage(pageNum))) {
+        return rc;
+    }
+    // success
+    return OK_RC;
+}
+
+RC RM_FileHandle::UpdateVarRec(const RM_Record& rec) {
+    RC rc;
+    // check whether rec has been read and get its rid if success
+    RID rid;
+    if ((rc = rec.GetRid(rid))) {
+        return rc;
+    }
+    // check whether record with given rid is exist and get its info if exist
+    PageNum pageNum;
+    SlotNum slotNum;
+    char* pData;
+    if ((rc = CheckRecExist(rid, pageNum, slotNum, pData))) {
+        return rc;
+    }
+    // replace the record in its slot, a record outgrowing its page moves
+    // out of it (the room of the old record always holds a stub)
+    int length = EncodeVarRec(rec.pData);
+    if ((rc = FreeVarRec(pData, slotNum))) {
+        return rc;
+    }
+    int bodyLength = length < RM_VAR_MINLENGTH ? RM_VAR_MINLENGTH : length;
+    bool isOutside = length > RM_VAR_MAXINLINE || !RM_VarPageFits(pData, slotNum, bodyLength);
+    if ((rc = PlaceVarRec(pageNum, pData, slotNum, length, isOutside))) {
+        return rc;
+    }
+    SetVarPageFree(pageNum, pData);
+    // mark page dirty
+    if ((rc = pfFileHandle.MarkDirty(pageNum))) {
+        return rc;
+    }
+    // unpin page
+    if ((rc = pfFileHandle.UnpinPage(pageNum))) {
+        return rc;
     }
     // success
     return OK_RC;
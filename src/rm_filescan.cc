@@ -7,11 +7,31 @@
 #include "rm.h"
 #include <cstring>
 
+// Add a condition comparing the attribute at given offset with a value to
+// the zone conditions if the attribute is kept in the zone map.
+static void RM_AddZoneCondition(const RM_FileHeader& fileHeader, int offset, CompOp compOp, const void* value,
+                                std::vector<RM_ZoneCondition>& zoneConditions) {
+    if (compOp == NO_OP || value == NULL) {
+        return;
+    }
+    for (int i = 0; i < fileHeader.numZoneFields; ++i) {
+        if (fileHeader.zoneFields[i].offset == offset) {
+            RM_ZoneCondition condition = {i, compOp, (const char*)value};
+            zoneConditions.push_back(condition);
+            return;
+        }
+    }
+}
+
 RM_FileScan::RM_FileScan() {
     isOpen = RM_SCANSTATUS_CLOSE;
 }
 
 RM_FileScan::~RM_FileScan() {
+    // unpin the current page of a scan left open on an error path
+    if (isOpen != RM_SCANSTATUS_CLOSE) {
+        CloseScan();
+    }
 }
 
 RC RM_FileScan::OpenScan(const RM_FileHandle& fileHandle, AttrType attrType, int attrLength,
@@ -30,6 +50,7 @@ RC RM_FileScan::OpenScan(const RM_FileHandle& fileHandle, AttrType attrType, int
         return RM_ATTRINVALID;
     }
     // copy the parameters
+    this->fileHandle = &fileHandle;
     this->fileHeader = fileHandle.fileHeader;
     this->pfFileHandle = fileHandle.pfFileHandle;
     this->attrType = attrType;
@@ -37,6 +58,8 @@ RC RM_FileScan::OpenScan(const RM_FileHandle& fileHandle, AttrType attrType, int
     this->attrOffset = attrOffset;
     this->compOp = compOp;
     this->value = value;
+    zoneConditions.clear();
+    RM_AddZoneCondition(fileHeader, attrOffset, compOp, value, zoneConditions);
     // get first page
     if ((rc = pfFileHandle.GetFirstPage(pageHandle))) {
         return rc;
@@ -44,7 +67,10 @@ RC RM_FileScan::OpenScan(const RM_FileHandle& fileHandle, AttrType attrType, int
     if ((rc = pageHandle.GetPageNum(pageNum))) {
         return rc;
     }
-    slotNum = fileHeader.numRecordsPerPage - 1;
+    // the header page has no slot
+    numSlots = 0;
+    slotNum = -1;
+    varRecord.resize(fileHeader.isVariable ? fileHeader.recordSize : 0);
     // success
     isOpen = RM_SCANSTATUS_SINGLE;
     isEOF = false;
@@ -62,9 +88,16 @@ RC RM_FileScan::OpenScan(const RM_FileHandle& fileHandle, const std::vector<Full
         return RM_FILEHANDLECLOSED;
     }
     // copy the parameters
+    this->fileHandle = &fileHandle;
     this->fileHeader = fileHandle.fileHeader;
     this->pfFileHandle = fileHandle.pfFileHandle;
     this->conditions = conditions;
+    zoneConditions.clear();
+    for (const auto& condition : this->conditions) {
+        if (!condition.bRhsIsAttr) {
+            RM_AddZoneCondition(fileHeader, condition.lhsAttr.offset, condition.op, condition.rhsValue.data, zoneConditions);
+        }
+    }
     // get first page
     if ((rc = pfFileHandle.GetFirstPage(pageHandle))) {
         return rc;
@@ -72,7 +105,10 @@ RC RM_FileScan::OpenScan(const RM_FileHandle& fileHandle, const std::vector<Full
     if ((rc = pageHandle.GetPageNum(pageNum))) {
         return rc;
     }
-    slotNum = fileHeader.numRecordsPerPage - 1;
+    // the header page has no slot
+    numSlots = 0;
+    slotNum = -1;
+    varRecord.resize(fileHeader.isVariable ? fileHeader.recordSize : 0);
     // success
     isOpen = RM_SCANSTATUS_MULTIPLE;
     isEOF = false;
@@ -93,11 +129,23 @@ RC RM_FileScan::GetNextRec(RM_Record& rec) {
     bool found = false;
     do {
         // go to next slot
-        if (slotNum == fileHeader.numRecordsPerPage - 1) {
+        if (slotNum + 1 >= numSlots) {
             if ((rc = pfFileHandle.UnpinPage(pageNum))) {
                 return rc;
             }
-            if ((rc = pfFileHandle.GetNextPage(pageNum, pageHandle))) {
+            // skip the pages whose zone map rules out the conditions, the
+            // free-space map pages are skipped below
+            PageNum nextPageNum = pageNum + 1;
+            while (!zoneConditions.empty() && nextPageNum < fileHeader.numPages && nextPageNum % RM_FSM_PAGES != 0 &&
+                   !fileHandle->ZoneMayMatch(nextPageNum, zoneConditions)) {
+                ++nextPageNum;
+            }
+            // the pages past the end are disposed, do not read them
+            if (nextPageNum >= fileHeader.numPages) {
+                isEOF = true;
+                return RM_EOF;
+            }
+            if ((rc = pfFileHandle.GetNextPage(nextPageNum - 1, pageHandle))) {
                 if (rc == PF_EOF) {
                     isEOF = true;
                     return RM_EOF;
@@ -110,41 +158,79 @@ RC RM_FileScan::GetNextRec(RM_Record& rec) {
             if ((rc = pageHandle.GetPageNum(pageNum))) {
                 return rc;
             }
+            // skip the free-space map pages and the overflow pages
+            numSlots = 0;
+            slotNum = -1;
+            if (pageNum % RM_FSM_PAGES == 0) {
+                continue;
+            }
+            if (fileHeader.isVariable) {
+                numSlots = ((RM_VarPageHeader*)pData)->numSlots;
+                if (numSlots == RM_OVERFLOWPAGE) {
+                    numSlots = 0;
+                    continue;
+                }
+            } else {
+                numSlots = fileHeader.numRecordsPerPage;
+            }
+            if (numSlots == 0) {
+                continue;
+            }
             slotNum = 0;
         } else {
             ++slotNum;
         }
-        // check whether record exist and satisfies the scan condition
-        if (pData[sizeof(PageNum) + slotNum / 8] & (1 << (slotNum & 7))) {
-            bool satisfy = true;
-            if (isOpen == RM_SCANSTATUS_SINGLE) {
-                if (*(char*)value == 0) {
-                    satisfy = *(pData + sizeof(PageNum) + fileHeader.bitmapSize + slotNum * fileHeader.recordSize + attrOffset) == (compOp == NE_OP);
+        // check whether record exist
+        char* recData;
+        if (fileHeader.isVariable) {
+            // a moved record is returned with the slot it is moved from
+            const RM_VarSlot& slot = ((RM_VarSlot*)(pData + sizeof(RM_VarPageHeader)))[slotNum];
+            if (slot.offset == 0 || (slot.length & RM_VARSLOT_MOVED)) {
+                continue;
+            }
+            if ((rc = fileHandle->ReadVarRec(pData, slotNum, &varRecord[0]))) {
+                return rc;
+            }
+            recData = &varRecord[0];
+        } else {
+            if (!(pData[sizeof(PageNum) + slotNum / 8] & (1 << (slotNum & 7)))) {
+                continue;
+            }
+            recData = pData + sizeof(PageNum) + fileHeader.bitmapSize + slotNum * fileHeader.recordSize;
+        }
+        // check whether record satisfies the scan condition
+        bool satisfy = true;
+        if (isOpen == RM_SCANSTATUS_SINGLE) {
+            if (*(char*)value == 0) {
+                satisfy = *(recData + attrOffset) == (compOp == NE_OP);
+            } else {
+                // a null never compares with a value
+                satisfy = (compOp == NO_OP || *(recData + attrOffset) != 0) && Attr::CompareAttr(attrType, attrLength, recData + attrOffset, compOp, value);
+            }
+        } else if (isOpen == RM_SCANSTATUS_MULTIPLE) {
+            for (unsigned int i = 0; satisfy && i < conditions.size(); ++i) {
+                if (*(recData + conditions[i].lhsAttr.offset) == 0 && (conditions[i].bRhsIsAttr || *(char*)conditions[i].rhsValue.data != 0)) {
+                    // a null never compares with a value
+                    satisfy = false;
+                } else if (conditions[i].bRhsIsAttr) {
+                    satisfy = satisfy && Attr::CompareAttr(conditions[i].lhsAttr.attrType, conditions[i].lhsAttr.attrLength, recData + conditions[i].lhsAttr.offset, conditions[i].op, recData + conditions[i].rhsAttr.offset);
                 } else {
-                    satisfy = Attr::CompareAttr(attrType, attrLength, pData + sizeof(PageNum) + fileHeader.bitmapSize + slotNum * fileHeader.recordSize + attrOffset, compOp, value);
-                }
-            } else if (isOpen == RM_SCANSTATUS_MULTIPLE) {
-                for (unsigned int i = 0; satisfy && i < conditions.size(); ++i) {
-                    if (conditions[i].bRhsIsAttr) {
-                        satisfy = satisfy && Attr::CompareAttr(conditions[i].lhsAttr.attrType, conditions[i].lhsAttr.attrLength, pData + sizeof(PageNum) + fileHeader.bitmapSize + slotNum * fileHeader.recordSize + conditions[i].lhsAttr.offset, conditions[i].op, pData + sizeof(PageNum) + fileHeader.bitmapSize + slotNum * fileHeader.recordSize + conditions[i].rhsAttr.offset);
+                    if (*(char*)conditions[i].rhsValue.data == 0) {
+                        satisfy = satisfy && *(recData + conditions[i].lhsAttr.offset) == (conditions[i].op == NE_OP);
                     } else {
-                        if (*(char*)conditions[i].rhsValue.data == 0) {
-                            satisfy = satisfy && *(pData + sizeof(PageNum) + fileHeader.bitmapSize + slotNum * fileHeader.recordSize + conditions[i].lhsAttr.offset) == (conditions[i].op == NE_OP);
-                        } else {
-                            satisfy = satisfy && Attr::CompareAttr(conditions[i].lhsAttr.attrType, conditions[i].lhsAttr.attrLength, pData + sizeof(PageNum) + fileHeader.bitmapSize + slotNum * fileHeader.recordSize + conditions[i].lhsAttr.offset, conditions[i].op, conditions[i].rhsValue.data);
-                        }
+                        satisfy = satisfy && Attr::CompareAttr(conditions[i].lhsAttr.attrType, conditions[i].lhsAttr.attrLength, recData + conditions[i].lhsAttr.offset, conditions[i].op, conditions[i].rhsValue.data);
                     }
                 }
             }
-            if (satisfy) {
-                rec.rid = RID(pageNum, slotNum);
-                if (rec.pData != NULL) {
-                    delete[] rec.pData;
-                }
-                rec.pData = new char[fileHeader.recordSize];
-                memcpy(rec.pData, pData + sizeof(PageNum) + fileHeader.bitmapSize + slotNum * fileHeader.recordSize, fileHeader.recordSize);
-                found = true;
+        }
+        if (satisfy) {
+            rec.rid = RID(pageNum, slotNum);
+            if (rec.pData != NULL) {
+                delete[] rec.pData;
             }
+            rec.pData = new char[fileHeader.recordSize];
+            memcpy(rec.pData, recData, fileHeader.recordSize);
+            found = true;
         }
     } while (!found);
     // success
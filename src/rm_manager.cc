@@ -5,6 +5,10 @@
 //
 
 #include "rm.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unistd.h>
 
 RM_Manager::RM_Manager(PF_Manager &pfm) {
     pPFMgr = &pfm;
@@ -13,26 +17,68 @@ RM_Manager::RM_Manager(PF_Manager &pfm) {
 RM_Manager::~RM_Manager() {
 }
 
-RC RM_Manager::CreateFile(const char* fileName, int recordSize) {
+// Offset of the records in a page of a fixed-length record file with
+// numRecords slots: after the number of free slots and the bitmap, aligned
+// so that the aligned attributes of the records stay aligned in the page.
+static int RM_RecordsOffset(int numRecords) {
+    return Attr::AlignLength(sizeof(PageNum) + (numRecords + 7) / 8);
+}
+
+// Name of the zone map file of a record file.
+static std::string RM_ZoneFileName(const char* fileName) {
+    return std::string(fileName) + ".zone";
+}
+
+RC RM_Manager::CreateFile(const char* fileName, int recordSize, bool isVariable, const std::vector<RM_VarField>& varFields,
+                          const std::vector<RM_ZoneField>& zoneFields) {
     RC rc;
-    // check recordSize by calculating numRecordsPerPage
+    // check recordSize by calculating numRecordsPerPage, records larger
+    // than a page go to overflow pages in a variable-length record file
     if (recordSize <= 0) {
         return RM_RECORDSIZETOOSMALL;
     }
-    if (recordSize >= PF_PAGE_SIZE) {
-        return RM_RECORDSIZETOOLARGE;
-    }
     int numRecordsPerPage = 0;
-    while (sizeof(PageNum) + (numRecordsPerPage - 1 / 8) + 1 + recordSize * numRecordsPerPage < PF_PAGE_SIZE) {
-        ++numRecordsPerPage;
+    int bitmapSize = 0;
+    if (!isVariable) {
+        if (recordSize >= PF_PAGE_SIZE) {
+            return RM_RECORDSIZETOOLARGE;
+        }
+        while (RM_RecordsOffset(numRecordsPerPage + 1) + recordSize * (numRecordsPerPage + 1) <= PF_PAGE_SIZE) {
+            ++numRecordsPerPage;
+        }
+        if (numRecordsPerPage <= 0) {
+            return RM_RECORDSIZETOOLARGE;
+        }
+        bitmapSize = RM_RecordsOffset(numRecordsPerPage) - sizeof(PageNum);
+    }
+    // check varFields, they must be in the record and sorted by offset
+    if (varFields.size() > MAXATTRS) {
+        return RM_ATTRINVALID;
+    }
+    for (unsigned int i = 0; i < varFields.size(); ++i) {
+        if (varFields[i].offset < (i > 0 ? varFields[i - 1].offset + 1 + varFields[i - 1].length : 0) ||
+            varFields[i].length <= 0 || varFields[i].length > MAXSTRINGLEN ||
+            varFields[i].offset + 1 + varFields[i].length > recordSize) {
+            return RM_ATTRINVALID;
+        }
+    }
+    // check zoneFields, they must be 4-byte attributes in the record
+    if (zoneFields.size() > RM_MAXZONEFIELDS) {
+        return RM_ATTRINVALID;
     }
-    if (--numRecordsPerPage <= 0) {
-        return RM_RECORDSIZETOOLARGE;
+    for (const auto& field : zoneFields) {
+        if ((field.attrType != INT && field.attrType != FLOAT && field.attrType != DATE) ||
+            field.offset < 0 || field.offset + 1 + (int)sizeof(int) > recordSize) {
+            return RM_ATTRINVALID;
+        }
     }
-    // create file
+    // create file, and the zone map file if there are zone fields
     if ((rc = pPFMgr->CreateFile(fileName))) {
         return rc;
     }
+    if (!zoneFields.empty() && (rc = pPFMgr->CreateFile(RM_ZoneFileName(fileName).c_str()))) {
+        return rc;
+    }
     // open file
     PF_FileHandle pfFileHandle;
     if ((rc = pPFMgr->OpenFile(fileName, pfFileHandle))) {
@@ -48,8 +94,20 @@ RC RM_Manager::CreateFile(const char* fileName, int recordSize) {
     if ((rc = pageHandle.GetData(pData))) {
         return rc;
     }
-    // write header page data
-    RM_FileHeader fileHeader(recordSize, numRecordsPerPage);
+    // write header page data, the free-space map starts empty
+    RM_FileHeader fileHeader(recordSize, numRecordsPerPage, bitmapSize);
+    if (isVariable) {
+        fileHeader.isVariable = 1;
+        fileHeader.numVarFields = varFields.size();
+        for (unsigned int i = 0; i < varFields.size(); ++i) {
+            fileHeader.varFields[i] = varFields[i];
+        }
+    }
+    fileHeader.numZoneFields = zoneFields.size();
+    for (unsigned int i = 0; i < zoneFields.size(); ++i) {
+        fileHeader.zoneFields[i] = zoneFields[i];
+    }
+    memset(pData, 0, PF_PAGE_SIZE);
     *(RM_FileHeader*)pData = fileHeader;
     // get header page num
     PageNum pageNum;
@@ -77,6 +135,29 @@ RC RM_Manager::DestroyFile(const char* fileName) {
     if ((rc = pPFMgr->DestroyFile(fileName))) {
         return rc;
     }
+    // a file created without zone fields has no zone map file
+    std::string zoneFileName = RM_ZoneFileName(fileName);
+    if (access(zoneFileName.c_str(), F_OK) == 0 && (rc = pPFMgr->DestroyFile(zoneFileName.c_str()))) {
+        return rc;
+    }
+    return OK_RC;
+}
+
+RC RM_Manager::RenameFile(const char* oldName, const char* newName) {
+    RC rc;
+    if ((rc = pPFMgr->RenameFile(oldName, newName))) {
+        return rc;
+    }
+    // a zone map file of newName left without one of oldName is stale
+    std::string oldZoneFileName = RM_ZoneFileName(oldName);
+    std::string newZoneFileName = RM_ZoneFileName(newName);
+    if (access(oldZoneFileName.c_str(), F_OK) == 0) {
+        if ((rc = pPFMgr->RenameFile(oldZoneFileName.c_str(), newZoneFileName.c_str()))) {
+            return rc;
+        }
+    } else if (access(newZoneFileName.c_str(), F_OK) == 0 && (rc = pPFMgr->DestroyFile(newZoneFileName.c_str()))) {
+        return rc;
+    }
     return OK_RC;
 }
 
@@ -111,6 +192,23 @@ RC RM_Manager::OpenFile(const char* fileName, RM_FileHandle& fileHandle) {
     if ((rc = pfFileHandle.UnpinPage(pageNum))) {
         return rc;
     }
+    // convert a file of the first format
+    if (fileHandle.fileHeader.formatVersion != RM_FORMATVERSION && (rc = fileHandle.ConvertFile())) {
+        return rc;
+    }
+    // read the free-space map
+    if ((rc = fileHandle.ReadFsm())) {
+        return rc;
+    }
+    // read the zone map
+    if (fileHandle.fileHeader.numZoneFields > 0) {
+        if ((rc = pPFMgr->OpenFile(RM_ZoneFileName(fileName).c_str(), fileHandle.zoneFileHandle))) {
+            return rc;
+        }
+        if ((rc = fileHandle.ReadZones())) {
+            return rc;
+        }
+    }
     // success
     return OK_RC;
 }
@@ -121,38 +219,17 @@ RC RM_Manager::CloseFile(RM_FileHandle &fileHandle) {
     if (!fileHandle.isOpen) {
         return RM_FILEHANDLECLOSED;
     }
-    // check whether fileHeader is modified
-    if (fileHandle.isHeaderModified) {
-        // get header page
-        PF_PageHandle pageHandle;
-        if ((rc = fileHandle.pfFileHandle.GetFirstPage(pageHandle))) {
-            return rc;
-        }
-        // get header page data pointer
-        char* pData;
-        if ((rc = pageHandle.GetData(pData))) {
-            return rc;
-        }
-        // write header page data
-        *(RM_FileHeader*)pData = fileHandle.fileHeader;
-        // get header page num
-        PageNum pageNum;
-        if ((rc = pageHandle.GetPageNum(pageNum))) {
-            return rc;
-        }
-        // mark header page dirty
-        if ((rc = fileHandle.pfFileHandle.MarkDirty(pageNum))) {
-            return rc;
-        }
-        // unpin header page
-        if ((rc = fileHandle.pfFileHandle.UnpinPage(pageNum))) {
-            return rc;
-        }
+    // write back fileHeader if it is modified
+    if ((rc = fileHandle.WriteHeader())) {
+        return rc;
     }
     // close file
     if ((rc = pPFMgr->CloseFile(fileHandle.pfFileHandle))) {
         return rc;
     }
+    if (fileHandle.fileHeader.numZoneFields > 0 && (rc = pPFMgr->CloseFile(fileHandle.zoneFileHandle))) {
+        return rc;
+    }
     fileHandle.isOpen = false;
     // success
     return OK_RC;
@@ -103,6 +103,15 @@ static int get_id(char *s) {
     if (!strcmp(string, "min"))       return yylval.ival = RW_MIN;
     if (!strcmp(string, "group"))     return yylval.ival = RW_GROUP;
     if (!strcmp(string, "by"))        return yylval.ival = RW_BY;
+    if (!strcmp(string, "begin"))     return yylval.ival = RW_BEGIN;
+    if (!strcmp(string, "commit"))    return yylval.ival = RW_COMMIT;
+    if (!strcmp(string, "rollback"))  return yylval.ival = RW_ROLLBACK;
+    if (!strcmp(string, "load"))      return yylval.ival = RW_LOAD;
+    if (!strcmp(string, "data"))      return yylval.ival = RW_DATA;
+    if (!strcmp(string, "vacuum"))    return yylval.ival = RW_VACUUM;
+    if (!strcmp(string, "variable"))  return yylval.ival = RW_VARIABLE;
+    if (!strcmp(string, "include"))   return yylval.ival = RW_INCLUDE;
+    if (!strcmp(string, "full"))      return yylval.ival = RW_FULL;
     yylval.sval = mk_string(s, len);
     return T_STRING;
 }
@@ -15,10 +15,54 @@
 #include "parser.h"
 #include "rm.h"
 #include "ix.h"
+#include <string>
+#include <map>
+#include <list>
+#include <unordered_map>
 using std::vector;
 
+//
+// Number of record and index files the handle cache keeps open.  An open
+// index also keeps its header page pinned in the buffer pool, so this
+// stays well below PF_BUFFER_SIZE.
+//
+#define SM_MAXOPENFILES 16
+
+//
+// Number of pages VACUUM empties between two flushes of the files it
+// changes.
+//
+#define SM_VACUUMBATCH 64
+
 class QL_Manager;
 
+//
+// SM_RelCache: catalog entry of a relation kept in memory while the db is
+// open, so that looking up a relation or its attributes needs no scan
+//
+struct SM_RelCache {
+    RelCat relCat; // relcat record
+    RID rid; // RID of the relcat record
+    std::vector<AttrCat> attrs; // attrcat records, sorted by offset
+    std::vector<RID> attrRids; // RIDs of the attrcat records
+    std::map<std::string, int> attrIndex; // attrName -> position in attrs
+    std::vector<int> multiIndexNos; // multi-column indexes, described by their index headers
+
+    // Sort attrs (and attrRids) by offset and rebuild attrIndex.
+    void SortAttrs();
+};
+
+//
+// SM_OpenFile: a record file or index kept open by the handle cache
+//
+struct SM_OpenFile {
+    std::string relName; // relation of the file
+    int indexNo; // index number, -1 for the record file
+    RM_FileHandle* fileHandle; // open record file, or NULL
+    IX_IndexHandle* indexHandle; // open index, or NULL
+    long lastUse; // useClock when last handed out
+};
+
 //
 // SM_Manager: provides system management
 //
@@ -42,30 +86,87 @@ public:
     RC CloseDb();
     // Show tables.
     RC ShowTables();
-    // Create relation relName with fieldCount fields.
-    RC CreateTable(const char* relName, int fieldCount, Field* fields);
+    // Create relation relName with fieldCount fields, with its STRING
+    // attributes stored with variable length if isVariable.
+    RC CreateTable(const char* relName, int fieldCount, Field* fields, bool isVariable = false);
     // Drop relation relName.
     RC DropTable(const char* relName);
     // Desc relation relName.
     RC DescTable(const char* relName);
-    // Create index for relName.attrName.
-    RC CreateIndex(const char* relName, const char* attrName);    
+    // Create index for relName.attrName, carrying the values of the
+    // nIncludeAttrs includeAttrs in its leaf entries.
+    RC CreateIndex(const char* relName, const char* attrName,
+                   int nIncludeAttrs = 0, const char* const includeAttrs[] = NULL);
+    // Create index for relName on the nAttrs attrNames, compared in turn.
+    RC CreateIndex(const char* relName, int nAttrs, const char* const attrNames[],
+                   int nIncludeAttrs = 0, const char* const includeAttrs[] = NULL);
     // Drop index for relName.attrName.
     RC DropIndex(const char* relName, const char* attrName);
+    // Drop index for relName on the nAttrs attrNames.
+    RC DropIndex(const char* relName, int nAttrs, const char* const attrNames[]);
     // Print relation relName contents.
     RC Print(const char* relName);
+    // Move the records at the end of relName into the free slots before
+    // them and free the emptied pages, at most maxPages pages if positive.
+    RC Vacuum(const char* relName, int maxPages);
+    // Rewrite relation relName into a new file with the current record
+    // layout (aligned attributes) and rebuild its indexes.  The new files
+    // replace the old ones once they are complete, after the catalog.
+    // OpenDb runs it on a table an older version left with a DATE stored
+    // as text or a multiple primary key indexed as a STRING.
+    RC VacuumFull(const char* relName);
+
+    // Get the record file of relName, opened once while the db is open.
+    RC GetFileHandle(const char* relName, RM_FileHandle*& fileHandle);
+    // Get index indexNo of relName, opened once while the db is open.
+    RC GetIndexHandle(const char* relName, int indexNo, IX_IndexHandle*& indexHandle);
+    // Get the index numbers of the multi-column indexes of relName.
+    RC GetMultiIndexes(const char* relName, std::vector<int>& indexNos);
+    // End of a statement: force the files used since the last forcing call
+    // (unless force is false, inside a transaction) and close the least
+    // recently used ones beyond SM_MAXOPENFILES.
+    RC ReleaseHandles(bool force = true);
 
 private:
     // Find relation relName in relcat.
     RC CheckRelExist(const char* relName, RM_Record& relCatRec);
     // Get all attrs relation relName in attrcat.
     RC GetAttrs(const char* relName, std::vector<AttrCat>& attrs);
+    // Get relation relName in relcat.
+    RC GetRelCat(const char* relName, RelCat& relCat);
+    // Get attr relName.attrName in attrcat.
+    RC GetAttr(const char* relName, const char* attrName, AttrCat& attr);
+    // Read relcat and attrcat into relCache.
+    RC LoadCatalog();
+    // Find file indexNo (-1 for the record file) of relName in the cache,
+    // opening it on a miss, and mark it as the most recently used.
+    RC GetOpenFile(const char* relName, int indexNo, SM_OpenFile*& openFile);
+    // Close the cached files of relName (of every relation if NULL).
+    RC CloseHandles(const char* relName = NULL);
+    // Close one cached file and remove it from the cache.
+    RC CloseOpenFile(std::list<SM_OpenFile>::iterator iter);
+    // Write the records of relName with the layout attrs, and its indexes,
+    // into new files named fileName (newFileHandle is left open on error).
+    RC BuildVacuumFiles(const char* relName, const char* fileName, const std::vector<AttrCat>& attrs, int recordSize,
+                        const std::vector<int>& indexNos, const std::vector<int>& indexAttrs,
+                        RM_FileHandle& newFileHandle, int& nRecs);
+    // Write the layout of the files of a VACUUM FULL of relName into the
+    // catalog, then move the files over the old ones.
+    RC FinishVacuumFull(const char* relName);
+    // Destroy the record file fileName and its indexes indexNos, if any.
+    void DestroyVacuumFiles(const char* fileName, const std::vector<int>& indexNos);
 
     IX_Manager& ixm; // internal IX_Manager
     RM_Manager& rmm; // internal RM_Manager
     RM_FileHandle relcatFileHandle; // fileHandle for relcat
     RM_FileHandle attrcatFileHandle; // fileHandle for attrcat
     bool isOpen; // whether a db is open
+    std::unordered_map<std::string, SM_RelCache> relCache; // catalog of the open db
+    std::list<SM_OpenFile> openFiles; // cached handles, most recently used first
+    std::map<std::pair<std::string, int>, std::list<SM_OpenFile>::iterator> openFileIndex;
+    long useClock; // number of handles handed out
+    long releaseClock; // useClock at the last ReleaseHandles
+    long forceClock; // useClock at the last ReleaseHandles that forced the files
     char zero[5]; // for scan all
 };
 
@@ -87,5 +188,6 @@ void SM_PrintError(RC rc);
 #define SM_SYSERROR        (START_SM_WARN + 10) // system error
 #define SM_INDEXPRIMARYKEY (START_SM_WARN + 11) // index is for primary key
 #define SM_ATTRNOTMATCH    (START_SM_WARN + 12) // attr not match
+#define SM_INCLUDEINVALID  (START_SM_WARN + 13) // included attr invalid
 
 #endif
@@ -27,7 +27,8 @@ static char* SM_WarnMsg[] = {
     (char*)"a db is open",
     (char*)"system error",
     (char*)"index is for primary key",
-    (char*)"attr not match"
+    (char*)"attr not match",
+    (char*)"included attr is the key or listed twice"
 };
 
 //
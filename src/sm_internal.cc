@@ -4,6 +4,7 @@
 // Authors:     Yi Xu
 //
 
+#include <algorithm>
 #include "sm.h"
 
 RelCat::RelCat(const char* recordData) {
@@ -72,3 +73,23 @@ void AttrCat::WriteRecordData(char* recordData) {
 bool operator==(const AttrCat& a, const AttrCat& b) {
     return strcmp(a.relName, b.relName) == 0 && strcmp(a.attrName, b.attrName) == 0;
 }
+
+void SM_RelCache::SortAttrs() {
+    std::vector<int> order(attrs.size());
+    for (int i = 0; i < (int)order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [this](int a, int b) -> bool { return attrs[a].offset < attrs[b].offset; });
+    std::vector<AttrCat> sortedAttrs;
+    std::vector<RID> sortedRids;
+    for (int i : order) {
+        sortedAttrs.push_back(attrs[i]);
+        sortedRids.push_back(attrRids[i]);
+    }
+    attrs.swap(sortedAttrs);
+    attrRids.swap(sortedRids);
+    attrIndex.clear();
+    for (int i = 0; i < (int)attrs.size(); ++i) {
+        attrIndex[attrs[i].attrName] = i;
+    }
+}
@@ -10,14 +10,73 @@
 #include <algorithm>
 #include "unistd.h"
 #include "global.h"
-#include "printer.h"
 #include "sm.h"
 #include "ix.h"
 #include "rm.h"
+#include "printer.h"
 
 using namespace std;
 
-SM_Manager::SM_Manager(IX_Manager &ixm, RM_Manager &rmm) : ixm(ixm), rmm(rmm), isOpen(false) {
+// The record layout VACUUM FULL writes: the attributes in the same order,
+// aligned, and a DATE stored as YYYY-MM-DD text by an older version becomes
+// a day number.  Returns the record size.
+static int SM_VacuumLayout(vector<AttrCat>& attrs) {
+    int recordSize = 0;
+    for (auto& attr : attrs) {
+        if (attr.attrType == DATE) {
+            attr.attrLength = sizeof(int);
+        }
+        attr.offset = Attr::AlignOffset(attr.attrType, recordSize);
+        recordSize = attr.offset + 1 + attr.attrLength;
+    }
+    return Attr::AlignLength(recordSize);
+}
+
+// Whether a table holds a DATE an older version stored as YYYY-MM-DD text,
+// which every statement now takes for a day number.
+static bool SM_HasTextDate(const SM_RelCache& relEntry) {
+    for (const auto& attr : relEntry.attrs) {
+        if (attr.attrType == DATE && attr.attrLength != sizeof(int)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Number of the attributes of the primary key of a table.
+static int SM_PrimaryKeyCount(const SM_RelCache& relEntry) {
+    int primaryKeyCount = 0;
+    for (const auto& attr : relEntry.attrs) {
+        if (attr.primaryKey > 0) {
+            ++primaryKeyCount;
+        }
+    }
+    return primaryKeyCount;
+}
+
+// The indexes VACUUM FULL rebuilds: both halves of each attribute index
+// (indexAttrs holds the position of the attribute), the index on a multiple
+// primary key (-1) and the multi-column indexes (-2).
+static void SM_VacuumIndexes(const SM_RelCache& relEntry, vector<int>& indexNos, vector<int>& indexAttrs) {
+    for (unsigned int i = 0; i < relEntry.attrs.size(); ++i) {
+        if (relEntry.attrs[i].indexNo != -1) {
+            indexNos.push_back(relEntry.attrs[i].indexNo);
+            indexNos.push_back(relEntry.attrs[i].indexNo + 1);
+            indexAttrs.push_back(i);
+            indexAttrs.push_back(i);
+        }
+    }
+    if (SM_PrimaryKeyCount(relEntry) > 1) {
+        indexNos.push_back(0);
+        indexAttrs.push_back(-1);
+    }
+    for (int indexNo : relEntry.multiIndexNos) {
+        indexNos.push_back(indexNo);
+        indexAttrs.push_back(-2);
+    }
+}
+
+SM_Manager::SM_Manager(IX_Manager &ixm, RM_Manager &rmm) : ixm(ixm), rmm(rmm), isOpen(false), useClock(0), releaseClock(0), forceClock(0) {
     *zero = 1;
     *(int*)(zero + 1) = 0;
 }
@@ -25,6 +84,116 @@ SM_Manager::SM_Manager(IX_Manager &ixm, RM_Manager &rmm) : ixm(ixm), rmm(rmm), i
 SM_Manager::~SM_Manager() {
 }
 
+// The STRING attributes of a variable-length table, stored with the length
+// of their values.
+static vector<RM_VarField> SM_VarFields(const vector<AttrCat>& attrs) {
+    vector<RM_VarField> varFields;
+    for (const auto& attr : attrs) {
+        if (attr.attrType == STRING) {
+            RM_VarField field;
+            field.offset = attr.offset;
+            field.length = attr.attrLength;
+            varFields.push_back(field);
+        }
+    }
+    return varFields;
+}
+
+// The INT, FLOAT and DATE attributes of a table, whose range of values in
+// each page is kept in the zone map of its record file.
+static vector<RM_ZoneField> SM_ZoneFields(const vector<AttrCat>& attrs) {
+    vector<RM_ZoneField> zoneFields;
+    for (const auto& attr : attrs) {
+        if ((attr.attrType == INT || attr.attrType == FLOAT || attr.attrType == DATE) && zoneFields.size() < RM_MAXZONEFIELDS) {
+            RM_ZoneField field;
+            field.offset = attr.offset;
+            field.attrType = attr.attrType;
+            zoneFields.push_back(field);
+        }
+    }
+    return zoneFields;
+}
+
+// The key of a record in the index on a multiple primary key, as QL builds
+// it: a null flag, then the encoded values of the primary key attributes in
+// key order.
+static void SM_PrimaryKey(const vector<AttrCat>& attrs, const char* recordData, int primaryKeyCount, vector<char>& key) {
+    key[0] = 1;
+    int offset = 1;
+    for (int k = 1; k <= primaryKeyCount; ++k) {
+        for (const auto& attr : attrs) {
+            if (attr.primaryKey == k) {
+                Attr::EncodeKey(attr.attrType, attr.attrLength, recordData + attr.offset, &key[offset]);
+                offset += attr.attrLength + 1;
+            }
+        }
+    }
+}
+
+// The included values of a record in a covering index, one after the other
+// as IX_IndexHandle::GetInclude lays them out.
+static void SM_Include(const vector<IX_IncludeField>& includeFields, const char* recordData, vector<char>& include) {
+    include.clear();
+    for (const auto& field : includeFields) {
+        include.insert(include.end(), recordData + field.offset, recordData + field.offset + field.length + 1);
+    }
+    // keeps &include[0] valid without included attributes
+    include.push_back(0);
+}
+
+// The attributes of an index, key attributes first, each of them existing
+// and listed once.
+static RC SM_IndexAttrs(const SM_RelCache& relEntry, const vector<const char*>& attrNames, vector<AttrCat>& attrs) {
+    for (unsigned int i = 0; i < attrNames.size(); ++i) {
+        auto iter = relEntry.attrIndex.find(attrNames[i]);
+        if (iter == relEntry.attrIndex.end()) {
+            return SM_ATTRNOTFOUND;
+        }
+        for (unsigned int j = 0; j < i; ++j) {
+            if (!strcmp(attrNames[i], attrNames[j])) {
+                return SM_INCLUDEINVALID;
+            }
+        }
+        attrs.push_back(relEntry.attrs[iter->second]);
+    }
+    return OK_RC;
+}
+
+// The included attributes of an index, attrs[first] and after.
+static vector<IX_IncludeField> SM_IncludeFields(const vector<AttrCat>& attrs, int first) {
+    vector<IX_IncludeField> includeFields;
+    for (unsigned int i = first; i < attrs.size(); ++i) {
+        IX_IncludeField field;
+        field.offset = attrs[i].offset;
+        field.length = attrs[i].attrLength;
+        includeFields.push_back(field);
+    }
+    return includeFields;
+}
+
+// The key attributes of a multi-column index, the first count attrs.
+static vector<IX_KeyField> SM_KeyFields(const vector<AttrCat>& attrs, int count) {
+    vector<IX_KeyField> keyFields;
+    for (int i = 0; i < count; ++i) {
+        IX_KeyField field;
+        field.offset = attrs[i].offset;
+        field.length = attrs[i].attrLength;
+        field.attrType = attrs[i].attrType;
+        keyFields.push_back(field);
+    }
+    return keyFields;
+}
+
+// The key of a record in a multi-column index, as
+// IX_IndexHandle::GetKey encodes it.
+static void SM_MultiKey(const vector<IX_KeyField>& keyFields, const char* recordData, vector<char>& key) {
+    key.assign(1, 1);
+    for (const auto& field : keyFields) {
+        key.resize(key.size() + field.length + 1);
+        Attr::EncodeKey(field.attrType, field.length, recordData + field.offset, &key[key.size() - field.length - 1]);
+    }
+}
+
 RC SM_Manager::CreateDb(const char* dbName) {
     RC rc;
     // check whether a db is open
@@ -207,8 +376,52 @@ RC SM_Manager::OpenDb(const char* dbName) {
     if ((rc = rmm.OpenFile("attrcat", attrcatFileHandle))) {
         return rc;
     }
-    // success
+    // read the catalog into memory
+    if ((rc = LoadCatalog())) {
+        return rc;
+    }
+    // finish a VACUUM FULL whose new files were complete, drop the files
+    // of one interrupted before
+    for (const auto& item : relCache) {
+        string newName = item.first + ".new";
+        vector<int> indexNos;
+        vector<int> indexAttrs;
+        SM_VacuumIndexes(item.second, indexNos, indexAttrs);
+        if (access(newName.c_str(), F_OK) == 0) {
+            if ((rc = FinishVacuumFull(item.first.c_str()))) {
+                return rc;
+            }
+        } else {
+            DestroyVacuumFiles(newName.c_str(), indexNos);
+        }
+        DestroyVacuumFiles((item.first + ".tmp").c_str(), indexNos);
+    }
     isOpen = true;
+    // rewrite the tables of an older version before any statement uses them
+    vector<string> oldRelNames;
+    for (const auto& item : relCache) {
+        bool isOld = SM_HasTextDate(item.second);
+        // an older version indexed a multiple primary key as a STRING of
+        // the key values one after the other
+        if (!isOld && SM_PrimaryKeyCount(item.second) > 1) {
+            IX_IndexHandle* indexHandle;
+            if ((rc = GetIndexHandle(item.first.c_str(), 0, indexHandle))) {
+                CloseDb();
+                return rc;
+            }
+            isOld = indexHandle->GetAttrType() != PRIMARYKEY;
+        }
+        if (isOld) {
+            oldRelNames.push_back(item.first);
+        }
+    }
+    for (const auto& relName : oldRelNames) {
+        if ((rc = VacuumFull(relName.c_str()))) {
+            CloseDb();
+            return rc;
+        }
+    }
+    // success
     cout << "[OpenDB]" << endl;
     cout << "dbName=" << dbName << endl;
     return OK_RC;
@@ -220,6 +433,10 @@ RC SM_Manager::CloseDb() {
     if (!isOpen) {
         return SM_DBNOTOPEN;
     }
+    // close the cached relation files
+    if ((rc = CloseHandles())) {
+        return rc;
+    }
     // close file for relcat
     if ((rc = rmm.CloseFile(relcatFileHandle))) {
         return rc;
@@ -230,6 +447,7 @@ RC SM_Manager::CloseDb() {
     }
     // success
     chdir("..");
+    relCache.clear();
     isOpen = false;
     cout << "[CloseDB]" << endl;
     return OK_RC;
@@ -270,30 +488,16 @@ RC SM_Manager::ShowTables() {
     return OK_RC;
 }
 
-RC SM_Manager::CreateTable(const char* relName, int fieldCount, Field* fields) {
+RC SM_Manager::CreateTable(const char* relName, int fieldCount, Field* fields, bool isVariable) {
     RC rc;
     // check whether a db is open
     if (!isOpen) {
         return SM_DBNOTOPEN;
     }
     // check whether relation relName already exists
-    RM_FileScan fileScan;
-    char relNameValue[MAXNAME + 1];
-    *relNameValue = 1;
-    strcpy(relNameValue + 1, relName);
-    if ((rc = fileScan.OpenScan(relcatFileHandle, STRING, MAXNAME, 0, EQ_OP, (void*)relNameValue))) {
-        return rc;
-    }
-    RM_Record relCatRec;
-    if ((rc = fileScan.GetNextRec(relCatRec)) != 0 && rc != RM_EOF) {
-        return rc;
-    }
-    if (rc != RM_EOF) {
+    if (relCache.find(relName) != relCache.end()) {
         return SM_RELEXIST;
     }
-    if ((rc = fileScan.CloseScan())) {
-        return rc;
-    }
     // update attrcat
     char* recordData = new char[AttrCat::SIZE];
     RID rid;
@@ -301,23 +505,24 @@ RC SM_Manager::CreateTable(const char* relName, int fieldCount, Field* fields) {
     int indexCount = 0;
     vector<AttrCat> attrs;
     for (int i = 0; i < fieldCount; ++i) {
-        if (fields[i].attr.attrName != NULL) { // new attribute
-            attrs.push_back(AttrCat(relName, fields[i].attr.attrName, recordSize, fields[i].attr.attrType, fields[i].attr.attrLength, -1, fields[i].isNotNull, 0, "", ""));
-            recordSize += 1 + fields[i].attr.attrLength;
+        if (fields[i].attr.attrName != NULL) { // new attribute, its value aligned
+            int offset = Attr::AlignOffset(fields[i].attr.attrType, recordSize);
+            attrs.push_back(AttrCat(relName, fields[i].attr.attrName, offset, fields[i].attr.attrType, fields[i].attr.attrLength, -1, fields[i].isNotNull, 0, "", ""));
+            recordSize = offset + 1 + fields[i].attr.attrLength;
         } else if (fields[i].nPrimaryKey > 0) { // primary key
             if (fields[i].nPrimaryKey > 1) {
-                // calc total length of primary keys
+                // calc total length of primary keys, each with its null flag
                 int len = 0;
                 for (int j = 0; j < fields[i].nPrimaryKey; ++j) {
                     for (auto attr : attrs) {
                         if (!strcmp(attr.attrName, fields[i].primaryKeyList[j])) {
-                            len += attr.attrLength;
+                            len += attr.attrLength + 1;
                         }
                     }
                 }
                 // create index for primary keys
                 ++indexCount;
-                if ((rc = ixm.CreateIndex(relName, 0, STRING, len))) {
+                if ((rc = ixm.CreateIndex(relName, 0, PRIMARYKEY, len))) {
                     return rc;
                 }
             }
@@ -373,11 +578,15 @@ RC SM_Manager::CreateTable(const char* relName, int fieldCount, Field* fields) {
             }
         }    
     }
+    recordSize = Attr::AlignLength(recordSize);
+    SM_RelCache relEntry;
     for (auto attr : attrs) {
         attr.WriteRecordData(recordData);
         if ((rc = attrcatFileHandle.InsertRec(recordData, rid))) {
             return rc;
         }
+        relEntry.attrs.push_back(attr);
+        relEntry.attrRids.push_back(rid);
     }
     if ((rc = attrcatFileHandle.ForcePages())) {
         return rc;
@@ -385,16 +594,23 @@ RC SM_Manager::CreateTable(const char* relName, int fieldCount, Field* fields) {
     delete[] recordData;
     // update relcat
     recordData = new char[RelCat::SIZE];
-    RelCat(relName, recordSize, attrs.size(), indexCount).WriteRecordData(recordData);
+    relEntry.relCat = RelCat(relName, recordSize, attrs.size(), indexCount);
+    relEntry.relCat.WriteRecordData(recordData);
     if ((rc = relcatFileHandle.InsertRec(recordData, rid))) {
         return rc;
     }
+    relEntry.rid = rid;
+    relEntry.SortAttrs();
+    relCache[relName] = relEntry;
     if ((rc = relcatFileHandle.ForcePages())) {
         return rc;
     }
     delete[] recordData;
-    // create table file
-    if ((rc = rmm.CreateFile(relName, recordSize))) {
+    // create table file, the STRING attributes of a variable-length table
+    // are stored with the length of their values, and the pages keep the
+    // range of the numeric attributes in a zone map
+    if ((rc = rmm.CreateFile(relName, recordSize, isVariable, isVariable ? SM_VarFields(attrs) : vector<RM_VarField>(),
+                             SM_ZoneFields(attrs)))) {
         return rc;
     }
     // success
@@ -432,6 +648,10 @@ RC SM_Manager::DropTable(const char* relName) {
     if ((rc = CheckRelExist(relName, relCatRec))) {
         return rc;
     }
+    // close the cached files of relName before destroying them
+    if ((rc = CloseHandles(relName))) {
+        return rc;
+    }
     // remove relation relName in relcat
     RID rid;
     if ((rc = relCatRec.GetRid(rid))) {
@@ -440,6 +660,12 @@ RC SM_Manager::DropTable(const char* relName) {
     if ((rc = relcatFileHandle.DeleteRec(rid))) {
         return rc;
     }
+    for (int indexNo : relCache[relName].multiIndexNos) {
+        if ((rc = ixm.DestroyIndex(relName, indexNo))) {
+            return rc;
+        }
+    }
+    relCache.erase(relName);
     // find all attributes of relation relName in attrcat
     RM_FileScan fileScan;
     char relNameValue[MAXNAME + 1];
@@ -524,7 +750,7 @@ RC SM_Manager::DescTable(const char* relName) {
              << " " << (attr.attrType == INT ? "INT" :
                         attr.attrType == FLOAT ? "FLOAT" :
                         attr.attrType == DATE ? "DATE" : "STRING")
-             << " " << attr.attrLength - (attr.attrType == STRING || attr.attrType == DATE);
+             << " " << attr.attrLength - (attr.attrType == STRING);
         if (attr.isNotNull) {
             cout << " NOT NULL";
         }
@@ -536,13 +762,30 @@ RC SM_Manager::DescTable(const char* relName) {
         }
         cout << endl;
     }
+    // print the multi-column indexes
+    for (int indexNo : relCache[relName].multiIndexNos) {
+        IX_IndexHandle* indexHandle;
+        if ((rc = GetIndexHandle(relName, indexNo, indexHandle))) {
+            return rc;
+        }
+        const char* separator = "INDEX (";
+        for (const auto& field : indexHandle->GetKeyFields()) {
+            for (const auto& attr : attrs) {
+                if (attr.offset == field.offset) {
+                    cout << separator << attr.attrName;
+                    separator = ", ";
+                }
+            }
+        }
+        cout << ")" << endl;
+    }
     // success
     cout << "[DescTable]" << endl
          << "relName=" << relName << endl;
     return OK_RC;
 }
 
-RC SM_Manager::CreateIndex(const char* relName, const char* attrName) {
+RC SM_Manager::CreateIndex(const char* relName, const char* attrName, int nIncludeAttrs, const char* const includeAttrs[]) {
     RC rc;
     // check whether a db is open
     if (!isOpen) {
@@ -558,6 +801,15 @@ RC SM_Manager::CreateIndex(const char* relName, const char* attrName) {
         return rc;
     }
     RelCat relCat(relCatData);
+    // check the included attributes: existing, not the key, no duplicates
+    SM_RelCache& relEntry = relCache[relName];
+    vector<const char*> attrNames(1, attrName);
+    attrNames.insert(attrNames.end(), includeAttrs, includeAttrs + nIncludeAttrs);
+    vector<AttrCat> indexAttrs;
+    if ((rc = SM_IndexAttrs(relEntry, attrNames, indexAttrs))) {
+        return rc;
+    }
+    vector<IX_IncludeField> includeFields = SM_IncludeFields(indexAttrs, 1);
     // find (relName, attrName) in attrcat
     RM_FileScan fileScan;
     char relNameValue[MAXNAME + 1];
@@ -586,11 +838,21 @@ RC SM_Manager::CreateIndex(const char* relName, const char* attrName) {
         if (attrCat.indexNo != -1) {
             return SM_INDEXEXIST;
         }
-        // found && update info
         if ((rc = fileScan.CloseScan())) {
             return rc;
         }
-        attrCat.indexNo = relCat.indexCount;
+        // create index before the catalog points to it, included attributes
+        // too long for a node leave no file behind
+        int indexNo = relCat.indexCount;
+        if ((rc = ixm.CreateIndex(relName, indexNo, attrCat.attrType, attrCat.attrLength, includeFields))) {
+            return rc;
+        }
+        if ((rc = ixm.CreateIndex(relName, indexNo + 1, attrCat.attrType, attrCat.attrLength, includeFields))) {
+            ixm.DestroyIndex(relName, indexNo);
+            return rc;
+        }
+        // found && update info
+        attrCat.indexNo = indexNo;
         relCat.indexCount += 2;
         attrCat.WriteRecordData(attrCatData);
         if ((rc = attrcatFileHandle.UpdateRec(attrCatRec))) {
@@ -606,13 +868,8 @@ RC SM_Manager::CreateIndex(const char* relName, const char* attrName) {
         if ((rc = relcatFileHandle.ForcePages())) {
             return rc;
         }
-        // create index
-        if ((rc = ixm.CreateIndex(relName, attrCat.indexNo, attrCat.attrType, attrCat.attrLength))) {
-            return rc;
-        }
-        if ((rc = ixm.CreateIndex(relName, attrCat.indexNo + 1, attrCat.attrType, attrCat.attrLength))) {
-            return rc;
-        }
+        relEntry.relCat = relCat;
+        relEntry.attrs[relEntry.attrIndex[attrName]].indexNo = attrCat.indexNo;
         IX_IndexHandle indexHandleNotNull;
         IX_IndexHandle indexHandleNull;
         if ((rc = ixm.OpenIndex(relName, attrCat.indexNo, indexHandleNotNull))) {
@@ -621,12 +878,22 @@ RC SM_Manager::CreateIndex(const char* relName, const char* attrName) {
         if ((rc = ixm.OpenIndex(relName, attrCat.indexNo + 1, indexHandleNull))) {
             return rc;
         }
-        // insert each record into index
-        RM_FileHandle relFileHandle;
-        if ((rc = rmm.OpenFile(relName, relFileHandle))) {
+        // collect the entries of each record, then bulk load both indexes
+        int includeLength = indexHandleNotNull.GetIncludeLength();
+        vector<char> include(includeLength + 1);
+        IX_IndexBuilder builderNotNull;
+        IX_IndexBuilder builderNull;
+        if ((rc = builderNotNull.Open(attrCat.attrType, attrCat.attrLength, includeLength))) {
+            return rc;
+        }
+        if ((rc = builderNull.Open(attrCat.attrType, attrCat.attrLength, includeLength))) {
+            return rc;
+        }
+        RM_FileHandle* relFileHandle;
+        if ((rc = GetFileHandle(relName, relFileHandle))) {
             return rc;
         }
-        if ((rc = fileScan.OpenScan(relFileHandle, INT, sizeof(int), 0, NO_OP, zero))) {
+        if ((rc = fileScan.OpenScan(*relFileHandle, INT, sizeof(int), 0, NO_OP, zero))) {
             return rc;
         }
         while (true) {
@@ -645,23 +912,27 @@ RC SM_Manager::CreateIndex(const char* relName, const char* attrName) {
             if ((rc = record.GetRid(rid))) {
                 return rc;
             }
+            indexHandleNotNull.GetInclude(recordData, &include[0]);
             if (*(recordData + attrCat.offset) == 0) {
-                if ((rc = indexHandleNull.InsertEntry(recordData + attrCat.offset, rid))) {
+                if ((rc = builderNull.AddEntry(recordData + attrCat.offset, rid, &include[0]))) {
                     return rc;
                 }
             } else {
-                if ((rc = indexHandleNotNull.InsertEntry(recordData + attrCat.offset, rid))) {
+                if ((rc = builderNotNull.AddEntry(recordData + attrCat.offset, rid, &include[0]))) {
                     return rc;
                 }
             }
         }
-        // close things
         if ((rc = fileScan.CloseScan())) {
             return rc;
         }
-        if ((rc = rmm.CloseFile(relFileHandle))) {
+        if ((rc = builderNotNull.Build(indexHandleNotNull))) {
+            return rc;
+        }
+        if ((rc = builderNull.Build(indexHandleNull))) {
             return rc;
         }
+        // close things
         if ((rc = ixm.CloseIndex(indexHandleNotNull))) {
             return rc;
         }
@@ -674,6 +945,135 @@ RC SM_Manager::CreateIndex(const char* relName, const char* attrName) {
     cout << "[CreateIndex]" << endl
          << "relName=" << relName << endl
          << "attrName=" << attrName << endl;
+    for (int i = 0; i < nIncludeAttrs; ++i) {
+        cout << "include=" << includeAttrs[i] << endl;
+    }
+    return OK_RC;
+}
+
+RC SM_Manager::CreateIndex(const char* relName, int nAttrs, const char* const attrNames[], int nIncludeAttrs, const char* const includeAttrs[]) {
+    RC rc;
+    if (nAttrs == 1) {
+        return CreateIndex(relName, attrNames[0], nIncludeAttrs, includeAttrs);
+    }
+    // check whether a db is open
+    if (!isOpen) {
+        return SM_DBNOTOPEN;
+    }
+    // find relation relName in relcat
+    RM_Record relCatRec;
+    if ((rc = CheckRelExist(relName, relCatRec))) {
+        return rc;
+    }
+    char *relCatData;
+    if ((rc = relCatRec.GetData(relCatData))) {
+        return rc;
+    }
+    RelCat relCat(relCatData);
+    // check the key and included attributes: existing, listed once
+    if (nAttrs > IX_MAXKEYFIELDS) {
+        return SM_INCLUDEINVALID;
+    }
+    SM_RelCache& relEntry = relCache[relName];
+    vector<const char*> names(attrNames, attrNames + nAttrs);
+    names.insert(names.end(), includeAttrs, includeAttrs + nIncludeAttrs);
+    vector<AttrCat> indexAttrs;
+    if ((rc = SM_IndexAttrs(relEntry, names, indexAttrs))) {
+        return rc;
+    }
+    vector<IX_KeyField> keyFields = SM_KeyFields(indexAttrs, nAttrs);
+    vector<IX_IncludeField> includeFields = SM_IncludeFields(indexAttrs, nAttrs);
+    int keyLength = 0;
+    for (const auto& field : keyFields) {
+        keyLength += field.length + 1;
+    }
+    // check whether an index on the same attributes exists
+    for (int indexNo : relEntry.multiIndexNos) {
+        IX_IndexHandle* indexHandle;
+        if ((rc = GetIndexHandle(relName, indexNo, indexHandle))) {
+            return rc;
+        }
+        vector<IX_KeyField> fields = indexHandle->GetKeyFields();
+        if (fields.size() == keyFields.size() &&
+            equal(fields.begin(), fields.end(), keyFields.begin(),
+                  [](const IX_KeyField& a, const IX_KeyField& b) { return a.offset == b.offset; })) {
+            return SM_INDEXEXIST;
+        }
+    }
+    // create index before the catalog counts it
+    int indexNo = relCat.indexCount;
+    if ((rc = ixm.CreateIndex(relName, indexNo, PRIMARYKEY, keyLength, includeFields, keyFields))) {
+        return rc;
+    }
+    relCat.indexCount += 1;
+    relCat.WriteRecordData(relCatData);
+    if ((rc = relcatFileHandle.UpdateRec(relCatRec))) {
+        return rc;
+    }
+    if ((rc = relcatFileHandle.ForcePages())) {
+        return rc;
+    }
+    relEntry.relCat = relCat;
+    relEntry.multiIndexNos.push_back(indexNo);
+    // collect the entries of each record, then bulk load the index
+    IX_IndexHandle indexHandle;
+    if ((rc = ixm.OpenIndex(relName, indexNo, indexHandle))) {
+        return rc;
+    }
+    IX_IndexBuilder builder;
+    if ((rc = builder.Open(PRIMARYKEY, keyLength, indexHandle.GetIncludeLength()))) {
+        return rc;
+    }
+    vector<char> key(keyLength + 1);
+    vector<char> include(indexHandle.GetIncludeLength() + 1);
+    RM_FileHandle* relFileHandle;
+    if ((rc = GetFileHandle(relName, relFileHandle))) {
+        return rc;
+    }
+    RM_FileScan fileScan;
+    if ((rc = fileScan.OpenScan(*relFileHandle, INT, sizeof(int), 0, NO_OP, zero))) {
+        return rc;
+    }
+    while (true) {
+        RM_Record record;
+        if ((rc = fileScan.GetNextRec(record)) != 0 && rc != RM_EOF) {
+            return rc;
+        }
+        if (rc == RM_EOF) {
+            break;
+        }
+        char* recordData;
+        if ((rc = record.GetData(recordData))) {
+            return rc;
+        }
+        RID rid;
+        if ((rc = record.GetRid(rid))) {
+            return rc;
+        }
+        indexHandle.GetKey(recordData, &key[0]);
+        indexHandle.GetInclude(recordData, &include[0]);
+        if ((rc = builder.AddEntry(&key[0], rid, &include[0]))) {
+            return rc;
+        }
+    }
+    if ((rc = fileScan.CloseScan())) {
+        return rc;
+    }
+    if ((rc = builder.Build(indexHandle))) {
+        return rc;
+    }
+    if ((rc = ixm.CloseIndex(indexHandle))) {
+        return rc;
+    }
+    // success
+    cout << "[CreateIndex]" << endl
+         << "relName=" << relName << endl;
+    for (int i = 0; i < nAttrs; ++i) {
+        cout << "attrName=" << attrNames[i] << endl;
+    }
+    for (int i = 0; i < nIncludeAttrs; ++i) {
+        cout << "include=" << includeAttrs[i] << endl;
+    }
     return OK_RC;
 }
 
@@ -721,6 +1121,9 @@ RC SM_Manager::DropIndex(const char* relName, const char* attrName) {
             return SM_INDEXPRIMARYKEY;
         }
         // found && drop index
+        if ((rc = CloseHandles(relName))) {
+            return rc;
+        }
         if ((rc = ixm.DestroyIndex(relName, attrCat.indexNo))) {
             return rc;
         }
@@ -733,6 +1136,8 @@ RC SM_Manager::DropIndex(const char* relName, const char* attrName) {
         if ((rc = attrcatFileHandle.UpdateRec(attrCatRec))) {
             return rc;
         }
+        SM_RelCache& relEntry = relCache[relName];
+        relEntry.attrs[relEntry.attrIndex[attrName]].indexNo = -1;
         if ((rc = attrcatFileHandle.ForcePages())) {
             return rc;
         }
@@ -748,6 +1153,69 @@ RC SM_Manager::DropIndex(const char* relName, const char* attrName) {
     return OK_RC;
 }
 
+RC SM_Manager::DropIndex(const char* relName, int nAttrs, const char* const attrNames[]) {
+    RC rc;
+    if (nAttrs == 1) {
+        return DropIndex(relName, attrNames[0]);
+    }
+    // check whether a db is open
+    if (!isOpen) {
+        return SM_DBNOTOPEN;
+    }
+    // find relation relName
+    auto iter = relCache.find(relName);
+    if (iter == relCache.end()) {
+        return SM_RELNOTFOUND;
+    }
+    SM_RelCache& relEntry = iter->second;
+    vector<AttrCat> indexAttrs;
+    if ((rc = SM_IndexAttrs(relEntry, vector<const char*>(attrNames, attrNames + nAttrs), indexAttrs))) {
+        return rc;
+    }
+    // find the index on these attributes, in this order
+    for (auto indexNo = relEntry.multiIndexNos.begin(); indexNo != relEntry.multiIndexNos.end(); ++indexNo) {
+        IX_IndexHandle* indexHandle;
+        if ((rc = GetIndexHandle(relName, *indexNo, indexHandle))) {
+            return rc;
+        }
+        vector<IX_KeyField> fields = indexHandle->GetKeyFields();
+        if (fields.size() != indexAttrs.size() ||
+            !equal(fields.begin(), fields.end(), indexAttrs.begin(),
+                   [](const IX_KeyField& a, const AttrCat& b) { return a.offset == b.offset; })) {
+            continue;
+        }
+        // found && drop index
+        if ((rc = CloseHandles(relName))) {
+            return rc;
+        }
+        if ((rc = ixm.DestroyIndex(relName, *indexNo))) {
+            return rc;
+        }
+        relEntry.multiIndexNos.erase(indexNo);
+        // success
+        cout << "[DropIndex]" << endl
+             << "relName=" << relName << endl;
+        for (int i = 0; i < nAttrs; ++i) {
+            cout << "attrName=" << attrNames[i] << endl;
+        }
+        return OK_RC;
+    }
+    return SM_INDEXNOTEXIST;
+}
+
+RC SM_Manager::GetMultiIndexes(const char* relName, vector<int>& indexNos) {
+    // check whether a db is open
+    if (!isOpen) {
+        return SM_DBNOTOPEN;
+    }
+    auto iter = relCache.find(relName);
+    if (iter == relCache.end()) {
+        return SM_RELNOTFOUND;
+    }
+    indexNos = iter->second.multiIndexNos;
+    return OK_RC;
+}
+
 RC SM_Manager::Print(const char* relName) {
     RC rc;
     // check whether a db is open
@@ -776,13 +1244,13 @@ RC SM_Manager::Print(const char* relName) {
     }
     Printer printer(attributes, attrs.size());
     printer.PrintHeader(cout);
-    // open the file and set up the file scan
-    RM_FileHandle relFileHandle;
-    if ((rc = rmm.OpenFile(relName, relFileHandle))) {
+    // get the file and set up the file scan
+    RM_FileHandle* relFileHandle;
+    if ((rc = GetFileHandle(relName, relFileHandle))) {
         return rc;
     }
     RM_FileScan fileScan;
-    if ((rc = fileScan.OpenScan(relFileHandle, INT, sizeof(int), 0, NO_OP, zero))) {
+    if ((rc = fileScan.OpenScan(*relFileHandle, INT, sizeof(int), 0, NO_OP, zero))) {
         return rc;
     }
     // print each record
@@ -806,7 +1274,8 @@ RC SM_Manager::Print(const char* relName) {
     if ((rc = fileScan.CloseScan())) {
         return rc;
     }
-    if ((rc = rmm.CloseFile(relFileHandle))) {
+    // the relation is only read, there is nothing to force
+    if ((rc = ReleaseHandles(false))) {
         return rc;
     }
     // success
@@ -815,53 +1284,682 @@ RC SM_Manager::Print(const char* relName) {
     return OK_RC;
 }
 
-RC SM_Manager::CheckRelExist(const char* relName, RM_Record& relCatRec) {
+RC SM_Manager::Vacuum(const char* relName, int maxPages) {
     RC rc;
-    RM_FileScan fileScan;
-    char relNameValue[MAXNAME + 1];
-    *relNameValue = 1;
-    strcpy(relNameValue + 1, relName);
-    if ((rc = fileScan.OpenScan(relcatFileHandle, STRING, MAXNAME, 0, EQ_OP, (void*)relNameValue))) {
-        return rc;
-    }
-    if ((rc = fileScan.GetNextRec(relCatRec)) != 0 && rc != RM_EOF) {
-        return rc;
-    }
-    if (rc == RM_EOF) {
-        return SM_RELNOTFOUND;
+    // check whether a db is open
+    if (!isOpen) {
+        return SM_DBNOTOPEN;
     }
-    if ((rc = fileScan.CloseScan())) {
+    // find all attributes of relation relName
+    RM_Record relCatRec;
+    if ((rc = CheckRelExist(relName, relCatRec))) {
         return rc;
     }
-    return OK_RC;
-}
-
-RC SM_Manager::GetAttrs(const char* relName, vector<AttrCat>& attrs) {
-    RC rc;
-    RM_FileScan fileScan;
-    char relNameValue[MAXNAME + 1];
-    *relNameValue = 1;
-    strcpy(relNameValue + 1, relName);
-    if ((rc = fileScan.OpenScan(attrcatFileHandle, STRING, MAXNAME, 0, EQ_OP, (void*)relNameValue))) {
+    vector<AttrCat> attrs;
+    if ((rc = GetAttrs(relName, attrs))) {
         return rc;
     }
-    while (true) {
-        RM_Record attrCatRec;
-        if ((rc = fileScan.GetNextRec(attrCatRec)) != 0 && rc != RM_EOF) {
+    PageNum numPagesBefore = -1;
+    PageNum lastPageNum = 0;
+    int nPages = 0;
+    int nRecs = 0;
+    bool isDone = false;
+    while (!isDone) {
+        // get the file and the indexes holding RIDs, the handles may be
+        // closed by ReleaseHandles between two batches
+        RM_FileHandle* relFileHandle;
+        if ((rc = GetFileHandle(relName, relFileHandle))) {
             return rc;
         }
-        if (rc == RM_EOF) {
-            break;
+        vector<AttrCat> indexAttrs;
+        vector<IX_IndexHandle*> indexHandles;
+        vector<IX_IndexHandle*> nullHandles;
+        vector<char> include(PF_PAGE_SIZE);
+        for (const auto& attr : attrs) {
+            if (attr.indexNo != -1) {
+                IX_IndexHandle* indexHandle;
+                if ((rc = GetIndexHandle(relName, attr.indexNo, indexHandle))) {
+                    return rc;
+                }
+                IX_IndexHandle* nullHandle;
+                if ((rc = GetIndexHandle(relName, attr.indexNo + 1, nullHandle))) {
+                    return rc;
+                }
+                indexAttrs.push_back(attr);
+                indexHandles.push_back(indexHandle);
+                nullHandles.push_back(nullHandle);
+            }
         }
-        char *attrCatData;
+        vector<IX_IndexHandle*> multiHandles;
+        for (int indexNo : relCache[relName].multiIndexNos) {
+            IX_IndexHandle* indexHandle;
+            if ((rc = GetIndexHandle(relName, indexNo, indexHandle))) {
+                return rc;
+            }
+            multiHandles.push_back(indexHandle);
+        }
+        vector<char> key(PF_PAGE_SIZE);
+        for (int batch = 0; batch < SM_VACUUMBATCH; ++batch) {
+            // free the empty pages at the end of the file
+            if ((rc = relFileHandle->TrimPages(lastPageNum))) {
+                return rc;
+            }
+            if (numPagesBefore == -1) {
+                numPagesBefore = lastPageNum + 1;
+            }
+            // stop once no page before the last one has a free slot
+            PageNum freePageNum;
+            if ((rc = relFileHandle->GetFirstFreePage(freePageNum))) {
+                return rc;
+            }
+            if (freePageNum == RM_NO_PAGE || freePageNum >= lastPageNum || (maxPages > 0 && nPages == maxPages)) {
+                isDone = true;
+                break;
+            }
+            // move the records of the last page, each to the lowest free
+            // slot; the overflow pages of a variable-length table stay
+            vector<RID> rids;
+            if ((rc = relFileHandle->GetPageRids(lastPageNum, rids))) {
+                return rc;
+            }
+            if (rids.empty()) {
+                isDone = true;
+                break;
+            }
+            for (const auto& rid : rids) {
+                if ((rc = relFileHandle->GetFirstFreePage(freePageNum))) {
+                    return rc;
+                }
+                if (freePageNum >= lastPageNum) {
+                    break;
+                }
+                RM_Record record;
+                if ((rc = relFileHandle->GetRec(rid, record))) {
+                    return rc;
+                }
+                char* recordData;
+                if ((rc = record.GetData(recordData))) {
+                    return rc;
+                }
+                RID newRid;
+                if ((rc = relFileHandle->InsertRec(recordData, newRid))) {
+                    return rc;
+                }
+                // point the index entries at the new RID
+                for (unsigned int i = 0; i < indexAttrs.size(); ++i) {
+                    char* value = recordData + indexAttrs[i].offset;
+                    IX_IndexHandle* handle = *value == 0 ? nullHandles[i] : indexHandles[i];
+                    if ((rc = handle->DeleteEntry(value, rid))) {
+                        return rc;
+                    }
+                    handle->GetInclude(recordData, &include[0]);
+                    if ((rc = handle->InsertEntry(value, newRid, &include[0]))) {
+                        return rc;
+                    }
+                }
+                for (auto handle : multiHandles) {
+                    handle->GetKey(recordData, &key[0]);
+                    if ((rc = handle->DeleteEntry(&key[0], rid))) {
+                        return rc;
+                    }
+                    handle->GetInclude(recordData, &include[0]);
+                    if ((rc = handle->InsertEntry(&key[0], newRid, &include[0]))) {
+                        return rc;
+                    }
+                }
+                if ((rc = relFileHandle->DeleteRec(rid))) {
+                    return rc;
+                }
+                ++nRecs;
+            }
+            ++nPages;
+        }
+        // force the batch before going on
+        if ((rc = ReleaseHandles())) {
+            return rc;
+        }
+    }
+    // success
+    cout << "[Vacuum]" << endl
+         << "relName=" << relName << endl
+         << nRecs << " record(s) moved, "
+         << numPagesBefore - (lastPageNum + 1) << " page(s) freed." << endl;
+    return OK_RC;
+}
+
+RC SM_Manager::VacuumFull(const char* relName) {
+    RC rc;
+    // check whether a db is open
+    if (!isOpen) {
+        return SM_DBNOTOPEN;
+    }
+    // find relation relName
+    auto iter = relCache.find(relName);
+    if (iter == relCache.end()) {
+        return SM_RELNOTFOUND;
+    }
+    SM_RelCache& relEntry = iter->second;
+    vector<AttrCat> attrs = relEntry.attrs;
+    int recordSize = SM_VacuumLayout(attrs);
+    vector<int> indexNos;
+    vector<int> indexAttrs;
+    SM_VacuumIndexes(relEntry, indexNos, indexAttrs);
+    // write the new record file and indexes next to the old ones, which
+    // are left alone until they are complete
+    string tmpName = string(relName) + ".tmp";
+    RM_FileHandle newFileHandle;
+    int nRecs = 0;
+    if ((rc = BuildVacuumFiles(relName, tmpName.c_str(), attrs, recordSize, indexNos, indexAttrs, newFileHandle, nRecs))) {
+        rmm.CloseFile(newFileHandle);
+        DestroyVacuumFiles(tmpName.c_str(), indexNos);
+        return rc;
+    }
+    // rename the complete files, the record file last: once it has its
+    // .new name the vacuum is finished, by OpenDb after a crash
+    string newName = string(relName) + ".new";
+    for (unsigned int i = 0; i < indexNos.size() && !rc; ++i) {
+        rc = ixm.RenameIndex(tmpName.c_str(), indexNos[i], newName.c_str());
+    }
+    if (rc || (rc = rmm.RenameFile(tmpName.c_str(), newName.c_str()))) {
+        DestroyVacuumFiles(tmpName.c_str(), indexNos);
+        DestroyVacuumFiles(newName.c_str(), indexNos);
+        return rc;
+    }
+    int tupleLength = relEntry.relCat.tupleLength;
+    if ((rc = FinishVacuumFull(relName))) {
+        return rc;
+    }
+    // success
+    cout << "[VacuumFull]" << endl
+         << "relName=" << relName << endl
+         << nRecs << " record(s) rewritten, tuple length "
+         << tupleLength << " -> " << recordSize << "." << endl;
+    return OK_RC;
+}
+
+RC SM_Manager::BuildVacuumFiles(const char* relName, const char* fileName, const vector<AttrCat>& attrs, int recordSize,
+                                const vector<int>& indexNos, const vector<int>& indexAttrs, RM_FileHandle& newFileHandle,
+                                int& nRecs) {
+    RC rc;
+    SM_RelCache& relEntry = relCache.find(relName)->second;
+    // create the new record file
+    RM_FileHandle* relFileHandle;
+    if ((rc = GetFileHandle(relName, relFileHandle))) {
+        return rc;
+    }
+    bool isVariable = relFileHandle->IsVariable();
+    if ((rc = rmm.CreateFile(fileName, recordSize, isVariable, isVariable ? SM_VarFields(attrs) : vector<RM_VarField>(),
+                             SM_ZoneFields(attrs)))) {
+        return rc;
+    }
+    if ((rc = rmm.OpenFile(fileName, newFileHandle))) {
+        return rc;
+    }
+    int primaryKeyCount = 0;
+    int primaryKeyLength = 0;
+    for (const auto& attr : attrs) {
+        if (attr.primaryKey > 0) {
+            ++primaryKeyCount;
+            primaryKeyLength += attr.attrLength + 1;
+        }
+    }
+    // the included and key attributes of an index move with the new layout
+    vector<vector<IX_IncludeField>> includeFields(indexNos.size());
+    vector<vector<IX_KeyField>> keyFields(indexNos.size());
+    vector<int> keyLengths(indexNos.size());
+    for (unsigned int i = 0; i < indexNos.size(); ++i) {
+        if (indexAttrs[i] == -1) {
+            continue;
+        }
+        IX_IndexHandle* indexHandle;
+        if ((rc = GetIndexHandle(relName, indexNos[i], indexHandle))) {
+            return rc;
+        }
+        for (auto field : indexHandle->GetIncludeFields()) {
+            for (unsigned int j = 0; j < attrs.size(); ++j) {
+                if (relEntry.attrs[j].offset == field.offset) {
+                    field.offset = attrs[j].offset;
+                    field.length = attrs[j].attrLength;
+                    includeFields[i].push_back(field);
+                }
+            }
+        }
+        for (auto field : indexHandle->GetKeyFields()) {
+            for (unsigned int j = 0; j < attrs.size(); ++j) {
+                if (relEntry.attrs[j].offset == field.offset) {
+                    field.offset = attrs[j].offset;
+                    field.length = attrs[j].attrLength;
+                    field.attrType = attrs[j].attrType;
+                    keyFields[i].push_back(field);
+                    keyLengths[i] += field.length + 1;
+                }
+            }
+        }
+    }
+    vector<IX_IndexBuilder> builders(indexNos.size());
+    for (unsigned int i = 0; i < indexNos.size(); ++i) {
+        int includeLength = 0;
+        for (const auto& field : includeFields[i]) {
+            includeLength += field.length + 1;
+        }
+        if (indexAttrs[i] == -1) {
+            rc = builders[i].Open(PRIMARYKEY, primaryKeyLength);
+        } else if (indexAttrs[i] == -2) {
+            rc = builders[i].Open(PRIMARYKEY, keyLengths[i], includeLength);
+        } else {
+            rc = builders[i].Open(attrs[indexAttrs[i]].attrType, attrs[indexAttrs[i]].attrLength, includeLength);
+        }
+        if (rc) {
+            return rc;
+        }
+    }
+    // copy the records
+    RM_FileScan fileScan;
+    if ((rc = fileScan.OpenScan(*relFileHandle, INT, sizeof(int), 0, NO_OP, zero))) {
+        return rc;
+    }
+    vector<char> newData(recordSize);
+    vector<char> key(primaryKeyLength + 1);
+    vector<char> multiKey;
+    vector<char> include;
+    nRecs = 0;
+    while (true) {
+        RM_Record record;
+        if ((rc = fileScan.GetNextRec(record)) != 0 && rc != RM_EOF) {
+            return rc;
+        }
+        if (rc == RM_EOF) {
+            break;
+        }
+        char* recordData;
+        if ((rc = record.GetData(recordData))) {
+            return rc;
+        }
+        fill(newData.begin(), newData.end(), 0);
+        for (unsigned int i = 0; i < attrs.size(); ++i) {
+            const char* value = recordData + relEntry.attrs[i].offset;
+            if (attrs[i].attrLength != relEntry.attrs[i].attrLength) {
+                newData[attrs[i].offset] = *value != 0;
+                if (*value != 0 && !Attr::ParseDate(value + 1, *(int*)&newData[attrs[i].offset + 1])) {
+                    return SM_ATTRNOTMATCH;
+                }
+            } else {
+                memcpy(&newData[attrs[i].offset], value, attrs[i].attrLength + 1);
+            }
+        }
+        RID rid;
+        if ((rc = newFileHandle.InsertRec(&newData[0], rid))) {
+            return rc;
+        }
+        for (unsigned int i = 0; i < indexNos.size(); ++i) {
+            if (indexAttrs[i] == -1) {
+                // QL keeps RID(0, 0) in the index on a multiple primary key
+                SM_PrimaryKey(attrs, &newData[0], primaryKeyCount, key);
+                rc = builders[i].AddEntry(&key[0], RID(0, 0));
+            } else if (indexAttrs[i] == -2) {
+                SM_MultiKey(keyFields[i], &newData[0], multiKey);
+                SM_Include(includeFields[i], &newData[0], include);
+                rc = builders[i].AddEntry(&multiKey[0], rid, &include[0]);
+            } else {
+                // the first index of an attribute holds the values, the
+                // second one the nulls
+                char* value = &newData[attrs[indexAttrs[i]].offset];
+                if ((*value != 0) == (indexNos[i] == attrs[indexAttrs[i]].indexNo)) {
+                    SM_Include(includeFields[i], &newData[0], include);
+                    rc = builders[i].AddEntry(value, rid, &include[0]);
+                }
+            }
+            if (rc) {
+                return rc;
+            }
+        }
+        ++nRecs;
+    }
+    if ((rc = fileScan.CloseScan())) {
+        return rc;
+    }
+    // close the record file and write the indexes
+    if ((rc = rmm.CloseFile(newFileHandle))) {
+        return rc;
+    }
+    for (unsigned int i = 0; i < indexNos.size(); ++i) {
+        if (indexAttrs[i] == -1) {
+            rc = ixm.CreateIndex(fileName, 0, PRIMARYKEY, primaryKeyLength);
+        } else if (indexAttrs[i] == -2) {
+            rc = ixm.CreateIndex(fileName, indexNos[i], PRIMARYKEY, keyLengths[i], includeFields[i], keyFields[i]);
+        } else {
+            rc = ixm.CreateIndex(fileName, indexNos[i], attrs[indexAttrs[i]].attrType, attrs[indexAttrs[i]].attrLength,
+                                 includeFields[i]);
+        }
+        if (rc) {
+            return rc;
+        }
+        IX_IndexHandle indexHandle;
+        if ((rc = ixm.OpenIndex(fileName, indexNos[i], indexHandle))) {
+            return rc;
+        }
+        if ((rc = builders[i].Build(indexHandle))) {
+            ixm.CloseIndex(indexHandle);
+            return rc;
+        }
+        if ((rc = ixm.CloseIndex(indexHandle))) {
+            return rc;
+        }
+    }
+    return OK_RC;
+}
+
+RC SM_Manager::FinishVacuumFull(const char* relName) {
+    RC rc;
+    SM_RelCache& relEntry = relCache.find(relName)->second;
+    // the catalog may already hold the new layout, writing it again
+    // changes nothing
+    vector<AttrCat> attrs = relEntry.attrs;
+    int recordSize = SM_VacuumLayout(attrs);
+    // update the catalog
+    for (unsigned int i = 0; i < attrs.size(); ++i) {
+        RM_Record attrCatRec;
+        if ((rc = attrcatFileHandle.GetRec(relEntry.attrRids[i], attrCatRec))) {
+            return rc;
+        }
+        char* attrCatData;
         if ((rc = attrCatRec.GetData(attrCatData))) {
             return rc;
         }
-        attrs.push_back(AttrCat(attrCatData));
+        attrs[i].WriteRecordData(attrCatData);
+        if ((rc = attrcatFileHandle.UpdateRec(attrCatRec))) {
+            return rc;
+        }
+    }
+    if ((rc = attrcatFileHandle.ForcePages())) {
+        return rc;
+    }
+    relEntry.relCat.tupleLength = recordSize;
+    RM_Record relCatRec;
+    if ((rc = relcatFileHandle.GetRec(relEntry.rid, relCatRec))) {
+        return rc;
+    }
+    char* relCatData;
+    if ((rc = relCatRec.GetData(relCatData))) {
+        return rc;
+    }
+    relEntry.relCat.WriteRecordData(relCatData);
+    if ((rc = relcatFileHandle.UpdateRec(relCatRec))) {
+        return rc;
+    }
+    if ((rc = relcatFileHandle.ForcePages())) {
+        return rc;
+    }
+    relEntry.attrs = attrs;
+    // move the new files over the old ones, the record file last
+    if ((rc = CloseHandles(relName))) {
+        return rc;
+    }
+    string newName = string(relName) + ".new";
+    vector<int> indexNos;
+    vector<int> indexAttrs;
+    SM_VacuumIndexes(relEntry, indexNos, indexAttrs);
+    for (int indexNo : indexNos) {
+        if (ixm.IndexExists(newName.c_str(), indexNo) && (rc = ixm.RenameIndex(newName.c_str(), indexNo, relName))) {
+            return rc;
+        }
+    }
+    if ((rc = rmm.RenameFile(newName.c_str(), relName))) {
+        return rc;
+    }
+    return OK_RC;
+}
+
+void SM_Manager::DestroyVacuumFiles(const char* fileName, const vector<int>& indexNos) {
+    if (access(fileName, F_OK) == 0) {
+        rmm.DestroyFile(fileName);
+    }
+    for (int indexNo : indexNos) {
+        if (ixm.IndexExists(fileName, indexNo)) {
+            ixm.DestroyIndex(fileName, indexNo);
+        }
+    }
+}
+
+RC SM_Manager::CheckRelExist(const char* relName, RM_Record& relCatRec) {
+    auto iter = relCache.find(relName);
+    if (iter == relCache.end()) {
+        return SM_RELNOTFOUND;
+    }
+    return relcatFileHandle.GetRec(iter->second.rid, relCatRec);
+}
+
+RC SM_Manager::GetAttrs(const char* relName, vector<AttrCat>& attrs) {
+    auto iter = relCache.find(relName);
+    if (iter != relCache.end()) {
+        attrs.insert(attrs.end(), iter->second.attrs.begin(), iter->second.attrs.end());
+    }
+    return OK_RC;
+}
+
+RC SM_Manager::GetRelCat(const char* relName, RelCat& relCat) {
+    auto iter = relCache.find(relName);
+    if (iter == relCache.end()) {
+        return SM_RELNOTFOUND;
+    }
+    relCat = iter->second.relCat;
+    return OK_RC;
+}
+
+RC SM_Manager::GetAttr(const char* relName, const char* attrName, AttrCat& attr) {
+    auto iter = relCache.find(relName);
+    if (iter == relCache.end()) {
+        return SM_RELNOTFOUND;
+    }
+    auto attrIter = iter->second.attrIndex.find(attrName);
+    if (attrIter == iter->second.attrIndex.end()) {
+        return SM_ATTRNOTFOUND;
+    }
+    attr = iter->second.attrs[attrIter->second];
+    return OK_RC;
+}
+
+RC SM_Manager::LoadCatalog() {
+    RC rc;
+    relCache.clear();
+    // read every relation in relcat
+    RM_FileScan fileScan;
+    if ((rc = fileScan.OpenScan(relcatFileHandle, INT, sizeof(int), 0, NO_OP, zero))) {
+        return rc;
+    }
+    while (true) {
+        RM_Record record;
+        if ((rc = fileScan.GetNextRec(record)) != 0 && rc != RM_EOF) {
+            return rc;
+        }
+        if (rc == RM_EOF) {
+            break;
+        }
+        char* recordData;
+        if ((rc = record.GetData(recordData))) {
+            return rc;
+        }
+        RelCat relCat(recordData);
+        SM_RelCache& relEntry = relCache[relCat.relName];
+        relEntry.relCat = relCat;
+        if ((rc = record.GetRid(relEntry.rid))) {
+            return rc;
+        }
     }
     if ((rc = fileScan.CloseScan())) {
         return rc;
     }
-    sort(attrs.begin(), attrs.end(), [](AttrCat a, AttrCat b) -> bool { return a.offset < b.offset; });
+    // read every attribute in attrcat
+    if ((rc = fileScan.OpenScan(attrcatFileHandle, INT, sizeof(int), 0, NO_OP, zero))) {
+        return rc;
+    }
+    while (true) {
+        RM_Record record;
+        if ((rc = fileScan.GetNextRec(record)) != 0 && rc != RM_EOF) {
+            return rc;
+        }
+        if (rc == RM_EOF) {
+            break;
+        }
+        char* recordData;
+        if ((rc = record.GetData(recordData))) {
+            return rc;
+        }
+        AttrCat attrCat(recordData);
+        RID rid;
+        if ((rc = record.GetRid(rid))) {
+            return rc;
+        }
+        SM_RelCache& relEntry = relCache[attrCat.relName];
+        relEntry.attrs.push_back(attrCat);
+        relEntry.attrRids.push_back(rid);
+    }
+    if ((rc = fileScan.CloseScan())) {
+        return rc;
+    }
+    // the other index files of a relation are its multi-column indexes,
+    // described by their index headers
+    for (auto& item : relCache) {
+        SM_RelCache& relEntry = item.second;
+        relEntry.SortAttrs();
+        vector<bool> isUsed(relEntry.relCat.indexCount + 1);
+        for (const auto& attr : relEntry.attrs) {
+            if (attr.indexNo != -1) {
+                isUsed[attr.indexNo] = isUsed[attr.indexNo + 1] = true;
+            }
+            if (attr.primaryKey > 1) {
+                isUsed[0] = true;
+            }
+        }
+        for (int indexNo = 0; indexNo < relEntry.relCat.indexCount; ++indexNo) {
+            if (!isUsed[indexNo] && ixm.IndexExists(item.first.c_str(), indexNo)) {
+                relEntry.multiIndexNos.push_back(indexNo);
+            }
+        }
+    }
+    return OK_RC;
+}
+
+RC SM_Manager::GetFileHandle(const char* relName, RM_FileHandle*& fileHandle) {
+    RC rc;
+    // check whether a db is open
+    if (!isOpen) {
+        return SM_DBNOTOPEN;
+    }
+    SM_OpenFile* openFile;
+    if ((rc = GetOpenFile(relName, -1, openFile))) {
+        return rc;
+    }
+    fileHandle = openFile->fileHandle;
+    return OK_RC;
+}
+
+RC SM_Manager::GetIndexHandle(const char* relName, int indexNo, IX_IndexHandle*& indexHandle) {
+    RC rc;
+    // check whether a db is open
+    if (!isOpen) {
+        return SM_DBNOTOPEN;
+    }
+    SM_OpenFile* openFile;
+    if ((rc = GetOpenFile(relName, indexNo, openFile))) {
+        return rc;
+    }
+    indexHandle = openFile->indexHandle;
+    return OK_RC;
+}
+
+RC SM_Manager::ReleaseHandles(bool force) {
+    RC rc;
+    if (force) {
+        // the files used since the last forcing call are at the front
+        for (auto iter = openFiles.begin(); iter != openFiles.end() && iter->lastUse > forceClock; ++iter) {
+            if (iter->fileHandle != NULL && (rc = iter->fileHandle->ForcePages())) {
+                return rc;
+            }
+            if (iter->indexHandle != NULL && (rc = iter->indexHandle->ForcePages())) {
+                return rc;
+            }
+        }
+        forceClock = useClock;
+    }
+    releaseClock = useClock;
+    // close the least recently used files beyond the budget
+    while (openFiles.size() > SM_MAXOPENFILES) {
+        if ((rc = CloseOpenFile(--openFiles.end()))) {
+            return rc;
+        }
+    }
+    return OK_RC;
+}
+
+RC SM_Manager::GetOpenFile(const char* relName, int indexNo, SM_OpenFile*& openFile) {
+    RC rc;
+    pair<string, int> key(relName, indexNo);
+    auto found = openFileIndex.find(key);
+    if (found != openFileIndex.end()) {
+        // move to the front
+        openFiles.splice(openFiles.begin(), openFiles, found->second);
+    } else {
+        // make room by closing files no handle of the running statement
+        // points to, i.e. those not used since the last ReleaseHandles
+        while (openFiles.size() >= SM_MAXOPENFILES && openFiles.back().lastUse <= releaseClock) {
+            if ((rc = CloseOpenFile(--openFiles.end()))) {
+                return rc;
+            }
+        }
+        SM_OpenFile newFile;
+        newFile.relName = relName;
+        newFile.indexNo = indexNo;
+        newFile.fileHandle = NULL;
+        newFile.indexHandle = NULL;
+        if (indexNo == -1) {
+            newFile.fileHandle = new RM_FileHandle;
+            if ((rc = rmm.OpenFile(relName, *newFile.fileHandle))) {
+                delete newFile.fileHandle;
+                return rc;
+            }
+        } else {
+            newFile.indexHandle = new IX_IndexHandle;
+            if ((rc = ixm.OpenIndex(relName, indexNo, *newFile.indexHandle))) {
+                delete newFile.indexHandle;
+                return rc;
+            }
+        }
+        openFiles.push_front(newFile);
+        openFileIndex[key] = openFiles.begin();
+    }
+    openFile = &openFiles.front();
+    openFile->lastUse = ++useClock;
+    return OK_RC;
+}
+
+RC SM_Manager::CloseHandles(const char* relName) {
+    RC rc;
+    for (auto iter = openFiles.begin(); iter != openFiles.end(); ) {
+        auto next = iter;
+        ++next;
+        if (relName == NULL || iter->relName == relName) {
+            if ((rc = CloseOpenFile(iter))) {
+                return rc;
+            }
+        }
+        iter = next;
+    }
+    return OK_RC;
+}
+
+RC SM_Manager::CloseOpenFile(list<SM_OpenFile>::iterator iter) {
+    RC rc;
+    // closing flushes the pages of the file
+    if (iter->fileHandle != NULL && (rc = rmm.CloseFile(*iter->fileHandle))) {
+        return rc;
+    }
+    if (iter->indexHandle != NULL && (rc = ixm.CloseIndex(*iter->indexHandle))) {
+        return rc;
+    }
+    delete iter->fileHandle;
+    delete iter->indexHandle;
+    openFileIndex.erase(make_pair(iter->relName, iter->indexNo));
+    openFiles.erase(iter);
     return OK_RC;
 }